@@ -0,0 +1,332 @@
+/**
+ * @file admission.c
+ * @brief Implémentation du contrôle d'admission : limite du nombre de transferts actifs
+ *        et files d'attente bornées des requêtes reçues en surcharge.
+ *        Un créneau libéré va à la plus ancienne petite requête ; après ADMISSION_SMALL_BURST petites requêtes,
+ *        la plus ancienne grosse requête passe (si un créneau « gros fichier » est libre). Les requêtes en attente
+ *        sont démarrées par un thread dédié (admission_next), jamais par le thread d'un transfert qui se termine :
+ *        un thread dont la priorité a été abaissée ne doit pas créer les threads des transferts suivants.
+ */
+
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#include "admission.h"
+
+#define IOPRIO_CLASS_SHIFT 13
+#define IOPRIO_CLASS_BE 2
+#define IOPRIO_WHO_PROCESS 1
+
+
+
+/**
+ * Fonction : elapsed_ms
+ * Description : Cette fonction calcule le temps écoulé (en millisecondes) depuis une date donnée.
+ * @param start : La date de départ (CLOCK_MONOTONIC).
+ * @return : Le temps écoulé en millisecondes.
+ */
+static double elapsed_ms(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000.0 + (now.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+
+
+
+/**
+ * Fonction : admission_init
+ * Description : Cette fonction initialise le contrôle d'admission à partir de la configuration.
+ * @param adm : Un pointeur vers la structure de contrôle d'admission.
+ * @param cfg : Un pointeur vers la configuration du serveur.
+ * @return : 0 en cas de succès, -1 en cas d'échec d'allocation.
+ */
+int admission_init(AdmissionControl* adm, const ServerConfig* cfg) {
+    memset(adm, 0, sizeof(*adm));
+    adm->max_active = cfg->max_transfers;
+    adm->policy = cfg->overflow_policy;
+    adm->queue_timeout = cfg->queue_timeout;
+    adm->capacity = (cfg->overflow_policy == OVERFLOW_QUEUE) ? cfg->queue_size : 0;
+
+    // Créneaux réservés aux petits fichiers : il en reste toujours au moins un pour les gros
+    int reserved = cfg->small_size > 0 ? cfg->small_slots : 0;
+    if (reserved > adm->max_active - 1) {
+        reserved = adm->max_active > 0 ? adm->max_active - 1 : 0;
+    }
+    adm->max_large = adm->max_active - reserved;
+
+    // Chaque file peut contenir toute la capacité (la limite commune est adm->capacity)
+    if (adm->capacity > 0) {
+        for (int c = 0; c < ADMISSION_NUM_CLASSES; c++) {
+            adm->queues[c].items = (PendingRequest*)malloc(adm->capacity * sizeof(PendingRequest));
+            if (adm->queues[c].items == NULL) {
+                return -1;
+            }
+        }
+    }
+    pthread_mutex_init(&adm->mutex, NULL);
+    pthread_cond_init(&adm->ready, NULL);
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : slot_available
+ * Description : Cette fonction indique si un transfert de la classe donnée peut démarrer (appelée sous le verrou).
+ * @param adm : Un pointeur vers la structure de contrôle d'admission.
+ * @param size_class : La classe de la requête.
+ * @return : true si un créneau est libre pour cette classe.
+ */
+static bool slot_available(const AdmissionControl* adm, AdmissionClass size_class) {
+    if (adm->max_active == 0) {
+        return true;
+    }
+    return adm->active < adm->max_active && (size_class == ADMISSION_SMALL || adm->active_large < adm->max_large);
+}
+
+
+
+
+/**
+ * Fonction : take_slot
+ * Description : Cette fonction réserve un créneau pour un transfert de la classe donnée (appelée sous le verrou).
+ * @param adm : Un pointeur vers la structure de contrôle d'admission.
+ * @param size_class : La classe du transfert.
+ * @return : Aucune valeur de retour
+ */
+static void take_slot(AdmissionControl* adm, AdmissionClass size_class) {
+    adm->active++;
+    if (size_class == ADMISSION_LARGE) {
+        adm->active_large++;
+    }
+    adm->started[size_class]++;
+}
+
+
+
+
+/**
+ * Fonction : choose_queue
+ * Description : Cette fonction choisit la file de la prochaine requête à démarrer (appelée sous le verrou) :
+ *               les petites requêtes d'abord, une grosse après ADMISSION_SMALL_BURST petites.
+ * @param adm : Un pointeur vers la structure de contrôle d'admission.
+ * @return : La classe choisie, ou ADMISSION_NUM_CLASSES si aucune requête ne peut démarrer.
+ */
+static AdmissionClass choose_queue(const AdmissionControl* adm) {
+    bool small_ready = adm->queues[ADMISSION_SMALL].count > 0 && slot_available(adm, ADMISSION_SMALL);
+    bool large_ready = adm->queues[ADMISSION_LARGE].count > 0 && slot_available(adm, ADMISSION_LARGE);
+
+    if (small_ready && (!large_ready || adm->small_streak < ADMISSION_SMALL_BURST)) {
+        return ADMISSION_SMALL;
+    }
+    return large_ready ? ADMISSION_LARGE : ADMISSION_NUM_CLASSES;
+}
+
+
+
+
+/**
+ * Fonction : admission_request
+ * Description : Cette fonction décide du sort d'une nouvelle requête : démarrage immédiat si un créneau est libre
+ *               pour sa classe, sinon application de la politique de surcharge (file d'attente, abandon ou erreur).
+ *               En cas d'acceptation, le créneau est réservé et devra être rendu par admission_release.
+ * @param adm : Un pointeur vers la structure de contrôle d'admission.
+ * @param client_addr : L'adresse du client.
+ * @param packet : Le paquet de requête reçu.
+ * @param packet_len : La taille du paquet reçu.
+ * @param request : La requête analysée (vues dans packet).
+ * @param size_class : La classe de taille de la requête.
+ * @return : La décision prise pour la requête.
+ */
+AdmissionDecision admission_request(AdmissionControl* adm, struct sockaddr_in client_addr, const char* packet, ssize_t packet_len,
+                                    const TFTP_Request* request, AdmissionClass size_class) {
+    pthread_mutex_lock(&adm->mutex);
+
+    // Un créneau rendu revient d'abord aux requêtes en attente qui peuvent démarrer (voir admission_next)
+    if (slot_available(adm, size_class) && choose_queue(adm) == ADMISSION_NUM_CLASSES) {
+        take_slot(adm, size_class);
+        adm->admitted++;
+        pthread_mutex_unlock(&adm->mutex);
+        return ADMISSION_ACCEPTED;
+    }
+
+    if (adm->policy == OVERFLOW_ERROR) {
+        adm->rejected++;
+        pthread_mutex_unlock(&adm->mutex);
+        return ADMISSION_REJECTED;
+    }
+
+    // Retransmission d'une requête déjà en attente : on ne la met pas deux fois dans la file
+    for (int c = 0; c < ADMISSION_NUM_CLASSES; c++) {
+        PendingQueue* queue = &adm->queues[c];
+        for (int i = 0; i < queue->count; i++) {
+            PendingRequest* pending = &queue->items[(queue->head + i) % adm->capacity];
+            if (memcmp(&pending->client_addr, &client_addr, sizeof(client_addr)) == 0) {
+                pthread_mutex_unlock(&adm->mutex);
+                return ADMISSION_DUPLICATE;
+            }
+        }
+    }
+
+    if (adm->count >= adm->capacity) {  // Politique drop, ou file pleine
+        adm->dropped++;
+        pthread_mutex_unlock(&adm->mutex);
+        return ADMISSION_DROPPED;
+    }
+
+    PendingQueue* queue = &adm->queues[size_class];
+    PendingRequest* slot = &queue->items[(queue->head + queue->count) % adm->capacity];
+    slot->client_addr = client_addr;
+    memcpy(slot->packet, packet, packet_len);
+    slot->packet_len = packet_len;
+    slot->request = *request;
+    rebase_request(&slot->request, packet, slot->packet);
+    slot->size_class = size_class;
+    slot->wait_ms = 0;
+    clock_gettime(CLOCK_MONOTONIC, &slot->enqueued_at);
+    queue->count++;
+    adm->count++;
+    adm->queued++;
+    if (adm->count > adm->max_queue_length) {
+        adm->max_queue_length = adm->count;
+    }
+
+    pthread_mutex_unlock(&adm->mutex);
+    return ADMISSION_QUEUED;
+}
+
+
+
+
+/**
+ * Fonction : admission_release
+ * Description : Cette fonction rend le créneau d'un transfert terminé (ou qui n'a pas pu démarrer). Si une requête
+ *               en attente peut alors démarrer, le thread de démarrage est réveillé ; le thread appelant ne la
+ *               démarre pas lui-même.
+ * @param adm : Un pointeur vers la structure de contrôle d'admission.
+ * @param finished : La classe du transfert terminé.
+ * @return : Aucune valeur de retour
+ */
+void admission_release(AdmissionControl* adm, AdmissionClass finished) {
+    pthread_mutex_lock(&adm->mutex);
+    adm->active--;
+    if (finished == ADMISSION_LARGE) {
+        adm->active_large--;
+    }
+    if (choose_queue(adm) != ADMISSION_NUM_CLASSES) {
+        pthread_cond_signal(&adm->ready);
+    }
+    pthread_mutex_unlock(&adm->mutex);
+}
+
+
+
+
+/**
+ * Fonction : admission_next
+ * Description : Cette fonction attend qu'une requête en attente puisse démarrer, la retire de sa file et lui
+ *               réserve un créneau (à rendre par admission_release). Appelée en boucle par le thread de démarrage.
+ *               Les requêtes ayant attendu plus longtemps que queue_timeout sont abandonnées : le client a abandonné.
+ * @param adm : Un pointeur vers la structure de contrôle d'admission.
+ * @param next : Un pointeur vers la structure qui reçoit la requête à démarrer.
+ * @return : Aucune valeur de retour
+ */
+void admission_next(AdmissionControl* adm, PendingRequest* next) {
+    pthread_mutex_lock(&adm->mutex);
+
+    for (;;) {
+        AdmissionClass size_class = choose_queue(adm);
+        if (size_class == ADMISSION_NUM_CLASSES) {
+            pthread_cond_wait(&adm->ready, &adm->mutex);
+            continue;
+        }
+        PendingQueue* queue = &adm->queues[size_class];
+        PendingRequest* pending = &queue->items[queue->head];
+        queue->head = (queue->head + 1) % adm->capacity;
+        queue->count--;
+        adm->count--;
+
+        double waited = elapsed_ms(&pending->enqueued_at);
+        if (adm->queue_timeout > 0 && waited > adm->queue_timeout * 1000.0) {
+            adm->expired++;     // Sans effet sur l'alternance petites/grosses requêtes
+            continue;
+        }
+
+        if (size_class == ADMISSION_SMALL) {
+            adm->small_streak++;
+        } else {
+            if (adm->queues[ADMISSION_SMALL].count > 0 && slot_available(adm, ADMISSION_SMALL)) {
+                adm->promoted++;
+            }
+            adm->small_streak = 0;
+        }
+        *next = *pending;
+        rebase_request(&next->request, pending->packet, next->packet);
+        next->wait_ms = waited;
+        take_slot(adm, size_class);
+        adm->dequeued++;
+        adm->total_wait_ms += waited;
+        if (waited > adm->max_wait_ms) {
+            adm->max_wait_ms = waited;
+        }
+        pthread_mutex_unlock(&adm->mutex);
+        return;
+    }
+}
+
+
+
+
+/**
+ * Fonction : admission_lower_priority
+ * Description : Cette fonction abaisse la priorité processeur (nice) et disque (ioprio) du thread appelant,
+ *               qui transfère un gros fichier : les petits transferts concurrents sont servis en premier.
+ *               Les deux réglages s'appliquent au thread seul (identifiant gettid) sous Linux.
+ * @return : Aucune valeur de retour
+ */
+void admission_lower_priority(void) {
+    pid_t tid = (pid_t) syscall(SYS_gettid);
+    if (setpriority(PRIO_PROCESS, tid, ADMISSION_LARGE_NICE) < 0) {
+        perror("Erreur lors de l'abaissement de la priorité du thread");
+    }
+    syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, tid, IOPRIO_CLASS_BE << IOPRIO_CLASS_SHIFT | ADMISSION_LARGE_IOPRIO);
+}
+
+
+
+
+/**
+ * Fonction : admission_report
+ * Description : Cette fonction affiche l'état du contrôle d'admission (transferts actifs, longueur de file, temps d'attente).
+ * @param adm : Un pointeur vers la structure de contrôle d'admission.
+ * @param out : Le flux de sortie.
+ * @return : Aucune valeur de retour
+ */
+void admission_report(AdmissionControl* adm, FILE* out) {
+    pthread_mutex_lock(&adm->mutex);
+
+    double oldest_ms = 0;
+    for (int c = 0; c < ADMISSION_NUM_CLASSES; c++) {
+        const PendingQueue* queue = &adm->queues[c];
+        if (queue->count > 0 && elapsed_ms(&queue->items[queue->head].enqueued_at) > oldest_ms) {
+            oldest_ms = elapsed_ms(&queue->items[queue->head].enqueued_at);
+        }
+    }
+    fprintf(out, "[ADMISSION] actifs %d/%d (gros fichiers %d/%d) | file %d/%d (max %d, plus ancienne %.1f ms)\n",
+            adm->active, adm->max_active, adm->active_large, adm->max_large, adm->count, adm->capacity,
+            adm->max_queue_length, oldest_ms);
+    fprintf(out, "[ADMISSION] petits fichiers : démarrés %lu, en file %d | gros fichiers : démarrés %lu, en file %d, passés devant %lu\n",
+            adm->started[ADMISSION_SMALL], adm->queues[ADMISSION_SMALL].count,
+            adm->started[ADMISSION_LARGE], adm->queues[ADMISSION_LARGE].count, adm->promoted);
+    fprintf(out, "[ADMISSION] admis %lu | mis en file %lu | sortis de file %lu | expirés %lu | ignorés %lu | refusés %lu\n",
+            adm->admitted, adm->queued, adm->dequeued, adm->expired, adm->dropped, adm->rejected);
+    fprintf(out, "[ADMISSION] attente moyenne %.1f ms | attente max %.1f ms\n",
+            adm->dequeued > 0 ? adm->total_wait_ms / adm->dequeued : 0.0, adm->max_wait_ms);
+
+    pthread_mutex_unlock(&adm->mutex);
+}
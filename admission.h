@@ -0,0 +1,123 @@
+/**
+ * @file admission.h
+ * @brief Contrôle d'admission des transferts et file d'attente des requêtes en surcharge.
+ *        Les requêtes sont classées par taille de fichier : les petits fichiers (menus de démarrage, configurations)
+ *        passent devant les gros, qui disposent d'un nombre limité de créneaux mais ne peuvent pas être affamés.
+ */
+
+
+#include <pthread.h>
+#include <time.h>
+
+#include "tftp.h"
+#include "config.h"
+
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#define ADMISSION_SMALL_BURST 4         /* Petites requêtes démarrées au plus avant une grosse requête en attente */
+#define ADMISSION_LARGE_NICE 10         /* Priorité (nice) d'un thread qui transfère un gros fichier */
+#define ADMISSION_LARGE_IOPRIO 7        /* Niveau d'E/S (classe best-effort, 0-7) d'un tel thread */
+
+/**
+ * @enum AdmissionDecision
+ * @brief Décision prise pour une nouvelle requête.
+ */
+typedef enum {
+    ADMISSION_ACCEPTED = 0, /* Un créneau est libre : le transfert peut démarrer */
+    ADMISSION_QUEUED,       /* La requête est placée dans la file d'attente */
+    ADMISSION_DUPLICATE,    /* La requête est déjà dans la file (retransmission du client) */
+    ADMISSION_DROPPED,      /* La requête est ignorée silencieusement */
+    ADMISSION_REJECTED      /* La requête doit recevoir un paquet d'erreur */
+} AdmissionDecision;
+
+
+
+
+/**
+ * @enum AdmissionClass
+ * @brief Classe de taille d'une requête.
+ */
+typedef enum {
+    ADMISSION_SMALL = 0,    /* Fichier de taille connue, sous le seuil : prioritaire */
+    ADMISSION_LARGE,        /* Gros fichier, ou taille inconnue (WRQ, fichier absent) */
+    ADMISSION_NUM_CLASSES
+} AdmissionClass;
+
+
+
+
+/**
+ * @struct PendingRequest
+ * @brief Requête en attente d'un créneau de transfert.
+ */
+typedef struct PendingRequest {
+    struct sockaddr_in client_addr;
+    char packet[MAX_PACKET_SIZE];
+    ssize_t packet_len;
+    TFTP_Request request;           /* Requête analysée par le thread d'écoute (vues dans packet) */
+    AdmissionClass size_class;
+    struct timespec enqueued_at;    /* Date de mise en file */
+    double wait_ms;                 /* Temps passé dans la file (rempli au retrait) */
+} PendingRequest;
+
+
+
+
+/**
+ * @struct PendingQueue
+ * @brief File FIFO des requêtes en attente d'une classe (tampon circulaire).
+ */
+typedef struct PendingQueue {
+    PendingRequest* items;
+    int head;
+    int count;
+} PendingQueue;
+
+
+
+
+/**
+ * @struct AdmissionControl
+ * @brief Compteur des transferts actifs et files bornées des requêtes en attente (une par classe de taille).
+ */
+typedef struct AdmissionControl {
+    int max_active;             /* Nombre maximum de transferts simultanés (0 = illimité) */
+    int active;                 /* Nombre de transferts en cours */
+    int max_large;              /* Créneaux utilisables par les gros fichiers (les autres leur sont réservés) */
+    int active_large;
+    OverflowPolicy policy;
+    int queue_timeout;          /* Attente maximale (s) avant abandon d'une requête */
+
+    PendingQueue queues[ADMISSION_NUM_CLASSES];
+    int capacity;               /* Requêtes en attente au plus, toutes classes confondues */
+    int count;
+    int small_streak;           /* Petites requêtes démarrées depuis la dernière grosse */
+
+    pthread_mutex_t mutex;
+    pthread_cond_t ready;       /* Une requête en attente peut démarrer (attendu par le thread de démarrage) */
+
+    /* Statistiques */
+    unsigned long admitted;     /* Transferts démarrés directement */
+    unsigned long queued;       /* Requêtes mises en file */
+    unsigned long dequeued;     /* Requêtes démarrées après attente */
+    unsigned long expired;      /* Requêtes abandonnées après un délai trop long */
+    unsigned long dropped;      /* Requêtes ignorées (file pleine ou politique drop) */
+    unsigned long rejected;     /* Requêtes refusées avec un paquet d'erreur */
+    unsigned long started[ADMISSION_NUM_CLASSES];   /* Transferts démarrés, par classe */
+    unsigned long promoted;     /* Grosses requêtes démarrées avant des petites en attente (anti-famine) */
+    int max_queue_length;
+    double total_wait_ms;
+    double max_wait_ms;
+} AdmissionControl;
+
+
+
+int admission_init(AdmissionControl* adm, const ServerConfig* cfg);
+AdmissionDecision admission_request(AdmissionControl* adm, struct sockaddr_in client_addr, const char* packet, ssize_t packet_len, const TFTP_Request* request, AdmissionClass size_class);
+void admission_release(AdmissionControl* adm, AdmissionClass finished);
+void admission_next(AdmissionControl* adm, PendingRequest* next);
+void admission_lower_priority(void);
+void admission_report(AdmissionControl* adm, FILE* out);
+
+#endif
@@ -0,0 +1,692 @@
+/**
+ * @file bench.c
+ * @brief Microbenchmarks de la couche de synchronisation (sync.c), des recherches dans les tables
+ *        (fichiers, clients) et de l'analyse des requêtes RRQ/WRQ, test aléatoire (fuzz) de cette analyse et
+ *        vérification des écritures creuses (sparse.c). Chaque mesure est écrite sur une ligne JSON, pour être
+ *        comparée d'une version à l'autre.
+ *
+ *        Usage : ./bench [-s all|sync|lookup|parse|fuzz|sparse] [-n opérations] [-t threads max] [-o fichier]
+ */
+
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "tftp.h"
+#include "fsroot.h"
+#include "sparse.h"
+
+
+#define BENCH_DEFAULT_OPS 200000        /* Opérations par mesure (réparties entre les threads) */
+#define BENCH_DEFAULT_THREADS 64        /* Nombre maximum de threads pour les mesures de sync */
+
+
+/**
+ * @struct SyncWorker
+ * @brief Paramètres et résultats d'un thread de la mesure de synchronisation.
+ */
+typedef struct SyncWorker {
+    FileList* file_list;
+    char filename[256];
+    bool write;                 /* sync_start_write/sync_end_write au lieu de la lecture */
+    long ops;
+    uint64_t* latencies;        /* Durée de chaque couple début/fin (ns) */
+    pthread_barrier_t* barrier;
+} SyncWorker;
+
+
+static FILE* out;               /* Résultats JSON (stdout par défaut) */
+
+
+
+
+/**
+ * Fonction : now_ns
+ * Description : Cette fonction retourne la date courante en nanosecondes (horloge monotone).
+ * @return : La date courante en nanosecondes.
+ */
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+
+
+/**
+ * Fonction : compare_u64
+ * Description : Fonction de comparaison pour qsort (ordre croissant).
+ */
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*) a;
+    uint64_t y = *(const uint64_t*) b;
+    return (x > y) - (x < y);
+}
+
+
+
+
+/**
+ * Fonction : percentile
+ * Description : Cette fonction retourne le centile demandé d'un tableau trié.
+ * @param sorted : Les valeurs triées.
+ * @param count : Le nombre de valeurs.
+ * @param p : Le centile (entre 0 et 100).
+ * @return : La valeur du centile.
+ */
+static uint64_t percentile(const uint64_t* sorted, size_t count, double p) {
+    size_t index = (size_t) (p / 100.0 * (count - 1) + 0.5);
+    return sorted[index < count ? index : count - 1];
+}
+
+
+
+
+/**
+ * Fonction : sync_worker
+ * Description : Corps d'un thread de la mesure de synchronisation : enchaîne les couples début/fin
+ *               de lecture (ou d'écriture) et mesure chacun.
+ * @param arg : Un pointeur vers le SyncWorker du thread.
+ * @return : NULL
+ */
+static void* sync_worker(void* arg) {
+    SyncWorker* w = (SyncWorker*) arg;
+
+    pthread_barrier_wait(w->barrier);
+    for (long i = 0; i < w->ops; i++) {
+        uint64_t start = now_ns();
+        if (w->write) {
+            if (sync_start_write(w->filename, w->file_list) == 0) {
+                sync_end_write(w->filename, w->file_list);
+            }
+        } else if (sync_start_read(w->filename, w->file_list) == 0) {
+            sync_end_read(w->filename, w->file_list);
+        }
+        w->latencies[i] = now_ns() - start;
+    }
+    return NULL;
+}
+
+
+
+
+/**
+ * Fonction : bench_sync_case
+ * Description : Cette fonction mesure le débit et la latence de la couche de synchronisation
+ *               pour un nombre de threads, un type d'accès et un partage de fichier donnés.
+ * @param write : Mesure des écritures (sinon des lectures).
+ * @param same_file : Tous les threads accèdent au même fichier (sinon un fichier par thread).
+ * @param threads : Le nombre de threads.
+ * @param total_ops : Le nombre total d'opérations, réparti entre les threads.
+ * @return : 0 en cas de succès, -1 en cas d'échec.
+ */
+static int bench_sync_case(bool write, bool same_file, int threads, long total_ops) {
+    FileList file_list;
+    pthread_barrier_t barrier;
+    long ops = total_ops / threads > 0 ? total_ops / threads : 1;
+
+    SyncWorker* workers = calloc(threads, sizeof(SyncWorker));
+    pthread_t* tids = calloc(threads, sizeof(pthread_t));
+    uint64_t* latencies = malloc(sizeof(uint64_t) * ops * threads);
+    if (workers == NULL || tids == NULL || latencies == NULL) {
+        free(workers);
+        free(tids);
+        free(latencies);
+        return -1;
+    }
+
+    initialize_fileList(&file_list);
+    pthread_barrier_init(&barrier, NULL, threads + 1);
+    for (int i = 0; i < threads; i++) {
+        workers[i].file_list = &file_list;
+        snprintf(workers[i].filename, sizeof(workers[i].filename), "bench/%s-%d.bin", write ? "w" : "r", same_file ? 0 : i);
+        workers[i].write = write;
+        workers[i].ops = ops;
+        workers[i].latencies = latencies + (size_t) i * ops;
+        workers[i].barrier = &barrier;
+        pthread_create(&tids[i], NULL, sync_worker, &workers[i]);
+    }
+
+    pthread_barrier_wait(&barrier);
+    uint64_t start = now_ns();
+    for (int i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    uint64_t elapsed = now_ns() - start;
+
+    size_t count = (size_t) ops * threads;
+    qsort(latencies, count, sizeof(uint64_t), compare_u64);
+    fprintf(out, "{\"suite\":\"sync\",\"op\":\"%s\",\"files\":\"%s\",\"threads\":%d,\"ops\":%zu,"
+                 "\"ops_per_sec\":%.0f,\"p50_ns\":%" PRIu64 ",\"p99_ns\":%" PRIu64 ",\"max_ns\":%" PRIu64 ","
+                 "\"waits\":%lu,\"list_contended\":%lu}\n",
+            write ? "write" : "read", same_file ? "same" : "distinct", threads, count,
+            count / (elapsed / 1e9), percentile(latencies, count, 50), percentile(latencies, count, 99),
+            latencies[count - 1], file_list.stats.read_waits + file_list.stats.write_waits, file_list.stats.list_contended);
+    fflush(out);
+
+    pthread_barrier_destroy(&barrier);
+    pthread_mutex_destroy(&file_list.files_mutex);
+    free(workers);
+    free(tids);
+    free(latencies);
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : bench_sync
+ * Description : Cette fonction lance les mesures de synchronisation de 1 à max_threads threads (puissances de 2),
+ *               en lecture et en écriture, sur un même fichier et sur des fichiers distincts.
+ * @param max_threads : Le nombre maximum de threads.
+ * @param total_ops : Le nombre d'opérations par mesure.
+ * @return : 0 en cas de succès, -1 en cas d'échec.
+ */
+static int bench_sync(int max_threads, long total_ops) {
+    for (int write = 0; write <= 1; write++) {
+        for (int same = 1; same >= 0; same--) {
+            for (int threads = 1; threads <= max_threads; threads *= 2) {
+                if (bench_sync_case(write, same, threads, total_ops) < 0) {
+                    return -1;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : report_lookup
+ * Description : Cette fonction écrit le résultat d'une mesure de recherche.
+ */
+static void report_lookup(const char* table, const char* result, int size, long ops, uint64_t elapsed) {
+    fprintf(out, "{\"suite\":\"lookup\",\"table\":\"%s\",\"result\":\"%s\",\"size\":%d,\"ops\":%ld,\"ns_per_op\":%.1f}\n",
+            table, result, size, ops, (double) elapsed / ops);
+    fflush(out);
+}
+
+
+
+
+/**
+ * Fonction : bench_lookup
+ * Description : Cette fonction mesure le coût de get_fileEntry et de get_client lorsque les tables grossissent,
+ *               pour une entrée présente (choisie au hasard) et une entrée absente.
+ * @param total_ops : Le nombre de recherches par mesure.
+ * @return : 0 en cas de succès, -1 en cas d'échec.
+ */
+static int bench_lookup(long total_ops) {
+    static const int sizes[] = {1, 8, 64, 256, MAX_CLIENTS};
+    static const char request[] = "bench";
+    char name[256];
+    volatile uintptr_t sink = 0;    // Empêche le compilateur de supprimer les recherches
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        int size = sizes[s];
+
+        // Table des fichiers (sync.c)
+        FileList file_list;
+        initialize_fileList(&file_list);
+        for (int i = 0; i < size; i++) {
+            snprintf(name, sizeof(name), "dir/file-%d.bin", i);
+            if (add_fileEntry(create_fileEntry(name, &file_list), &file_list) < 0) {
+                return -1;
+            }
+        }
+
+        srand(size);
+        uint64_t start = now_ns();
+        for (long i = 0; i < total_ops; i++) {
+            sink += (uintptr_t) get_fileEntry(file_list.files[rand() % size]->filename, &file_list);
+        }
+        report_lookup("files", "hit", size, total_ops, now_ns() - start);
+
+        snprintf(name, sizeof(name), "dir/absent.bin");
+        start = now_ns();
+        for (long i = 0; i < total_ops; i++) {
+            sink += (uintptr_t) get_fileEntry(name, &file_list);
+        }
+        report_lookup("files", "miss", size, total_ops, now_ns() - start);
+
+        for (int i = 0; i < MAX_CLIENTS; i++) {
+            free(file_list.files[i]);
+        }
+        pthread_mutex_destroy(&file_list.files_mutex);
+
+        // Liste des clients (tftp.c)
+        TFTP_ClientsList clients;
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        initialiser_ListeClients(&clients);
+        for (int i = 0; i < size; i++) {
+            addr.sin_port = htons(10000 + i);
+            TFTP_Client* client = init_client(addr, request);
+            if (client == NULL) {
+                return -1;
+            }
+            client->socket_fd = -1;
+            ajouterClient(client, &clients);
+        }
+
+        start = now_ns();
+        for (long i = 0; i < total_ops; i++) {
+            addr.sin_port = htons(10000 + rand() % size);
+            sink += (uintptr_t) get_client(&clients, addr, request);
+        }
+        report_lookup("clients", "hit", size, total_ops, now_ns() - start);
+
+        addr.sin_port = htons(9999);
+        start = now_ns();
+        for (long i = 0; i < total_ops; i++) {
+            sink += (uintptr_t) get_client(&clients, addr, request);
+        }
+        report_lookup("clients", "miss", size, total_ops, now_ns() - start);
+
+        for (int i = 0; i < clients.nbClients; i++) {
+            free(clients.clients[i]);
+        }
+        free(clients.clients);
+        pthread_mutex_destroy(&clients.mutex);
+    }
+    (void) sink;
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : build_request
+ * Description : Cette fonction construit un paquet RRQ/WRQ (opcode, nom, mode, options éventuelles).
+ * @param packet : Le tampon qui reçoit le paquet.
+ * @param opcode : L'opcode (RRQ ou WRQ).
+ * @param filename : Le nom de fichier demandé.
+ * @param options : Les options à ajouter (couples nom/valeur séparés par des octets nuls), ou NULL.
+ * @param options_len : La taille des options.
+ * @return : La taille du paquet.
+ */
+static ssize_t build_request(char* packet, uint16_t opcode, const char* filename, const char* options, size_t options_len) {
+    uint16_t op = htons(opcode);
+    size_t len = 0;
+
+    memcpy(packet, &op, sizeof(op));
+    len += sizeof(op);
+    len += sprintf(packet + len, "%s", filename) + 1;
+    len += sprintf(packet + len, "%s", "octet") + 1;
+    if (options != NULL) {
+        memcpy(packet + len, options, options_len);
+        len += options_len;
+    }
+    return (ssize_t) len;
+}
+
+
+
+
+/**
+ * Fonction : bench_parse
+ * Description : Cette fonction mesure l'analyse d'une requête telle que faite par le thread d'écoute :
+ *               parse_request et normalisation du chemin (sur place : le paquet est recopié avant chaque analyse,
+ *               comme le remplit recvfrom) et, pour une WRQ, nom du fichier temporaire.
+ * @param total_ops : Le nombre d'analyses par mesure.
+ * @return : 0 en cas de succès, -1 en cas d'échec.
+ */
+static int bench_parse(long total_ops) {
+    static const char options[] = "blksize\0" "1428\0" "tsize\0" "0\0";
+    static const struct {
+        const char* name;
+        uint16_t opcode;
+        const char* filename;
+        bool with_options;
+    } cases[] = {
+        {"rrq_short", TFTP_OPCODE_RRQ, "file.bin", false},
+        {"rrq_nested", TFTP_OPCODE_RRQ, "/images/2024//boot/./pxelinux.0", false},
+        {"rrq_options", TFTP_OPCODE_RRQ, "images/boot/pxelinux.0", true},
+        {"wrq_short", TFTP_OPCODE_WRQ, "upload.bin", false},
+        {"wrq_nested", TFTP_OPCODE_WRQ, "backups/router-01/config/startup.cfg", true},
+    };
+    char received[MAX_PACKET_SIZE];
+    char packet[MAX_PACKET_SIZE];
+    TFTP_Request request;
+    int error_code;
+    const char* error_message;
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        ssize_t len = build_request(received, cases[c].opcode, cases[c].filename,
+                                    cases[c].with_options ? options : NULL, sizeof(options) - 1);
+
+        uint64_t start = now_ns();
+        for (long i = 0; i < total_ops; i++) {
+            memcpy(packet, received, len);
+            if (parse_request(packet, len, &request, &error_code, &error_message) < 0 || fsroot_normalize(request.filename) < 0) {
+                fprintf(stderr, "Requête de test refusée (%s) : %s\n", cases[c].name, error_message);
+                return -1;
+            }
+            if (ntohs(request.opcode) == TFTP_OPCODE_WRQ) {
+                free(get_temp_file_name(request.filename));
+            }
+        }
+        uint64_t elapsed = now_ns() - start;
+
+        fprintf(out, "{\"suite\":\"parse\",\"case\":\"%s\",\"bytes\":%zd,\"ops\":%ld,\"ns_per_op\":%.1f}\n",
+                cases[c].name, len, total_ops, (double) elapsed / total_ops);
+        fflush(out);
+    }
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : check_request
+ * Description : Cette fonction vérifie une requête acceptée par parse_request : vues dans le paquet et terminées
+ *               par un de ses octets nuls, mode et options dans leurs bornes.
+ * @return : NULL si la requête est cohérente, sinon la description de l'anomalie.
+ */
+static const char* check_request(const char* packet, ssize_t len, const TFTP_Request* request) {
+    const char* limit = packet + len;
+    if (request->filename < packet + 2 || request->filename >= limit || memchr(request->filename, '\0', limit - request->filename) == NULL) {
+        return "nom de fichier hors du paquet";
+    }
+    if (request->mode <= request->filename || request->mode >= limit || memchr(request->mode, '\0', limit - request->mode) == NULL) {
+        return "mode hors du paquet";
+    }
+    if (strcasecmp(request->mode, "octet") != 0 && strcasecmp(request->mode, "netascii") != 0) {
+        return "mode invalide accepté";
+    }
+    const TFTP_Options* options = &request->options;
+    if (((options->present & TFTP_OPTION_BLKSIZE) && (options->blksize < 8 || options->blksize > 65464))
+        || ((options->present & TFTP_OPTION_TIMEOUT) && options->timeout == 0)
+        || ((options->present & TFTP_OPTION_WINDOWSIZE) && options->windowsize == 0)) {
+        return "option hors de ses bornes";
+    }
+    return NULL;
+}
+
+
+
+
+/**
+ * Fonction : bench_fuzz
+ * Description : Cette fonction soumet à parse_request des requêtes valides altérées au hasard (octets modifiés, octets
+ *               nuls insérés, paquet tronqué ou entièrement aléatoire). Le paquet est placé juste avant une page
+ *               protégée : toute lecture au-delà de la taille reçue provoque une erreur de segmentation.
+ *               Mesure aussi le coût d'un rejet.
+ * @param total_ops : Le nombre de paquets soumis.
+ * @return : 0 en cas de succès, -1 si une requête acceptée est incohérente.
+ */
+static int bench_fuzz(long total_ops) {
+    static const char options[] = "blksize\0" "1428\0" "tsize\0" "0\0" "timeout\0" "3\0" "windowsize\0" "16\0";
+    static const char* const filenames[] = {"pxelinux.0", "/images//boot/./vmlinuz", "a", "backups/router-01/startup.cfg"};
+    long page = sysconf(_SC_PAGESIZE);
+    char* area = (char*) mmap(NULL, 2 * page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (area == MAP_FAILED || mprotect(area + page, page, PROT_NONE) < 0) {
+        perror("Erreur lors de la préparation de la page de garde");
+        return -1;
+    }
+
+    char base[MAX_PACKET_SIZE];
+    TFTP_Request request;
+    int error_code;
+    const char* error_message;
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    long accepted = 0;
+    uint64_t elapsed = 0;
+
+    for (long i = 0; i < total_ops; i++) {
+        // Générateur xorshift64 : suite reproductible d'une exécution à l'autre
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        uint64_t r = state;
+        ssize_t len = build_request(base, (r & 1) ? TFTP_OPCODE_WRQ : TFTP_OPCODE_RRQ, filenames[(r >> 1) & 3],
+                                    options, (r >> 3) % sizeof(options));
+        switch ((r >> 12) & 3) {
+            case 0:     // Octets modifiés
+                for (int k = 0; k < 1 + (int) ((r >> 14) & 3); k++) {
+                    base[(r >> (20 + 8 * k)) % len] = (char) (r >> (16 + 8 * k));
+                }
+                break;
+            case 1:     // Octet nul inséré
+                base[(r >> 20) % len] = '\0';
+                break;
+            case 2:     // Paquet tronqué
+                len = (ssize_t) ((r >> 20) % (uint64_t) (len + 1));
+                break;
+            default:    // Paquet aléatoire
+                len = (ssize_t) ((r >> 20) % (MAX_PACKET_SIZE + 1));
+                for (ssize_t k = 0; k < len; k++) {
+                    base[k] = (char) ((r >> (k % 7) * 8) ^ (uint64_t) k * 0x9E37u);
+                }
+                if (len >= 2 && (r & 0x10)) {
+                    base[0] = 0;
+                    base[1] = (char) (1 + ((r >> 5) & 1));
+                }
+                break;
+        }
+
+        char* packet = area + page - len;
+        memcpy(packet, base, len);
+        uint64_t start = now_ns();
+        int ret = parse_request(packet, len, &request, &error_code, &error_message);
+        elapsed += now_ns() - start;
+        if (ret == 0) {
+            const char* problem = check_request(packet, len, &request);
+            if (problem != NULL) {
+                fprintf(stderr, "Paquet %ld accepté à tort : %s\n", i, problem);
+                return -1;
+            }
+            accepted++;
+        }
+    }
+    munmap(area, 2 * page);
+
+    fprintf(out, "{\"suite\":\"fuzz\",\"ops\":%ld,\"accepted\":%ld,\"rejected\":%ld,\"ns_per_op\":%.1f}\n",
+            total_ops, accepted, total_ops - accepted, (double) elapsed / total_ops);
+    fflush(out);
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : check_sparse_case
+ * Description : Cette fonction écrit un fichier reçu bloc par bloc comme handle_write_request (blocs de 512 octets,
+ *               dernier bloc plus court, éventuellement vide) avec sparse_write et sparse_writer_finish, puis vérifie
+ *               sa taille et son contenu, relu par sparse_read.
+ * @param blocks : Les blocs de 512 octets : 'D' pour des données, 'Z' pour un bloc nul.
+ * @param tail : La taille du dernier bloc (0 à 511).
+ * @param tail_zero : Dernier bloc nul (sinon des données).
+ * @param skipped : Un pointeur qui cumule les octets nuls non écrits.
+ * @return : NULL si le fichier est correct, sinon la description de l'écart.
+ */
+static const char* check_sparse_case(const char* blocks, size_t tail, bool tail_zero, uint64_t* skipped) {
+    size_t count = strlen(blocks);
+    size_t size = count * MAX_DATA_SIZE + tail;
+    char* expected = (char*) calloc(size + 1, 1);
+    char* actual = (char*) malloc(size + MAX_DATA_SIZE);
+    FILE* file = tmpfile();
+    const char* problem = NULL;
+    if (expected == NULL || actual == NULL || file == NULL) {
+        problem = "allocation ou fichier temporaire impossible";
+        goto done;
+    }
+    for (size_t i = 0; i < size; i++) {
+        size_t block = i / MAX_DATA_SIZE;
+        bool zero = block < count ? blocks[block] == 'Z' : tail_zero;
+        expected[i] = zero ? 0 : (char) (1 + (i * 7 + block) % 251);
+    }
+
+    SparseWriter writer;
+    sparse_writer_init(&writer, file);
+    for (size_t offset = 0; ; offset += MAX_DATA_SIZE) {
+        size_t len = size - offset < MAX_DATA_SIZE ? size - offset : MAX_DATA_SIZE;
+        if (sparse_write(&writer, file, expected + offset, len) != len) {
+            problem = "écriture refusée";
+            goto done;
+        }
+        if (len < MAX_DATA_SIZE) {
+            break;      // Dernier bloc (vide si la taille est un multiple de 512)
+        }
+    }
+    if (sparse_writer_finish(&writer, file) != 0 || fflush(file) != 0) {
+        problem = "fin d'écriture en erreur";
+        goto done;
+    }
+    *skipped += writer.skipped;
+
+    struct stat st;
+    if (fstat(fileno(file), &st) != 0 || (size_t) st.st_size != size) {
+        problem = "taille du fichier incorrecte (fichier tronqué)";
+        goto done;
+    }
+    rewind(file);
+    SparseReader reader;
+    sparse_reader_init(&reader, file);
+    size_t total = 0, n;
+    while ((n = sparse_read(&reader, file, actual + total, MAX_DATA_SIZE)) > 0) {
+        total += n;
+        if (n < MAX_DATA_SIZE || total > size) {
+            break;
+        }
+    }
+    if (total != size || memcmp(actual, expected, size) != 0) {
+        problem = "contenu relu différent";
+    }
+
+done:
+    if (file != NULL) {
+        fclose(file);
+    }
+    free(expected);
+    free(actual);
+    return problem;
+}
+
+
+
+
+/**
+ * Fonction : bench_sparse
+ * Description : Cette fonction vérifie les écritures creuses sur des fichiers qui commencent, se terminent ou sont
+ *               entièrement faits de blocs nuls, en particulier ceux dont la taille est un multiple de 512 (le
+ *               dernier bloc reçu est alors vide).
+ * @return : 0 en cas de succès, -1 si un fichier est incorrect.
+ */
+static int bench_sparse(void) {
+    static const struct {
+        const char* blocks;
+        size_t tail;
+        bool tail_zero;
+    } cases[] = {
+        {"", 0, false}, {"D", 0, false}, {"Z", 0, false}, {"DZ", 0, false}, {"ZD", 0, false}, {"ZZZ", 0, false},
+        {"DZZDZZ", 0, false}, {"DZ", 100, true}, {"DZ", 100, false}, {"Z", 1, true}, {"", 10, true}, {"ZDZ", 511, true}
+    };
+    int count = (int) (sizeof(cases) / sizeof(cases[0]));
+    uint64_t skipped = 0;
+    uint64_t start = now_ns();
+    for (int i = 0; i < count; i++) {
+        const char* problem = check_sparse_case(cases[i].blocks, cases[i].tail, cases[i].tail_zero, &skipped);
+        if (problem != NULL) {
+            fprintf(stderr, "Écriture creuse \"%s\" + %zu octets %s : %s\n", cases[i].blocks, cases[i].tail,
+                    cases[i].tail_zero ? "nuls" : "de données", problem);
+            return -1;
+        }
+    }
+    fprintf(out, "{\"suite\":\"sparse\",\"cases\":%d,\"skipped_bytes\":%" PRIu64 ",\"ms\":%.1f}\n",
+            count, skipped, (now_ns() - start) / 1e6);
+    fflush(out);
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : print_usage
+ * Description : Cette fonction affiche l'aide de la ligne de commande.
+ * @param prog : Le nom du programme.
+ */
+static void print_usage(const char* prog) {
+    fprintf(stderr, "Usage : %s [options]\n"
+                    "  -s SUITE     mesures à lancer : all, sync, lookup, parse, fuzz ou sparse (défaut : all)\n"
+                    "  -n OPS       opérations par mesure (défaut : %d)\n"
+                    "  -t THREADS   nombre maximum de threads pour sync (défaut : %d)\n"
+                    "  -o FICHIER   fichier de résultats JSON, une mesure par ligne (défaut : sortie standard)\n",
+            prog, BENCH_DEFAULT_OPS, BENCH_DEFAULT_THREADS);
+}
+
+
+
+
+int main(int argc, char* argv[]) {
+    const char* suite = "all";
+    const char* output = NULL;
+    long total_ops = BENCH_DEFAULT_OPS;
+    int max_threads = BENCH_DEFAULT_THREADS;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:n:t:o:h")) != -1) {
+        switch (opt) {
+            case 's': suite = optarg; break;
+            case 'n': total_ops = strtol(optarg, NULL, 10); break;
+            case 't': max_threads = atoi(optarg); break;
+            case 'o': output = optarg; break;
+            default:
+                print_usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (total_ops <= 0 || max_threads <= 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    // Les résultats sont écrits sur une copie de la sortie standard : les messages affichés
+    // par sync.c lorsqu'un fichier est occupé sont écartés pour ne pas corrompre le JSON.
+    out = output != NULL ? fopen(output, "w") : fdopen(dup(STDOUT_FILENO), "w");
+    if (out == NULL || freopen("/dev/null", "w", stdout) == NULL) {
+        perror("Erreur lors de l'ouverture du fichier de résultats");
+        return 1;
+    }
+
+    bool all = strcmp(suite, "all") == 0;
+    if (!all && strcmp(suite, "sync") != 0 && strcmp(suite, "lookup") != 0 && strcmp(suite, "parse") != 0 && strcmp(suite, "fuzz") != 0
+        && strcmp(suite, "sparse") != 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    int ret = 0;
+    if (ret == 0 && (all || strcmp(suite, "sync") == 0)) {
+        ret = bench_sync(max_threads, total_ops);
+    }
+    if (ret == 0 && (all || strcmp(suite, "lookup") == 0)) {
+        ret = bench_lookup(total_ops);
+    }
+    if (ret == 0 && (all || strcmp(suite, "parse") == 0)) {
+        ret = bench_parse(total_ops);
+    }
+    if (ret == 0 && (all || strcmp(suite, "fuzz") == 0)) {
+        ret = bench_fuzz(total_ops);
+    }
+    if (ret == 0 && (all || strcmp(suite, "sparse") == 0)) {
+        ret = bench_sparse();
+    }
+
+    fclose(out);
+    return ret == 0 ? 0 : 1;
+}
@@ -0,0 +1,371 @@
+/**
+ * @file bundle.c
+ * @brief Implémentation des paquets d'images projetés en mémoire.
+ *        Les flux ouverts sur un paquet (fopencookie) gardent une référence : un rechargement ne libère la
+ *        projection précédente qu'à la fermeture du dernier flux.
+ */
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "bundle.h"
+
+
+/**
+ * @struct BundleReader
+ * @brief Flux de lecture d'un fichier du paquet.
+ */
+typedef struct BundleReader {
+    BundleSet* set;
+    Bundle* bundle;
+    const char* data;
+    uint64_t size;
+    uint64_t offset;
+} BundleReader;
+
+
+
+
+/**
+ * Fonction : bundle_load
+ * Description : Cette fonction projette un fichier paquet en mémoire et vérifie son en-tête et son index.
+ * @param path : Le fichier paquet.
+ * @return : Le paquet (une référence), ou NULL en cas d'erreur (errno = EINVAL si le paquet est invalide).
+ */
+static Bundle* bundle_load(const char* path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return NULL;
+    }
+    if (!S_ISREG(st.st_mode) || (uint64_t) st.st_size < sizeof(BundleHeader)) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+    const char* map = (const char*) mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+    madvise((void*) map, (size_t) st.st_size, MADV_WILLNEED);    // Lecture anticipée : le paquet est chaud dès les premières requêtes
+
+    const BundleHeader* header = (const BundleHeader*) map;
+    uint64_t size = (uint64_t) st.st_size;
+    uint64_t index_end = sizeof(BundleHeader) + (uint64_t) header->count * sizeof(BundleEntry);
+    bool valid = memcmp(header->magic, BUNDLE_MAGIC, sizeof(header->magic)) == 0 && header->total_size == size
+        && index_end <= size && header->names_size <= size - index_end
+        && (header->names_size == 0 || map[index_end + header->names_size - 1] == '\0');
+
+    const BundleEntry* entries = (const BundleEntry*) (map + sizeof(BundleHeader));
+    const char* names = map + index_end;
+    for (uint32_t i = 0; valid && i < header->count; i++) {
+        const BundleEntry* entry = &entries[i];
+        valid = (uint64_t) entry->name_offset + entry->name_len < header->names_size
+            && names[entry->name_offset + entry->name_len] == '\0'
+            && entry->offset <= size && entry->size <= size - entry->offset
+            && (i == 0 || strcmp(names + entries[i - 1].name_offset, names + entry->name_offset) < 0);   // Recherche dichotomique
+    }
+    if (!valid) {
+        munmap((void*) map, (size_t) st.st_size);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    Bundle* bundle = (Bundle*) calloc(1, sizeof(Bundle));
+    if (bundle == NULL) {
+        munmap((void*) map, (size_t) st.st_size);
+        return NULL;
+    }
+    bundle->map = map;
+    bundle->size = (size_t) st.st_size;
+    bundle->count = header->count;
+    bundle->entries = entries;
+    bundle->names = names;
+    bundle->refs = 1;
+    return bundle;
+}
+
+
+
+
+/**
+ * Fonction : bundle_release
+ * Description : Cette fonction rend une référence sur un paquet ; le dernier utilisateur libère la projection.
+ * @param set : Le paquet courant (son mutex protège les références).
+ * @param bundle : Le paquet.
+ * @return : Aucune valeur de retour
+ */
+static void bundle_release(BundleSet* set, Bundle* bundle) {
+    pthread_mutex_lock(&set->mutex);
+    bool last = --bundle->refs == 0;
+    pthread_mutex_unlock(&set->mutex);
+    if (last) {
+        munmap((void*) bundle->map, bundle->size);
+        free(bundle);
+    }
+}
+
+
+
+
+/**
+ * Fonction : bundle_find
+ * Description : Cette fonction cherche un fichier dans l'index trié d'un paquet.
+ * @param bundle : Le paquet.
+ * @param filename : Le nom normalisé du fichier.
+ * @return : L'entrée du fichier, ou NULL s'il est absent du paquet.
+ */
+static const BundleEntry* bundle_find(const Bundle* bundle, const char* filename) {
+    uint32_t low = 0;
+    uint32_t high = bundle->count;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        int cmp = strcmp(filename, bundle->names + bundle->entries[middle].name_offset);
+        if (cmp == 0) {
+            return &bundle->entries[middle];
+        }
+        if (cmp < 0) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+    }
+    return NULL;
+}
+
+
+
+
+/**
+ * Fonction : bundle_acquire
+ * Description : Cette fonction cherche un fichier dans le paquet courant et prend une référence sur ce paquet.
+ * @param set : Le paquet courant.
+ * @param filename : Le nom normalisé du fichier.
+ * @param entry : Un pointeur qui reçoit l'entrée du fichier.
+ * @return : Le paquet (à rendre avec bundle_release), ou NULL si le fichier n'y est pas.
+ */
+static Bundle* bundle_acquire(BundleSet* set, const char* filename, const BundleEntry** entry) {
+    if (set->path == NULL) {
+        return NULL;
+    }
+    pthread_mutex_lock(&set->mutex);
+    Bundle* bundle = set->current;
+    *entry = bundle != NULL ? bundle_find(bundle, filename) : NULL;
+    if (*entry != NULL) {
+        bundle->refs++;
+        set->hits++;
+        set->bytes += (*entry)->size;
+    } else {
+        bundle = NULL;
+        set->misses++;
+    }
+    pthread_mutex_unlock(&set->mutex);
+    return bundle;
+}
+
+
+
+
+/**
+ * Fonction : bundle_init
+ * Description : Cette fonction charge le paquet d'images.
+ * @param set : Le paquet courant à initialiser.
+ * @param path : Le fichier paquet (NULL = désactivé).
+ * @return : 0 en cas de succès, -1 en cas d'erreur (errno positionné).
+ */
+int bundle_init(BundleSet* set, const char* path) {
+    memset(set, 0, sizeof(*set));
+    pthread_mutex_init(&set->mutex, NULL);
+    set->path = path;
+    if (path == NULL) {
+        return 0;
+    }
+    set->current = bundle_load(path);
+    return set->current != NULL ? 0 : -1;
+}
+
+
+
+
+/**
+ * Fonction : bundle_reload
+ * Description : Cette fonction recharge le fichier paquet (remplacé par renommage) et en fait le paquet courant.
+ *               En cas d'erreur, le paquet courant est conservé.
+ * @param set : Le paquet courant.
+ * @return : 0 en cas de succès, -1 en cas d'erreur (errno positionné).
+ */
+int bundle_reload(BundleSet* set) {
+    if (set->path == NULL) {
+        return 0;
+    }
+    Bundle* bundle = bundle_load(set->path);
+    pthread_mutex_lock(&set->mutex);
+    Bundle* old = NULL;
+    if (bundle != NULL) {
+        old = set->current;
+        set->current = bundle;
+        set->reloads++;
+    } else {
+        set->failed_reloads++;
+    }
+    pthread_mutex_unlock(&set->mutex);
+    if (old != NULL) {
+        bundle_release(set, old);
+    }
+    return bundle != NULL ? 0 : -1;
+}
+
+
+
+
+/**
+ * Fonction : reader_read
+ * Description : Fonction de lecture du flux (fopencookie) : copie depuis la projection.
+ * @return : Le nombre d'octets lus, 0 en fin de fichier.
+ */
+static ssize_t reader_read(void* cookie, char* buffer, size_t size) {
+    BundleReader* reader = (BundleReader*) cookie;
+    if (size > reader->size - reader->offset) {
+        size = reader->size - reader->offset;
+    }
+    memcpy(buffer, reader->data + reader->offset, size);
+    reader->offset += size;
+    return (ssize_t) size;
+}
+
+
+
+
+/**
+ * Fonction : reader_close
+ * Description : Fonction de fermeture du flux (fopencookie) : rend la référence sur le paquet.
+ * @return : 0
+ */
+static int reader_close(void* cookie) {
+    BundleReader* reader = (BundleReader*) cookie;
+    bundle_release(reader->set, reader->bundle);
+    free(reader);
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : bundle_open
+ * Description : Cette fonction ouvre en lecture un fichier du paquet courant.
+ * @param set : Le paquet courant.
+ * @param filename : Le nom normalisé du fichier.
+ * @return : Le flux de lecture, ou NULL (errno = ENOENT si le fichier n'est pas dans le paquet).
+ */
+FILE* bundle_open(BundleSet* set, const char* filename) {
+    const BundleEntry* entry;
+    Bundle* bundle = bundle_acquire(set, filename, &entry);
+    if (bundle == NULL) {
+        errno = ENOENT;
+        return NULL;
+    }
+    BundleReader* reader = (BundleReader*) calloc(1, sizeof(BundleReader));
+    if (reader == NULL) {
+        bundle_release(set, bundle);
+        return NULL;
+    }
+    reader->set = set;
+    reader->bundle = bundle;
+    reader->data = bundle->map + entry->offset;
+    reader->size = entry->size;
+
+    cookie_io_functions_t functions = { reader_read, NULL, NULL, reader_close };
+    FILE* file = fopencookie(reader, "rb", functions);
+    if (file == NULL) {
+        bundle_release(set, bundle);
+        free(reader);
+        errno = ENOMEM;
+    }
+    return file;
+}
+
+
+
+
+/**
+ * Fonction : bundle_size
+ * Description : Cette fonction donne la taille d'un fichier du paquet courant (classement des requêtes).
+ * @param set : Le paquet courant.
+ * @param filename : Le nom normalisé du fichier.
+ * @param size : Un pointeur qui reçoit la taille.
+ * @return : true si le fichier est dans le paquet.
+ */
+bool bundle_size(BundleSet* set, const char* filename, uint64_t* size) {
+    if (set->path == NULL) {
+        return false;
+    }
+    pthread_mutex_lock(&set->mutex);
+    const BundleEntry* entry = set->current != NULL ? bundle_find(set->current, filename) : NULL;
+    if (entry != NULL) {
+        *size = entry->size;
+    }
+    pthread_mutex_unlock(&set->mutex);
+    return entry != NULL;
+}
+
+
+
+
+/**
+ * Fonction : bundle_read_small
+ * Description : Cette fonction copie le contenu d'un petit fichier du paquet courant (chemin rapide).
+ * @param set : Le paquet courant.
+ * @param filename : Le nom normalisé du fichier.
+ * @param data : Le tampon qui reçoit le contenu.
+ * @param max : La taille du tampon : les fichiers de max octets ou plus ne sont pas copiés.
+ * @return : La taille du contenu, -1 si le fichier n'est pas dans le paquet ou s'il est trop gros.
+ */
+int bundle_read_small(BundleSet* set, const char* filename, char* data, size_t max) {
+    if (set->path == NULL) {
+        return -1;
+    }
+    int len = -1;
+    pthread_mutex_lock(&set->mutex);
+    const BundleEntry* entry = set->current != NULL ? bundle_find(set->current, filename) : NULL;
+    if (entry != NULL && entry->size < max) {
+        memcpy(data, set->current->map + entry->offset, (size_t) entry->size);
+        len = (int) entry->size;
+        set->hits++;
+        set->bytes += entry->size;
+    }
+    pthread_mutex_unlock(&set->mutex);
+    return len;
+}
+
+
+
+
+/**
+ * Fonction : bundle_report
+ * Description : Cette fonction affiche l'état du paquet d'images.
+ * @param set : Le paquet courant.
+ * @param out : Le flux de sortie.
+ * @return : Aucune valeur de retour
+ */
+void bundle_report(BundleSet* set, FILE* out) {
+    if (set->path == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&set->mutex);
+    fprintf(out, "[BUNDLE] %s | fichiers %u (%.1f Mo) | servis %lu (%.1f Mo) | absents %lu | rechargements %lu (échecs %lu)\n",
+            set->path, set->current != NULL ? set->current->count : 0, set->current != NULL ? set->current->size / 1048576.0 : 0.0,
+            set->hits, set->bytes / 1048576.0, set->misses, set->reloads, set->failed_reloads);
+    pthread_mutex_unlock(&set->mutex);
+}
@@ -0,0 +1,97 @@
+/**
+ * @file bundle.h
+ * @brief Paquets d'images : un seul fichier regroupe le contenu de nombreux petits fichiers et un index trié
+ *        (chemin, position, taille). Le paquet est projeté en mémoire (mmap) au démarrage ; les RRQ des chemins
+ *        qu'il contient sont servis depuis la projection, sans ouverture de fichier. SIGHUP recharge le paquet :
+ *        le nouveau remplace l'ancien d'un seul coup, l'ancien reste projeté jusqu'à la fin des transferts en cours.
+ *        Les paquets sont construits par l'outil mkbundle, et doivent être remplacés par renommage (comme le fait
+ *        mkbundle), jamais réécrits sur place : la lecture d'une projection tronquée provoque SIGBUS.
+ *
+ *        Format (ordre des octets de la machine) :
+ *          BundleHeader | BundleEntry[count] (triées par nom, strcmp) | noms terminés par '\0' | contenus
+ */
+
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+#ifndef BUNDLE_H
+#define BUNDLE_H
+
+#define BUNDLE_MAGIC "TFTPBDL1"
+
+
+/**
+ * @struct BundleHeader
+ * @brief En-tête du fichier paquet.
+ */
+typedef struct BundleHeader {
+    char magic[8];                  /* BUNDLE_MAGIC */
+    uint32_t count;                 /* Nombre de fichiers */
+    uint32_t reserved;
+    uint64_t names_size;            /* Taille de la table des noms */
+    uint64_t total_size;            /* Taille du fichier paquet (détecte un paquet tronqué) */
+} BundleHeader;
+
+
+
+
+/**
+ * @struct BundleEntry
+ * @brief Entrée de l'index : les positions sont relatives au début du fichier paquet.
+ */
+typedef struct BundleEntry {
+    uint64_t offset;                /* Contenu du fichier */
+    uint64_t size;
+    uint32_t name_offset;           /* Nom, relatif au début de la table des noms */
+    uint32_t name_len;
+} BundleEntry;
+
+
+
+
+/**
+ * @struct Bundle
+ * @brief Paquet projeté en mémoire, libéré par son dernier utilisateur.
+ */
+typedef struct Bundle {
+    const char* map;
+    size_t size;
+    uint32_t count;
+    const BundleEntry* entries;
+    const char* names;
+    int refs;                       /* Paquet courant + flux ouverts (protégé par le mutex de BundleSet) */
+} Bundle;
+
+
+
+
+/**
+ * @struct BundleSet
+ * @brief Paquet courant et compteurs.
+ */
+typedef struct BundleSet {
+    const char* path;               /* Fichier paquet (NULL = désactivé) */
+    Bundle* current;
+    pthread_mutex_t mutex;
+
+    unsigned long hits;             /* Fichiers servis depuis le paquet */
+    unsigned long misses;           /* Fichiers absents du paquet (servis depuis la racine) */
+    unsigned long reloads;
+    unsigned long failed_reloads;
+    unsigned long long bytes;       /* Octets servis depuis le paquet */
+} BundleSet;
+
+
+
+int bundle_init(BundleSet* set, const char* path);
+int bundle_reload(BundleSet* set);
+FILE* bundle_open(BundleSet* set, const char* filename);
+bool bundle_size(BundleSet* set, const char* filename, uint64_t* size);
+int bundle_read_small(BundleSet* set, const char* filename, char* data, size_t max);
+void bundle_report(BundleSet* set, FILE* out);
+
+#endif
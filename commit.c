@@ -0,0 +1,426 @@
+/**
+ * @file commit.c
+ * @brief Implémentation de l'écriture durable des fichiers reçus.
+ *        Un fichier reçu n'est acquitté (dernier ACK) qu'une fois son contenu et son renommage rendus durables.
+ *        Pour ne pas payer un fsync par fichier lors des sauvegardes massives, les validations en attente
+ *        sont traitées par lots sur un thread dédié.
+ */
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "commit.h"
+
+
+
+/**
+ * Fonction : write_all
+ * Description : Cette fonction écrit entièrement un tampon dans un descripteur.
+ * @param fd : Le descripteur.
+ * @param data : Le tampon à écrire.
+ * @param length : La taille du tampon.
+ * @return : 0 en cas de succès, -1 en cas d'erreur.
+ */
+static int write_all(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        data += written;
+        length -= written;
+    }
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : spill
+ * Description : Cette fonction déverse le contenu en mémoire dans le fichier temporaire.
+ * @param upload : Le fichier en cours de réception.
+ * @return : 0 en cas de succès, -1 en cas d'erreur.
+ */
+static int spill(StagedUpload* upload) {
+    upload->fd = fsroot_open(upload->root, upload->temp_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (upload->fd < 0) {
+        return -1;
+    }
+    if (write_all(upload->fd, upload->data, upload->length) < 0) {
+        return -1;
+    }
+    free(upload->data);
+    upload->data = NULL;
+    upload->length = 0;
+    upload->capacity = 0;
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : staged_write
+ * Description : Fonction d'écriture du flux (fopencookie) : ajout en mémoire, ou écriture dans le fichier
+ *               temporaire une fois le seuil dépassé.
+ * @return : Le nombre d'octets écrits, 0 en cas d'erreur.
+ */
+static ssize_t staged_write(void* cookie, const char* buffer, size_t size) {
+    StagedUpload* upload = (StagedUpload*)cookie;
+
+    if (upload->fd == -1 && upload->length + size > upload->threshold && spill(upload) < 0) {
+        return 0;
+    }
+    if (upload->fd != -1) {
+        return write_all(upload->fd, buffer, size) < 0 ? 0 : (ssize_t) size;
+    }
+
+    if (upload->length + size > upload->capacity) {
+        size_t capacity = upload->capacity ? upload->capacity * 2 : 4096;
+        while (capacity < upload->length + size) {
+            capacity *= 2;
+        }
+        char* data = (char*)realloc(upload->data, capacity);
+        if (data == NULL) {
+            return 0;
+        }
+        upload->data = data;
+        upload->capacity = capacity;
+    }
+    memcpy(upload->data + upload->length, buffer, size);
+    upload->length += size;
+    return size;
+}
+
+
+
+
+/**
+ * Fonction : staged_close
+ * Description : Fonction de fermeture du flux (fopencookie) : libère la mémoire et ferme le fichier temporaire.
+ * @return : 0
+ */
+static int staged_close(void* cookie) {
+    StagedUpload* upload = (StagedUpload*)cookie;
+    if (upload->fd != -1) {
+        close(upload->fd);
+    }
+    free(upload->data);
+    free(upload);
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : staged_upload_open
+ * Description : Cette fonction crée le flux d'écriture d'un fichier reçu. Tant que le fichier ne dépasse pas
+ *               le seuil, il reste en mémoire et le fichier temporaire n'est même pas créé.
+ * @param root : La racine de service.
+ * @param temp_name : Le nom du fichier temporaire.
+ * @param threshold : La taille maximale conservée en mémoire.
+ * @param upload : Un pointeur qui reçoit l'état du fichier (libéré à la fermeture du flux).
+ * @return : Le flux d'écriture, ou NULL en cas d'erreur.
+ */
+FILE* staged_upload_open(ServingRoot* root, const char* temp_name, size_t threshold, StagedUpload** upload) {
+    if (strlen(temp_name) >= PATH_MAX) {
+        errno = ENAMETOOLONG;
+        return NULL;
+    }
+    StagedUpload* staged = (StagedUpload*)calloc(1, sizeof(StagedUpload));
+    if (staged == NULL) {
+        return NULL;
+    }
+    staged->root = root;
+    strcpy(staged->temp_name, temp_name);
+    staged->threshold = threshold;
+    staged->fd = -1;
+
+    cookie_io_functions_t functions = { NULL, staged_write, NULL, staged_close };
+    FILE* file = fopencookie(staged, "wb", functions);
+    if (file == NULL) {
+        free(staged);
+        return NULL;
+    }
+    *upload = staged;
+    return file;
+}
+
+
+
+
+/**
+ * Fonction : staged_upload_renamed
+ * Description : Cette fonction indique si le fichier reçu a été renommé en son nom définitif par la validation
+ *               (la cible est remplacée, même si la validation a ensuite échoué).
+ * @param upload : Le fichier en cours de réception.
+ * @return : true si la cible a été remplacée.
+ */
+bool staged_upload_renamed(const StagedUpload* upload) {
+    return upload->renamed;
+}
+
+
+
+
+/**
+ * Fonction : staged_upload_spilled
+ * Description : Cette fonction indique si le fichier temporaire existe sur disque (à supprimer en cas d'échec).
+ * @param upload : Le fichier en cours de réception.
+ * @return : true si le fichier temporaire a été créé.
+ */
+bool staged_upload_spilled(const StagedUpload* upload) {
+    return upload->fd != -1;
+}
+
+
+
+
+/**
+ * Fonction : commit_batch
+ * Description : Cette fonction valide un lot de fichiers : écriture des fichiers encore en mémoire, synchronisation
+ *               des données de chaque fichier du lot (écriture lancée pour tous avec sync_file_range, puis fdatasync
+ *               de chacun : les autres fichiers du système de fichiers ne sont pas attendus), renommages, puis un
+ *               fsync par répertoire parent distinct.
+ *               Statut d'une demande : 0 succès, -1 échec avant le renommage (fichier temporaire à supprimer),
+ *               1 fichier renommé mais répertoire non synchronisé (la cible est déjà remplacée).
+ * @param gc : Le thread de validation.
+ * @param batch : La liste des demandes du lot.
+ * @param count : Le nombre de demandes.
+ * @return : Aucune valeur de retour
+ */
+static void commit_batch(GroupCommit* gc, CommitJob* batch, int count) {
+    dev_t* devices = (dev_t*)malloc(count * sizeof(dev_t));
+    ino_t* inodes = (ino_t*)malloc(count * sizeof(ino_t));
+    int seen = 0;
+    struct stat st;
+
+    // 1. Écriture des fichiers encore en mémoire
+    for (CommitJob* job = batch; job != NULL; job = job->next) {
+        job->status = 0;
+        if (!staged_upload_spilled(job->upload)) {
+            gc->staged_in_memory++;
+            if (spill(job->upload) < 0) {
+                job->status = -1;
+            }
+        }
+    }
+
+    // 2. Synchronisation des données des seuls fichiers du lot : écritures lancées ensemble, puis attendues une à une
+    if (count > 1) {
+        for (CommitJob* job = batch; job != NULL; job = job->next) {
+            if (job->status == 0) {
+                sync_file_range(job->upload->fd, 0, 0, SYNC_FILE_RANGE_WRITE);
+            }
+        }
+    }
+    for (CommitJob* job = batch; job != NULL; job = job->next) {
+        if (job->status == 0 && fdatasync(job->upload->fd) != 0) {
+            perror("Erreur lors de la synchronisation d'un fichier reçu");
+            job->status = -1;
+        }
+    }
+
+    // 3. Renommages, puis synchronisation de chaque répertoire parent une seule fois
+    for (CommitJob* job = batch; job != NULL; job = job->next) {
+        if (devices == NULL || inodes == NULL) {
+            job->status = -1;
+        }
+        if (job->status != 0) {
+            continue;
+        }
+        if (fsroot_rename(gc->root, job->upload->temp_name, job->target) != 0) {
+            perror("Erreur lors du renommage du fichier temporaire");
+            job->status = -1;
+            continue;
+        }
+        close(job->upload->fd);  // Le fichier temporaire n'existe plus
+        job->upload->fd = -1;
+        job->upload->renamed = true;
+
+        // Au-delà, un échec laisse la cible remplacée : il est signalé à part (statut 1)
+        int dirfd = fsroot_open_parent(gc->root, job->target);
+        if (dirfd < 0 || fstat(dirfd, &st) != 0) {
+            perror("Erreur lors de l'ouverture du répertoire d'un fichier reçu");
+            job->status = 1;
+        } else {
+            bool known = false;
+            for (int i = 0; i < seen; i++) {
+                known = known || (devices[i] == st.st_dev && inodes[i] == st.st_ino);
+            }
+            if (!known) {
+                if (fsync(dirfd) != 0) {
+                    perror("Erreur lors de la synchronisation du répertoire d'un fichier reçu");
+                    job->status = 1;    // Répertoire non retenu : la demande suivante le synchronise à nouveau
+                } else {
+                    devices[seen] = st.st_dev;
+                    inodes[seen++] = st.st_ino;
+                }
+            }
+        }
+        if (dirfd >= 0) {
+            close(dirfd);
+        }
+    }
+
+    free(devices);
+    free(inodes);
+}
+
+
+
+
+/**
+ * Fonction : commit_thread
+ * Description : Boucle du thread de validation : attend des demandes, les traite par lots et réveille les demandeurs.
+ * @param arg : Un pointeur vers la structure GroupCommit.
+ * @return : Aucune valeur de retour
+ */
+static void* commit_thread(void* arg) {
+    GroupCommit* gc = (GroupCommit*)arg;
+
+    pthread_mutex_lock(&gc->mutex);
+    while (1) {
+        while (gc->head == NULL) {
+            pthread_cond_wait(&gc->work_cond, &gc->mutex);
+        }
+        if (gc->window_ms > 0) {    // Laisser le temps à d'autres demandes de rejoindre le lot
+            pthread_mutex_unlock(&gc->mutex);
+            usleep(gc->window_ms * 1000);
+            pthread_mutex_lock(&gc->mutex);
+        }
+
+        CommitJob* batch = gc->head;
+        gc->head = NULL;
+        gc->tail = NULL;
+        pthread_mutex_unlock(&gc->mutex);
+
+        int count = 0;
+        for (CommitJob* job = batch; job != NULL; job = job->next) {
+            count++;
+        }
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        commit_batch(gc, batch, count);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        pthread_mutex_lock(&gc->mutex);
+        gc->batches++;
+        gc->files += count;
+        gc->total_batch_ms += (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0;
+        if (count > gc->max_batch) {
+            gc->max_batch = count;
+        }
+        // Les demandeurs ne peuvent reprendre la main qu'après libération du mutex
+        CommitJob* job = batch;
+        while (job != NULL) {
+            CommitJob* next = job->next;
+            if (job->status < 0) {
+                gc->failures++;
+            } else if (job->status > 0) {
+                gc->not_durable++;
+            }
+            job->done = true;
+            job = next;
+        }
+        pthread_cond_broadcast(&gc->done_cond);
+    }
+    return NULL;
+}
+
+
+
+
+/**
+ * Fonction : commit_init
+ * Description : Cette fonction initialise et démarre le thread de validation groupée.
+ * @param gc : La structure GroupCommit.
+ * @param root : La racine de service.
+ * @param window_ms : Le délai d'accumulation des lots (0 = aucun).
+ * @return : 0 en cas de succès, -1 en cas d'échec.
+ */
+int commit_init(GroupCommit* gc, ServingRoot* root, int window_ms) {
+    memset(gc, 0, sizeof(*gc));
+    gc->root = root;
+    gc->window_ms = window_ms;
+    pthread_mutex_init(&gc->mutex, NULL);
+    pthread_cond_init(&gc->work_cond, NULL);
+    pthread_cond_init(&gc->done_cond, NULL);
+
+    if (pthread_create(&gc->thread, NULL, commit_thread, gc) != 0) {
+        return -1;
+    }
+    pthread_detach(gc->thread);
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : commit_upload
+ * Description : Cette fonction soumet un fichier reçu au thread de validation et attend que son contenu
+ *               et son nom définitif soient durables.
+ * @param gc : Le thread de validation.
+ * @param file : Le flux d'écriture du fichier (vidé avant la soumission).
+ * @param upload : L'état du fichier reçu.
+ * @param target : Le nom définitif du fichier.
+ * @return : 0 en cas de succès, -1 en cas d'échec avant le renommage (fichier temporaire à supprimer),
+ *           1 si la cible a été remplacée mais son répertoire n'a pas pu être synchronisé.
+ */
+int commit_upload(GroupCommit* gc, FILE* file, StagedUpload* upload, const char* target) {
+    if (fflush(file) != 0) {
+        return -1;
+    }
+
+    CommitJob job;
+    job.upload = upload;
+    job.target = target;
+    job.status = -1;
+    job.done = false;
+    job.next = NULL;
+
+    pthread_mutex_lock(&gc->mutex);
+    if (gc->tail != NULL) {
+        gc->tail->next = &job;
+    } else {
+        gc->head = &job;
+    }
+    gc->tail = &job;
+    pthread_cond_signal(&gc->work_cond);
+
+    while (!job.done) {
+        pthread_cond_wait(&gc->done_cond, &gc->mutex);
+    }
+    pthread_mutex_unlock(&gc->mutex);
+    return job.status;
+}
+
+
+
+
+/**
+ * Fonction : commit_report
+ * Description : Cette fonction affiche les compteurs de la validation groupée.
+ * @param gc : Le thread de validation.
+ * @param out : Le flux de sortie.
+ * @return : Aucune valeur de retour
+ */
+void commit_report(GroupCommit* gc, FILE* out) {
+    pthread_mutex_lock(&gc->mutex);
+    fprintf(out, "[COMMIT] lots %lu | fichiers %lu (dont %lu préparés en mémoire) | échecs %lu | renommés sans répertoire synchronisé %lu | lot max %d | durée moyenne d'un lot %.2f ms\n",
+            gc->batches, gc->files, gc->staged_in_memory, gc->failures, gc->not_durable, gc->max_batch,
+            gc->batches > 0 ? gc->total_batch_ms / gc->batches : 0.0);
+    pthread_mutex_unlock(&gc->mutex);
+}
@@ -0,0 +1,85 @@
+/**
+ * @file commit.h
+ * @brief Écriture durable des fichiers reçus (WRQ) : préparation en mémoire des petits fichiers
+ *        et validation groupée (écriture + synchronisation + renommage) sur un thread dédié.
+ */
+
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "fsroot.h"
+
+#ifndef COMMIT_H
+#define COMMIT_H
+
+
+/**
+ * @struct StagedUpload
+ * @brief Fichier en cours de réception : conservé en mémoire tant qu'il ne dépasse pas le seuil,
+ *        puis déversé dans le fichier temporaire.
+ */
+typedef struct StagedUpload {
+    ServingRoot* root;
+    char temp_name[PATH_MAX];   /* Fichier temporaire (sous la racine) */
+    size_t threshold;           /* Taille maximale conservée en mémoire */
+    char* data;                 /* Contenu en mémoire (tant que fd == -1) */
+    size_t length;
+    size_t capacity;
+    int fd;                     /* Fichier temporaire après déversement, -1 sinon */
+    bool renamed;               /* Renommé en son nom définitif par la validation */
+} StagedUpload;
+
+
+
+
+/**
+ * @struct CommitJob
+ * @brief Demande de validation d'un fichier reçu, en attente du thread de validation.
+ */
+typedef struct CommitJob {
+    StagedUpload* upload;
+    const char* target;         /* Nom définitif du fichier */
+    int status;                 /* 0 succès, -1 échec avant le renommage, 1 renommé mais répertoire non synchronisé */
+    bool done;
+    struct CommitJob* next;
+} CommitJob;
+
+
+
+
+/**
+ * @struct GroupCommit
+ * @brief Thread de validation groupée : toutes les demandes en attente sont écrites, synchronisées
+ *        (fichiers du lot seulement), renommées, puis chaque répertoire modifié est synchronisé une fois.
+ */
+typedef struct GroupCommit {
+    ServingRoot* root;
+    int window_ms;              /* Délai d'accumulation avant chaque lot (0 = lot naturel) */
+    CommitJob* head;
+    CommitJob* tail;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t work_cond;   /* Nouvelle demande */
+    pthread_cond_t done_cond;   /* Lot terminé */
+
+    unsigned long batches;
+    unsigned long files;
+    unsigned long failures;         /* Échecs avant le renommage */
+    unsigned long not_durable;      /* Cibles remplacées dont le répertoire n'a pas pu être synchronisé */
+    unsigned long staged_in_memory; /* Fichiers validés sans jamais avoir été écrits avant le lot */
+    int max_batch;
+    double total_batch_ms;
+} GroupCommit;
+
+
+
+FILE* staged_upload_open(ServingRoot* root, const char* temp_name, size_t threshold, StagedUpload** upload);
+bool staged_upload_spilled(const StagedUpload* upload);
+bool staged_upload_renamed(const StagedUpload* upload);
+int commit_init(GroupCommit* gc, ServingRoot* root, int window_ms);
+int commit_upload(GroupCommit* gc, FILE* file, StagedUpload* upload, const char* target);
+void commit_report(GroupCommit* gc, FILE* out);
+
+#endif
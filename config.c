@@ -0,0 +1,345 @@
+/**
+ * @file config.c
+ * @brief Lecture de la configuration du serveur TFTP depuis la ligne de commande.
+ */
+
+
+#include <getopt.h>
+#include <string.h>
+#include <strings.h>
+
+#include "config.h"
+
+
+ServerConfig config;    // Configuration globale du serveur
+
+
+
+
+/**
+ * Fonction : init_config
+ * Description : Cette fonction initialise la configuration avec les valeurs par défaut.
+ * @param cfg : Un pointeur vers la structure de configuration à initialiser.
+ * @return : Aucune valeur de retour
+ */
+void init_config(ServerConfig* cfg) {
+    cfg->port = DEFAULT_SERVER_PORT;
+    cfg->max_transfers = DEFAULT_MAX_TRANSFERS;
+    cfg->queue_size = DEFAULT_QUEUE_SIZE;
+    cfg->queue_timeout = DEFAULT_QUEUE_TIMEOUT;
+    cfg->overflow_policy = OVERFLOW_QUEUE;
+    cfg->small_size = DEFAULT_SMALL_SIZE;
+    cfg->small_slots = DEFAULT_SMALL_SLOTS;
+    cfg->rate_limit = 0;
+    cfg->rate_burst = DEFAULT_RATE_BURST;
+    cfg->block_rollover = 0;
+    cfg->negcache_size = DEFAULT_NEGCACHE_SIZE;
+    cfg->root = DEFAULT_ROOT_DIR;
+    cfg->durability = DURABILITY_NONE;
+    cfg->stage_size = DEFAULT_STAGE_SIZE;
+    cfg->commit_window = 0;
+    cfg->trace_file = NULL;
+    cfg->histo_file = NULL;
+    cfg->upstream = NULL;
+    cfg->peers = NULL;
+    cfg->peer_listen = NULL;
+    cfg->peer_cache = DEFAULT_PEER_CACHE;
+    cfg->bundle = NULL;
+    cfg->vfile_rules = NULL;
+    cfg->content_store = NULL;
+    cfg->socket_filter = 1;
+    cfg->checksums = 0;
+    cfg->impair = NULL;
+    cfg->socket_pool = DEFAULT_SOCKET_POOL;
+    cfg->tiny_cache = DEFAULT_TINY_CACHE;
+}
+
+
+
+
+/**
+ * Fonction : print_usage
+ * Description : Cette fonction affiche l'aide de la ligne de commande.
+ * @param prog : Le nom du programme.
+ * @return : Aucune valeur de retour
+ */
+void print_usage(const char* prog) {
+    fprintf(stderr,
+        "Usage : %s [options]\n"
+        "  -p, --port <port>            Port d'écoute (défaut %d)\n"
+        "  -m, --max-transfers <n>      Transferts simultanés maximum, 0 = illimité (défaut %d)\n"
+        "  -q, --queue-size <n>         Taille de la file d'attente (défaut %d)\n"
+        "  -o, --overflow <politique>   queue | drop | error (défaut queue)\n"
+        "  -w, --queue-timeout <s>      Attente maximale dans la file (défaut %d s)\n"
+        "  -z, --small-size <octets>    Fichiers prioritaires jusqu'à cette taille, 0 = pas de priorité (défaut %d)\n"
+        "  -Z, --small-slots <n>        Créneaux réservés aux fichiers prioritaires (défaut %d)\n"
+        "  -r, --rate <req/s>           Requêtes par seconde et par IP source, 0 = illimité (défaut 0)\n"
+        "  -b, --burst <n>              Rafale autorisée par IP source (défaut %d)\n"
+        "  -R, --rollover <0|1>         Numéro de bloc après 65535 (défaut 0)\n"
+        "  -n, --negcache-size <n>      Entrées du cache des fichiers inexistants, 0 = désactivé (défaut %d)\n"
+        "  -d, --root <répertoire>      Racine de service (défaut répertoire courant)\n"
+        "  -D, --durability <mode>      none | group : validation durable des fichiers reçus (défaut none)\n"
+        "  -S, --stage-size <octets>    Fichiers reçus conservés en mémoire jusqu'à cette taille (défaut %d)\n"
+        "  -W, --commit-window <ms>     Délai d'accumulation des lots de validation (défaut 0)\n"
+        "  -T, --trace <fichier>        Enregistre les requêtes, ACK et DATA reçus (rejouables avec replay)\n"
+        "  -H, --histo-file <fichier>   Exporte les histogrammes de latence en JSON sur SIGUSR1 (SIGUSR2 : remise à zéro)\n"
+        "  -C, --content-store <rép.>   Déduplique les fichiers reçus (liens vers un magasin adressé par SHA-256, sous la racine)\n"
+        "  -U, --upstream <hôte:port>   Récupère les fichiers absents auprès de ce serveur TFTP et les conserve sous la racine\n"
+        "  -N, --peers <hôte:port,...>  Mode pair : canaux de toutes les instances (même liste partout), fichiers lus par leur propriétaire\n"
+        "  -L, --peer-listen <h:port>   Canal de cette instance (doit figurer dans la liste -N)\n"
+        "  -M, --peer-cache <Mo>        Cache mémoire des fichiers dont cette instance est propriétaire (défaut %d Mo)\n"
+        "  -B, --bundle <fichier>       Sert les fichiers d'un paquet d'images (construit par mkbundle), rechargé sur SIGHUP\n"
+        "  -V, --vfiles <fichier>       Règles « motif modèle » des fichiers générés en mémoire (ex. pxelinux.cfg/01-* pxe.tpl)\n"
+        "  -t, --tiny-cache <n>         Fichiers d'un seul bloc servis par le thread d'écoute (cache), 0 = désactivé (défaut %d)\n"
+        "  -P, --socket-pool <n>        Sockets de transfert créés au démarrage, 0 = un socket par transfert (défaut %d)\n"
+        "  -I, --impair <spéc.>         Dégrade les DATA/ACK des transferts pour les tests, ex. seed=7,drop=0.02,ack-delay=40,jitter=10\n"
+        "                               (clés : seed, [data-|ack-]drop|dup|reorder (probabilités), delay|jitter (ms))\n"
+        "  -K, --checksums              Active le contrôle CRC32C (empreintes <fichier>.crc32c des fichiers reçus, défaut désactivé)\n"
+        "  -k, --no-checksums           Sans effet : contrôle CRC32C désactivé par défaut (conservée pour compatibilité)\n"
+        "  -F, --no-filter              Désactive les filtres BPF des sockets (rejet des paquets invalides par le noyau)\n"
+        "  -h, --help                   Affiche cette aide\n",
+        prog, DEFAULT_SERVER_PORT, DEFAULT_MAX_TRANSFERS, DEFAULT_QUEUE_SIZE, DEFAULT_QUEUE_TIMEOUT,
+        DEFAULT_SMALL_SIZE, DEFAULT_SMALL_SLOTS, DEFAULT_RATE_BURST,
+        DEFAULT_NEGCACHE_SIZE, DEFAULT_STAGE_SIZE, DEFAULT_PEER_CACHE, DEFAULT_TINY_CACHE, DEFAULT_SOCKET_POOL);
+}
+
+
+
+
+/**
+ * Fonction : parse_int_option
+ * Description : Cette fonction convertit la valeur d'une option en entier positif ou nul.
+ * @param value : La chaîne à convertir.
+ * @param result : Un pointeur vers l'entier résultat.
+ * @return : 0 en cas de succès, -1 si la valeur est invalide.
+ */
+static int parse_int_option(const char* value, int* result) {
+    char* end;
+    long v = strtol(value, &end, 10);
+    if (*value == '\0' || *end != '\0' || v < 0 || v > 1000000000L) {
+        return -1;
+    }
+    *result = (int) v;
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : parse_config
+ * Description : Cette fonction lit les options de la ligne de commande et remplit la configuration.
+ * @param cfg : Un pointeur vers la structure de configuration (déjà initialisée).
+ * @param argc : Le nombre d'arguments.
+ * @param argv : Le tableau des arguments.
+ * @return : 0 en cas de succès, 1 si l'aide a été demandée, -1 en cas d'option invalide.
+ */
+int parse_config(ServerConfig* cfg, int argc, char* argv[]) {
+    static const struct option long_options[] = {
+        {"port",          required_argument, NULL, 'p'},
+        {"max-transfers", required_argument, NULL, 'm'},
+        {"queue-size",    required_argument, NULL, 'q'},
+        {"overflow",      required_argument, NULL, 'o'},
+        {"queue-timeout", required_argument, NULL, 'w'},
+        {"small-size",    required_argument, NULL, 'z'},
+        {"small-slots",   required_argument, NULL, 'Z'},
+        {"rate",          required_argument, NULL, 'r'},
+        {"burst",         required_argument, NULL, 'b'},
+        {"rollover",      required_argument, NULL, 'R'},
+        {"negcache-size", required_argument, NULL, 'n'},
+        {"root",          required_argument, NULL, 'd'},
+        {"durability",    required_argument, NULL, 'D'},
+        {"stage-size",    required_argument, NULL, 'S'},
+        {"commit-window", required_argument, NULL, 'W'},
+        {"trace",         required_argument, NULL, 'T'},
+        {"histo-file",    required_argument, NULL, 'H'},
+        {"upstream",      required_argument, NULL, 'U'},
+        {"content-store", required_argument, NULL, 'C'},
+        {"peers",         required_argument, NULL, 'N'},
+        {"peer-listen",   required_argument, NULL, 'L'},
+        {"peer-cache",    required_argument, NULL, 'M'},
+        {"bundle",        required_argument, NULL, 'B'},
+        {"vfiles",        required_argument, NULL, 'V'},
+        {"tiny-cache",    required_argument, NULL, 't'},
+        {"socket-pool",   required_argument, NULL, 'P'},
+        {"impair",        required_argument, NULL, 'I'},
+        {"checksums",     no_argument,       NULL, 'K'},
+        {"no-checksums",  no_argument,       NULL, 'k'},
+        {"no-filter",     no_argument,       NULL, 'F'},
+        {"help",          no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "p:m:q:o:w:z:Z:r:b:R:n:d:D:S:W:T:H:U:N:L:M:C:B:V:t:P:I:KkFh", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'p':
+                if (parse_int_option(optarg, &cfg->port) < 0 || cfg->port > 65535) {
+                    fprintf(stderr, "Erreur : port invalide '%s'\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'm':
+                if (parse_int_option(optarg, &cfg->max_transfers) < 0) {
+                    fprintf(stderr, "Erreur : nombre de transferts invalide '%s'\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'q':
+                if (parse_int_option(optarg, &cfg->queue_size) < 0) {
+                    fprintf(stderr, "Erreur : taille de file invalide '%s'\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'o':
+                if (strcasecmp(optarg, "queue") == 0) {
+                    cfg->overflow_policy = OVERFLOW_QUEUE;
+                } else if (strcasecmp(optarg, "drop") == 0) {
+                    cfg->overflow_policy = OVERFLOW_DROP;
+                } else if (strcasecmp(optarg, "error") == 0) {
+                    cfg->overflow_policy = OVERFLOW_ERROR;
+                } else {
+                    fprintf(stderr, "Erreur : politique de surcharge inconnue '%s'\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'w':
+                if (parse_int_option(optarg, &cfg->queue_timeout) < 0) {
+                    fprintf(stderr, "Erreur : délai d'attente invalide '%s'\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'z':
+                if (parse_int_option(optarg, &cfg->small_size) < 0) {
+                    fprintf(stderr, "Erreur : taille de fichier prioritaire invalide '%s'\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'Z':
+                if (parse_int_option(optarg, &cfg->small_slots) < 0) {
+                    fprintf(stderr, "Erreur : nombre de créneaux réservés invalide '%s'\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'r': {
+                char* end;
+                cfg->rate_limit = strtod(optarg, &end);
+                if (*optarg == '\0' || *end != '\0' || cfg->rate_limit < 0) {
+                    fprintf(stderr, "Erreur : débit invalide '%s'\n", optarg);
+                    return -1;
+                }
+                break;
+            }
+            case 'b':
+                if (parse_int_option(optarg, &cfg->rate_burst) < 0 || cfg->rate_burst == 0) {
+                    fprintf(stderr, "Erreur : rafale invalide '%s'\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'R':
+                if (parse_int_option(optarg, &cfg->block_rollover) < 0 || cfg->block_rollover > 1) {
+                    fprintf(stderr, "Erreur : valeur de rebouclage invalide '%s' (0 ou 1)\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'n':
+                if (parse_int_option(optarg, &cfg->negcache_size) < 0) {
+                    fprintf(stderr, "Erreur : taille de cache invalide '%s'\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'd':
+                cfg->root = optarg;
+                break;
+            case 'D':
+                if (strcasecmp(optarg, "none") == 0) {
+                    cfg->durability = DURABILITY_NONE;
+                } else if (strcasecmp(optarg, "group") == 0) {
+                    cfg->durability = DURABILITY_GROUP;
+                } else {
+                    fprintf(stderr, "Erreur : mode de durabilité inconnu '%s'\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'S':
+                if (parse_int_option(optarg, &cfg->stage_size) < 0) {
+                    fprintf(stderr, "Erreur : taille de préparation invalide '%s'\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'W':
+                if (parse_int_option(optarg, &cfg->commit_window) < 0) {
+                    fprintf(stderr, "Erreur : délai de validation invalide '%s'\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'T':
+                cfg->trace_file = optarg;
+                break;
+            case 'H':
+                cfg->histo_file = optarg;
+                break;
+            case 'U':
+                cfg->upstream = optarg;
+                break;
+            case 'C':
+                cfg->content_store = optarg;
+                break;
+            case 'N':
+                cfg->peers = optarg;
+                break;
+            case 'L':
+                cfg->peer_listen = optarg;
+                break;
+            case 'M':
+                if (parse_int_option(optarg, &cfg->peer_cache) < 0 || cfg->peer_cache == 0) {
+                    fprintf(stderr, "Erreur : taille du cache des pairs invalide '%s'\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'B':
+                cfg->bundle = optarg;
+                break;
+            case 'V':
+                cfg->vfile_rules = optarg;
+                break;
+            case 't':
+                if (parse_int_option(optarg, &cfg->tiny_cache) < 0) {
+                    fprintf(stderr, "Erreur : taille du cache des petits fichiers invalide '%s'\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'P':
+                if (parse_int_option(optarg, &cfg->socket_pool) < 0) {
+                    fprintf(stderr, "Erreur : taille du pool de sockets invalide '%s'\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'I':
+                cfg->impair = optarg;
+                break;
+            case 'K':
+                cfg->checksums = 1;
+                break;
+            case 'k':
+                cfg->checksums = 0;
+                break;
+            case 'F':
+                cfg->socket_filter = 0;
+                break;
+            case 'h':
+                return 1;
+            default:
+                return -1;
+        }
+    }
+    if (cfg->content_store != NULL && cfg->durability == DURABILITY_GROUP) {
+        fprintf(stderr, "Erreur : la déduplication (-C) n'est pas disponible en mode de durabilité group\n");
+        return -1;
+    }
+    if (cfg->peers != NULL && cfg->peer_listen == NULL) {
+        fprintf(stderr, "Erreur : le mode pair (-N) exige le canal de cette instance (-L)\n");
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,96 @@
+/**
+ * @file config.h
+ * @brief Définition de la configuration du serveur TFTP (options de la ligne de commande).
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#define DEFAULT_SERVER_PORT 69
+#define DEFAULT_MAX_TRANSFERS 64
+#define DEFAULT_QUEUE_SIZE 128
+#define DEFAULT_QUEUE_TIMEOUT 10
+#define DEFAULT_RATE_BURST 10
+#define DEFAULT_NEGCACHE_SIZE 1024
+#define DEFAULT_ROOT_DIR "."
+#define DEFAULT_STAGE_SIZE 65536
+#define DEFAULT_SMALL_SIZE 1048576
+#define DEFAULT_SMALL_SLOTS 8
+#define DEFAULT_SOCKET_POOL 64
+#define DEFAULT_TINY_CACHE 256
+#define DEFAULT_PEER_CACHE 256
+
+
+/**
+ * @enum OverflowPolicy
+ * @brief Comportement du serveur lorsque le nombre maximum de transferts actifs est atteint.
+ */
+typedef enum {
+    OVERFLOW_QUEUE = 0,     /* Mise en file d'attente (puis abandon silencieux si la file est pleine) */
+    OVERFLOW_DROP,          /* Abandon silencieux, le client retransmettra sa requête */
+    OVERFLOW_ERROR          /* Réponse immédiate par un paquet d'erreur */
+} OverflowPolicy;
+
+
+
+
+/**
+ * @enum DurabilityMode
+ * @brief Garanties apportées aux fichiers reçus (WRQ) avant l'envoi du dernier ACK.
+ */
+typedef enum {
+    DURABILITY_NONE = 0,    /* Renommage après le dernier ACK, sans fsync */
+    DURABILITY_GROUP        /* Écriture, fsync et renommage par lots avant le dernier ACK */
+} DurabilityMode;
+
+
+
+
+/**
+ * @struct ServerConfig
+ * @brief Structure regroupant les paramètres du serveur.
+ */
+typedef struct ServerConfig {
+    int port;                       /* Port d'écoute du serveur */
+    int max_transfers;              /* Nombre maximum de transferts simultanés (0 = illimité) */
+    int queue_size;                 /* Taille de la file d'attente des requêtes */
+    int queue_timeout;              /* Durée (s) au-delà de laquelle une requête en attente est abandonnée */
+    OverflowPolicy overflow_policy; /* Politique en cas de surcharge */
+    int small_size;                 /* Taille (octets) jusqu'à laquelle un fichier est prioritaire (0 = pas de classement) */
+    int small_slots;                /* Créneaux réservés aux petits fichiers */
+    double rate_limit;              /* Requêtes par seconde autorisées par IP source (0 = illimité) */
+    int rate_burst;                 /* Rafale autorisée par IP source */
+    int block_rollover;             /* Numéro de bloc après 65535 : 0 ou 1 */
+    int negcache_size;              /* Entrées du cache des fichiers inexistants (0 = désactivé) */
+    const char* root;               /* Racine de service : aucun fichier n'est servi en dehors */
+    DurabilityMode durability;      /* Mode de validation des fichiers reçus */
+    int stage_size;                 /* Taille maximale d'un fichier reçu conservé en mémoire (mode durable) */
+    int commit_window;              /* Délai (ms) d'accumulation d'un lot de validation */
+    const char* trace_file;         /* Fichier de trace des paquets reçus (NULL = désactivé) */
+    const char* histo_file;         /* Export JSON des histogrammes de latence sur SIGUSR1 (NULL = désactivé) */
+    int tiny_cache;                 /* Fichiers d'un seul bloc en cache pour le chemin rapide (0 = désactivé) */
+    int socket_pool;                /* Sockets de transfert créés au démarrage (0 = un socket par transfert) */
+    const char* impair;             /* Dégradation réseau simulée des transferts (NULL = désactivée, voir impair.h) */
+    int checksums;                  /* CRC32C des transferts et fichiers d'empreinte des fichiers reçus (1, option -K) ou non (0, défaut) */
+    int socket_filter;              /* Filtres BPF sur les sockets (1) ou vérifications en espace utilisateur seules (0) */
+    const char* content_store;      /* Magasin de déduplication des fichiers reçus, relatif à la racine (NULL = désactivé) */
+    const char* vfile_rules;        /* Règles des fichiers virtuels générés à partir de modèles (NULL = désactivé, voir vfile.h) */
+    const char* bundle;             /* Paquet d'images projeté en mémoire, servi avant la racine (NULL = désactivé) */
+    const char* upstream;           /* Serveur TFTP amont des fichiers absents, « hôte[:port] » (NULL = désactivé) */
+    const char* peers;              /* Canaux de toutes les instances du mode pair, « hôte:port,... » (NULL = désactivé, voir peer.h) */
+    const char* peer_listen;        /* Canal de cette instance (figure dans la liste des pairs) */
+    int peer_cache;                 /* Cache mémoire (Mo) des fichiers dont cette instance est propriétaire */
+} ServerConfig;
+
+
+extern ServerConfig config;
+
+void init_config(ServerConfig* cfg);
+int parse_config(ServerConfig* cfg, int argc, char* argv[]);
+void print_usage(const char* prog);
+
+#endif
@@ -0,0 +1,143 @@
+/**
+ * @file crc32c.c
+ * @brief Implémentation du CRC32C. L'implémentation est choisie une seule fois, au premier appel.
+ *        La valeur manipulée par l'appelant est le CRC final (inversé) : 0 pour commencer, puis le résultat
+ *        de chaque appel, comme crc32() de zlib. CRC32C("123456789") = 0xE3069283.
+ */
+
+
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+#include "crc32c.h"
+
+#define CRC32C_POLY 0x82F63B78u        /* Polynôme de Castagnoli, bits inversés */
+
+
+static uint32_t crc32c_table[8][256];
+static uint32_t (*crc32c_impl)(uint32_t crc, const unsigned char* p, size_t len);
+static const char* crc32c_name;
+static pthread_once_t crc32c_once = PTHREAD_ONCE_INIT;
+
+
+
+/**
+ * Fonction : crc32c_table_update
+ * Description : Cette fonction calcule le CRC par tables, 8 octets par itération (« slicing-by-8 »).
+ * @param crc : Le CRC courant (non inversé).
+ * @param p : Les données.
+ * @param len : La taille des données.
+ * @return : Le CRC mis à jour (non inversé).
+ */
+static uint32_t crc32c_table_update(uint32_t crc, const unsigned char* p, size_t len) {
+    while (len >= 8) {
+        uint32_t low = crc ^ ((uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24);
+        uint32_t high = (uint32_t) p[4] | (uint32_t) p[5] << 8 | (uint32_t) p[6] << 16 | (uint32_t) p[7] << 24;
+        crc = crc32c_table[7][low & 0xFF] ^ crc32c_table[6][(low >> 8) & 0xFF]
+            ^ crc32c_table[5][(low >> 16) & 0xFF] ^ crc32c_table[4][low >> 24]
+            ^ crc32c_table[3][high & 0xFF] ^ crc32c_table[2][(high >> 8) & 0xFF]
+            ^ crc32c_table[1][(high >> 16) & 0xFF] ^ crc32c_table[0][high >> 24];
+        p += 8;
+        len -= 8;
+    }
+    while (len--) {
+        crc = crc32c_table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+
+
+
+#if defined(__x86_64__)
+/**
+ * Fonction : crc32c_sse42_update
+ * Description : Cette fonction calcule le CRC avec l'instruction crc32 de SSE4.2, 8 octets par instruction.
+ * @param crc : Le CRC courant (non inversé).
+ * @param p : Les données.
+ * @param len : La taille des données.
+ * @return : Le CRC mis à jour (non inversé).
+ */
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42_update(uint32_t crc, const unsigned char* p, size_t len) {
+    uint64_t crc64 = crc;
+    while (len >= 8) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+        p += 8;
+        len -= 8;
+    }
+    crc = (uint32_t) crc64;
+    while (len--) {
+        crc = _mm_crc32_u8(crc, *p++);
+    }
+    return crc;
+}
+#endif
+
+
+
+
+/**
+ * Fonction : crc32c_select
+ * Description : Cette fonction construit les tables et choisit l'implémentation (appelée une seule fois).
+ * @return : Aucune valeur de retour
+ */
+static void crc32c_select(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (CRC32C_POLY & (0u - (crc & 1)));
+        }
+        crc32c_table[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int k = 1; k < 8; k++) {
+            crc32c_table[k][i] = crc32c_table[0][crc32c_table[k - 1][i] & 0xFF] ^ (crc32c_table[k - 1][i] >> 8);
+        }
+    }
+
+    crc32c_impl = crc32c_table_update;
+    crc32c_name = "tables";
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2")) {
+        crc32c_impl = crc32c_sse42_update;
+        crc32c_name = "sse4.2";
+    }
+#endif
+}
+
+
+
+
+/**
+ * Fonction : crc32c_update
+ * Description : Cette fonction ajoute des données à un CRC32C.
+ * @param crc : Le CRC des données précédentes (0 au début).
+ * @param data : Les données à ajouter.
+ * @param len : La taille des données.
+ * @return : Le CRC32C de l'ensemble des données.
+ */
+uint32_t crc32c_update(uint32_t crc, const void* data, size_t len) {
+    pthread_once(&crc32c_once, crc32c_select);
+    return ~crc32c_impl(~crc, (const unsigned char*) data, len);
+}
+
+
+
+
+/**
+ * Fonction : crc32c_implementation
+ * Description : Cette fonction indique l'implémentation utilisée.
+ * @return : « sse4.2 » ou « tables ».
+ */
+const char* crc32c_implementation(void) {
+    pthread_once(&crc32c_once, crc32c_select);
+    return crc32c_name;
+}
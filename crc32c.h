@@ -0,0 +1,18 @@
+/**
+ * @file crc32c.h
+ * @brief CRC32C (polynôme de Castagnoli) incrémental : instruction crc32 de SSE4.2 si le processeur la fournit,
+ *        sinon tables (8 octets par itération).
+ */
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef CRC32C_H
+#define CRC32C_H
+
+
+uint32_t crc32c_update(uint32_t crc, const void* data, size_t len);
+const char* crc32c_implementation(void);
+
+#endif
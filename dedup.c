@@ -0,0 +1,229 @@
+/**
+ * @file dedup.c
+ * @brief Implémentation de la déduplication des fichiers reçus.
+ *        À la validation, le fichier temporaire devient l'objet de son contenu (lien dans le magasin) s'il est nouveau ;
+ *        sinon un lien vers l'objet existant remplace le fichier cible et le fichier temporaire est supprimé, avant que
+ *        ses pages n'aient en général été écrites sur disque.
+ */
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "dedup.h"
+
+
+
+/**
+ * Fonction : dedup_init
+ * Description : Cette fonction initialise le magasin adressé par contenu (créé à la première validation).
+ * @param store : Le magasin à initialiser.
+ * @param root : La racine de service.
+ * @param dir : Le répertoire du magasin, relatif à la racine.
+ * @return : 0 en cas de succès, -1 si le chemin est invalide (errno positionné).
+ */
+int dedup_init(ContentStore* store, ServingRoot* root, const char* dir) {
+    memset(store, 0, sizeof(*store));
+    store->root = root;
+    pthread_mutex_init(&store->mutex, NULL);
+
+    if (strlen(dir) >= sizeof(store->dir)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(store->dir, dir);
+    if (fsroot_normalize(store->dir) < 0) {
+        return -1;
+    }
+    if (store->dir[0] == '\0') {
+        errno = EINVAL;     // La racine elle-même ne peut pas servir de magasin
+        return -1;
+    }
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : dedup_owns
+ * Description : Cette fonction indique si un chemin désigne le magasin ou l'un de ses objets
+ *               (interdits aux clients : un objet remplacé modifierait tous les fichiers qui le partagent).
+ * @param store : Le magasin.
+ * @param filename : Le chemin normalisé d'une requête.
+ * @return : true si le chemin est dans le magasin.
+ */
+bool dedup_owns(const ContentStore* store, const char* filename) {
+    size_t len = strlen(store->dir);
+    return strncmp(filename, store->dir, len) == 0 && (filename[len] == '\0' || filename[len] == '/');
+}
+
+
+
+
+/**
+ * Fonction : writer_write
+ * Description : Fonction d'écriture du flux (fopencookie) : mise à jour de l'empreinte et écriture dans le fichier temporaire.
+ * @return : Le nombre d'octets écrits, 0 en cas d'erreur.
+ */
+static ssize_t writer_write(void* cookie, const char* buffer, size_t size) {
+    DedupWriter* writer = (DedupWriter*)cookie;
+    if (fwrite(buffer, 1, size, writer->inner) != size) {
+        return 0;
+    }
+    sha256_update(&writer->hash, buffer, size);
+    writer->bytes += size;
+    return size;
+}
+
+
+
+
+/**
+ * Fonction : writer_close
+ * Description : Fonction de fermeture du flux (fopencookie) : ferme le fichier temporaire.
+ * @return : 0 en cas de succès, EOF en cas d'erreur.
+ */
+static int writer_close(void* cookie) {
+    DedupWriter* writer = (DedupWriter*)cookie;
+    int ret = fclose(writer->inner);
+    free(writer);
+    return ret;
+}
+
+
+
+
+/**
+ * Fonction : dedup_wrap
+ * Description : Cette fonction enveloppe le flux d'un fichier reçu pour calculer son empreinte pendant la réception.
+ * @param file : Le flux du fichier temporaire (NULL : aucun effet).
+ * @param writer : Un pointeur qui reçoit l'état du calcul (NULL si le flux n'a pas pu être enveloppé).
+ * @return : Le flux à utiliser pour l'écriture (le flux d'origine si l'enveloppe n'a pas pu être créée).
+ */
+FILE* dedup_wrap(FILE* file, DedupWriter** writer) {
+    *writer = NULL;
+    if (file == NULL) {
+        return NULL;
+    }
+    DedupWriter* w = (DedupWriter*)calloc(1, sizeof(DedupWriter));
+    if (w == NULL) {
+        return file;
+    }
+    w->inner = file;
+    sha256_init(&w->hash);
+
+    cookie_io_functions_t functions = { NULL, writer_write, NULL, writer_close };
+    FILE* wrapped = fopencookie(w, "wb", functions);
+    if (wrapped == NULL) {
+        free(w);
+        return file;
+    }
+    *writer = w;
+    return wrapped;
+}
+
+
+
+
+/**
+ * Fonction : object_matches
+ * Description : Cette fonction vérifie qu'un objet existant du magasin est un fichier de la taille attendue.
+ * @return : true si l'objet peut remplacer le fichier reçu.
+ */
+static bool object_matches(ContentStore* store, const char* object, uint64_t bytes) {
+    int fd = fsroot_open(store->root, object, O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    bool matches = fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && (uint64_t) st.st_size == bytes;
+    close(fd);
+    return matches;
+}
+
+
+
+
+/**
+ * Fonction : dedup_commit
+ * Description : Cette fonction remplace le renommage d'un fichier reçu complet : un contenu nouveau est ajouté au magasin
+ *               (lien vers le fichier temporaire) puis renommé sur la cible ; un contenu déjà connu est lié à la cible
+ *               et le fichier temporaire supprimé. En cas d'échec du magasin, le fichier est simplement renommé.
+ * @param store : Le magasin.
+ * @param file : Le flux d'écriture (vidé avant la validation).
+ * @param writer : L'état du calcul d'empreinte de ce flux.
+ * @param temp_name : Le fichier temporaire.
+ * @param target : Le nom définitif du fichier.
+ * @return : 0 en cas de succès, -1 si le fichier n'a pas pu être renommé (errno positionné).
+ */
+int dedup_commit(ContentStore* store, FILE* file, DedupWriter* writer, const char* temp_name, const char* target) {
+    if (fflush(file) != 0 || fflush(writer->inner) != 0) {
+        return -1;
+    }
+
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    char hex[SHA256_HEX_SIZE];
+    sha256_final(&writer->hash, digest);
+    sha256_hex(digest, hex);
+
+    char object[PATH_MAX];
+    char link_name[PATH_MAX];
+    bool created = false;
+    bool duplicate = false;
+    if (snprintf(object, sizeof(object), "%s/%.2s/%s", store->dir, hex, hex + 2) < (int) sizeof(object)
+        && snprintf(link_name, sizeof(link_name), "%s%s", temp_name, DEDUP_LINK_SUFFIX) < (int) sizeof(link_name)
+        && fsroot_mkdirs(store->root, object) == 0) {
+        if (fsroot_link(store->root, temp_name, object) == 0) {
+            created = true;
+        } else if (errno == EEXIST && object_matches(store, object, writer->bytes)) {
+            fsroot_unlink(store->root, link_name);  // Lien laissé par un arrêt brutal
+            if (fsroot_link(store->root, object, link_name) == 0) {
+                if (fsroot_rename(store->root, link_name, target) == 0) {
+                    fsroot_unlink(store->root, temp_name);
+                    duplicate = true;
+                } else {
+                    fsroot_unlink(store->root, link_name);
+                }
+            }
+        }
+    }
+
+    if (!duplicate && fsroot_rename(store->root, temp_name, target) != 0) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&store->mutex);
+    store->files++;
+    if (created) {
+        store->objects++;
+    } else if (duplicate) {
+        store->duplicates++;
+        store->bytes_saved += writer->bytes;
+    } else {
+        store->fallbacks++;
+    }
+    pthread_mutex_unlock(&store->mutex);
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : dedup_report
+ * Description : Cette fonction affiche les compteurs de la déduplication.
+ * @param store : Le magasin.
+ * @param out : Le flux de sortie.
+ * @return : Aucune valeur de retour
+ */
+void dedup_report(ContentStore* store, FILE* out) {
+    pthread_mutex_lock(&store->mutex);
+    fprintf(out, "[DEDUP] magasin %s | fichiers %lu | nouveaux contenus %lu | doublons %lu (%.1f Ko économisés) | sans déduplication %lu\n",
+            store->dir, store->files, store->objects, store->duplicates, store->bytes_saved / 1024.0, store->fallbacks);
+    pthread_mutex_unlock(&store->mutex);
+}
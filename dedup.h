@@ -0,0 +1,61 @@
+/**
+ * @file dedup.h
+ * @brief Déduplication des fichiers reçus : l'empreinte SHA-256 est calculée pendant la réception, et les contenus
+ *        identiques sont conservés une seule fois dans un magasin adressé par contenu (liens physiques).
+ */
+
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "fsroot.h"
+#include "sha256.h"
+
+#ifndef DEDUP_H
+#define DEDUP_H
+
+#define DEDUP_LINK_SUFFIX ".lnk"        /* Lien temporaire vers l'objet, renommé sur le fichier cible */
+
+
+/**
+ * @struct DedupWriter
+ * @brief Flux d'écriture d'un fichier reçu : transmet les données au fichier temporaire et calcule leur empreinte.
+ */
+typedef struct DedupWriter {
+    FILE* inner;                    /* Flux du fichier temporaire */
+    Sha256 hash;
+    uint64_t bytes;
+} DedupWriter;
+
+
+
+
+/**
+ * @struct ContentStore
+ * @brief Magasin adressé par contenu, sous la racine de service : <dir>/<2 premiers chiffres>/<62 suivants>.
+ *        Chaque fichier reçu est un lien physique vers l'objet de son contenu ; le serveur remplaçant toujours
+ *        un fichier par renommage (jamais en place), un objet partagé n'est jamais modifié.
+ */
+typedef struct ContentStore {
+    ServingRoot* root;
+    char dir[PATH_MAX];             /* Répertoire du magasin (normalisé, relatif à la racine) */
+    pthread_mutex_t mutex;
+
+    unsigned long files;            /* Fichiers reçus validés */
+    unsigned long objects;          /* Contenus nouveaux ajoutés au magasin */
+    unsigned long duplicates;       /* Fichiers remplacés par un lien vers un objet existant */
+    unsigned long fallbacks;        /* Fichiers conservés sans déduplication (erreur, limite de liens) */
+    unsigned long long bytes_saved; /* Octets non conservés grâce aux doublons */
+} ContentStore;
+
+
+
+int dedup_init(ContentStore* store, ServingRoot* root, const char* dir);
+bool dedup_owns(const ContentStore* store, const char* filename);
+FILE* dedup_wrap(FILE* file, DedupWriter** writer);
+int dedup_commit(ContentStore* store, FILE* file, DedupWriter* writer, const char* temp_name, const char* target);
+void dedup_report(ContentStore* store, FILE* out);
+
+#endif
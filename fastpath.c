@@ -0,0 +1,470 @@
+/**
+ * @file fastpath.c
+ * @brief Implémentation du chemin rapide des fichiers d'un seul bloc.
+ *        Le cache est validé à chaque requête par fstat (inode, taille, dates de modification et de changement) :
+ *        le serveur remplaçant les fichiers par renommage, un fichier reçu depuis la mise en cache a un autre inode.
+ *        Le thread de service attend les ACK de tous les transferts en cours (epoll) jusqu'à la plus proche échéance.
+ */
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+#include "fastpath.h"
+#include "probes.h"
+
+#define FASTPATH_EVENTS 32
+#define FASTPATH_WAKE FASTPATH_MAX_TRANSFERS     /* Identifiant epoll de l'eventfd */
+
+
+
+/**
+ * Fonction : hash_filename
+ * Description : Cette fonction calcule l'alvéole d'un nom de fichier (FNV-1a).
+ * @param filename : Le nom du fichier.
+ * @return : L'indice de l'alvéole.
+ */
+static uint32_t hash_filename(const char* filename) {
+    uint32_t h = 2166136261u;
+    for (const unsigned char* p = (const unsigned char*) filename; *p; p++) {
+        h ^= *p;
+        h *= 16777619u;
+    }
+    return h & (FASTPATH_BUCKETS - 1);
+}
+
+
+
+
+/**
+ * Fonction : find_entry
+ * Description : Cette fonction recherche l'entrée d'un nom de fichier.
+ * @param fp : Le chemin rapide.
+ * @param filename : Le nom du fichier.
+ * @return : L'indice de l'entrée, ou -1 si elle n'existe pas.
+ */
+static int find_entry(FastPath* fp, const char* filename) {
+    for (int i = fp->buckets[hash_filename(filename)]; i != -1; i = fp->entries[i].next) {
+        if (strcmp(fp->entries[i].filename, filename) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+
+
+/**
+ * Fonction : remove_entry
+ * Description : Cette fonction retire une entrée de son alvéole et la libère.
+ * @param fp : Le chemin rapide.
+ * @param index : L'indice de l'entrée à retirer.
+ * @return : Aucune valeur de retour
+ */
+static void remove_entry(FastPath* fp, int index) {
+    int* link = &fp->buckets[hash_filename(fp->entries[index].filename)];
+    while (*link != -1 && *link != index) {
+        link = &fp->entries[*link].next;
+    }
+    if (*link == index) {
+        *link = fp->entries[index].next;
+    }
+    fp->entries[index].used = false;
+    fp->count--;
+}
+
+
+
+
+/**
+ * Fonction : same_file
+ * Description : Cette fonction vérifie qu'une entrée du cache correspond toujours au fichier ouvert.
+ * @return : true si le contenu en cache peut être envoyé.
+ */
+static bool same_file(const TinyEntry* entry, const struct stat* st) {
+    return entry->dev == st->st_dev && entry->ino == st->st_ino && entry->len == st->st_size
+        && entry->mtime.tv_sec == st->st_mtim.tv_sec && entry->mtime.tv_nsec == st->st_mtim.tv_nsec
+        && entry->ctime.tv_sec == st->st_ctim.tv_sec && entry->ctime.tv_nsec == st->st_ctim.tv_nsec;
+}
+
+
+
+
+/**
+ * Fonction : load_file
+ * Description : Cette fonction fournit le contenu d'un fichier d'un seul bloc, depuis le cache ou en le lisant
+ *               (le fichier lu remplace alors l'entrée la plus ancienne).
+ * @param fp : Le chemin rapide.
+ * @param root : La racine de service.
+ * @param bundles : Le paquet d'images, prioritaire sur la racine (copie depuis la projection, sans cache).
+ * @param vfiles : Les fichiers virtuels, prioritaires sur le paquet (contenus en cache dans vfile.c).
+ * @param peer : L'adresse du client (variables des modèles).
+ * @param filename : Le nom normalisé du fichier.
+ * @param data : Le tampon qui reçoit le contenu (MAX_DATA_SIZE octets).
+ * @return : La taille du contenu, -1 si le fichier n'est pas servi par le chemin rapide.
+ */
+static int load_file(FastPath* fp, ServingRoot* root, BundleSet* bundles, VirtualFiles* vfiles, const struct sockaddr_in* peer,
+                     const char* filename, char* data) {
+    if (vfile_match(vfiles, filename)) {
+        return vfile_read_small(vfiles, filename, peer, data, MAX_DATA_SIZE);
+    }
+    uint64_t bundle_len;
+    if (bundle_size(bundles, filename, &bundle_len)) {
+        return bundle_len < MAX_DATA_SIZE ? bundle_read_small(bundles, filename, data, MAX_DATA_SIZE) : -1;
+    }
+    if (strlen(filename) >= FASTPATH_MAX_FILENAME) {
+        return -1;
+    }
+    int fd = fsroot_open(root, filename, O_RDONLY | O_NONBLOCK | O_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;      // Erreurs (fichier absent, accès refusé) traitées par le chemin normal
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size >= MAX_DATA_SIZE) {
+        close(fd);
+        return -1;
+    }
+
+    int index = find_entry(fp, filename);
+    if (index != -1 && same_file(&fp->entries[index], &st)) {
+        close(fd);
+        memcpy(data, fp->entries[index].data, fp->entries[index].len);
+        fp->hits++;
+        return fp->entries[index].len;
+    }
+
+    ssize_t len = pread(fd, data, MAX_DATA_SIZE, 0);
+    struct stat after;
+    bool stable = len == st.st_size && fstat(fd, &after) == 0
+        && after.st_size == st.st_size && after.st_mtim.tv_sec == st.st_mtim.tv_sec && after.st_mtim.tv_nsec == st.st_mtim.tv_nsec;
+    close(fd);
+    if (!stable) {
+        return -1;      // Fichier en cours de modification : le chemin normal le lira sous verrou
+    }
+
+    if (index != -1) {
+        remove_entry(fp, index);
+    }
+    index = fp->next_slot;
+    fp->next_slot = (fp->next_slot + 1) % fp->capacity;
+    if (fp->entries[index].used) {
+        remove_entry(fp, index);
+    }
+    TinyEntry* entry = &fp->entries[index];
+    strcpy(entry->filename, filename);
+    memcpy(entry->data, data, len);
+    entry->len = (uint16_t) len;
+    entry->dev = st.st_dev;
+    entry->ino = st.st_ino;
+    entry->mtime = st.st_mtim;
+    entry->ctime = st.st_ctim;
+    uint32_t bucket = hash_filename(filename);
+    entry->next = fp->buckets[bucket];
+    fp->buckets[bucket] = index;
+    entry->used = true;
+    fp->count++;
+    fp->loads++;
+    return (int) len;
+}
+
+
+
+
+/**
+ * Fonction : finish_transfer
+ * Description : Cette fonction termine un transfert (mutex déjà verrouillé) : le socket est rendu au pool.
+ * @param fp : Le chemin rapide.
+ * @param slot : L'emplacement du transfert.
+ * @param success : true si l'ACK a été reçu.
+ * @return : Aucune valeur de retour
+ */
+static void finish_transfer(FastPath* fp, int slot, bool success) {
+    TinyTransfer* transfer = &fp->transfers[slot];
+    epoll_ctl(fp->epoll_fd, EPOLL_CTL_DEL, transfer->sockfd, NULL);
+    sockpool_release(fp->pool, transfer->sockfd);
+    transfer->sockfd = -1;
+    fp->active--;
+    if (success) {
+        uint64_t duration_us = histo_now_us() - transfer->received_us;
+        fp->completed++;
+        histo_record_transfer(fp->histo, transfer->packet_len - TFTP_HEADER_SIZE, duration_us);
+        PROBE4(transfer__complete, transfer->id, TFTP_OPCODE_RRQ, transfer->packet_len - TFTP_HEADER_SIZE, duration_us);
+    } else {
+        fp->failures++;
+    }
+}
+
+
+
+
+/**
+ * Fonction : receive_ack
+ * Description : Cette fonction lit les paquets reçus par le socket d'un transfert (mutex déjà verrouillé).
+ * @param fp : Le chemin rapide.
+ * @param slot : L'emplacement du transfert.
+ * @return : Aucune valeur de retour
+ */
+static void receive_ack(FastPath* fp, int slot) {
+    TinyTransfer* transfer = &fp->transfers[slot];
+    TFTP_AckPacket ack_packet;
+    ssize_t recvlen;
+    while ((recvlen = recv(transfer->sockfd, &ack_packet, sizeof(ack_packet), MSG_DONTWAIT)) >= 0) {
+        if (recvlen == 0) {
+            continue;
+        }
+        trace_record(fp->trace, &transfer->peer, &ack_packet, recvlen);
+        if (recvlen >= TFTP_HEADER_SIZE && ack_packet.opcode == htons(TFTP_OPCODE_ACK) && ack_packet.block_num == htons(1)) {
+            if (transfer->sent_us != 0) {
+                histo_record(fp->histo, HISTO_ACK_RTT, histo_now_us() - transfer->sent_us);
+            }
+            PROBE3(ack__received, transfer->id, 1, transfer->packet_len - TFTP_HEADER_SIZE);
+            finish_transfer(fp, slot, true);
+            return;
+        }
+        if (recvlen >= 2 && ack_packet.opcode == htons(TFTP_OPCODE_ERR)) {
+            finish_transfer(fp, slot, false);   // Transfert annulé par le client
+            return;
+        }
+    }
+    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        finish_transfer(fp, slot, false);       // Client injoignable (ICMP port unreachable)
+    }
+}
+
+
+
+
+/**
+ * Fonction : service_loop
+ * Description : Fonction du thread de service : réception des ACK, retransmissions et abandons.
+ * @param arg : Le chemin rapide.
+ * @return : Aucune valeur de retour (le thread ne se termine pas).
+ */
+static void* service_loop(void* arg) {
+    FastPath* fp = (FastPath*)arg;
+    struct epoll_event events[FASTPATH_EVENTS];
+
+    for (;;) {
+        int timeout_ms = -1;
+        pthread_mutex_lock(&fp->mutex);
+        uint64_t now = histo_now_us();
+        for (int i = 0; i < FASTPATH_MAX_TRANSFERS; i++) {
+            if (fp->transfers[i].sockfd >= 0) {
+                uint64_t deadline = fp->transfers[i].deadline_us;
+                int wait_ms = deadline > now ? (int) ((deadline - now + 999) / 1000) : 0;
+                if (timeout_ms < 0 || wait_ms < timeout_ms) {
+                    timeout_ms = wait_ms;
+                }
+            }
+        }
+        pthread_mutex_unlock(&fp->mutex);
+
+        int n = epoll_wait(fp->epoll_fd, events, FASTPATH_EVENTS, timeout_ms);
+
+        pthread_mutex_lock(&fp->mutex);
+        for (int i = 0; i < n; i++) {
+            int slot = (int) events[i].data.u32;
+            if (slot == FASTPATH_WAKE) {
+                uint64_t value;
+                if (read(fp->wake_fd, &value, sizeof(value)) < 0) {
+                    continue;
+                }
+            } else if (fp->transfers[slot].sockfd >= 0) {
+                receive_ack(fp, slot);
+            }
+        }
+
+        now = histo_now_us();
+        for (int i = 0; i < FASTPATH_MAX_TRANSFERS; i++) {
+            TinyTransfer* transfer = &fp->transfers[i];
+            if (transfer->sockfd < 0 || transfer->deadline_us > now) {
+                continue;
+            }
+            PROBE3(timeout, transfer->id, 1, transfer->retries);
+            if (transfer->retries < MAX_RETRIES) {
+                send(transfer->sockfd, &transfer->packet, transfer->packet_len, 0);
+                PROBE3(retransmit, transfer->id, 1, transfer->retries + 1);
+                transfer->sent_us = 0;
+                transfer->retries++;
+                transfer->deadline_us = now + TIMEOUT_SECONDS * 1000000ULL;
+                fp->retransmits++;
+            } else {
+                send_error_packet(transfer->sockfd, &transfer->peer, NotDefined, get_error_message(NotDefined), NULL);
+                finish_transfer(fp, i, false);
+            }
+        }
+        pthread_mutex_unlock(&fp->mutex);
+    }
+    return NULL;
+}
+
+
+
+
+/**
+ * Fonction : fastpath_init
+ * Description : Cette fonction initialise le cache et démarre le thread de service.
+ *               Le thread hérite du masque de signaux de l'appelant.
+ * @param fp : Le chemin rapide à initialiser.
+ * @param capacity : Le nombre maximum de fichiers en cache (0 = chemin rapide désactivé).
+ * @param pool : Le pool des sockets de transfert.
+ * @param trace : L'enregistrement des paquets reçus.
+ * @param histo : Les histogrammes de latence.
+ * @return : 0 en cas de succès, -1 en cas d'échec (errno positionné).
+ */
+int fastpath_init(FastPath* fp, int capacity, SocketPool* pool, PacketTrace* trace, HistoRegistry* histo) {
+    memset(fp, 0, sizeof(*fp));
+    fp->epoll_fd = -1;
+    fp->wake_fd = -1;
+    fp->pool = pool;
+    fp->trace = trace;
+    fp->histo = histo;
+    for (int i = 0; i < FASTPATH_BUCKETS; i++) {
+        fp->buckets[i] = -1;
+    }
+    for (int i = 0; i < FASTPATH_MAX_TRANSFERS; i++) {
+        fp->transfers[i].sockfd = -1;
+    }
+    pthread_mutex_init(&fp->mutex, NULL);
+    if (capacity <= 0) {
+        return 0;
+    }
+
+    fp->entries = (TinyEntry*)calloc(capacity, sizeof(TinyEntry));
+    fp->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    fp->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fp->entries == NULL || fp->epoll_fd < 0 || fp->wake_fd < 0) {
+        return -1;
+    }
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.u32 = FASTPATH_WAKE;
+    if (epoll_ctl(fp->epoll_fd, EPOLL_CTL_ADD, fp->wake_fd, &event) < 0) {
+        return -1;
+    }
+    int ret = pthread_create(&fp->thread, NULL, service_loop, fp);
+    if (ret != 0) {
+        errno = ret;
+        return -1;
+    }
+    pthread_detach(fp->thread);
+    fp->capacity = capacity;
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : fastpath_serve
+ * Description : Cette fonction sert directement un RRQ si le fichier tient dans un seul DATA : le DATA est envoyé
+ *               par le thread d'écoute et le transfert confié au thread de service. Une requête retransmise pour un
+ *               transfert en cours est ignorée.
+ * @param fp : Le chemin rapide.
+ * @param root : La racine de service.
+ * @param bundles : Le paquet d'images.
+ * @param vfiles : Les fichiers virtuels.
+ * @param peer : L'adresse du client.
+ * @param request : La requête analysée (nom normalisé).
+ * @param received_us : La date de réception de la requête (histo_now_us).
+ * @return : true si la requête est traitée, false si elle doit suivre le chemin normal.
+ */
+bool fastpath_serve(FastPath* fp, ServingRoot* root, BundleSet* bundles, VirtualFiles* vfiles, const struct sockaddr_in* peer, const TFTP_Request* request, uint64_t received_us) {
+    if (fp->capacity == 0 || ntohs(request->opcode) != TFTP_OPCODE_RRQ) {
+        return false;
+    }
+
+    // Emplacement réservé avant la lecture : les doublons et la saturation sont détectés sans accès disque
+    pthread_mutex_lock(&fp->mutex);
+    int slot = -1;
+    for (int i = 0; i < FASTPATH_MAX_TRANSFERS; i++) {
+        const TinyTransfer* transfer = &fp->transfers[i];
+        if (transfer->sockfd >= 0 && transfer->peer.sin_addr.s_addr == peer->sin_addr.s_addr && transfer->peer.sin_port == peer->sin_port) {
+            pthread_mutex_unlock(&fp->mutex);
+            return true;
+        }
+        if (transfer->sockfd == -1 && slot == -1) {
+            slot = i;
+        }
+    }
+    if (slot == -1) {
+        fp->busy++;
+        pthread_mutex_unlock(&fp->mutex);
+        return false;
+    }
+    pthread_mutex_unlock(&fp->mutex);
+
+    TinyTransfer* transfer = &fp->transfers[slot];
+    int len = load_file(fp, root, bundles, vfiles, peer, request->filename, transfer->packet.data);
+    if (len < 0) {
+        return false;
+    }
+    int sockfd = sockpool_checkout(fp->pool, peer);
+    if (sockfd < 0) {
+        return false;
+    }
+
+    transfer->peer = *peer;
+    transfer->id = next_transfer_id();
+    PROBE3(request__accepted, transfer->id, TFTP_OPCODE_RRQ, request->filename);
+    transfer->packet.opcode = htons(TFTP_OPCODE_DATA);
+    transfer->packet.block_num = htons(1);
+    transfer->packet_len = (size_t) len + TFTP_HEADER_SIZE;
+    transfer->retries = 0;
+    transfer->received_us = received_us;
+    if (send(sockfd, &transfer->packet, transfer->packet_len, 0) < 0) {
+        sockpool_release(fp->pool, sockfd);
+        return false;
+    }
+    transfer->sent_us = histo_now_us();
+    PROBE4(data__sent, transfer->id, 1, len, len);
+    transfer->deadline_us = transfer->sent_us + TIMEOUT_SECONDS * 1000000ULL;
+    histo_record(fp->histo, HISTO_FIRST_DATA, transfer->sent_us - received_us);
+    printf("[FAST] @IP %s:%d, file: %s (%d Bytes)\n", inet_ntoa(peer->sin_addr), ntohs(peer->sin_port), request->filename, len);
+
+    pthread_mutex_lock(&fp->mutex);
+    transfer->sockfd = sockfd;
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.u32 = (uint32_t) slot;
+    epoll_ctl(fp->epoll_fd, EPOLL_CTL_ADD, sockfd, &event);
+    if (fp->active++ == 0) {
+        // Le thread de service attend sans échéance : les suivantes sont toutes plus tardives que celle-ci
+        uint64_t one = 1;
+        if (write(fp->wake_fd, &one, sizeof(one)) < 0) {
+            perror("Erreur lors du réveil du thread de service");
+        }
+    }
+    pthread_mutex_unlock(&fp->mutex);
+    return true;
+}
+
+
+
+
+/**
+ * Fonction : fastpath_report
+ * Description : Cette fonction affiche les compteurs du chemin rapide.
+ * @param fp : Le chemin rapide.
+ * @param out : Le flux de sortie.
+ * @return : Aucune valeur de retour
+ */
+void fastpath_report(FastPath* fp, FILE* out) {
+    if (fp->capacity == 0) {
+        return;
+    }
+    pthread_mutex_lock(&fp->mutex);
+    fprintf(out, "[FAST] fichiers en cache %d/%d | servis %lu (cache %lu, lus %lu) | en cours %d | terminés %lu | échecs %lu | retransmissions %lu | renvoyés au chemin normal (saturé) %lu\n",
+            fp->count, fp->capacity, fp->hits + fp->loads, fp->hits, fp->loads, fp->active, fp->completed, fp->failures, fp->retransmits, fp->busy);
+    pthread_mutex_unlock(&fp->mutex);
+}
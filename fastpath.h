@@ -0,0 +1,105 @@
+/**
+ * @file fastpath.h
+ * @brief Service direct des fichiers d'un seul bloc (moins de 512 octets) par le thread d'écoute : contenu en cache,
+ *        DATA unique envoyé depuis un socket de transfert, ACK et retransmissions suivis par un thread de service commun
+ *        (ni thread ni client par transfert).
+ */
+
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <sys/types.h>
+#include <netinet/in.h>
+
+#include "tftp.h"
+#include "fsroot.h"
+#include "bundle.h"
+#include "vfile.h"
+#include "sockpool.h"
+
+#ifndef FASTPATH_H
+#define FASTPATH_H
+
+#define FASTPATH_BUCKETS 256            /* Nombre d'alvéoles de la table de hachage (puissance de 2) */
+#define FASTPATH_MAX_FILENAME 512
+#define FASTPATH_MAX_TRANSFERS 256      /* Transferts en cours ; au-delà, le chemin normal est utilisé */
+
+
+/**
+ * @struct TinyEntry
+ * @brief Contenu d'un fichier d'un seul bloc, valide tant que le fichier (inode, taille, dates) n'a pas changé.
+ */
+typedef struct TinyEntry {
+    char filename[FASTPATH_MAX_FILENAME];
+    char data[MAX_DATA_SIZE];
+    uint16_t len;
+    dev_t dev;
+    ino_t ino;
+    struct timespec mtime;
+    struct timespec ctime;
+    int next;                       /* Entrée suivante dans l'alvéole (-1 = fin) */
+    bool used;
+} TinyEntry;
+
+
+
+
+/**
+ * @struct TinyTransfer
+ * @brief Transfert d'un seul bloc en attente de son ACK.
+ */
+typedef struct TinyTransfer {
+    int sockfd;                     /* Socket connecté au client (-1 = emplacement libre) */
+    uint64_t id;                    /* Identifiant du transfert (sondes USDT) */
+    struct sockaddr_in peer;
+    TFTP_DataPacket packet;
+    size_t packet_len;
+    int retries;
+    uint64_t received_us;           /* Réception de la requête */
+    uint64_t sent_us;               /* Envoi du DATA (0 après une retransmission : pas de mesure d'aller-retour) */
+    uint64_t deadline_us;           /* Prochaine retransmission */
+} TinyTransfer;
+
+
+
+
+/**
+ * @struct FastPath
+ * @brief Cache des fichiers d'un seul bloc (utilisé par le thread d'écoute seul) et transferts en cours
+ *        (partagés avec le thread de service, protégés par le mutex).
+ */
+typedef struct FastPath {
+    int capacity;                   /* Nombre maximum de fichiers en cache (0 = chemin rapide désactivé) */
+    TinyEntry* entries;
+    int buckets[FASTPATH_BUCKETS];
+    int next_slot;                  /* Prochaine entrée à remplacer (FIFO) */
+    int count;
+
+    TinyTransfer transfers[FASTPATH_MAX_TRANSFERS];
+    int active;
+    int epoll_fd;
+    int wake_fd;                    /* eventfd : réveille le thread de service au premier transfert */
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    SocketPool* pool;
+    PacketTrace* trace;
+    HistoRegistry* histo;
+
+    unsigned long hits;             /* Fichiers servis depuis le cache */
+    unsigned long loads;            /* Fichiers lus puis mis en cache */
+    unsigned long completed;
+    unsigned long failures;         /* Transferts abandonnés (erreur du client, plus de tentatives) */
+    unsigned long retransmits;
+    unsigned long busy;             /* Requêtes renvoyées au chemin normal faute d'emplacement */
+} FastPath;
+
+
+
+int fastpath_init(FastPath* fp, int capacity, SocketPool* pool, PacketTrace* trace, HistoRegistry* histo);
+bool fastpath_serve(FastPath* fp, ServingRoot* root, BundleSet* bundles, VirtualFiles* vfiles, const struct sockaddr_in* peer, const TFTP_Request* request, uint64_t received_us);
+void fastpath_report(FastPath* fp, FILE* out);
+
+#endif
@@ -0,0 +1,678 @@
+/**
+ * @file fsroot.c
+ * @brief Implémentation de la racine de service.
+ *        Chaque chemin demandé est découpé en répertoire parent + nom final. Le répertoire parent est cherché
+ *        dans un arbre de descripteurs déjà ouverts (résolus depuis la racine avec RESOLVE_BENEATH), puis le
+ *        fichier est ouvert avec openat2 relativement à ce descripteur : le noyau ne parcourt plus le chemin complet
+ *        et aucune requête ne peut sortir de la racine (« .. », liens symboliques, chemins absolus).
+ */
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/openat2.h>
+
+#include "fsroot.h"
+
+
+
+/**
+ * Fonction : now_ms
+ * Description : Cette fonction retourne la date courante en millisecondes (horloge monotone).
+ * @return : La date courante en millisecondes.
+ */
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+
+
+
+/**
+ * Fonction : open_beneath
+ * Description : Cette fonction ouvre un chemin relatif à un répertoire sans pouvoir en sortir
+ *               (openat2 avec RESOLVE_BENEATH, dont la présence est vérifiée par fsroot_init).
+ * @param dirfd : Le descripteur du répertoire de départ.
+ * @param path : Le chemin relatif à ouvrir.
+ * @param flags : Les options d'ouverture.
+ * @param mode : Les droits du fichier créé (si O_CREAT).
+ * @return : Le descripteur ouvert, ou -1 en cas d'erreur (errno positionné).
+ */
+static int open_beneath(int dirfd, const char* path, int flags, mode_t mode) {
+    struct open_how how;
+    memset(&how, 0, sizeof(how));
+    how.flags = (uint64_t) (flags | O_CLOEXEC);
+    how.mode = (flags & O_CREAT) ? mode : 0;
+    how.resolve = RESOLVE_BENEATH | RESOLVE_NO_MAGICLINKS;
+
+    return (int) syscall(SYS_openat2, dirfd, path, &how, sizeof(how));
+}
+
+
+
+
+/**
+ * Fonction : split_path
+ * Description : Cette fonction normalise le chemin d'une requête (suppression des « / » initiaux, des composants
+ *               vides et « . ») et le découpe en répertoire parent et nom final. Les composants « .. » sont refusés.
+ * @param filename : Le chemin demandé par le client.
+ * @param dir : Le tampon qui reçoit le répertoire parent normalisé (chaîne vide pour la racine).
+ * @param leaf : Le tampon qui reçoit le nom final.
+ * @return : 0 en cas de succès, -1 si le chemin est refusé (errno positionné).
+ */
+static int split_path(const char* filename, char* dir, char* leaf) {
+    size_t dir_len = 0;
+    leaf[0] = '\0';
+    dir[0] = '\0';
+
+    const char* p = filename;
+    while (*p) {
+        while (*p == '/') {
+            p++;
+        }
+        const char* end = strchrnul(p, '/');
+        size_t len = end - p;
+        if (len == 0 || (len == 1 && p[0] == '.')) {
+            p = end;
+            continue;
+        }
+        if (len == 2 && p[0] == '.' && p[1] == '.') {
+            errno = EACCES;
+            return -1;
+        }
+        if (len > NAME_MAX) {
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+
+        if (leaf[0] != '\0') {     // Le composant précédent était un répertoire
+            size_t leaf_len = strlen(leaf);
+            if (dir_len + leaf_len + 2 >= PATH_MAX) {
+                errno = ENAMETOOLONG;
+                return -1;
+            }
+            if (dir_len > 0) {
+                dir[dir_len++] = '/';
+            }
+            memcpy(dir + dir_len, leaf, leaf_len + 1);
+            dir_len += leaf_len;
+        }
+        memcpy(leaf, p, len);
+        leaf[len] = '\0';
+        p = end;
+    }
+
+    if (leaf[0] == '\0') {
+        errno = ENOENT;
+        return -1;
+    }
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : free_subtree
+ * Description : Cette fonction ferme et libère les sous-répertoires en cache d'un nœud (verrou d'écriture détenu).
+ * @param root : Un pointeur vers la racine de service.
+ * @param node : Le nœud dont les descendants sont libérés.
+ * @return : Aucune valeur de retour
+ */
+static void free_subtree(ServingRoot* root, DirNode* node) {
+    DirNode* child = node->children;
+    while (child != NULL) {
+        DirNode* next = child->sibling;
+        free_subtree(root, child);
+        close(child->fd);
+        free(child);
+        root->num_nodes--;
+        child = next;
+    }
+    node->children = NULL;
+}
+
+
+
+
+/**
+ * Fonction : revalidate
+ * Description : Cette fonction vérifie qu'un répertoire en cache correspond toujours au chemin demandé
+ *               (verrou d'écriture détenu). Un répertoire renommé ou remplacé est rouvert, un répertoire supprimé est retiré.
+ * @param root : Un pointeur vers la racine de service.
+ * @param parent : Le nœud parent.
+ * @param node : Le nœud à revalider.
+ * @param prefix : Le chemin du répertoire depuis la racine.
+ * @return : Le nœud revalidé, ou NULL s'il a été retiré (errno positionné).
+ */
+static DirNode* revalidate(ServingRoot* root, DirNode* parent, DirNode* node, const char* prefix) {
+    struct stat st;
+    int fd = open_beneath(root->root.fd, prefix, O_PATH | O_DIRECTORY, 0);
+
+    if (fd >= 0 && fstat(fd, &st) != 0) {   // Sans identité lisible, le répertoire est traité comme supprimé
+        int saved_errno = errno;
+        close(fd);
+        fd = -1;
+        errno = saved_errno;
+    }
+    if (fd >= 0 && st.st_dev == node->dev && st.st_ino == node->ino) {
+        close(fd);
+        node->checked_ms = now_ms();
+        return node;
+    }
+
+    int saved_errno = errno;
+    root->revalidations++;
+    free_subtree(root, node);
+
+    if (fd >= 0) {     // Même chemin, autre répertoire : on remplace le descripteur
+        close(node->fd);
+        node->fd = fd;
+        node->dev = st.st_dev;
+        node->ino = st.st_ino;
+        node->checked_ms = now_ms();
+        return node;
+    }
+
+    DirNode** link = &parent->children;
+    while (*link != node) {
+        link = &(*link)->sibling;
+    }
+    *link = node->sibling;
+    close(node->fd);
+    free(node);
+    root->num_nodes--;
+    errno = saved_errno;
+    return NULL;
+}
+
+
+
+
+/**
+ * Fonction : resolve_dir
+ * Description : Cette fonction retourne le descripteur d'un répertoire sous la racine en parcourant l'arbre en cache.
+ *               En mode lecture (update = false), elle échoue avec le code 1 dès qu'un composant manque ou doit être
+ *               revalidé ; en mode écriture, elle complète l'arbre. Si le cache est plein, un descripteur temporaire
+ *               est ouvert et devra être fermé par l'appelant.
+ * @param root : Un pointeur vers la racine de service.
+ * @param dir : Le répertoire normalisé (chaîne vide pour la racine).
+ * @param update : true si le verrou d'écriture est détenu.
+ * @param dirfd : Un pointeur vers le descripteur résultat.
+ * @param temporary : Un pointeur vers l'indicateur de descripteur temporaire.
+ * @return : 0 en cas de succès, 1 si le verrou d'écriture est nécessaire, -1 en cas d'erreur (errno positionné).
+ */
+static int resolve_dir(ServingRoot* root, const char* dir, bool update, int* dirfd, bool* temporary) {
+    char prefix[PATH_MAX];
+    uint64_t now = now_ms();
+    DirNode* node = &root->root;
+    const char* p = dir;
+
+    *temporary = false;
+    while (*p) {
+        const char* end = strchrnul(p, '/');
+        size_t len = end - p;
+        memcpy(prefix, dir, end - dir);
+        prefix[end - dir] = '\0';
+
+        DirNode* child = node->children;
+        while (child != NULL && (strncmp(child->name, p, len) != 0 || child->name[len] != '\0')) {
+            child = child->sibling;
+        }
+
+        if (child == NULL || now - child->checked_ms > FSROOT_REVALIDATE_MS) {
+            if (!update) {
+                return 1;
+            }
+            if (child != NULL) {
+                child = revalidate(root, node, child, prefix);
+                if (child == NULL) {
+                    return -1;
+                }
+            } else if (root->num_nodes >= FSROOT_MAX_NODES) {
+                *dirfd = open_beneath(root->root.fd, dir, O_PATH | O_DIRECTORY, 0);
+                *temporary = true;
+                return *dirfd < 0 ? -1 : 0;
+            } else {
+                struct stat st;
+                int fd = open_beneath(root->root.fd, prefix, O_PATH | O_DIRECTORY, 0);
+                if (fd < 0) {
+                    return -1;
+                }
+                if (fstat(fd, &st) != 0 || (child = (DirNode*)calloc(1, sizeof(DirNode))) == NULL) {
+                    close(fd);
+                    return -1;
+                }
+                memcpy(child->name, p, len);
+                child->fd = fd;
+                child->dev = st.st_dev;
+                child->ino = st.st_ino;
+                child->checked_ms = now;
+                child->sibling = node->children;
+                node->children = child;
+                root->num_nodes++;
+                root->misses++;
+            }
+        }
+
+        node = child;
+        p = *end ? end + 1 : end;
+    }
+
+    if (!update) {
+        __atomic_fetch_add(&root->hits, 1, __ATOMIC_RELAXED);
+    }
+    *dirfd = node->fd;
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : acquire_parent
+ * Description : Cette fonction résout le répertoire parent d'un chemin et retourne un descripteur qui reste valable
+ *               après libération du verrou (copie du descripteur en cache).
+ * @param root : Un pointeur vers la racine de service.
+ * @param filename : Le chemin demandé.
+ * @param leaf : Le tampon qui reçoit le nom final.
+ * @return : Un descripteur du répertoire parent à fermer par l'appelant, ou -1 en cas d'erreur.
+ */
+static int acquire_parent(ServingRoot* root, const char* filename, char* leaf) {
+    char dir[PATH_MAX];
+    int dirfd;
+    bool temporary;
+
+    if (split_path(filename, dir, leaf) < 0) {
+        return -1;
+    }
+
+    pthread_rwlock_rdlock(&root->lock);
+    int ret = resolve_dir(root, dir, false, &dirfd, &temporary);
+    if (ret == 1) {
+        pthread_rwlock_unlock(&root->lock);
+        pthread_rwlock_wrlock(&root->lock);
+        ret = resolve_dir(root, dir, true, &dirfd, &temporary);
+    }
+    if (ret == 0 && !temporary) {
+        dirfd = fcntl(dirfd, F_DUPFD_CLOEXEC, 0);
+    }
+    int saved_errno = errno;
+    pthread_rwlock_unlock(&root->lock);
+    errno = saved_errno;
+    return ret == 0 ? dirfd : -1;
+}
+
+
+
+
+/**
+ * Fonction : fsroot_init
+ * Description : Cette fonction ouvre la racine de service une seule fois et initialise le cache des répertoires.
+ *               Sans openat2 (noyau antérieur à 5.6), les requêtes ne pourraient pas être confinées : échec (ENOSYS).
+ * @param root : Un pointeur vers la racine de service.
+ * @param path : Le chemin du répertoire racine.
+ * @return : 0 en cas de succès, -1 en cas d'échec.
+ */
+int fsroot_init(ServingRoot* root, const char* path) {
+    struct stat st;
+    memset(root, 0, sizeof(*root));
+    if (strlen(path) >= sizeof(root->path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(root->path, path);
+
+    root->root.fd = open(path, O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if (root->root.fd < 0 || fstat(root->root.fd, &st) != 0) {
+        return -1;
+    }
+    int probe = open_beneath(root->root.fd, ".", O_PATH | O_DIRECTORY, 0);
+    if (probe < 0) {
+        int saved_errno = errno;
+        close(root->root.fd);
+        errno = saved_errno;
+        return -1;
+    }
+    close(probe);
+    root->root.dev = st.st_dev;
+    root->root.ino = st.st_ino;
+    pthread_rwlock_init(&root->lock, NULL);
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : fsroot_normalize
+ * Description : Cette fonction remplace un chemin de requête par sa forme normalisée relative à la racine
+ *               (« /a//./b » devient « a/b »). Le résultat n'est jamais plus long que le chemin d'origine.
+ * @param filename : Le chemin à normaliser (modifié sur place).
+ * @return : 0 en cas de succès, -1 si le chemin est refusé (errno positionné).
+ */
+int fsroot_normalize(char* filename) {
+    char dir[PATH_MAX];
+    char leaf[NAME_MAX + 1];
+
+    if (split_path(filename, dir, leaf) < 0) {
+        return -1;
+    }
+    if (dir[0] != '\0') {
+        sprintf(filename, "%s/%s", dir, leaf);
+    } else {
+        strcpy(filename, leaf);
+    }
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : fsroot_open
+ * Description : Cette fonction ouvre un fichier sous la racine de service.
+ * @param root : Un pointeur vers la racine de service.
+ * @param filename : Le chemin demandé par le client.
+ * @param flags : Les options d'ouverture (open(2)).
+ * @param mode : Les droits du fichier créé (si O_CREAT).
+ * @return : Le descripteur ouvert, ou -1 en cas d'erreur (errno positionné).
+ */
+int fsroot_open(ServingRoot* root, const char* filename, int flags, mode_t mode) {
+    char dir[PATH_MAX];
+    char leaf[NAME_MAX + 1];
+    int dirfd;
+    bool temporary;
+
+    if (split_path(filename, dir, leaf) < 0) {
+        return -1;
+    }
+
+    pthread_rwlock_rdlock(&root->lock);
+    int ret = resolve_dir(root, dir, false, &dirfd, &temporary);
+    if (ret == 1) {
+        pthread_rwlock_unlock(&root->lock);
+        pthread_rwlock_wrlock(&root->lock);
+        ret = resolve_dir(root, dir, true, &dirfd, &temporary);
+    }
+
+    int fd = -1;
+    if (ret == 0) {
+        fd = open_beneath(dirfd, leaf, flags, mode);
+        int saved_errno = errno;
+        if (temporary) {
+            close(dirfd);
+        }
+        errno = saved_errno;
+    }
+    int saved_errno = errno;
+    pthread_rwlock_unlock(&root->lock);
+    errno = saved_errno;
+    return fd;
+}
+
+
+
+
+/**
+ * Fonction : fsroot_fopen
+ * Description : Cette fonction ouvre un fichier sous la racine de service avec la sémantique de fopen
+ *               (modes « r », « rb », « w », « wb »).
+ * @param root : Un pointeur vers la racine de service.
+ * @param filename : Le chemin demandé par le client.
+ * @param mode : Le mode d'ouverture fopen.
+ * @return : Le flux ouvert, ou NULL en cas d'erreur (errno positionné).
+ */
+FILE* fsroot_fopen(ServingRoot* root, const char* filename, const char* mode) {
+    int flags = (mode[0] == 'w') ? (O_WRONLY | O_CREAT | O_TRUNC) : O_RDONLY;
+    int fd = fsroot_open(root, filename, flags, 0644);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    FILE* file = fdopen(fd, mode);
+    if (file == NULL) {
+        close(fd);
+    }
+    return file;
+}
+
+
+
+
+/**
+ * Fonction : fsroot_rename
+ * Description : Cette fonction renomme un fichier sous la racine de service (remplacement atomique de la destination).
+ * @param root : Un pointeur vers la racine de service.
+ * @param from : Le chemin source.
+ * @param to : Le chemin destination.
+ * @return : 0 en cas de succès, -1 en cas d'erreur (errno positionné).
+ */
+int fsroot_rename(ServingRoot* root, const char* from, const char* to) {
+    char from_leaf[NAME_MAX + 1];
+    char to_leaf[NAME_MAX + 1];
+
+    int from_dirfd = acquire_parent(root, from, from_leaf);
+    if (from_dirfd < 0) {
+        return -1;
+    }
+    int to_dirfd = acquire_parent(root, to, to_leaf);
+    if (to_dirfd < 0) {
+        close(from_dirfd);
+        return -1;
+    }
+
+    int ret = renameat(from_dirfd, from_leaf, to_dirfd, to_leaf);
+    int saved_errno = errno;
+    close(from_dirfd);
+    close(to_dirfd);
+    errno = saved_errno;
+    return ret;
+}
+
+
+
+
+/**
+ * Fonction : fsroot_link
+ * Description : Cette fonction crée un lien physique sous la racine de service (la destination ne doit pas exister).
+ * @param root : Un pointeur vers la racine de service.
+ * @param from : Le chemin du fichier existant.
+ * @param to : Le chemin du nouveau lien.
+ * @return : 0 en cas de succès, -1 en cas d'erreur (errno positionné).
+ */
+int fsroot_link(ServingRoot* root, const char* from, const char* to) {
+    char from_leaf[NAME_MAX + 1];
+    char to_leaf[NAME_MAX + 1];
+
+    int from_dirfd = acquire_parent(root, from, from_leaf);
+    if (from_dirfd < 0) {
+        return -1;
+    }
+    int to_dirfd = acquire_parent(root, to, to_leaf);
+    if (to_dirfd < 0) {
+        close(from_dirfd);
+        return -1;
+    }
+
+    int ret = linkat(from_dirfd, from_leaf, to_dirfd, to_leaf, 0);
+    int saved_errno = errno;
+    close(from_dirfd);
+    close(to_dirfd);
+    errno = saved_errno;
+    return ret;
+}
+
+
+
+
+/**
+ * Fonction : fsroot_open_tmpfile
+ * Description : Cette fonction crée un fichier anonyme (O_TMPFILE) dans le répertoire parent d'un fichier sous la racine :
+ *               il n'a aucun nom tant qu'il n'est pas publié par fsroot_link_tmpfile, et disparaît à sa fermeture.
+ * @param root : Un pointeur vers la racine de service.
+ * @param filename : Le chemin du futur fichier.
+ * @param flags : Les options d'ouverture (O_RDWR ou O_WRONLY, et options complémentaires).
+ * @param mode : Les droits du fichier publié.
+ * @return : Le descripteur ouvert, ou -1 en cas d'erreur (errno positionné).
+ */
+int fsroot_open_tmpfile(ServingRoot* root, const char* filename, int flags, mode_t mode) {
+    char leaf[NAME_MAX + 1];
+    int dirfd = acquire_parent(root, filename, leaf);
+    if (dirfd < 0) {
+        return -1;
+    }
+
+    int fd = openat(dirfd, ".", O_TMPFILE | flags, mode);
+    int saved_errno = errno;
+    close(dirfd);
+    errno = saved_errno;
+    return fd;
+}
+
+
+
+
+/**
+ * Fonction : fsroot_link_tmpfile
+ * Description : Cette fonction publie un fichier anonyme sous son nom (la destination ne doit pas exister).
+ * @param root : Un pointeur vers la racine de service.
+ * @param fd : Le descripteur ouvert par fsroot_open_tmpfile.
+ * @param to : Le chemin du fichier.
+ * @return : 0 en cas de succès, -1 en cas d'erreur (errno positionné, EEXIST si la destination existe).
+ */
+int fsroot_link_tmpfile(ServingRoot* root, int fd, const char* to) {
+    char to_leaf[NAME_MAX + 1];
+    char proc_path[64];
+
+    int to_dirfd = acquire_parent(root, to, to_leaf);
+    if (to_dirfd < 0) {
+        return -1;
+    }
+
+    // linkat(AT_EMPTY_PATH) exige CAP_DAC_READ_SEARCH : passage par /proc/self/fd
+    snprintf(proc_path, sizeof(proc_path), "/proc/self/fd/%d", fd);
+    int ret = linkat(AT_FDCWD, proc_path, to_dirfd, to_leaf, AT_SYMLINK_FOLLOW);
+    int saved_errno = errno;
+    close(to_dirfd);
+    errno = saved_errno;
+    return ret;
+}
+
+
+
+
+/**
+ * Fonction : fsroot_unlink
+ * Description : Cette fonction supprime un fichier sous la racine de service.
+ * @param root : Un pointeur vers la racine de service.
+ * @param filename : Le chemin du fichier.
+ * @return : 0 en cas de succès, -1 en cas d'erreur (errno positionné).
+ */
+int fsroot_unlink(ServingRoot* root, const char* filename) {
+    char leaf[NAME_MAX + 1];
+    int dirfd = acquire_parent(root, filename, leaf);
+    if (dirfd < 0) {
+        return -1;
+    }
+
+    int ret = unlinkat(dirfd, leaf, 0);
+    int saved_errno = errno;
+    close(dirfd);
+    errno = saved_errno;
+    return ret;
+}
+
+
+
+
+/**
+ * Fonction : fsroot_open_parent
+ * Description : Cette fonction ouvre en lecture le répertoire parent d'un fichier sous la racine
+ *               (par exemple pour le synchroniser avec fsync après un renommage).
+ * @param root : Un pointeur vers la racine de service.
+ * @param filename : Le chemin du fichier.
+ * @return : Un descripteur du répertoire parent (O_RDONLY), ou -1 en cas d'erreur (errno positionné).
+ */
+int fsroot_open_parent(ServingRoot* root, const char* filename) {
+    char leaf[NAME_MAX + 1];
+    int dirfd = acquire_parent(root, filename, leaf);
+    if (dirfd < 0) {
+        return -1;
+    }
+
+    int fd = openat(dirfd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    int saved_errno = errno;
+    close(dirfd);
+    errno = saved_errno;
+    return fd;
+}
+
+
+
+
+/**
+ * Fonction : fsroot_mkdirs
+ * Description : Cette fonction crée les répertoires parents manquants d'un fichier sous la racine.
+ *               Chaque répertoire est ouvert relativement au précédent (RESOLVE_BENEATH) : un lien symbolique
+ *               dans le chemin ne permet pas de créer un répertoire hors de la racine.
+ * @param root : Un pointeur vers la racine de service.
+ * @param filename : Le chemin du fichier.
+ * @return : 0 en cas de succès, -1 en cas d'erreur (errno positionné).
+ */
+int fsroot_mkdirs(ServingRoot* root, const char* filename) {
+    char dir[PATH_MAX];
+    char leaf[NAME_MAX + 1];
+
+    if (split_path(filename, dir, leaf) < 0) {
+        return -1;
+    }
+
+    int dirfd = fcntl(root->root.fd, F_DUPFD_CLOEXEC, 0);
+    char* p = dir;
+    while (dirfd >= 0 && *p) {
+        char* end = strchrnul(p, '/');
+        char saved = *end;
+        *end = '\0';
+        int next = -1;
+        if (mkdirat(dirfd, p, 0755) == 0 || errno == EEXIST) {
+            next = open_beneath(dirfd, p, O_PATH | O_DIRECTORY, 0);
+        }
+        int saved_errno = errno;
+        close(dirfd);
+        errno = saved_errno;
+        dirfd = next;
+        p = saved ? end + 1 : end;
+    }
+    if (dirfd < 0) {
+        return -1;
+    }
+    close(dirfd);
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : fsroot_report
+ * Description : Cette fonction affiche les compteurs du cache des répertoires.
+ * @param root : Un pointeur vers la racine de service.
+ * @param out : Le flux de sortie.
+ * @return : Aucune valeur de retour
+ */
+void fsroot_report(ServingRoot* root, FILE* out) {
+    pthread_rwlock_rdlock(&root->lock);
+    fprintf(out, "[FSROOT] racine %s | répertoires en cache %d/%d | succès %lu | ouvertures %lu | revalidations %lu\n",
+            root->path, root->num_nodes, FSROOT_MAX_NODES,
+            root->hits, root->misses, root->revalidations);
+    pthread_rwlock_unlock(&root->lock);
+}
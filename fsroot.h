@@ -0,0 +1,70 @@
+/**
+ * @file fsroot.h
+ * @brief Racine de service : résolution des chemins des requêtes sous un répertoire racine
+ *        (openat2 + RESOLVE_BENEATH) avec cache des descripteurs de sous-répertoires.
+ */
+
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <limits.h>
+#include <sys/types.h>
+
+#ifndef FSROOT_H
+#define FSROOT_H
+
+#define FSROOT_MAX_NODES 256            /* Nombre maximum de répertoires en cache */
+#define FSROOT_REVALIDATE_MS 1000       /* Intervalle de revalidation d'un répertoire en cache */
+
+
+/**
+ * @struct DirNode
+ * @brief Nœud de l'arbre des préfixes : un répertoire ouvert (O_PATH) sous la racine.
+ */
+typedef struct DirNode {
+    char name[NAME_MAX + 1];        /* Composant du chemin */
+    int fd;                         /* Descripteur O_PATH du répertoire */
+    dev_t dev;
+    ino_t ino;
+    uint64_t checked_ms;            /* Date de la dernière validation */
+    struct DirNode* children;       /* Premier sous-répertoire en cache */
+    struct DirNode* sibling;        /* Répertoire suivant de même parent */
+} DirNode;
+
+
+
+
+/**
+ * @struct ServingRoot
+ * @brief Racine de service ouverte une seule fois, et arbre des sous-répertoires déjà résolus.
+ *        Les ouvertures se font sous verrou de lecture ; la mise à jour de l'arbre sous verrou d'écriture.
+ */
+typedef struct ServingRoot {
+    char path[PATH_MAX];
+    DirNode root;                   /* Nœud racine (name vide) */
+    int num_nodes;
+    pthread_rwlock_t lock;
+
+    unsigned long hits;             /* Répertoires trouvés dans le cache */
+    unsigned long misses;           /* Répertoires ouverts puis ajoutés au cache */
+    unsigned long revalidations;    /* Répertoires remplacés ou supprimés après revalidation */
+} ServingRoot;
+
+
+
+int fsroot_init(ServingRoot* root, const char* path);
+int fsroot_normalize(char* filename);
+int fsroot_open(ServingRoot* root, const char* filename, int flags, mode_t mode);
+FILE* fsroot_fopen(ServingRoot* root, const char* filename, const char* mode);
+int fsroot_rename(ServingRoot* root, const char* from, const char* to);
+int fsroot_link(ServingRoot* root, const char* from, const char* to);
+int fsroot_open_tmpfile(ServingRoot* root, const char* filename, int flags, mode_t mode);
+int fsroot_link_tmpfile(ServingRoot* root, int fd, const char* to);
+int fsroot_unlink(ServingRoot* root, const char* filename);
+int fsroot_open_parent(ServingRoot* root, const char* filename);
+int fsroot_mkdirs(ServingRoot* root, const char* filename);
+void fsroot_report(ServingRoot* root, FILE* out);
+
+#endif
@@ -0,0 +1,363 @@
+/**
+ * @file histo.c
+ * @brief Implémentation des histogrammes de latence.
+ *        Alvéoles log-linéaires : les valeurs inférieures à HISTO_SUB_COUNT ont chacune leur alvéole, puis chaque
+ *        puissance de 2 est découpée en HISTO_SUB_COUNT alvéoles de même largeur (erreur relative < 1/16).
+ *        Un thread écrit uniquement dans son bloc (stockages atomiques relâchés) ; l'export lit tous les blocs.
+ *        La remise à zéro incrémente une génération : chaque thread vide son propre bloc à sa mesure suivante,
+ *        et l'export ignore les blocs d'une génération précédente.
+ */
+
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "histo.h"
+
+
+static const char* phase_names[HISTO_NUM_PHASES] = {
+    "first_data", "sync_wait", "ack_rtt", "data_rtt",
+    "transfer_64k", "transfer_1m", "transfer_16m", "transfer_256m", "transfer_huge"
+};
+
+static const double percentiles[] = {50, 90, 99, 99.9};
+
+
+
+/**
+ * Fonction : histo_now_us
+ * Description : Cette fonction retourne la date courante en microsecondes (horloge monotone).
+ * @return : La date courante en microsecondes.
+ */
+uint64_t histo_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+
+
+/**
+ * Fonction : bucket_index
+ * Description : Cette fonction retourne l'alvéole d'une valeur.
+ */
+static int bucket_index(uint64_t value) {
+    if (value < HISTO_SUB_COUNT) {
+        return (int) value;
+    }
+    int bits = 63 - __builtin_clzll(value);     // Position du bit de poids fort (>= HISTO_SUB_BITS)
+    if (bits > HISTO_MAX_BITS) {
+        return HISTO_BUCKETS - 1;
+    }
+    int sub = (int) (value >> (bits - HISTO_SUB_BITS)) & (HISTO_SUB_COUNT - 1);
+    return (bits - HISTO_SUB_BITS + 1) * HISTO_SUB_COUNT + sub;
+}
+
+
+
+
+/**
+ * Fonction : bucket_value
+ * Description : Cette fonction retourne la plus grande valeur d'une alvéole.
+ */
+static uint64_t bucket_value(int index) {
+    if (index < HISTO_SUB_COUNT) {
+        return (uint64_t) index;
+    }
+    int bits = index / HISTO_SUB_COUNT + HISTO_SUB_BITS - 1;
+    int sub = index % HISTO_SUB_COUNT;
+    uint64_t width = (uint64_t) 1 << (bits - HISTO_SUB_BITS);
+    return ((uint64_t) (HISTO_SUB_COUNT + sub) << (bits - HISTO_SUB_BITS)) + width - 1;
+}
+
+
+
+
+/**
+ * Fonction : release_block
+ * Description : Destructeur de la clé de thread : le bloc du thread terminé devient réutilisable.
+ */
+static void release_block(void* arg) {
+    HistoBlock* block = arg;
+    __atomic_store_n(&block->in_use, false, __ATOMIC_RELEASE);
+}
+
+
+
+
+/**
+ * Fonction : histo_init
+ * Description : Cette fonction initialise le registre des histogrammes.
+ * @param reg : Le registre à initialiser.
+ * @return : 0 en cas de succès, -1 en cas d'erreur.
+ */
+int histo_init(HistoRegistry* reg) {
+    memset(reg, 0, sizeof(*reg));
+    pthread_mutex_init(&reg->mutex, NULL);
+    return pthread_key_create(&reg->key, release_block) == 0 ? 0 : -1;
+}
+
+
+
+
+/**
+ * Fonction : thread_block
+ * Description : Cette fonction retourne le bloc du thread courant, en lui attribuant un bloc libre
+ *               (ou un nouveau bloc) à sa première mesure.
+ * @return : Le bloc du thread, ou NULL en cas d'erreur d'allocation.
+ */
+static HistoBlock* thread_block(HistoRegistry* reg) {
+    HistoBlock* block = pthread_getspecific(reg->key);
+    if (block != NULL) {
+        return block;
+    }
+
+    pthread_mutex_lock(&reg->mutex);
+    for (block = reg->blocks; block != NULL; block = block->next) {
+        if (!__atomic_load_n(&block->in_use, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+    }
+    if (block == NULL) {
+        block = calloc(1, sizeof(HistoBlock));
+        if (block == NULL) {
+            pthread_mutex_unlock(&reg->mutex);
+            return NULL;
+        }
+        block->generation = __atomic_load_n(&reg->generation, __ATOMIC_ACQUIRE);
+        block->next = reg->blocks;
+        __atomic_store_n(&reg->blocks, block, __ATOMIC_RELEASE);
+        reg->num_blocks++;
+    }
+    block->in_use = true;
+    pthread_mutex_unlock(&reg->mutex);
+
+    pthread_setspecific(reg->key, block);
+    return block;
+}
+
+
+
+
+/**
+ * Fonction : histo_record
+ * Description : Cette fonction ajoute une mesure à l'histogramme d'une phase (sans verrou).
+ * @param reg : Le registre (NULL : aucun effet).
+ * @param phase : La phase mesurée.
+ * @param value_us : La durée mesurée, en microsecondes.
+ * @return : Aucune valeur de retour
+ */
+void histo_record(HistoRegistry* reg, HistoPhase phase, uint64_t value_us) {
+    if (reg == NULL) {
+        return;
+    }
+    HistoBlock* block = thread_block(reg);
+    if (block == NULL) {
+        return;
+    }
+
+    unsigned generation = __atomic_load_n(&reg->generation, __ATOMIC_ACQUIRE);
+    if (block->generation != generation) {
+        // Remise à zéro demandée depuis la dernière mesure de ce bloc
+        memset(block->counts, 0, sizeof(block->counts));
+        memset(block->max, 0, sizeof(block->max));
+        __atomic_store_n(&block->generation, generation, __ATOMIC_RELEASE);
+    }
+
+    uint64_t* count = &block->counts[phase][bucket_index(value_us)];
+    __atomic_store_n(count, *count + 1, __ATOMIC_RELAXED);
+    if (value_us > block->max[phase]) {
+        __atomic_store_n(&block->max[phase], value_us, __ATOMIC_RELAXED);
+    }
+}
+
+
+
+
+/**
+ * Fonction : histo_record_transfer
+ * Description : Cette fonction enregistre la durée totale d'un transfert dans l'histogramme de sa classe de taille.
+ * @param reg : Le registre (NULL : aucun effet).
+ * @param bytes : La taille du fichier transféré.
+ * @param duration_us : La durée du transfert, en microsecondes.
+ * @return : Aucune valeur de retour
+ */
+void histo_record_transfer(HistoRegistry* reg, uint64_t bytes, uint64_t duration_us) {
+    HistoPhase phase;
+    if (bytes < ((uint64_t) 64 << 10)) {
+        phase = HISTO_TRANSFER_64K;
+    } else if (bytes < ((uint64_t) 1 << 20)) {
+        phase = HISTO_TRANSFER_1M;
+    } else if (bytes < ((uint64_t) 16 << 20)) {
+        phase = HISTO_TRANSFER_16M;
+    } else if (bytes < ((uint64_t) 256 << 20)) {
+        phase = HISTO_TRANSFER_256M;
+    } else {
+        phase = HISTO_TRANSFER_HUGE;
+    }
+    histo_record(reg, phase, duration_us);
+}
+
+
+
+
+/**
+ * Fonction : histo_reset
+ * Description : Cette fonction remet tous les histogrammes à zéro (chaque bloc est vidé par son thread).
+ * @param reg : Le registre.
+ * @return : Aucune valeur de retour
+ */
+void histo_reset(HistoRegistry* reg) {
+    __atomic_add_fetch(&reg->generation, 1, __ATOMIC_RELEASE);
+}
+
+
+
+
+/**
+ * Fonction : merge
+ * Description : Cette fonction additionne les blocs de la génération courante.
+ * @param reg : Le registre.
+ * @param counts : Reçoit les compteurs additionnés (HISTO_NUM_PHASES x HISTO_BUCKETS).
+ * @param max : Reçoit le maximum de chaque phase.
+ * @param totals : Reçoit le nombre de mesures de chaque phase.
+ * @return : Aucune valeur de retour
+ */
+static void merge(HistoRegistry* reg, uint64_t* counts, uint64_t* max, uint64_t* totals) {
+    unsigned generation = __atomic_load_n(&reg->generation, __ATOMIC_ACQUIRE);
+    memset(counts, 0, sizeof(uint64_t) * HISTO_NUM_PHASES * HISTO_BUCKETS);
+    memset(max, 0, sizeof(uint64_t) * HISTO_NUM_PHASES);
+    memset(totals, 0, sizeof(uint64_t) * HISTO_NUM_PHASES);
+
+    for (HistoBlock* block = __atomic_load_n(&reg->blocks, __ATOMIC_ACQUIRE); block != NULL; block = block->next) {
+        if (__atomic_load_n(&block->generation, __ATOMIC_ACQUIRE) != generation) {
+            continue;   // Bloc pas encore vidé depuis la dernière remise à zéro
+        }
+        for (int p = 0; p < HISTO_NUM_PHASES; p++) {
+            for (int i = 0; i < HISTO_BUCKETS; i++) {
+                uint64_t c = __atomic_load_n(&block->counts[p][i], __ATOMIC_RELAXED);
+                counts[p * HISTO_BUCKETS + i] += c;
+                totals[p] += c;
+            }
+            uint64_t m = __atomic_load_n(&block->max[p], __ATOMIC_RELAXED);
+            if (m > max[p]) {
+                max[p] = m;
+            }
+        }
+    }
+}
+
+
+
+
+/**
+ * Fonction : value_at
+ * Description : Cette fonction retourne la valeur du centile demandé d'un histogramme.
+ */
+static uint64_t value_at(const uint64_t* counts, uint64_t total, uint64_t max, double percentile) {
+    uint64_t rank = (uint64_t) (percentile / 100.0 * total + 0.5);
+    uint64_t seen = 0;
+    if (rank == 0) {
+        rank = 1;
+    }
+    for (int i = 0; i < HISTO_BUCKETS; i++) {
+        seen += counts[i];
+        if (seen >= rank) {
+            uint64_t value = bucket_value(i);
+            return value < max ? value : max;
+        }
+    }
+    return max;
+}
+
+
+
+
+/**
+ * Fonction : histo_report
+ * Description : Cette fonction affiche les centiles de chaque phase mesurée.
+ * @param reg : Le registre.
+ * @param out : Le flux de sortie.
+ * @return : Aucune valeur de retour
+ */
+void histo_report(HistoRegistry* reg, FILE* out) {
+    uint64_t* counts = malloc(sizeof(uint64_t) * HISTO_NUM_PHASES * HISTO_BUCKETS);
+    uint64_t max[HISTO_NUM_PHASES];
+    uint64_t totals[HISTO_NUM_PHASES];
+    if (counts == NULL) {
+        return;
+    }
+    merge(reg, counts, max, totals);
+
+    for (int p = 0; p < HISTO_NUM_PHASES; p++) {
+        if (totals[p] == 0) {
+            continue;
+        }
+        const uint64_t* c = counts + p * HISTO_BUCKETS;
+        fprintf(out, "[HISTO] %-13s n %-8" PRIu64 " | p50 %.3f ms | p90 %.3f ms | p99 %.3f ms | p99.9 %.3f ms | max %.3f ms\n",
+                phase_names[p], totals[p],
+                value_at(c, totals[p], max[p], 50) / 1000.0, value_at(c, totals[p], max[p], 90) / 1000.0,
+                value_at(c, totals[p], max[p], 99) / 1000.0, value_at(c, totals[p], max[p], 99.9) / 1000.0,
+                max[p] / 1000.0);
+    }
+    free(counts);
+}
+
+
+
+
+/**
+ * Fonction : histo_export
+ * Description : Cette fonction écrit tous les histogrammes (alvéoles non vides comprises) dans un fichier JSON.
+ *               Le fichier est écrit sous un nom temporaire puis renommé : un lecteur ne voit jamais d'export partiel.
+ * @param reg : Le registre.
+ * @param path : Le chemin du fichier JSON.
+ * @return : 0 en cas de succès, -1 en cas d'erreur.
+ */
+int histo_export(HistoRegistry* reg, const char* path) {
+    uint64_t* counts = malloc(sizeof(uint64_t) * HISTO_NUM_PHASES * HISTO_BUCKETS);
+    uint64_t max[HISTO_NUM_PHASES];
+    uint64_t totals[HISTO_NUM_PHASES];
+    char temp[4096];
+    if (counts == NULL || snprintf(temp, sizeof(temp), "%s.tmp", path) >= (int) sizeof(temp)) {
+        free(counts);
+        return -1;
+    }
+    FILE* file = fopen(temp, "w");
+    if (file == NULL) {
+        free(counts);
+        return -1;
+    }
+    merge(reg, counts, max, totals);
+
+    fprintf(file, "{\"unit\":\"us\",\"sub_bucket_bits\":%d,\"generation\":%u,\"phases\":{",
+            HISTO_SUB_BITS, __atomic_load_n(&reg->generation, __ATOMIC_ACQUIRE));
+    for (int p = 0; p < HISTO_NUM_PHASES; p++) {
+        const uint64_t* c = counts + p * HISTO_BUCKETS;
+        fprintf(file, "%s\"%s\":{\"count\":%" PRIu64 ",\"max\":%" PRIu64, p > 0 ? "," : "", phase_names[p], totals[p], max[p]);
+        for (size_t k = 0; k < sizeof(percentiles) / sizeof(percentiles[0]); k++) {
+            fprintf(file, ",\"p%g\":%" PRIu64, percentiles[k], totals[p] > 0 ? value_at(c, totals[p], max[p], percentiles[k]) : 0);
+        }
+        fprintf(file, ",\"buckets\":[");    // Couples [plus grande valeur de l'alvéole, nombre de mesures]
+        bool first = true;
+        for (int i = 0; i < HISTO_BUCKETS; i++) {
+            if (c[i] != 0) {
+                fprintf(file, "%s[%" PRIu64 ",%" PRIu64 "]", first ? "" : ",", bucket_value(i), c[i]);
+                first = false;
+            }
+        }
+        fprintf(file, "]}");
+    }
+    fprintf(file, "}}\n");
+    free(counts);
+
+    if (fclose(file) != 0 || rename(temp, path) != 0) {
+        unlink(temp);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,81 @@
+/**
+ * @file histo.h
+ * @brief Histogrammes de latence par phase de transfert (log-linéaires, à la manière de HdrHistogram).
+ *        Chaque thread enregistre dans son propre bloc de compteurs, sans verrou ; l'export additionne les blocs.
+ */
+
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifndef HISTO_H
+#define HISTO_H
+
+#define HISTO_SUB_BITS 4                                /* 16 sous-alvéoles par puissance de 2 (précision ~6 %) */
+#define HISTO_SUB_COUNT (1 << HISTO_SUB_BITS)
+#define HISTO_MAX_BITS 40                               /* Valeurs jusqu'à 2^40 µs (~12 jours) */
+#define HISTO_BUCKETS ((HISTO_MAX_BITS - HISTO_SUB_BITS + 2) * HISTO_SUB_COUNT)
+
+
+/**
+ * @enum HistoPhase
+ * @brief Phases mesurées (toutes en microsecondes).
+ */
+typedef enum {
+    HISTO_FIRST_DATA = 0,   /* Réception de la requête → envoi du premier DATA (RRQ, attente d'admission comprise) */
+    HISTO_SYNC_WAIT,        /* Attente dans sync_start_read / sync_start_write */
+    HISTO_ACK_RTT,          /* Envoi d'un DATA → réception de son ACK (RRQ, blocs non retransmis) */
+    HISTO_DATA_RTT,         /* Envoi d'un ACK → réception du DATA suivant (WRQ, blocs non retransmis) */
+    HISTO_TRANSFER_64K,     /* Durée totale d'un transfert réussi, par taille de fichier */
+    HISTO_TRANSFER_1M,
+    HISTO_TRANSFER_16M,
+    HISTO_TRANSFER_256M,
+    HISTO_TRANSFER_HUGE,
+    HISTO_NUM_PHASES
+} HistoPhase;
+
+
+
+
+/**
+ * @struct HistoBlock
+ * @brief Compteurs d'un thread. Un seul thread écrit dans un bloc ; les blocs des threads terminés
+ *        sont réutilisés par les threads suivants (leurs compteurs sont conservés).
+ */
+typedef struct HistoBlock {
+    uint64_t counts[HISTO_NUM_PHASES][HISTO_BUCKETS];
+    uint64_t max[HISTO_NUM_PHASES];
+    unsigned generation;            /* Génération de remise à zéro des compteurs */
+    bool in_use;
+    struct HistoBlock* next;
+} HistoBlock;
+
+
+
+
+/**
+ * @struct HistoRegistry
+ * @brief Liste des blocs de tous les threads. Le mutex ne protège que l'attribution des blocs
+ *        (première mesure d'un thread, fin d'un thread), jamais l'enregistrement.
+ */
+typedef struct HistoRegistry {
+    HistoBlock* blocks;
+    int num_blocks;
+    unsigned generation;            /* Incrémentée à chaque remise à zéro */
+    pthread_key_t key;              /* Bloc du thread courant */
+    pthread_mutex_t mutex;
+} HistoRegistry;
+
+
+
+int histo_init(HistoRegistry* reg);
+uint64_t histo_now_us(void);
+void histo_record(HistoRegistry* reg, HistoPhase phase, uint64_t value_us);
+void histo_record_transfer(HistoRegistry* reg, uint64_t bytes, uint64_t duration_us);
+void histo_reset(HistoRegistry* reg);
+void histo_report(HistoRegistry* reg, FILE* out);
+int histo_export(HistoRegistry* reg, const char* path);
+
+#endif
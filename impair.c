@@ -0,0 +1,425 @@
+/**
+ * @file impair.c
+ * @brief Implémentation de la dégradation réseau simulée.
+ *        Le délai est appliqué par le thread du transfert avant l'envoi ou avant de rendre le paquet reçu : avec un
+ *        seul paquet en vol (TFTP attend chaque ACK), c'est équivalent à une latence du lien. Un paquet retenu pour
+ *        réordonnancement est envoyé (ou délivré) juste après le suivant ; s'il n'y a pas de suivant, il est perdu.
+ *        Une perte en réception n'allonge pas l'attente : la réception expire à l'échéance prévue.
+ */
+
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <sys/socket.h>
+
+#include "impair.h"
+
+#define OPCODE_DATA 3
+#define OPCODE_ACK 4
+
+
+
+/**
+ * Fonction : splitmix64
+ * Description : Cette fonction mélange une valeur 64 bits (initialisation des générateurs).
+ * @param x : La valeur à mélanger.
+ * @return : La valeur mélangée.
+ */
+static uint64_t splitmix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+
+
+
+/**
+ * Fonction : next_random
+ * Description : Cette fonction tire un nombre uniforme dans [0, 1) (xorshift64*).
+ * @param state : L'état du transfert.
+ * @return : Le nombre tiré.
+ */
+static double next_random(ImpairState* state) {
+    state->rng ^= state->rng >> 12;
+    state->rng ^= state->rng << 25;
+    state->rng ^= state->rng >> 27;
+    return ((state->rng * 0x2545F4914F6CDD1DULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+
+
+/**
+ * Fonction : set_rule_value
+ * Description : Cette fonction affecte une valeur de la spécification à une règle.
+ * @param rule : La règle.
+ * @param key : Le paramètre (drop, dup, reorder, delay, jitter).
+ * @param value : La valeur.
+ * @return : 0 en cas de succès, -1 si le paramètre ou la valeur est invalide.
+ */
+static int set_rule_value(ImpairRule* rule, const char* key, const char* value) {
+    char* end;
+    double v = strtod(value, &end);
+    if (*value == '\0' || *end != '\0' || v < 0) {
+        return -1;
+    }
+    if (strcasecmp(key, "drop") == 0 && v <= 1) {
+        rule->drop = v;
+    } else if (strcasecmp(key, "dup") == 0 && v <= 1) {
+        rule->duplicate = v;
+    } else if (strcasecmp(key, "reorder") == 0 && v <= 1) {
+        rule->reorder = v;
+    } else if (strcasecmp(key, "delay") == 0 && v <= 60000) {
+        rule->delay_ms = (int) v;
+    } else if (strcasecmp(key, "jitter") == 0 && v <= 60000) {
+        rule->jitter_ms = (int) v;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : impair_init
+ * Description : Cette fonction analyse la spécification de la dégradation, une liste « clé=valeur » séparée par
+ *               des virgules : seed, puis [data-|ack-]drop, dup, reorder (probabilités), delay, jitter (ms).
+ *               Sans préfixe, la valeur s'applique aux DATA et aux ACK. Exemple : « seed=7,drop=0.02,data-delay=40,jitter=10 ».
+ * @param imp : La dégradation à initialiser.
+ * @param spec : La spécification (NULL = aucune dégradation).
+ * @return : 0 en cas de succès, -1 si la spécification est invalide (errno = EINVAL).
+ */
+int impair_init(Impairment* imp, const char* spec) {
+    memset(imp, 0, sizeof(*imp));
+    pthread_mutex_init(&imp->mutex, NULL);
+    if (spec == NULL) {
+        return 0;
+    }
+    imp->enabled = true;
+    imp->seed = 1;
+
+    char* copy = strdup(spec);
+    if (copy == NULL) {
+        return -1;
+    }
+    int ret = 0;
+    char* saveptr = NULL;
+    for (char* item = strtok_r(copy, ",", &saveptr); item != NULL && ret == 0; item = strtok_r(NULL, ",", &saveptr)) {
+        char* value = strchr(item, '=');
+        if (value == NULL) {
+            ret = -1;
+            break;
+        }
+        *value++ = '\0';
+
+        if (strcasecmp(item, "seed") == 0) {
+            char* end;
+            imp->seed = strtoull(value, &end, 0);
+            ret = (*value == '\0' || *end != '\0') ? -1 : 0;
+        } else if (strncasecmp(item, "data-", 5) == 0) {
+            ret = set_rule_value(&imp->rules[IMPAIR_DATA], item + 5, value);
+        } else if (strncasecmp(item, "ack-", 4) == 0) {
+            ret = set_rule_value(&imp->rules[IMPAIR_ACK], item + 4, value);
+        } else {
+            ret = set_rule_value(&imp->rules[IMPAIR_DATA], item, value);
+            if (ret == 0) {
+                ret = set_rule_value(&imp->rules[IMPAIR_ACK], item, value);
+            }
+        }
+    }
+    free(copy);
+    if (ret < 0) {
+        errno = EINVAL;
+    }
+    return ret;
+}
+
+
+
+
+/**
+ * Fonction : impair_attach
+ * Description : Cette fonction crée l'état de dégradation d'un transfert.
+ * @param imp : La dégradation de l'exécution.
+ * @param transfer_id : L'identifiant du transfert (les tirages ne dépendent que de la graine et de cet identifiant).
+ * @return : L'état du transfert, NULL si la dégradation est désactivée (envois et réceptions directs).
+ */
+ImpairState* impair_attach(Impairment* imp, uint64_t transfer_id) {
+    if (!imp->enabled) {
+        return NULL;
+    }
+    ImpairState* state = (ImpairState*)calloc(1, sizeof(ImpairState));
+    if (state == NULL) {
+        return NULL;
+    }
+    state->impairment = imp;
+    state->rng = splitmix64(imp->seed ^ splitmix64(transfer_id));
+    if (state->rng == 0) {
+        state->rng = 1;     // xorshift : l'état nul est absorbant
+    }
+    return state;
+}
+
+
+
+
+/**
+ * Fonction : impair_detach
+ * Description : Cette fonction libère l'état d'un transfert (un paquet encore retenu est perdu).
+ * @param state : L'état (NULL : aucun effet).
+ * @return : Aucune valeur de retour
+ */
+void impair_detach(ImpairState* state) {
+    free(state);
+}
+
+
+
+
+/**
+ * Fonction : classify
+ * Description : Cette fonction détermine le type d'un paquet.
+ * @return : IMPAIR_DATA, IMPAIR_ACK, ou -1 pour un paquet jamais dégradé.
+ */
+static int classify(const void* buffer, size_t len) {
+    if (len < 4) {
+        return -1;
+    }
+    const unsigned char* p = (const unsigned char*) buffer;
+    uint16_t opcode = (uint16_t) (p[0] << 8 | p[1]);
+    if (opcode == OPCODE_DATA) {
+        return IMPAIR_DATA;
+    }
+    return opcode == OPCODE_ACK ? IMPAIR_ACK : -1;
+}
+
+
+
+
+/**
+ * @struct ImpairDecision
+ * @brief Traitement tiré pour un paquet.
+ */
+typedef struct ImpairDecision {
+    bool drop;
+    bool duplicate;
+    bool reorder;
+    int delay_ms;
+} ImpairDecision;
+
+
+
+
+/**
+ * Fonction : decide
+ * Description : Cette fonction tire le traitement d'un paquet et met à jour les compteurs.
+ *               Le nombre de tirages par paquet est fixe, pour que la suite reste reproductible.
+ * @param state : L'état du transfert.
+ * @param kind : Le type du paquet.
+ * @return : Le traitement à appliquer.
+ */
+static ImpairDecision decide(ImpairState* state, ImpairKind kind) {
+    Impairment* imp = state->impairment;
+    const ImpairRule* rule = &imp->rules[kind];
+    ImpairDecision decision;
+    double r_drop = next_random(state);
+    double r_dup = next_random(state);
+    double r_reorder = next_random(state);
+    double r_jitter = next_random(state);
+
+    decision.drop = r_drop < rule->drop;
+    decision.duplicate = !decision.drop && r_dup < rule->duplicate;
+    decision.reorder = !decision.drop && r_reorder < rule->reorder;
+    decision.delay_ms = decision.drop ? 0 : rule->delay_ms + (int) ((2 * r_jitter - 1) * rule->jitter_ms);
+    if (decision.delay_ms < 0) {
+        decision.delay_ms = 0;
+    }
+
+    pthread_mutex_lock(&imp->mutex);
+    imp->packets[kind]++;
+    imp->dropped[kind] += decision.drop;
+    imp->duplicated[kind] += decision.duplicate;
+    imp->reordered[kind] += decision.reorder;
+    imp->delay_ms[kind] += decision.delay_ms;
+    pthread_mutex_unlock(&imp->mutex);
+    return decision;
+}
+
+
+
+
+/**
+ * Fonction : sleep_ms
+ * Description : Cette fonction suspend le thread (délai simulé).
+ * @return : Aucune valeur de retour
+ */
+static void sleep_ms(int ms) {
+    if (ms <= 0) {
+        return;
+    }
+    struct timespec ts = { ms / 1000, (long) (ms % 1000) * 1000000L };
+    while (nanosleep(&ts, &ts) < 0 && errno == EINTR) {
+    }
+}
+
+
+
+
+/**
+ * Fonction : now_ms
+ * Description : Cette fonction lit l'horloge monotone.
+ * @return : La date en millisecondes.
+ */
+static int64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+
+
+
+/**
+ * Fonction : impair_send
+ * Description : Cette fonction envoie un paquet sur un socket connecté, avec la dégradation tirée pour ce paquet.
+ *               Un paquet perdu ou retenu est considéré comme envoyé.
+ * @param state : L'état du transfert (NULL : envoi direct).
+ * @param sockfd : Le socket connecté.
+ * @param buffer : Le paquet.
+ * @param len : La taille du paquet.
+ * @return : La taille envoyée, -1 en cas d'erreur (errno positionné).
+ */
+ssize_t impair_send(ImpairState* state, int sockfd, const void* buffer, size_t len) {
+    int kind = state != NULL ? classify(buffer, len) : -1;
+    if (kind < 0) {
+        return send(sockfd, buffer, len, 0);
+    }
+
+    ImpairDecision decision = decide(state, (ImpairKind) kind);
+    if (decision.drop) {
+        return (ssize_t) len;
+    }
+    sleep_ms(decision.delay_ms);
+    if (decision.reorder && state->held_send_len == 0 && len <= sizeof(state->held_send)) {
+        memcpy(state->held_send, buffer, len);
+        state->held_send_len = len;
+        return (ssize_t) len;
+    }
+
+    ssize_t ret = send(sockfd, buffer, len, 0);
+    if (ret >= 0 && decision.duplicate) {
+        send(sockfd, buffer, len, 0);
+    }
+    if (ret >= 0 && state->held_send_len > 0) {
+        send(sockfd, state->held_send, state->held_send_len, 0);
+        state->held_send_len = 0;
+    }
+    return ret;
+}
+
+
+
+
+/**
+ * Fonction : impair_recv
+ * Description : Cette fonction reçoit un paquet sur un socket connecté, avec la dégradation tirée pour ce paquet.
+ *               Sans dégradation, la réception utilise le délai du socket (SO_RCVTIMEO) ; avec, elle attend au plus timeout_ms.
+ * @param state : L'état du transfert (NULL : réception directe).
+ * @param sockfd : Le socket connecté.
+ * @param buffer : Le tampon de réception.
+ * @param len : La taille du tampon.
+ * @param timeout_ms : Le délai de réception (millisecondes).
+ * @return : La taille du paquet, -1 en cas d'erreur ou d'expiration du délai (errno = EAGAIN).
+ */
+ssize_t impair_recv(ImpairState* state, int sockfd, void* buffer, size_t len, int timeout_ms) {
+    if (state == NULL) {
+        return recv(sockfd, buffer, len, 0);
+    }
+    if (state->held_recv_len > 0) {
+        size_t held = state->held_recv_len < len ? state->held_recv_len : len;
+        memcpy(buffer, state->held_recv, held);
+        state->held_recv_len = 0;
+        return (ssize_t) held;
+    }
+
+    int64_t deadline = now_ms() + timeout_ms;
+    for (;;) {
+        int64_t remaining = deadline - now_ms();
+        if (remaining <= 0) {
+            errno = EAGAIN;
+            return -1;
+        }
+        struct pollfd pfd = { sockfd, POLLIN, 0 };
+        int ready = poll(&pfd, 1, (int) remaining);
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ready <= 0) {
+            if (ready == 0) {
+                errno = EAGAIN;
+            }
+            return -1;
+        }
+        ssize_t n = recv(sockfd, buffer, len, MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+
+        int kind = classify(buffer, (size_t) n);
+        if (kind < 0) {
+            return n;
+        }
+        ImpairDecision decision = decide(state, (ImpairKind) kind);
+        if (decision.drop) {
+            continue;
+        }
+        if (decision.reorder && state->held_recv_len == 0 && (size_t) n <= sizeof(state->held_recv)) {
+            memcpy(state->held_recv, buffer, n);    // Délivré après le paquet suivant
+            state->held_recv_len = (size_t) n;
+            continue;
+        }
+        sleep_ms(decision.delay_ms);
+        if (decision.duplicate && state->held_recv_len == 0 && (size_t) n <= sizeof(state->held_recv)) {
+            memcpy(state->held_recv, buffer, n);
+            state->held_recv_len = (size_t) n;
+        }
+        return n;
+    }
+}
+
+
+
+
+/**
+ * Fonction : impair_report
+ * Description : Cette fonction affiche les compteurs de la dégradation.
+ * @param imp : La dégradation.
+ * @param out : Le flux de sortie.
+ * @return : Aucune valeur de retour
+ */
+void impair_report(Impairment* imp, FILE* out) {
+    if (!imp->enabled) {
+        return;
+    }
+    static const char* names[IMPAIR_NUM_KINDS] = { "DATA", "ACK" };
+    pthread_mutex_lock(&imp->mutex);
+    fprintf(out, "[IMPAIR] graine %llu", (unsigned long long) imp->seed);
+    for (int kind = 0; kind < IMPAIR_NUM_KINDS; kind++) {
+        fprintf(out, " | %s %lu : perdus %lu, dupliqués %lu, réordonnés %lu, délai moyen %.1f ms",
+                names[kind], imp->packets[kind], imp->dropped[kind], imp->duplicated[kind], imp->reordered[kind],
+                imp->packets[kind] > 0 ? (double) imp->delay_ms[kind] / imp->packets[kind] : 0.0);
+    }
+    fprintf(out, "\n");
+    pthread_mutex_unlock(&imp->mutex);
+}
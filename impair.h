@@ -0,0 +1,91 @@
+/**
+ * @file impair.h
+ * @brief Dégradation réseau simulée (perte, duplication, réordonnancement, délai) des DATA et des ACK des transferts,
+ *        sans netem ni droits root : les envois et réceptions de handle_read_request et handle_write_request passent
+ *        par impair_send et impair_recv. Le tirage est reproductible : graine de l'exécution et identifiant du transfert.
+ */
+
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+#ifndef IMPAIR_H
+#define IMPAIR_H
+
+#define IMPAIR_MAX_PACKET 516
+
+
+/**
+ * @enum ImpairKind
+ * @brief Paquets dégradés (les autres, requêtes et erreurs, ne le sont jamais).
+ */
+typedef enum {
+    IMPAIR_DATA = 0,
+    IMPAIR_ACK,
+    IMPAIR_NUM_KINDS
+} ImpairKind;
+
+
+
+
+/**
+ * @struct ImpairRule
+ * @brief Dégradation d'un type de paquet, dans les deux sens.
+ */
+typedef struct ImpairRule {
+    double drop;                    /* Probabilité de perte */
+    double duplicate;               /* Probabilité de duplication */
+    double reorder;                 /* Probabilité qu'un paquet soit retenu et délivré après le suivant */
+    int delay_ms;                   /* Délai ajouté à chaque paquet */
+    int jitter_ms;                  /* Variation uniforme du délai (± jitter) */
+} ImpairRule;
+
+
+
+
+/**
+ * @struct Impairment
+ * @brief Configuration de l'exécution et compteurs (partagés par tous les transferts).
+ */
+typedef struct Impairment {
+    bool enabled;
+    uint64_t seed;
+    ImpairRule rules[IMPAIR_NUM_KINDS];
+    pthread_mutex_t mutex;
+
+    unsigned long packets[IMPAIR_NUM_KINDS];
+    unsigned long dropped[IMPAIR_NUM_KINDS];
+    unsigned long duplicated[IMPAIR_NUM_KINDS];
+    unsigned long reordered[IMPAIR_NUM_KINDS];
+    unsigned long long delay_ms[IMPAIR_NUM_KINDS];
+} Impairment;
+
+
+
+
+/**
+ * @struct ImpairState
+ * @brief État d'un transfert : générateur pseudo-aléatoire et paquets retenus (un par sens).
+ */
+typedef struct ImpairState {
+    Impairment* impairment;
+    uint64_t rng;
+    char held_send[IMPAIR_MAX_PACKET];      /* Paquet à envoyer après le suivant */
+    size_t held_send_len;                   /* 0 = aucun */
+    char held_recv[IMPAIR_MAX_PACKET];      /* Paquet reçu à délivrer à la réception suivante (retenu ou dupliqué) */
+    size_t held_recv_len;
+} ImpairState;
+
+
+
+int impair_init(Impairment* imp, const char* spec);
+ImpairState* impair_attach(Impairment* imp, uint64_t transfer_id);
+void impair_detach(ImpairState* state);
+ssize_t impair_send(ImpairState* state, int sockfd, const void* buffer, size_t len);
+ssize_t impair_recv(ImpairState* state, int sockfd, void* buffer, size_t len, int timeout_ms);
+void impair_report(Impairment* imp, FILE* out);
+
+#endif
@@ -0,0 +1,255 @@
+/**
+ * @file integrity.c
+ * @brief Implémentation du contrôle d'intégrité.
+ *        Un fichier d'empreinte n'est utilisé que s'il n'est pas plus ancien que le fichier (sinon le fichier a été
+ *        modifié hors du serveur depuis sa réception). Les empreintes mémorisées sont indexées par inode : une entrée
+ *        est remplacée par la dernière version lue qui tombe dans la même case.
+ */
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "integrity.h"
+#include "crc32c.h"
+
+#define SIDECAR_MAX_SIZE 64
+
+
+
+/**
+ * Fonction : integrity_init
+ * Description : Cette fonction initialise le contrôle d'intégrité.
+ * @param store : Le contrôle à initialiser.
+ * @param root : La racine de service.
+ * @param enabled : false pour ne pas écrire ni comparer d'empreintes.
+ * @return : Aucune valeur de retour
+ */
+void integrity_init(IntegrityStore* store, ServingRoot* root, bool enabled) {
+    memset(store, 0, sizeof(*store));
+    store->enabled = enabled;
+    store->root = root;
+    pthread_mutex_init(&store->mutex, NULL);
+}
+
+
+
+
+/**
+ * Fonction : same_time
+ * Description : Cette fonction compare deux dates.
+ * @return : true si elles sont égales.
+ */
+static bool same_time(const struct timespec* a, const struct timespec* b) {
+    return a->tv_sec == b->tv_sec && a->tv_nsec == b->tv_nsec;
+}
+
+
+
+
+/**
+ * Fonction : read_sidecar
+ * Description : Cette fonction lit le fichier d'empreinte d'un fichier, s'il existe et n'est pas périmé.
+ * @param store : Le contrôle d'intégrité.
+ * @param filename : Le nom du fichier.
+ * @param st : L'état du fichier.
+ * @param crc : Un pointeur qui reçoit l'empreinte.
+ * @return : true si l'empreinte est connue.
+ */
+static bool read_sidecar(IntegrityStore* store, const char* filename, const struct stat* st, uint32_t* crc) {
+    char sidecar[PATH_MAX];
+    if (snprintf(sidecar, sizeof(sidecar), "%s%s", filename, INTEGRITY_SUFFIX) >= (int) sizeof(sidecar)) {
+        return false;
+    }
+    int fd = fsroot_open(store->root, sidecar, O_RDONLY | O_NONBLOCK | O_CLOEXEC, 0);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat sidecar_st;
+    char buffer[SIDECAR_MAX_SIZE];
+    ssize_t len = -1;
+    if (fstat(fd, &sidecar_st) == 0 && S_ISREG(sidecar_st.st_mode)
+        && (sidecar_st.st_mtim.tv_sec > st->st_mtim.tv_sec
+            || (sidecar_st.st_mtim.tv_sec == st->st_mtim.tv_sec && sidecar_st.st_mtim.tv_nsec >= st->st_mtim.tv_nsec))) {
+        len = read(fd, buffer, sizeof(buffer) - 1);
+    }
+    close(fd);
+    if (len <= 0) {
+        return false;
+    }
+    buffer[len] = '\0';
+
+    unsigned int value;
+    uint64_t size;
+    if (sscanf(buffer, "%8x %" SCNu64, &value, &size) != 2 || size != (uint64_t) st->st_size) {
+        return false;
+    }
+    *crc = value;
+    return true;
+}
+
+
+
+
+/**
+ * Fonction : integrity_check_read
+ * Description : Cette fonction enregistre l'empreinte d'un fichier envoyé en entier et la compare à la valeur connue
+ *               pour cette version du fichier (empreinte mémorisée d'un envoi précédent ou fichier d'empreinte).
+ * @param store : Le contrôle d'intégrité.
+ * @param filename : Le nom normalisé du fichier.
+ * @param file : Le flux lu (les flux sans descripteur, comme ceux du mode proxy, sont seulement comptés).
+ * @param crc : Le CRC32C des données envoyées.
+ * @param bytes : Le nombre d'octets envoyés.
+ * @return : 0 si l'empreinte est cohérente ou inconnue, -1 si elle diffère de la valeur connue.
+ */
+int integrity_check_read(IntegrityStore* store, const char* filename, FILE* file, uint32_t crc, uint64_t bytes) {
+    if (!store->enabled) {
+        return 0;
+    }
+    pthread_mutex_lock(&store->mutex);
+    store->reads++;
+    store->bytes += bytes;
+    pthread_mutex_unlock(&store->mutex);
+
+    struct stat st;
+    int fd = fileno(file);
+    if (fd < 0 || fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || (uint64_t) st.st_size != bytes) {
+        return 0;   // Version du fichier inconnue : rien à mémoriser
+    }
+
+    ChecksumEntry* entry = &store->cache[(uint64_t) (st.st_ino ^ st.st_dev) & (INTEGRITY_CACHE_SIZE - 1)];
+    uint32_t expected = 0;
+    pthread_mutex_lock(&store->mutex);
+    bool known = entry->used && entry->dev == st.st_dev && entry->ino == st.st_ino && entry->size == bytes
+        && same_time(&entry->mtime, &st.st_mtim) && same_time(&entry->ctime, &st.st_ctim);
+    if (known) {
+        expected = entry->crc;
+    }
+    pthread_mutex_unlock(&store->mutex);
+    if (!known) {
+        known = read_sidecar(store, filename, &st, &expected);
+    }
+
+    pthread_mutex_lock(&store->mutex);
+    if (known && expected != crc) {
+        store->mismatches++;
+        pthread_mutex_unlock(&store->mutex);
+        printf("[CRC32C] ALERTE : %s envoyé avec l'empreinte %08x, %08x attendue (fichier altéré ?)\n", filename, crc, expected);
+        return -1;
+    }
+    if (known) {
+        store->verified++;
+    }
+    entry->dev = st.st_dev;
+    entry->ino = st.st_ino;
+    entry->size = bytes;
+    entry->mtime = st.st_mtim;
+    entry->ctime = st.st_ctim;
+    entry->crc = crc;
+    entry->used = true;
+    pthread_mutex_unlock(&store->mutex);
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : integrity_owns
+ * Description : Cette fonction indique si un chemin désigne un fichier d'empreinte ou son fichier temporaire
+ *               (interdits aux clients : une empreinte lue révèle le contenu attendu, une empreinte écrite serait forgée).
+ * @param store : Le contrôle d'intégrité.
+ * @param filename : Le chemin normalisé d'une requête.
+ * @return : true si le chemin est réservé aux empreintes.
+ */
+bool integrity_owns(const IntegrityStore* store, const char* filename) {
+    static const char* const suffixes[] = { INTEGRITY_SUFFIX, INTEGRITY_SUFFIX ".new" };
+    size_t len = strlen(filename);
+    for (size_t i = 0; store->enabled && i < sizeof(suffixes) / sizeof(suffixes[0]); i++) {
+        size_t suffix_len = strlen(suffixes[i]);
+        if (len > suffix_len && strcmp(filename + len - suffix_len, suffixes[i]) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+
+
+/**
+ * Fonction : integrity_write_sidecar
+ * Description : Cette fonction écrit le fichier d'empreinte d'un fichier reçu, après son renommage
+ *               (fichier temporaire renommé : le fichier d'empreinte n'est jamais partiellement écrit).
+ * @param store : Le contrôle d'intégrité.
+ * @param filename : Le nom normalisé du fichier reçu.
+ * @param crc : Le CRC32C des données reçues.
+ * @param bytes : Le nombre d'octets reçus.
+ * @return : 0 en cas de succès, -1 en cas d'échec (errno positionné).
+ */
+int integrity_write_sidecar(IntegrityStore* store, const char* filename, uint32_t crc, uint64_t bytes) {
+    if (!store->enabled) {
+        return 0;
+    }
+    pthread_mutex_lock(&store->mutex);
+    store->writes++;
+    store->bytes += bytes;
+    pthread_mutex_unlock(&store->mutex);
+
+    char sidecar[PATH_MAX];
+    char temp[PATH_MAX];
+    char content[SIDECAR_MAX_SIZE];
+    int ret = -1;
+    int len = snprintf(content, sizeof(content), "%08x %" PRIu64 "\n", crc, bytes);
+    if (snprintf(sidecar, sizeof(sidecar), "%s%s", filename, INTEGRITY_SUFFIX) < (int) sizeof(sidecar)
+        && snprintf(temp, sizeof(temp), "%s%s.new", filename, INTEGRITY_SUFFIX) < (int) sizeof(temp)) {
+        int fd = fsroot_open(store->root, temp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd >= 0) {
+            bool written = write(fd, content, len) == len;
+            if (close(fd) == 0 && written) {
+                ret = fsroot_rename(store->root, temp, sidecar);
+            }
+            if (ret != 0) {
+                int saved_errno = errno;
+                fsroot_unlink(store->root, temp);
+                errno = saved_errno;
+            }
+        }
+    } else {
+        errno = ENAMETOOLONG;
+    }
+
+    pthread_mutex_lock(&store->mutex);
+    if (ret == 0) {
+        store->sidecars++;
+    } else {
+        store->sidecar_failures++;
+    }
+    pthread_mutex_unlock(&store->mutex);
+    return ret;
+}
+
+
+
+
+/**
+ * Fonction : integrity_report
+ * Description : Cette fonction affiche les compteurs du contrôle d'intégrité.
+ * @param store : Le contrôle d'intégrité.
+ * @param out : Le flux de sortie.
+ * @return : Aucune valeur de retour
+ */
+void integrity_report(IntegrityStore* store, FILE* out) {
+    if (!store->enabled) {
+        return;
+    }
+    pthread_mutex_lock(&store->mutex);
+    fprintf(out, "[CRC32C] %s | envois %lu (vérifiés %lu, écarts %lu) | réceptions %lu (empreintes écrites %lu, échecs %lu) | %.1f Mo contrôlés\n",
+            crc32c_implementation(), store->reads, store->verified, store->mismatches,
+            store->writes, store->sidecars, store->sidecar_failures, store->bytes / (1024.0 * 1024.0));
+    pthread_mutex_unlock(&store->mutex);
+}
@@ -0,0 +1,69 @@
+/**
+ * @file integrity.h
+ * @brief Contrôle d'intégrité des fichiers transférés, sans relecture : le CRC32C calculé pendant le transfert est
+ *        conservé à côté des fichiers reçus (fichier « <nom>.crc32c ») et mémorisé pour les fichiers envoyés ;
+ *        un envoi ultérieur du même fichier est comparé à la valeur connue.
+ */
+
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <sys/types.h>
+
+#include "fsroot.h"
+
+#ifndef INTEGRITY_H
+#define INTEGRITY_H
+
+#define INTEGRITY_SUFFIX ".crc32c"      /* Empreinte d'un fichier reçu : « <crc en hexadécimal> <taille> » */
+#define INTEGRITY_CACHE_SIZE 1024       /* Empreintes mémorisées (table à correspondance directe, puissance de 2) */
+
+
+/**
+ * @struct ChecksumEntry
+ * @brief Empreinte d'une version d'un fichier (identifiée par inode, taille et dates).
+ */
+typedef struct ChecksumEntry {
+    dev_t dev;
+    ino_t ino;
+    uint64_t size;
+    struct timespec mtime;
+    struct timespec ctime;
+    uint32_t crc;
+    bool used;
+} ChecksumEntry;
+
+
+
+
+/**
+ * @struct IntegrityStore
+ * @brief Empreintes mémorisées et compteurs du contrôle d'intégrité.
+ */
+typedef struct IntegrityStore {
+    bool enabled;
+    ServingRoot* root;
+    ChecksumEntry cache[INTEGRITY_CACHE_SIZE];
+    pthread_mutex_t mutex;
+
+    unsigned long reads;            /* Envois complets */
+    unsigned long verified;         /* Envois comparés à une empreinte connue (cache ou fichier d'empreinte) */
+    unsigned long mismatches;       /* Envois dont l'empreinte diffère : fichier altéré sur disque */
+    unsigned long writes;           /* Réceptions complètes */
+    unsigned long sidecars;         /* Fichiers d'empreinte écrits */
+    unsigned long sidecar_failures;
+    unsigned long long bytes;       /* Octets contrôlés */
+} IntegrityStore;
+
+
+
+void integrity_init(IntegrityStore* store, ServingRoot* root, bool enabled);
+bool integrity_owns(const IntegrityStore* store, const char* filename);
+int integrity_check_read(IntegrityStore* store, const char* filename, FILE* file, uint32_t crc, uint64_t bytes);
+int integrity_write_sidecar(IntegrityStore* store, const char* filename, uint32_t crc, uint64_t bytes);
+void integrity_report(IntegrityStore* store, FILE* out);
+
+#endif
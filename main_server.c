@@ -10,26 +10,150 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
+#include <signal.h>
 #include <arpa/inet.h>
 #include <sys/time.h>
 #include <pthread.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 
 
 #include "tftp.h"
 #include "sync.h"
-
-#define SERVER_MAIN_PORT 69
+#include "config.h"
+#include "admission.h"
+#include "ratelimit.h"
+#include "negcache.h"
+#include "fsroot.h"
+#include "commit.h"
+#include "trace.h"
+#include "histo.h"
+#include "proxy.h"
+#include "dedup.h"
+#include "sockfilter.h"
+#include "sockpool.h"
+#include "fastpath.h"
+#include "integrity.h"
+#include "probes.h"
+#include "impair.h"
+#include "bundle.h"
+#include "vfile.h"
+#include "peer.h"
 
 typedef int (*TFTP_HandlerFunction)(TFTP_Client *client, TFTP_Request* request);
 
 
 void *handleClient(void *arg);
+static int demarrer_transfert(struct sockaddr_in client_addr, const char* packet, ssize_t packet_len, const TFTP_Request* request, double wait_ms, AdmissionClass size_class);
+static void liberer_creneau(AdmissionClass size_class);
+static void* demarrer_en_attente(void* arg);
+static AdmissionClass classer_requete(const TFTP_Request* request);
+static void terminer_transfert(TFTP_Client* client);
+static int finaliser_upload(TFTP_Client* client, TFTP_Request* request);
 
 
 
 // Global VAR
 FileList fileList;
 TFTP_ClientsList clientsList;
+AdmissionControl admission;
+RateLimiter rateLimiter;
+NegativeCache negCache;
+ServingRoot servingRoot;
+GroupCommit groupCommit;
+PacketTrace packetTrace;
+HistoRegistry histograms;
+UpstreamProxy upstreamProxy;
+ContentStore contentStore;
+SocketFilter socketFilter;
+SocketPool socketPool;
+FastPath fastPath;
+IntegrityStore integrity;
+Impairment impairment;
+BundleSet imageBundle;
+VirtualFiles virtualFiles;
+PeerGroup peerGroup;
+static volatile sig_atomic_t stats_requested = 0;
+static volatile sig_atomic_t stop_requested = 0;
+static volatile sig_atomic_t reset_requested = 0;
+static volatile sig_atomic_t reload_requested = 0;
+
+
+
+/**
+ * @brief Gestionnaire du signal SIGUSR1 : demande l'affichage des statistiques par le thread principal.
+ * @param sig Le numéro du signal reçu.
+ */
+static void on_stats_signal(int sig) {
+    (void) sig;
+    stats_requested = 1;
+}
+
+
+/**
+ * @brief Gestionnaire du signal SIGUSR2 : demande la remise à zéro des histogrammes de latence.
+ * @param sig Le numéro du signal reçu.
+ */
+static void on_reset_signal(int sig) {
+    (void) sig;
+    reset_requested = 1;
+}
+
+
+/**
+ * @brief Gestionnaire du signal SIGHUP : demande le rechargement du paquet d'images.
+ * @param sig Le numéro du signal reçu.
+ */
+static void on_reload_signal(int sig) {
+    (void) sig;
+    reload_requested = 1;
+}
+
+
+/**
+ * @brief Gestionnaire de SIGINT/SIGTERM : demande l'arrêt du thread principal (la trace est alors vidée).
+ * @param sig Le numéro du signal reçu.
+ */
+static void on_stop_signal(int sig) {
+    (void) sig;
+    stop_requested = 1;
+}
+
+
+/**
+ * @brief Affiche les statistiques du serveur (file d'attente, transferts actifs).
+ */
+static void afficher_statistiques(void) {
+    admission_report(&admission, stdout);
+    sync_report(&fileList, stdout);
+    sockfilter_report(&socketFilter, stdout);
+    sockpool_report(&socketPool, stdout);
+    fastpath_report(&fastPath, stdout);
+    integrity_report(&integrity, stdout);
+    impair_report(&impairment, stdout);
+    bundle_report(&imageBundle, stdout);
+    vfile_report(&virtualFiles, stdout);
+    peer_report(&peerGroup, stdout);
+    ratelimit_report(&rateLimiter, stdout);
+    negcache_report(&negCache, stdout);
+    fsroot_report(&servingRoot, stdout);
+    if (config.durability == DURABILITY_GROUP) {
+        commit_report(&groupCommit, stdout);
+    }
+    if (config.content_store != NULL) {
+        dedup_report(&contentStore, stdout);
+    }
+    if (config.upstream != NULL) {
+        proxy_report(&upstreamProxy, stdout);
+    }
+    trace_report(&packetTrace, stdout);
+    histo_report(&histograms, stdout);
+    if (config.histo_file != NULL && histo_export(&histograms, config.histo_file) < 0) {
+        perror("Erreur lors de l'export des histogrammes");
+    }
+    fflush(stdout);
+}
 
 
 
@@ -38,70 +162,404 @@ TFTP_ClientsList clientsList;
  * @return 0 en cas de succès.
  */
 
-int main() {
+int main(int argc, char* argv[]) {
     struct sockaddr_in client_addr;
     socklen_t client_len;
     char buffer[MAX_PACKET_SIZE];
 
+    init_config(&config);
+    int parsed = parse_config(&config, argc, argv);
+    if (parsed != 0) {
+        print_usage(argv[0]);
+        return parsed < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
     // Initialisation du serveur TFTP
     printf("Initialisation du serveur TFTP...\n");
-    int sockfd = create_Socket("0.0.0.0", SERVER_MAIN_PORT);
-    printf("Serveur TFTP initialisé et en attente de connexions sur le port %d\n", SERVER_MAIN_PORT);
+    if (fsroot_init(&servingRoot, config.root) < 0 || chdir(config.root) < 0) {
+        if (errno == ENOSYS) {
+            fprintf(stderr, "Erreur : openat2 indisponible (Linux 5.6 ou plus récent requis), les requêtes ne seraient pas confinées à la racine\n");
+            return EXIT_FAILURE;
+        }
+        perror("Erreur lors de l'ouverture de la racine de service");
+        return EXIT_FAILURE;
+    }
+    int sockfd = create_Socket("0.0.0.0", config.port);
+    sockfilter_init(&socketFilter, config.socket_filter);
+    if (sockfilter_attach(&socketFilter, sockfd, SOCKFILTER_LISTENER) < 0) {
+        perror("Erreur lors de l'installation du filtre BPF (paquets filtrés par le thread d'écoute)");
+    }
+    printf("Serveur TFTP initialisé et en attente de connexions sur le port %d\n", config.port);
     client_len = sizeof(client_addr);
 
     initialize_fileList(&fileList);
+    initialiser_ListeClients(&clientsList);
+    if (admission_init(&admission, &config) < 0) {
+        perror("Erreur lors de l'initialisation du contrôle d'admission");
+        return EXIT_FAILURE;
+    }
+    ratelimit_init(&rateLimiter, config.rate_limit, config.rate_burst);
+    negcache_init(&negCache, config.negcache_size);
+    integrity_init(&integrity, &servingRoot, config.checksums);
+    if (impair_init(&impairment, config.impair) < 0) {
+        fprintf(stderr, "Erreur : spécification de dégradation invalide '%s'\n", config.impair);
+        return EXIT_FAILURE;
+    }
+    if (bundle_init(&imageBundle, config.bundle) < 0) {
+        perror("Erreur lors du chargement du paquet d'images");
+        return EXIT_FAILURE;
+    }
+    if (vfile_init(&virtualFiles, config.vfile_rules) < 0) {
+        fprintf(stderr, "Erreur : règles des fichiers virtuels invalides\n");
+        return EXIT_FAILURE;
+    }
+    if (impairment.enabled) {
+        printf("[IMPAIR] dégradation réseau simulée active (graine %llu)\n", (unsigned long long) impairment.seed);
+    }
+
+    // Les threads de validation, des paquets égarés et du chemin rapide ne doivent pas recevoir les signaux destinés au thread d'écoute
+    sigset_t signaux, ancien;
+    sigemptyset(&signaux);
+    sigaddset(&signaux, SIGUSR1);
+    sigaddset(&signaux, SIGUSR2);
+    sigaddset(&signaux, SIGHUP);
+    sigaddset(&signaux, SIGINT);
+    sigaddset(&signaux, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signaux, &ancien);
+    int commit_ret = config.durability == DURABILITY_GROUP ? commit_init(&groupCommit, &servingRoot, config.commit_window) : 0;
+    int pool_ret = sockpool_init(&socketPool, config.socket_pool, &socketFilter);
+    int fast_ret = pool_ret < 0 ? 0 : fastpath_init(&fastPath, config.tiny_cache, &socketPool, &packetTrace, &histograms);
+    int peer_ret = peer_init(&peerGroup, &servingRoot, config.peers, config.peer_listen, config.peer_cache);
+    pthread_t dispatch_tid;     // Démarrage des requêtes en attente, à la priorité normale
+    int dispatch_ret = admission.capacity > 0 ? pthread_create(&dispatch_tid, NULL, demarrer_en_attente, NULL) : 0;
+    pthread_sigmask(SIG_SETMASK, &ancien, NULL);
+    if (dispatch_ret != 0) {
+        errno = dispatch_ret;
+        perror("Erreur lors de la création du thread de démarrage des requêtes en attente");
+        return EXIT_FAILURE;
+    }
+    if (admission.capacity > 0) {
+        pthread_detach(dispatch_tid);
+    }
+    if (pool_ret < 0) {
+        perror("Erreur lors de la création du pool de sockets de transfert");
+        return EXIT_FAILURE;
+    }
+    if (fast_ret < 0) {
+        perror("Erreur lors du démarrage du chemin rapide");
+        return EXIT_FAILURE;
+    }
+    if (commit_ret < 0) {
+        perror("Erreur lors du démarrage du thread de validation");
+        return EXIT_FAILURE;
+    }
+    if (peer_ret < 0) {
+        perror("Erreur lors du démarrage du mode pair (liste -N, canal -L)");
+        return EXIT_FAILURE;
+    }
+    if (config.peers != NULL) {
+        printf("[PEER] canal %s, %d instances\n", config.peer_listen, peerGroup.node_count);
+    }
+    if (trace_init(&packetTrace, config.trace_file) < 0) {
+        perror("Erreur lors de la création du fichier de trace");
+        return EXIT_FAILURE;
+    }
+    if (histo_init(&histograms) < 0) {
+        perror("Erreur lors de l'initialisation des histogrammes");
+        return EXIT_FAILURE;
+    }
+    if (config.content_store != NULL && dedup_init(&contentStore, &servingRoot, config.content_store) < 0) {
+        perror("Erreur lors de l'initialisation du magasin de déduplication");
+        return EXIT_FAILURE;
+    }
+    if (config.upstream != NULL && proxy_init(&upstreamProxy, config.upstream, &servingRoot, &fileList, (uint16_t) config.block_rollover) < 0) {
+        perror("Erreur lors de la résolution du serveur amont");
+        return EXIT_FAILURE;
+    }
 
-    while (1) {
+    // SIGUSR1 interrompt recvfrom (pas de SA_RESTART) pour afficher les statistiques
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_stats_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGUSR1, &sa, NULL);
+    sa.sa_handler = on_reset_signal;
+    sigaction(SIGUSR2, &sa, NULL);
+    sa.sa_handler = on_reload_signal;
+    sigaction(SIGHUP, &sa, NULL);
+    sa.sa_handler = on_stop_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    while (!stop_requested) {
         ssize_t num_bytes_received = recvfrom(sockfd, &buffer, MAX_PACKET_SIZE, 0, (struct sockaddr *)&client_addr, &client_len);
+        int recv_errno = errno;     // Les traitements des signaux ci-dessous peuvent modifier errno
+
+        if (stats_requested) {
+            stats_requested = 0;
+            afficher_statistiques();
+        }
+        if (reset_requested) {
+            reset_requested = 0;
+            histo_reset(&histograms);
+            printf("[HISTO] histogrammes remis à zéro\n");
+        }
+        if (reload_requested) {
+            reload_requested = 0;
+            if (bundle_reload(&imageBundle) < 0) {
+                perror("Erreur lors du rechargement du paquet d'images (paquet précédent conservé)");
+            } else if (config.bundle != NULL) {
+                printf("[BUNDLE] paquet %s rechargé\n", config.bundle);
+            }
+        }
+
         if (num_bytes_received == -1) {
-            perror("Erreur lors de la réception des données du client");
+            if (recv_errno != EINTR) {
+                errno = recv_errno;
+                perror("Erreur lors de la réception des données du client");
+            }
             continue;
         }
 
+        uint64_t received_us = histo_now_us();
+        trace_record(&packetTrace, &client_addr, buffer, num_bytes_received);
+
         if (num_bytes_received < 11){
             continue;
         }
 
-        if (get_client(&clientsList,client_addr,buffer) != NULL ){
-            printf("client déja .... ignore\n");
+        // Limitation par IP source, avant toute allocation
+        if (!ratelimit_allow(&rateLimiter, client_addr.sin_addr)) {
             continue;
         }
 
-        char* client_ip = inet_ntoa(client_addr.sin_addr);
-        int newsockfd = create_Socket(client_ip,0);
+        // Requêtes mal formées et fichiers connus comme inexistants : réponse directe, sans créer de transfert
+        TFTP_Request request;
+        int error_code;
+        const char* error_message;
+        if (parse_request(buffer, num_bytes_received, &request, &error_code, &error_message) < 0) {
+            send_error_packet(sockfd, &client_addr, error_code, get_error_message(error_code), error_message);
+            continue;
+        }
+        if (fsroot_normalize(request.filename) < 0
+            || (config.content_store != NULL && dedup_owns(&contentStore, request.filename))
+            || integrity_owns(&integrity, request.filename)
+            || (ntohs(request.opcode) == TFTP_OPCODE_WRQ && vfile_match(&virtualFiles, request.filename))) {
+            send_error_packet(sockfd, &client_addr, AccessViolation, get_error_message(AccessViolation), NULL);
+            continue;
+        }
+        uint64_t bundle_len;   // Fichier ajouté par un rechargement du paquet : le cache des fichiers inexistants ne le voit pas
+        if (ntohs(request.opcode) == TFTP_OPCODE_RRQ && negcache_lookup(&negCache, request.filename)
+            && !bundle_size(&imageBundle, request.filename, &bundle_len)) {
+            send_error_packet(sockfd, &client_addr, FileNotFound, get_error_message(FileNotFound), NULL);
+            continue;
+        }
 
-        TFTP_Client* client = init_client(client_addr,buffer);
+        if (get_client(&clientsList,client_addr,buffer) != NULL ){
+            printf("client déja .... ignore\n");
+            continue;
+        }
 
-        if (client == NULL) {
-            perror("Erreur lors de l'allocation de mémoire pour les données client");
-            close(newsockfd);
+        // Fichier d'un seul bloc : DATA envoyé directement, sans client ni thread (ni créneau d'admission)
+        if (fastpath_serve(&fastPath, &servingRoot, &imageBundle, &virtualFiles, &client_addr, &request, received_us)) {
             continue;
         }
 
-        client->socket_fd = newsockfd;
-        client->client_addr = client_addr;
-        memcpy(client->packet, buffer, num_bytes_received);
+        // Contrôle d'admission : démarrage, mise en attente, abandon ou refus
+        AdmissionClass size_class = classer_requete(&request);
+        switch (admission_request(&admission, client_addr, buffer, num_bytes_received, &request, size_class)) {
+            case ADMISSION_ACCEPTED:
+                if (demarrer_transfert(client_addr, buffer, num_bytes_received, &request, 0, size_class) < 0) {
+                    liberer_creneau(size_class);
+                }
+                break;
+            case ADMISSION_REJECTED:
+                send_error_packet(sockfd, &client_addr, NotDefined, get_error_message(NotDefined), "Serveur surchargé, réessayez plus tard");
+                break;
+            default:    // En file d'attente, doublon ou ignorée
+                break;
+        }
+    }
 
-        ajouterClient(client,&clientsList);
+    trace_flush(&packetTrace);  // Les transferts en cours sont interrompus avec le processus
+    return 0;
+}
 
 
-        // Création d'un thread pour gérer le client
-        pthread_t tid;
-        if (pthread_create(&tid, NULL, handleClient, client) != 0) {
-            perror("Erreur lors de la création du thread client");
-            supprimer_client(&clientsList,client);
-            continue;
-        }
-        
-        pthread_detach(tid); // Le thread est détaché car nous n'attendons pas explicitement sa fin
+
+
+/**
+ * @brief Démarre le transfert d'une requête admise : socket connecté au client (pool), client et thread associé.
+ *        Le créneau d'admission doit déjà être réservé ; il est rendu par le thread à la fin du transfert.
+ * @param client_addr L'adresse du client.
+ * @param packet Le paquet de requête reçu.
+ * @param packet_len La taille du paquet reçu.
+ * @param request La requête analysée par le thread d'écoute (vues dans packet, reportées sur la copie du client).
+ * @param wait_ms Le temps passé par la requête dans la file d'attente (0 si admise directement).
+ * @param size_class La classe de taille de la requête (créneau réservé).
+ * @return 0 en cas de succès, -1 en cas d'échec (le créneau reste alors à rendre par l'appelant).
+ */
+static int demarrer_transfert(struct sockaddr_in client_addr, const char* packet, ssize_t packet_len, const TFTP_Request* request, double wait_ms, AdmissionClass size_class) {
+    int newsockfd = sockpool_checkout(&socketPool, &client_addr);
+    if (newsockfd < 0) {
+        perror("Erreur lors de la connexion du socket de transfert");
+        return -1;
+    }
+
+    TFTP_Client* client = init_client(client_addr,packet);
+
+    if (client == NULL) {
+        perror("Erreur lors de l'allocation de mémoire pour les données client");
+        sockpool_release(&socketPool, newsockfd);
+        return -1;
     }
 
+    client->socket_fd = newsockfd;
+    client->client_addr = client_addr;
+    client->rollover = (uint16_t) config.block_rollover;
+    memcpy(client->packet, packet, packet_len);
+    client->packet_len = packet_len;
+    client->request = *request;
+    rebase_request(&client->request, packet, client->packet);
+    client->trace = &packetTrace;
+    client->histo = &histograms;
+    client->received_us = histo_now_us() - (uint64_t) (wait_ms * 1000);
+    client->size_class = size_class;
+    client->transfer_id = next_transfer_id();
+    client->impair = impair_attach(&impairment, client->transfer_id);
+    PROBE3(request__accepted, client->transfer_id, (unsigned char) client->packet[0] << 8 | (unsigned char) client->packet[1], client->packet + 2);
+
+    ajouterClient(client,&clientsList);
+
+
+    // Création d'un thread pour gérer le client (les signaux restent traités par le thread principal)
+    sigset_t signaux, ancien;
+    sigemptyset(&signaux);
+    sigaddset(&signaux, SIGUSR1);
+    sigaddset(&signaux, SIGUSR2);
+    sigaddset(&signaux, SIGHUP);
+    sigaddset(&signaux, SIGINT);
+    sigaddset(&signaux, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signaux, &ancien);
+
+    pthread_t tid;
+    int ret = pthread_create(&tid, NULL, handleClient, client);
+    pthread_sigmask(SIG_SETMASK, &ancien, NULL);
+
+    if (ret != 0) {
+        perror("Erreur lors de la création du thread client");
+        sockpool_release(&socketPool, newsockfd);
+        client->socket_fd = -1;
+        supprimer_client(&clientsList,client);
+        return -1;
+    }
+
+    pthread_detach(tid); // Le thread est détaché car nous n'attendons pas explicitement sa fin
     return 0;
 }
 
 
 
 
+/**
+ * @brief Rend le créneau d'un transfert terminé (ou qui n'a pas pu démarrer). Si des requêtes attendent, le thread
+ *        de démarrage est réveillé : le thread appelant, dont la priorité a pu être abaissée (gros fichier),
+ *        ne crée pas lui-même le thread du transfert suivant, qui hériterait de cette priorité.
+ * @param size_class La classe de taille du transfert terminé.
+ */
+static void liberer_creneau(AdmissionClass size_class) {
+    admission_release(&admission, size_class);
+}
+
+
+
+
+/**
+ * @brief Thread de démarrage des requêtes en attente : chaque créneau rendu est transmis à la requête choisie
+ *        par le contrôle d'admission, démarrée à la priorité normale du thread.
+ * @param arg Inutilisé.
+ * @return Ne retourne pas.
+ */
+static void* demarrer_en_attente(void* arg) {
+    (void) arg;
+    PendingRequest next;
+    for (;;) {
+        admission_next(&admission, &next);
+        printf("[ADMISSION] démarrage d'une requête en attente depuis %.1f ms\n", next.wait_ms);
+        if (demarrer_transfert(next.client_addr, next.packet, next.packet_len, &next.request, next.wait_ms, next.size_class) < 0) {
+            admission_release(&admission, next.size_class);
+        }
+    }
+    return NULL;
+}
+
+
+
+
+/**
+ * @brief Classe une requête par taille de fichier : un RRQ d'un fichier existant jusqu'à config.small_size octets
+ *        est prioritaire ; les WRQ et les fichiers absents (taille inconnue) ne le sont pas.
+ *        Sans seuil (config.small_size = 0), toutes les requêtes sont dans la même classe.
+ * @param request La requête analysée (nom normalisé).
+ * @return La classe de taille de la requête.
+ */
+static AdmissionClass classer_requete(const TFTP_Request* request) {
+    if (config.small_size == 0) {
+        return ADMISSION_SMALL;
+    }
+    if (ntohs(request->opcode) != TFTP_OPCODE_RRQ) {
+        return ADMISSION_LARGE;
+    }
+    if (vfile_match(&virtualFiles, request->filename)) {
+        return ADMISSION_SMALL;     // Contenu généré en mémoire
+    }
+    uint64_t bundle_len;
+    if (bundle_size(&imageBundle, request->filename, &bundle_len)) {
+        return bundle_len <= (uint64_t) config.small_size ? ADMISSION_SMALL : ADMISSION_LARGE;
+    }
+    int fd = fsroot_open(&servingRoot, request->filename, O_PATH | O_CLOEXEC, 0);
+    if (fd < 0) {
+        return ADMISSION_LARGE;
+    }
+    struct stat st;
+    bool small = fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size <= config.small_size;
+    close(fd);
+    return small ? ADMISSION_SMALL : ADMISSION_LARGE;
+}
+
+
+
+
+/**
+ * @brief Termine le thread d'un transfert : retour du socket dans le pool, suppression du client et libération de son créneau.
+ * @param client Le client dont le transfert est terminé.
+ */
+static void terminer_transfert(TFTP_Client* client) {
+    AdmissionClass size_class = (AdmissionClass) client->size_class;
+    sockpool_release(&socketPool, client->socket_fd);
+    client->socket_fd = -1;
+    supprimer_client(&clientsList,client);   // Suppression du client de la liste des clients connectés
+    liberer_creneau(size_class);
+    pthread_exit(NULL);
+}
+
+
+
+
+/**
+ * @brief Valide un fichier reçu en mode durable : appelée par handle_write_request avant le dernier ACK,
+ *        elle attend que le thread de validation groupée ait écrit, synchronisé et renommé le fichier.
+ * @param client Le client dont le fichier est reçu.
+ * @param request La requête d'écriture.
+ * @return 0 en cas de succès, -1 en cas d'échec.
+ */
+static int finaliser_upload(TFTP_Client* client, TFTP_Request* request) {
+    return commit_upload(&groupCommit, client->file, client->staged, request->filename);
+}
+
+
+
+
 
 
 
@@ -113,116 +571,138 @@ int main() {
  * @return Aucune valeur de retour.
  */
 void *handleClient(void *arg) {
-    TFTP_Request request;
     TFTP_HandlerFunction selectedHandler = NULL;
-    Sync_Function SYNC_START = NULL;
+    Sync_Start_Function SYNC_START = NULL;
     Sync_Function SYNC_END = NULL;
 
 
     // Récupérer les données du client
     TFTP_Client *client = (TFTP_Client *)arg;
-    int sockfd = client->socket_fd;
+    sync_transfer_id = client->transfer_id;
     printf("\nNouveau client connecté, adresse IP : %s, port : %d\n", inet_ntoa(client->client_addr.sin_addr), ntohs(client->client_addr.sin_port));
 
-    // Analyser le paquet reçu
-    char* buffer = client->packet;
-    memcpy(&request.opcode, buffer, sizeof(uint16_t));
+    // Requête analysée et normalisée une seule fois, par le thread d'écoute
+    TFTP_Request request = client->request;
 
     // Sélection du gestionnaire de demande en fonction de l'opcode
     if (ntohs(request.opcode) == TFTP_OPCODE_RRQ) {
         SYNC_START = sync_start_read;
         SYNC_END = sync_end_read;
         selectedHandler = handle_read_request;
-    } else if (ntohs(request.opcode) == TFTP_OPCODE_WRQ) {
+    } else {
         SYNC_START = sync_start_write;
         SYNC_END = sync_end_write;
         selectedHandler = handle_write_request;
-    } else {
-        send_error_packet(sockfd, &client->client_addr, NotDefined, get_error_message(NotDefined),"Opcode non pris en charge");
-        pthread_exit(NULL);
     }
 
-    // Extraction du nom de fichier
-    size_t filename_length = strlen(buffer + 2);
-    strcpy(request.filename, buffer + 2);
-    if (filename_length == 0) {
-        printf("Erreur: Nom de fichier vide.\n");
-        send_error_packet(sockfd, &client->client_addr, NotDefined, get_error_message(NotDefined),"Nom de fichier vide");  // Envoyer un paquet d'erreur au client
-        pthread_exit(NULL);
-    }
 
     
 
-    // Extraction du mode de transfert
-    size_t mode_offset = 2 + filename_length + 1; // Offset pour accéder au début du mode
-    size_t mode_length = strlen(buffer + mode_offset);
-
-    strcpy(request.mode, buffer + mode_offset);
-    if (mode_length == 0 || (strcasecmp(request.mode, "netascii") != 0 && strcasecmp(request.mode, "octet") != 0) ) {
-        printf("Erreur: Mode de transfert non reconnu.\n");
-        send_error_packet(sockfd, &client->client_addr, NotDefined, get_error_message(NotDefined),"Mode de transfert non reconnu");    // Envoyer un paquet d'erreur au client
-        
+    uint64_t sync_start_us = histo_now_us();
+    if (SYNC_START(request.filename,&fileList) < 0) {   // début de la synchronisation pour le fichier demandé
+        // Table des fichiers pleine : le transfert n'est pas lancé sans exclusion lecteurs/écrivain
+        send_error_packet(client->socket_fd, &client->client_addr, NotDefined, get_error_message(NotDefined), "Serveur surchargé, réessayez plus tard");
+        terminer_transfert(client);
     }
-
-
-    
-
-    SYNC_START(request.filename,&fileList);     // début de la synchronisation pour le fichier demandé
-    char* temp_file;
+    histo_record(client->histo, HISTO_SYNC_WAIT, histo_now_us() - sync_start_us);
+    char* temp_file = NULL;
+    DedupWriter* dedup = NULL;
     int status;
     // printf("client fd %d commence\n",client->socket_fd);
 
 
     if(ntohs(request.opcode) == TFTP_OPCODE_RRQ ) { // Ouverture du fichier en lecture ou écriture en fonction de l'opération demandée
-        if (strcasecmp(request.mode, "netascii") == 0) { // Ouverture du fichier demandé
-            client->file = fopen(request.filename, "r");
-        } else if (strcasecmp(request.mode, "octet") == 0) {
-            client->file = fopen(request.filename, "rb");
-        } 
+        client->file = vfile_open(&virtualFiles, request.filename, &client->client_addr);   // Fichier virtuel généré en mémoire
+        if (client->file == NULL && errno == ENOENT) {
+            client->file = bundle_open(&imageBundle, request.filename);     // Puis paquet d'images, servi depuis la projection
+        }
+        if (client->file == NULL && errno == ENOENT) {
+            client->file = peer_open(&peerGroup, request.filename);     // Puis cache mémoire de l'instance propriétaire du fichier
+        }
+        if (client->file == NULL && errno == ENOENT) {
+            if (strcasecmp(request.mode, "netascii") == 0) { // Ouverture du fichier demandé
+                client->file = fsroot_fopen(&servingRoot, request.filename, "r");
+            } else if (strcasecmp(request.mode, "octet") == 0) {
+                client->file = fsroot_fopen(&servingRoot, request.filename, "rb");
+            }
+        }
+        if (client->file == NULL && errno == ENOENT && config.upstream != NULL) {
+            client->file = proxy_open(&upstreamProxy, request.filename);    // Fichier absent : récupéré auprès du serveur amont
+        }
     } else {
 
         temp_file = get_temp_file_name(request.filename);
         // printf("temp filename %s\n",temp_file);
 
-        if (strcasecmp(request.mode, "netascii") == 0) {
-            client->file = fopen(temp_file, "w");
+        if (config.durability == DURABILITY_GROUP) {    // Fichier préparé en mémoire, validé avant le dernier ACK
+            client->file = staged_upload_open(&servingRoot, temp_file, config.stage_size, &client->staged);
+            client->finalize = finaliser_upload;
+        } else if (strcasecmp(request.mode, "netascii") == 0) {
+            client->file = fsroot_fopen(&servingRoot, temp_file, "w");
         } else if (strcasecmp(request.mode, "octet") == 0) {
-            client->file = fopen(temp_file, "wb");
+            client->file = fsroot_fopen(&servingRoot, temp_file, "wb");
+        }
+        if (config.content_store != NULL) {     // Empreinte calculée pendant la réception
+            client->file = dedup_wrap(client->file, &dedup);
         }
 
     }
     
     
     if (client->file == NULL) { 
-        printf("Erreur !! : fichier non trouvé\n");
-        send_error_packet(client->socket_fd, &client->client_addr,FileNotFound, get_error_message(FileNotFound),NULL);// Envoi d'un paquet d'erreur au client
+        int open_errno = errno;
+        if (open_errno == EACCES || open_errno == EPERM || open_errno == EXDEV || open_errno == ELOOP) {
+            printf("Erreur !! : accès refusé\n");    // Droits insuffisants ou chemin hors de la racine
+            send_error_packet(client->socket_fd, &client->client_addr,AccessViolation, get_error_message(AccessViolation),NULL);
+        } else {
+            printf("Erreur !! : fichier non trouvé\n");
+            if (open_errno == ENOENT && ntohs(request.opcode) == TFTP_OPCODE_RRQ && config.upstream == NULL) {
+                negcache_insert(&negCache, request.filename);   // Les prochaines demandes seront refusées par le thread d'écoute
+            }
+            send_error_packet(client->socket_fd, &client->client_addr,FileNotFound, get_error_message(FileNotFound),NULL);// Envoi d'un paquet d'erreur au client
+        }
         SYNC_END(request.filename,&fileList); 
-        pthread_exit(NULL);;
+        free(temp_file);
+        terminer_transfert(client);
     }
     
     
+    if (ntohs(request.opcode) == TFTP_OPCODE_RRQ && client->size_class == ADMISSION_LARGE && config.small_size > 0) {
+        admission_lower_priority();     // Gros fichier : les petits transferts passent devant (processeur et disque)
+    }
     status = selectedHandler(client, &request); // Gestion de la demande du client
+    if (ntohs(request.opcode) == TFTP_OPCODE_RRQ && status == 0) {
+        integrity_check_read(&integrity, request.filename, client->file, client->crc32c, client->bytes);
+    }
 
     
 
     if (ntohs(request.opcode) == TFTP_OPCODE_WRQ){
 
         if (status == 0) {
-            // Supprimer l'ancien fichier
-            if (access(request.filename, F_OK) != -1) {
-                // printf("Le fichier existe.\n");
-                if (remove(request.filename) != 0) {
-                    perror("Erreur lors de la suppression de l'ancien fichier");
+            // Renommer le fichier temporaire en cas de succès (remplace atomiquement l'ancien fichier).
+            // En mode durable, le renommage a déjà été fait par le thread de validation ; avec déduplication,
+            // la cible devient un lien vers l'objet de son contenu.
+            if (dedup != NULL && dedup_commit(&contentStore, client->file, dedup, temp_file, request.filename) != 0) {
+                perror("Erreur lors de la validation du fichier dédupliqué");
+            } else if (dedup == NULL && client->staged == NULL && fsroot_rename(&servingRoot, temp_file, request.filename) != 0) {
+                perror("Erreur lors du renommage du fichier temporaire");
+            } else {
+                PROBE3(rename__done, client->transfer_id, request.filename, client->bytes);
+                if (integrity_write_sidecar(&integrity, request.filename, client->crc32c, client->bytes) != 0) {
+                    perror("Erreur lors de l'écriture de l'empreinte CRC32C");
                 }
             }
-
-            // Renommer le fichier temporaire en cas de succès
-            if (rename(temp_file, request.filename) != 0) {
-                perror("Erreur lors du renommage du fichier temporaire");
+            negcache_invalidate(&negCache, request.filename);
+        } else if (client->staged != NULL && staged_upload_renamed(client->staged)) {
+            // Validation interrompue après le renommage : la cible est déjà remplacée, le fichier temporaire n'existe plus
+            if (integrity_write_sidecar(&integrity, request.filename, client->crc32c, client->bytes) != 0) {
+                perror("Erreur lors de l'écriture de l'empreinte CRC32C");
             }
-        } else if (status != 0 ) {
+            negcache_invalidate(&negCache, request.filename);
+        } else if (client->staged == NULL || staged_upload_spilled(client->staged)) {
             // Supprimer le fichier temporaire en cas d'échec
-            if (remove(temp_file) != 0) {
+            if (fsroot_unlink(&servingRoot, temp_file) != 0) {
                 perror("Erreur lors de la suppression du fichier temporaire");
             }
         }
@@ -234,9 +714,8 @@ void *handleClient(void *arg) {
 
     // printf("client fd %d termine\n",client->socket_fd);
     SYNC_END(request.filename,&fileList);    // Fin de la synchronisation pour le fichier demandé
-    supprimer_client(&clientsList,client);   // Suppression du client de la liste des clients connectés
-
-    pthread_exit(NULL);
+    terminer_transfert(client);
+    return NULL;
 
      
 }
@@ -0,0 +1,281 @@
+/**
+ * @file mkbundle.c
+ * @brief Construction d'un paquet d'images (voir bundle.h) à partir d'un répertoire : chaque fichier ordinaire
+ *        de l'arborescence est ajouté sous son chemin relatif (forme normalisée des requêtes, « a/b »).
+ *        Le paquet est écrit dans « <paquet>.new », synchronisé, puis renommé : un serveur en cours d'exécution
+ *        le prend en compte sur SIGHUP (kill -HUP), sans jamais voir un paquet incomplet.
+ *
+ *        Usage : ./mkbundle [-v] répertoire paquet
+ */
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <inttypes.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "bundle.h"
+
+
+/**
+ * @struct SourceFile
+ * @brief Fichier à ajouter au paquet.
+ */
+typedef struct SourceFile {
+    char* name;                 /* Chemin relatif au répertoire source */
+    uint64_t size;              /* Taille au moment du parcours */
+} SourceFile;
+
+
+static SourceFile* files;       /* Fichiers trouvés par le parcours (nftw n'a pas de paramètre utilisateur) */
+static size_t file_count;
+static size_t file_capacity;
+static size_t prefix_len;       /* Longueur du répertoire source suivi de '/' */
+static struct stat skipped[2];  /* Paquet existant et paquet en cours d'écriture (s'ils sont dans l'arborescence) */
+static bool verbose;
+
+
+
+
+/**
+ * Fonction : print_usage
+ * Description : Cette fonction affiche l'aide de la ligne de commande.
+ * @param prog : Le nom du programme.
+ * @return : Aucune valeur de retour
+ */
+static void print_usage(const char* prog) {
+    fprintf(stderr,
+        "Usage : %s [-v] répertoire paquet\n"
+        "  Regroupe les fichiers du répertoire dans un paquet d'images (option -B du serveur).\n"
+        "  -v   Affiche chaque fichier ajouté\n",
+        prog);
+}
+
+
+
+
+/**
+ * Fonction : collect_file
+ * Description : Fonction appelée par nftw pour chaque entrée de l'arborescence : les fichiers ordinaires sont retenus.
+ * @return : 0 pour continuer le parcours, -1 en cas d'erreur.
+ */
+static int collect_file(const char* path, const struct stat* st, int type, struct FTW* ftw) {
+    (void) ftw;
+    if (type != FTW_F || !S_ISREG(st->st_mode)) {
+        return 0;
+    }
+    for (int i = 0; i < 2; i++) {
+        if (skipped[i].st_ino == st->st_ino && skipped[i].st_dev == st->st_dev) {
+            return 0;
+        }
+    }
+    if (file_count == file_capacity) {
+        file_capacity = file_capacity == 0 ? 1024 : file_capacity * 2;
+        SourceFile* grown = (SourceFile*) realloc(files, file_capacity * sizeof(SourceFile));
+        if (grown == NULL) {
+            return -1;
+        }
+        files = grown;
+    }
+    files[file_count].name = strdup(path + prefix_len);
+    files[file_count].size = (uint64_t) st->st_size;
+    if (files[file_count].name == NULL) {
+        return -1;
+    }
+    file_count++;
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : compare_files
+ * Description : Fonction de comparaison de qsort : ordre de strcmp, celui de la recherche du serveur.
+ */
+static int compare_files(const void* a, const void* b) {
+    return strcmp(((const SourceFile*) a)->name, ((const SourceFile*) b)->name);
+}
+
+
+
+
+/**
+ * Fonction : write_all
+ * Description : Cette fonction écrit un tampon en entier.
+ * @return : 0 en cas de succès, -1 en cas d'erreur.
+ */
+static int write_all(int fd, const void* buffer, size_t len) {
+    const char* p = (const char*) buffer;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        p += n;
+        len -= (size_t) n;
+    }
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : copy_file
+ * Description : Cette fonction ajoute le contenu d'un fichier au paquet ; le fichier ne doit pas avoir changé
+ *               de taille depuis le parcours (l'index est déjà écrit).
+ * @param dirfd : Le répertoire source.
+ * @param file : Le fichier.
+ * @param out : Le paquet en cours d'écriture.
+ * @return : 0 en cas de succès, -1 en cas d'erreur.
+ */
+static int copy_file(int dirfd, const SourceFile* file, int out) {
+    int fd = openat(dirfd, file->name, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "Erreur : %s : %s\n", file->name, strerror(errno));
+        return -1;
+    }
+    char buffer[65536];
+    uint64_t copied = 0;
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof(buffer))) > 0 && copied + (uint64_t) n <= file->size) {
+        if (write_all(out, buffer, (size_t) n) < 0) {
+            close(fd);
+            return -1;
+        }
+        copied += (uint64_t) n;
+    }
+    close(fd);
+    if (n != 0 || copied != file->size) {
+        fprintf(stderr, "Erreur : %s modifié pendant la construction du paquet\n", file->name);
+        return -1;
+    }
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : main
+ * Description : Parcourt le répertoire, écrit l'en-tête, l'index, les noms puis les contenus, et renomme le paquet.
+ */
+int main(int argc, char* argv[]) {
+    int opt;
+    while ((opt = getopt(argc, argv, "vh")) != -1) {
+        switch (opt) {
+            case 'v': verbose = true; break;
+            default:
+                print_usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind != argc - 2) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    const char* source = argv[optind];
+    const char* output = argv[optind + 1];
+
+    char temp[PATH_MAX];
+    if (snprintf(temp, sizeof(temp), "%s.new", output) >= (int) sizeof(temp)) {
+        fprintf(stderr, "Erreur : nom de paquet trop long\n");
+        return 1;
+    }
+    int out = open(temp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (out < 0) {
+        fprintf(stderr, "Erreur : %s : %s\n", temp, strerror(errno));
+        return 1;
+    }
+    fstat(out, &skipped[0]);
+    if (stat(output, &skipped[1]) < 0) {
+        skipped[1] = skipped[0];
+    }
+
+    size_t source_len = strlen(source);
+    while (source_len > 1 && source[source_len - 1] == '/') {
+        source_len--;
+    }
+    prefix_len = source_len + 1;
+    int dirfd = open(source, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd < 0 || nftw(source, collect_file, 64, FTW_PHYS) != 0) {
+        fprintf(stderr, "Erreur lors du parcours de %s : %s\n", source, strerror(errno));
+        unlink(temp);
+        return 1;
+    }
+    if (file_count > UINT32_MAX) {
+        fprintf(stderr, "Erreur : trop de fichiers\n");
+        unlink(temp);
+        return 1;
+    }
+    qsort(files, file_count, sizeof(SourceFile), compare_files);
+
+    // Index et noms construits en mémoire : les positions des contenus sont connues avant leur écriture
+    uint64_t names_size = 0;
+    for (size_t i = 0; i < file_count; i++) {
+        names_size += strlen(files[i].name) + 1;
+    }
+    if (names_size > UINT32_MAX) {
+        fprintf(stderr, "Erreur : table des noms trop grande\n");
+        unlink(temp);
+        return 1;
+    }
+    BundleEntry* entries = (BundleEntry*) calloc(file_count + 1, sizeof(BundleEntry));
+    char* names = (char*) malloc(names_size + 1);
+    if (entries == NULL || names == NULL) {
+        perror("Erreur d'allocation");
+        unlink(temp);
+        return 1;
+    }
+    uint64_t offset = sizeof(BundleHeader) + file_count * sizeof(BundleEntry) + names_size;
+    uint32_t name_offset = 0;
+    for (size_t i = 0; i < file_count; i++) {
+        size_t len = strlen(files[i].name);
+        memcpy(names + name_offset, files[i].name, len + 1);
+        entries[i].offset = offset;
+        entries[i].size = files[i].size;
+        entries[i].name_offset = name_offset;
+        entries[i].name_len = (uint32_t) len;
+        name_offset += (uint32_t) len + 1;
+        offset += files[i].size;
+    }
+
+    BundleHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BUNDLE_MAGIC, sizeof(header.magic));
+    header.count = (uint32_t) file_count;
+    header.names_size = names_size;
+    header.total_size = offset;
+
+    int ret = write_all(out, &header, sizeof(header)) < 0 || write_all(out, entries, file_count * sizeof(BundleEntry)) < 0
+        || write_all(out, names, names_size) < 0 ? -1 : 0;
+    for (size_t i = 0; ret == 0 && i < file_count; i++) {
+        ret = copy_file(dirfd, &files[i], out);
+        if (ret == 0 && verbose) {
+            printf("%s (%" PRIu64 " octets)\n", files[i].name, files[i].size);
+        }
+    }
+    if (ret == 0 && (fsync(out) < 0 || close(out) < 0 || rename(temp, output) < 0)) {
+        ret = -1;
+    }
+    if (ret < 0) {
+        fprintf(stderr, "Erreur lors de l'écriture du paquet %s : %s\n", output, strerror(errno));
+        unlink(temp);
+        return 1;
+    }
+    printf("Paquet %s : %zu fichiers, %.1f Mo\n", output, file_count, offset / 1048576.0);
+    return 0;
+}
@@ -0,0 +1,466 @@
+/**
+ * @file negcache.c
+ * @brief Implémentation du cache des recherches négatives.
+ *        Un fichier absent n'est mis en cache que si son répertoire parent et chacun de ses ancêtres peuvent être
+ *        surveillés par inotify : toute création ou tout renommage vers ce nom, et tout déplacement ou suppression
+ *        d'un répertoire du chemin, invalide l'entrée avant la recherche suivante. Les événements sont rattachés
+ *        à leur répertoire par le descripteur inotify, sans parcourir le cache.
+ */
+
+
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+#include "negcache.h"
+
+#define NEGCACHE_WATCH_MASK (IN_CREATE | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+
+
+
+/**
+ * Fonction : hash_filename
+ * Description : Cette fonction calcule l'alvéole d'un nom de fichier (FNV-1a).
+ * @param filename : Le nom du fichier.
+ * @return : L'indice de l'alvéole.
+ */
+static uint32_t hash_filename(const char* filename) {
+    uint32_t h = 2166136261u;
+    for (const unsigned char* p = (const unsigned char*) filename; *p; p++) {
+        h ^= *p;
+        h *= 16777619u;
+    }
+    return h & (NEGCACHE_BUCKETS - 1);
+}
+
+
+
+
+/**
+ * Fonction : find_entry
+ * Description : Cette fonction recherche l'entrée d'un nom de fichier (mutex déjà verrouillé).
+ * @param nc : Un pointeur vers le cache.
+ * @param filename : Le nom du fichier.
+ * @return : L'indice de l'entrée, ou -1 si elle n'existe pas.
+ */
+static int find_entry(NegativeCache* nc, const char* filename) {
+    for (int i = nc->buckets[hash_filename(filename)]; i != -1; i = nc->entries[i].next) {
+        if (strcmp(nc->entries[i].filename, filename) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+
+
+/**
+ * Fonction : find_watch
+ * Description : Cette fonction recherche la surveillance d'un descripteur inotify (mutex déjà verrouillé).
+ * @param nc : Un pointeur vers le cache.
+ * @param wd : Le descripteur inotify.
+ * @return : L'indice de la surveillance, ou -1 si ce descripteur n'est pas (ou plus) suivi.
+ */
+static int find_watch(NegativeCache* nc, int wd) {
+    for (int i = nc->watch_buckets[wd & (NEGCACHE_BUCKETS - 1)]; i != -1; i = nc->watches[i].next) {
+        if (nc->watches[i].wd == wd) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+
+
+/**
+ * Fonction : release_watch
+ * Description : Cette fonction rend une référence sur une surveillance (mutex déjà verrouillé). Une surveillance
+ *               qui n'a plus de référence est retirée d'inotify, puis rend la référence qu'elle tenait sur son parent.
+ * @param nc : Un pointeur vers le cache.
+ * @param index : L'indice de la surveillance.
+ * @return : Aucune valeur de retour
+ */
+static void release_watch(NegativeCache* nc, int index) {
+    while (index != -1 && --nc->watches[index].refs == 0) {
+        NegWatch* watch = &nc->watches[index];
+        inotify_rm_watch(nc->inotify_fd, watch->wd);    // EINVAL si le noyau l'a déjà retirée (IN_IGNORED)
+        int* link = &nc->watch_buckets[watch->wd & (NEGCACHE_BUCKETS - 1)];
+        while (*link != index) {
+            link = &nc->watches[*link].next;
+        }
+        *link = watch->next;
+        int parent = watch->parent;
+        watch->wd = -1;
+        watch->next = nc->free_watch;
+        nc->free_watch = index;
+        nc->watch_count--;
+        index = parent;
+    }
+}
+
+
+
+
+/**
+ * Fonction : remove_entry
+ * Description : Cette fonction retire une entrée de son alvéole et de son répertoire, et la libère (mutex déjà verrouillé).
+ * @param nc : Un pointeur vers le cache.
+ * @param index : L'indice de l'entrée à retirer.
+ * @return : Aucune valeur de retour
+ */
+static void remove_entry(NegativeCache* nc, int index) {
+    NegEntry* entry = &nc->entries[index];
+    int* link = &nc->buckets[hash_filename(entry->filename)];
+    while (*link != -1 && *link != index) {
+        link = &nc->entries[*link].next;
+    }
+    if (*link == index) {
+        *link = entry->next;
+    }
+
+    if (entry->watch_prev != -1) {
+        nc->entries[entry->watch_prev].watch_next = entry->watch_next;
+    } else {
+        nc->watches[entry->watch].entries = entry->watch_next;
+    }
+    if (entry->watch_next != -1) {
+        nc->entries[entry->watch_next].watch_prev = entry->watch_prev;
+    }
+    release_watch(nc, entry->watch);
+
+    entry->used = false;
+    nc->count--;
+}
+
+
+
+
+/**
+ * Fonction : take_slot
+ * Description : Cette fonction choisit l'entrée à remplacer (FIFO) et la libère si elle est utilisée (mutex déjà verrouillé).
+ * @param nc : Un pointeur vers le cache.
+ * @return : L'indice de l'entrée libre.
+ */
+static int take_slot(NegativeCache* nc) {
+    int index = nc->next_slot;
+    nc->next_slot = (nc->next_slot + 1) % nc->capacity;
+    if (nc->entries[index].used) {
+        remove_entry(nc, index);
+        nc->evictions++;
+    }
+    return index;
+}
+
+
+
+
+/**
+ * Fonction : acquire_watch
+ * Description : Cette fonction place un répertoire sous surveillance et prend une référence sur sa surveillance
+ *               (mutex déjà verrouillé). Faute de surveillance libre, les entrées les plus anciennes sont remplacées.
+ * @param nc : Un pointeur vers le cache.
+ * @param directory : Le chemin du répertoire.
+ * @param parent : La surveillance du répertoire parent, dont l'appelant tient une référence (-1 pour la racine du chemin).
+ * @return : L'indice de la surveillance, ou -1 si le répertoire ne peut pas être surveillé.
+ */
+static int acquire_watch(NegativeCache* nc, const char* directory, int parent) {
+    int wd = inotify_add_watch(nc->inotify_fd, directory, NEGCACHE_WATCH_MASK);
+    if (wd < 0) {
+        return -1;
+    }
+    int index = find_watch(nc, wd);
+    if (index == -1) {
+        while (nc->free_watch == -1 && nc->count > 0) {
+            take_slot(nc);
+        }
+        if (nc->free_watch == -1) {
+            inotify_rm_watch(nc->inotify_fd, wd);
+            return -1;
+        }
+        index = nc->free_watch;
+        NegWatch* watch = &nc->watches[index];
+        nc->free_watch = watch->next;
+        watch->wd = wd;
+        watch->parent = parent;
+        watch->refs = 0;
+        watch->entries = -1;
+        watch->next = nc->watch_buckets[wd & (NEGCACHE_BUCKETS - 1)];
+        nc->watch_buckets[wd & (NEGCACHE_BUCKETS - 1)] = index;
+        nc->watch_count++;
+        if (parent != -1) {
+            nc->watches[parent].refs++;
+        }
+    }
+    nc->watches[index].refs++;
+    return index;
+}
+
+
+
+
+/**
+ * Fonction : invalidate_subtree
+ * Description : Cette fonction supprime les entrées d'un répertoire déplacé ou supprimé et de tous ses sous-répertoires
+ *               (mutex déjà verrouillé). Ces événements sont rares : les surveillances sont parcourues.
+ * @param nc : Un pointeur vers le cache.
+ * @param index : La surveillance du répertoire.
+ * @return : Aucune valeur de retour
+ */
+static void invalidate_subtree(NegativeCache* nc, int index) {
+    for (int i = 0; i < nc->capacity; i++) {
+        int ancestor = nc->watches[i].wd != -1 ? i : -1;
+        while (ancestor != -1 && ancestor != index) {
+            ancestor = nc->watches[ancestor].parent;
+        }
+        while (ancestor != -1 && nc->watches[i].wd != -1 && nc->watches[i].entries != -1) {
+            remove_entry(nc, nc->watches[i].entries);  // Peut libérer cette surveillance et ses ancêtres inutilisés
+            nc->invalidations++;
+        }
+    }
+}
+
+
+
+
+/**
+ * Fonction : process_events
+ * Description : Cette fonction lit les événements inotify en attente et supprime les entrées concernées
+ *               (mutex déjà verrouillé). En cas de débordement de la file d'événements, tout le cache est vidé.
+ * @param nc : Un pointeur vers le cache.
+ * @return : Aucune valeur de retour
+ */
+static void process_events(NegativeCache* nc) {
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    while (1) {
+        ssize_t len = read(nc->inotify_fd, buffer, sizeof(buffer));
+        if (len <= 0) {
+            return;     // EAGAIN : plus d'événement en attente
+        }
+
+        for (char* ptr = buffer; ptr < buffer + len; ptr += sizeof(struct inotify_event) + ((struct inotify_event*) ptr)->len) {
+            const struct inotify_event* event = (const struct inotify_event*) ptr;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                for (int i = 0; i < nc->capacity; i++) {
+                    if (nc->entries[i].used) {
+                        remove_entry(nc, i);
+                        nc->invalidations++;
+                    }
+                }
+                continue;
+            }
+            int watch = find_watch(nc, event->wd);
+            if (watch == -1) {
+                continue;   // Surveillance déjà retirée
+            }
+            if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                invalidate_subtree(nc, watch);  // Les chemins du répertoire ne désignent plus ses fichiers
+            } else if (event->len > 0 && nc->watches[watch].entries != -1) {
+                // Nom créé dans le répertoire : même préfixe que n'importe quelle entrée de ce répertoire
+                const NegEntry* sibling = &nc->entries[nc->watches[watch].entries];
+                size_t prefix = sibling->basename - sibling->filename;
+                char filename[NEGCACHE_MAX_FILENAME];
+                if (prefix + strlen(event->name) < sizeof(filename)) {
+                    memcpy(filename, sibling->filename, prefix);
+                    strcpy(filename + prefix, event->name);
+                    int index = find_entry(nc, filename);
+                    if (index != -1) {
+                        remove_entry(nc, index);
+                        nc->invalidations++;
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+
+
+/**
+ * Fonction : negcache_init
+ * Description : Cette fonction initialise le cache des recherches négatives.
+ * @param nc : Un pointeur vers le cache.
+ * @param capacity : Le nombre maximum d'entrées (0 = cache désactivé).
+ * @return : 0 en cas de succès, -1 en cas d'échec.
+ */
+int negcache_init(NegativeCache* nc, int capacity) {
+    memset(nc, 0, sizeof(*nc));
+    nc->inotify_fd = -1;
+    for (int i = 0; i < NEGCACHE_BUCKETS; i++) {
+        nc->buckets[i] = -1;
+    }
+    pthread_mutex_init(&nc->mutex, NULL);
+    if (capacity <= 0) {
+        return 0;
+    }
+
+    nc->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (nc->inotify_fd < 0) {
+        perror("Erreur lors de l'initialisation d'inotify, cache négatif désactivé");
+        return -1;
+    }
+    nc->entries = (NegEntry*)calloc(capacity, sizeof(NegEntry));
+    nc->watches = (NegWatch*)calloc(capacity, sizeof(NegWatch));
+    if (nc->entries == NULL || nc->watches == NULL) {
+        free(nc->entries);
+        free(nc->watches);
+        nc->entries = NULL;
+        nc->watches = NULL;
+        close(nc->inotify_fd);
+        nc->inotify_fd = -1;
+        return -1;
+    }
+    for (int i = 0; i < NEGCACHE_BUCKETS; i++) {
+        nc->watch_buckets[i] = -1;
+    }
+    for (int i = 0; i < capacity; i++) {
+        nc->watches[i].wd = -1;
+        nc->watches[i].next = i + 1 < capacity ? i + 1 : -1;
+    }
+    nc->free_watch = 0;
+    nc->capacity = capacity;
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : negcache_lookup
+ * Description : Cette fonction indique si un fichier est connu comme inexistant.
+ *               Les événements inotify en attente sont appliqués avant la recherche.
+ * @param nc : Un pointeur vers le cache.
+ * @param filename : Le nom du fichier demandé.
+ * @return : true si le fichier est connu comme inexistant, false sinon.
+ */
+bool negcache_lookup(NegativeCache* nc, const char* filename) {
+    if (nc->capacity == 0) {
+        return false;
+    }
+    pthread_mutex_lock(&nc->mutex);
+    process_events(nc);
+    bool found = find_entry(nc, filename) != -1;
+    if (found) {
+        nc->hits++;
+    }
+    pthread_mutex_unlock(&nc->mutex);
+    return found;
+}
+
+
+
+
+/**
+ * Fonction : negcache_insert
+ * Description : Cette fonction enregistre un fichier inexistant. Le répertoire parent et ses ancêtres sont d'abord
+ *               placés sous surveillance, puis l'absence du fichier est vérifiée à nouveau : une création intervenue
+ *               entre-temps est ainsi soit vue par cette vérification, soit signalée par inotify.
+ * @param nc : Un pointeur vers le cache.
+ * @param filename : Le nom du fichier inexistant.
+ * @return : Aucune valeur de retour
+ */
+void negcache_insert(NegativeCache* nc, const char* filename) {
+    size_t len = strlen(filename);
+    if (nc->capacity == 0 || len == 0 || len >= NEGCACHE_MAX_FILENAME) {
+        return;
+    }
+
+    pthread_mutex_lock(&nc->mutex);
+    process_events(nc);
+    if (find_entry(nc, filename) != -1) {
+        pthread_mutex_unlock(&nc->mutex);
+        return;
+    }
+
+    // Surveillance de chaque répertoire du chemin, de la racine au parent (une référence tenue sur le dernier)
+    char directory[NEGCACHE_MAX_FILENAME];
+    strcpy(directory, filename[0] == '/' ? "/" : ".");
+    int watch = acquire_watch(nc, directory, -1);
+    const char* slash = NULL;
+    for (const char* p = strchr(filename + 1, '/'); watch != -1 && p != NULL; p = strchr(p + 1, '/')) {
+        memcpy(directory, filename, p - filename);
+        directory[p - filename] = '\0';
+        int child = acquire_watch(nc, directory, watch);
+        release_watch(nc, watch);
+        watch = child;
+        slash = p;
+    }
+    if (filename[0] == '/' && slash == NULL) {
+        slash = filename;
+    }
+    if (watch == -1 || access(filename, F_OK) == 0) {  // Répertoire non surveillable, ou fichier créé entre-temps
+        release_watch(nc, watch);
+        pthread_mutex_unlock(&nc->mutex);
+        return;
+    }
+
+    int index = take_slot(nc);
+    NegEntry* entry = &nc->entries[index];
+    memcpy(entry->filename, filename, len + 1);
+    entry->basename = slash == NULL ? entry->filename : entry->filename + (slash - filename) + 1;
+    entry->watch = watch;       // La référence prise sur la surveillance revient à l'entrée
+    entry->watch_prev = -1;
+    entry->watch_next = nc->watches[watch].entries;
+    if (entry->watch_next != -1) {
+        nc->entries[entry->watch_next].watch_prev = index;
+    }
+    nc->watches[watch].entries = index;
+    entry->used = true;
+    uint32_t bucket = hash_filename(filename);
+    entry->next = nc->buckets[bucket];
+    nc->buckets[bucket] = index;
+    nc->count++;
+    nc->inserts++;
+
+    pthread_mutex_unlock(&nc->mutex);
+}
+
+
+
+
+/**
+ * Fonction : negcache_invalidate
+ * Description : Cette fonction supprime un fichier du cache (par exemple après l'écriture d'un fichier par WRQ).
+ * @param nc : Un pointeur vers le cache.
+ * @param filename : Le nom du fichier.
+ * @return : Aucune valeur de retour
+ */
+void negcache_invalidate(NegativeCache* nc, const char* filename) {
+    if (nc->capacity == 0) {
+        return;
+    }
+    pthread_mutex_lock(&nc->mutex);
+    int index = find_entry(nc, filename);
+    if (index != -1) {
+        remove_entry(nc, index);
+        nc->invalidations++;
+    }
+    pthread_mutex_unlock(&nc->mutex);
+}
+
+
+
+
+/**
+ * Fonction : negcache_report
+ * Description : Cette fonction affiche les compteurs du cache des recherches négatives.
+ * @param nc : Un pointeur vers le cache.
+ * @param out : Le flux de sortie.
+ * @return : Aucune valeur de retour
+ */
+void negcache_report(NegativeCache* nc, FILE* out) {
+    if (nc->capacity == 0) {
+        return;
+    }
+    pthread_mutex_lock(&nc->mutex);
+    fprintf(out, "[NEGCACHE] entrées %d/%d | répertoires surveillés %d | réponses directes %lu | insertions %lu | invalidations %lu | évictions %lu\n",
+            nc->count, nc->capacity, nc->watch_count, nc->hits, nc->inserts, nc->invalidations, nc->evictions);
+    pthread_mutex_unlock(&nc->mutex);
+}
@@ -0,0 +1,85 @@
+/**
+ * @file negcache.h
+ * @brief Cache des fichiers inexistants (recherches négatives), invalidé par inotify.
+ */
+
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifndef NEGCACHE_H
+#define NEGCACHE_H
+
+#define NEGCACHE_BUCKETS 1024           /* Nombre d'alvéoles de la table de hachage (puissance de 2) */
+#define NEGCACHE_MAX_FILENAME 512
+
+
+/**
+ * @struct NegEntry
+ * @brief Nom de fichier connu comme inexistant.
+ */
+typedef struct NegEntry {
+    char filename[NEGCACHE_MAX_FILENAME];
+    const char* basename;       /* Dernier composant du chemin (pointe dans filename) */
+    int watch;                  /* Surveillance du répertoire parent */
+    int watch_prev;             /* Entrées voisines de même répertoire parent (-1 = fin) */
+    int watch_next;
+    int next;                   /* Entrée suivante dans l'alvéole (-1 = fin) */
+    bool used;
+} NegEntry;
+
+
+
+
+/**
+ * @struct NegWatch
+ * @brief Répertoire surveillé par inotify : parent d'entrées du cache ou ancêtre d'un tel répertoire.
+ *        Il est retiré d'inotify dès que plus aucune entrée n'en dépend.
+ */
+typedef struct NegWatch {
+    int wd;                     /* Descripteur inotify (-1 = surveillance libre) */
+    int parent;                 /* Surveillance du répertoire parent (-1 pour la racine du chemin) */
+    int refs;                   /* Entrées de ce répertoire et surveillances de ses sous-répertoires */
+    int entries;                /* Première entrée de ce répertoire (-1 = aucune) */
+    int next;                   /* Surveillance suivante de même alvéole, ou surveillance libre suivante */
+} NegWatch;
+
+
+
+
+/**
+ * @struct NegativeCache
+ * @brief Table de hachage bornée des fichiers inexistants. Les entrées sont remplacées en FIFO
+ *        lorsque la table est pleine, et supprimées dès qu'inotify signale une création dans leur répertoire,
+ *        ou le déplacement ou la suppression de ce répertoire ou de l'un de ses ancêtres.
+ */
+typedef struct NegativeCache {
+    int capacity;               /* Nombre maximum d'entrées (0 = cache désactivé) */
+    NegEntry* entries;
+    int buckets[NEGCACHE_BUCKETS];
+    int next_slot;              /* Prochaine entrée à remplacer (FIFO) */
+    int count;
+    NegWatch* watches;          /* capacity surveillances */
+    int watch_buckets[NEGCACHE_BUCKETS];    /* Surveillances indexées par descripteur inotify */
+    int free_watch;             /* Première surveillance libre (-1 = aucune) */
+    int watch_count;
+    int inotify_fd;
+    pthread_mutex_t mutex;
+
+    unsigned long hits;
+    unsigned long inserts;
+    unsigned long invalidations;
+    unsigned long evictions;
+} NegativeCache;
+
+
+
+int negcache_init(NegativeCache* nc, int capacity);
+bool negcache_lookup(NegativeCache* nc, const char* filename);
+void negcache_insert(NegativeCache* nc, const char* filename);
+void negcache_invalidate(NegativeCache* nc, const char* filename);
+void negcache_report(NegativeCache* nc, FILE* out);
+
+#endif
@@ -0,0 +1,1163 @@
+/**
+ * @file peer.c
+ * @brief Implémentation du mode pair : anneau de hachage cohérent, cache mémoire de l'instance propriétaire
+ *        et canal TCP entre instances. Le thread d'écoute du canal crée un thread par connexion acceptée
+ *        (adresse d'une instance de la liste, PEER_MAX_CONNECTIONS au plus).
+ *        Les flux ouverts sur un fichier du cache (fopencookie) gardent une référence sur son entrée :
+ *        une éviction ne libère le contenu qu'à la fermeture du dernier flux.
+ */
+
+
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+#include "peer.h"
+#include "tftp.h"
+
+
+/**
+ * @struct PeerReader
+ * @brief Flux de lecture d'un fichier du cache mémoire.
+ */
+typedef struct PeerReader {
+    PeerGroup* group;
+    PeerEntry* entry;
+    uint64_t offset;
+} PeerReader;
+
+
+
+
+/**
+ * @struct PeerStream
+ * @brief Flux de lecture d'un fichier reçu de l'instance propriétaire, lu sur le canal au fur et à mesure.
+ */
+typedef struct PeerStream {
+    PeerGroup* group;
+    int fd;
+    uint64_t remaining;
+    uint64_t received;
+} PeerStream;
+
+
+
+
+/**
+ * @struct PeerConnection
+ * @brief Connexion d'un pair, confiée à un thread.
+ */
+typedef struct PeerConnection {
+    PeerGroup* group;
+    int fd;
+} PeerConnection;
+
+
+
+
+/**
+ * Fonction : now_us
+ * Description : Cette fonction donne l'horloge monotone en microsecondes.
+ * @return : L'instant courant.
+ */
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000ULL + (uint64_t) ts.tv_nsec / 1000;
+}
+
+
+
+
+/**
+ * Fonction : hash_key
+ * Description : Cette fonction calcule le hachage d'un nom de fichier ou d'un point de l'anneau
+ *               (FNV-1a suivi du mélange final de MurmurHash3 : les noms voisins sont bien répartis sur l'anneau).
+ * @param key : La chaîne à hacher.
+ * @return : Le hachage sur 64 bits.
+ */
+static uint64_t hash_key(const char* key) {
+    uint64_t h = 14695981039346656037ULL;
+    for (; *key != '\0'; key++) {
+        h ^= (unsigned char) *key;
+        h *= 1099511628211ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+
+
+
+/**
+ * Fonction : parse_address
+ * Description : Cette fonction résout une adresse « hôte:port » (IPv4).
+ * @param spec : L'adresse.
+ * @param addr : Un pointeur qui reçoit l'adresse résolue.
+ * @return : 0 en cas de succès, -1 en cas d'erreur (errno positionné).
+ */
+static int parse_address(const char* spec, struct sockaddr_in* addr) {
+    char host[64];
+    if (strlen(spec) >= sizeof(host)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(host, spec);
+    char* colon = strrchr(host, ':');
+    if (colon == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    char* end;
+    *colon = '\0';
+    long port = strtol(colon + 1, &end, 10);
+    if (colon[1] == '\0' || *end != '\0' || port <= 0 || port > 65535) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    struct addrinfo hints;
+    struct addrinfo* result;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, NULL, &hints, &result) != 0) {
+        errno = EHOSTUNREACH;
+        return -1;
+    }
+    memcpy(addr, result->ai_addr, sizeof(*addr));
+    addr->sin_port = htons((uint16_t) port);
+    freeaddrinfo(result);
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : compare_points
+ * Description : Fonction de comparaison de qsort : ordre des points sur l'anneau.
+ */
+static int compare_points(const void* a, const void* b) {
+    const PeerPoint* pa = (const PeerPoint*) a;
+    const PeerPoint* pb = (const PeerPoint*) b;
+    if (pa->hash != pb->hash) {
+        return pa->hash < pb->hash ? -1 : 1;
+    }
+    return pa->node - pb->node;
+}
+
+
+
+
+/**
+ * Fonction : owner_of
+ * Description : Cette fonction donne l'instance propriétaire d'un fichier : le premier point de l'anneau
+ *               qui suit le hachage de son nom.
+ * @param group : Le groupe d'instances.
+ * @param filename : Le nom normalisé du fichier.
+ * @return : L'indice de l'instance propriétaire.
+ */
+static int owner_of(const PeerGroup* group, const char* filename) {
+    uint64_t h = hash_key(filename);
+    int low = 0;
+    int high = group->ring_size;
+    while (low < high) {
+        int middle = low + (high - low) / 2;
+        if (group->ring[middle].hash < h) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return group->ring[low == group->ring_size ? 0 : low].node;
+}
+
+
+
+
+/**
+ * Fonction : read_all
+ * Description : Cette fonction lit exactement len octets sur le canal.
+ * @return : 0 en cas de succès, -1 en cas d'erreur ou de fermeture prématurée.
+ */
+static int read_all(int fd, void* buffer, size_t len) {
+    char* p = (char*) buffer;
+    while (len > 0) {
+        ssize_t n = recv(fd, p, len, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            if (n == 0) {
+                errno = EIO;
+            }
+            return -1;
+        }
+        p += n;
+        len -= (size_t) n;
+    }
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : send_all
+ * Description : Cette fonction écrit un tampon en entier sur le canal (sans SIGPIPE si le pair a fermé).
+ * @return : 0 en cas de succès, -1 en cas d'erreur.
+ */
+static int send_all(int fd, const void* buffer, size_t len) {
+    const char* p = (const char*) buffer;
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        p += n;
+        len -= (size_t) n;
+    }
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : set_timeouts
+ * Description : Cette fonction borne la durée des lectures et écritures sur un socket du canal.
+ * @param fd : Le socket du canal.
+ * @param send_timeout_ms : La durée maximale d'une écriture (millisecondes).
+ * @return : Aucune valeur de retour
+ */
+static void set_timeouts(int fd, int send_timeout_ms) {
+    struct timeval tv = { PEER_IO_TIMEOUT_MS / 1000, (PEER_IO_TIMEOUT_MS % 1000) * 1000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    tv.tv_sec = send_timeout_ms / 1000;
+    tv.tv_usec = (send_timeout_ms % 1000) * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+
+
+
+/**
+ * Fonction : same_file
+ * Description : Cette fonction vérifie qu'une entrée du cache correspond toujours au fichier ouvert.
+ * @return : true si le contenu en cache peut être servi.
+ */
+static bool same_file(const PeerEntry* entry, const struct stat* st) {
+    return entry->dev == st->st_dev && entry->ino == st->st_ino && entry->size == (uint64_t) st->st_size
+        && entry->mtime.tv_sec == st->st_mtim.tv_sec && entry->mtime.tv_nsec == st->st_mtim.tv_nsec
+        && entry->ctime.tv_sec == st->st_ctim.tv_sec && entry->ctime.tv_nsec == st->st_ctim.tv_nsec;
+}
+
+
+
+
+/**
+ * Fonction : bucket_of
+ * Description : Cette fonction donne l'alvéole de la table de hachage d'un nom de fichier.
+ */
+static uint32_t bucket_of(const char* filename) {
+    return (uint32_t) hash_key(filename) & (PEER_BUCKETS - 1);
+}
+
+
+
+
+/**
+ * Fonction : cache_find
+ * Description : Cette fonction cherche un fichier dans le cache (mutex du groupe pris).
+ * @return : L'entrée du fichier (éventuellement en cours de lecture), ou NULL.
+ */
+static PeerEntry* cache_find(PeerGroup* group, const char* filename) {
+    for (PeerEntry* entry = group->buckets[bucket_of(filename)]; entry != NULL; entry = entry->next) {
+        if (strcmp(entry->filename, filename) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+
+
+
+/**
+ * Fonction : entry_release_locked
+ * Description : Cette fonction rend une référence sur une entrée (mutex du groupe pris) ; le dernier
+ *               utilisateur libère le contenu.
+ * @return : Aucune valeur de retour
+ */
+static void entry_release_locked(PeerEntry* entry) {
+    if (--entry->refs == 0) {
+        free(entry->data);
+        free(entry);
+    }
+}
+
+
+
+
+/**
+ * Fonction : entry_release
+ * Description : Cette fonction rend une référence sur une entrée du cache.
+ * @return : Aucune valeur de retour
+ */
+static void entry_release(PeerGroup* group, PeerEntry* entry) {
+    pthread_mutex_lock(&group->mutex);
+    entry_release_locked(entry);
+    pthread_mutex_unlock(&group->mutex);
+}
+
+
+
+
+/**
+ * Fonction : lru_unlink
+ * Description : Cette fonction retire une entrée de la liste LRU (mutex du groupe pris).
+ * @return : Aucune valeur de retour
+ */
+static void lru_unlink(PeerGroup* group, PeerEntry* entry) {
+    if (entry->newer != NULL) {
+        entry->newer->older = entry->older;
+    } else {
+        group->newest = entry->older;
+    }
+    if (entry->older != NULL) {
+        entry->older->newer = entry->newer;
+    } else {
+        group->oldest = entry->newer;
+    }
+    entry->newer = NULL;
+    entry->older = NULL;
+}
+
+
+
+
+/**
+ * Fonction : lru_push
+ * Description : Cette fonction place une entrée en tête de la liste LRU (mutex du groupe pris).
+ * @return : Aucune valeur de retour
+ */
+static void lru_push(PeerGroup* group, PeerEntry* entry) {
+    entry->older = group->newest;
+    entry->newer = NULL;
+    if (group->newest != NULL) {
+        group->newest->newer = entry;
+    } else {
+        group->oldest = entry;
+    }
+    group->newest = entry;
+}
+
+
+
+
+/**
+ * Fonction : hash_unlink
+ * Description : Cette fonction retire une entrée de la table de hachage (mutex du groupe pris).
+ * @return : Aucune valeur de retour
+ */
+static void hash_unlink(PeerGroup* group, PeerEntry* entry) {
+    PeerEntry** link = &group->buckets[bucket_of(entry->filename)];
+    while (*link != entry) {
+        link = &(*link)->next;
+    }
+    *link = entry->next;
+    entry->next = NULL;
+}
+
+
+
+
+/**
+ * Fonction : cache_remove
+ * Description : Cette fonction retire du cache une entrée chargée et rend la référence du cache (mutex du groupe pris).
+ * @return : Aucune valeur de retour
+ */
+static void cache_remove(PeerGroup* group, PeerEntry* entry) {
+    hash_unlink(group, entry);
+    lru_unlink(group, entry);
+    group->cache_bytes -= entry->size;
+    group->cache_files--;
+    entry_release_locked(entry);
+}
+
+
+
+
+/**
+ * Fonction : set_version
+ * Description : Cette fonction associe à une entrée la version du fichier lu (taille, inode et dates).
+ * @return : Aucune valeur de retour
+ */
+static void set_version(PeerEntry* entry, const struct stat* st) {
+    entry->size = (uint64_t) st->st_size;
+    entry->dev = st->st_dev;
+    entry->ino = st->st_ino;
+    entry->mtime = st->st_mtim;
+    entry->ctime = st->st_ctim;
+}
+
+
+
+
+/**
+ * Fonction : unchanged
+ * Description : Cette fonction vérifie qu'un fichier n'a pas été modifié depuis son fstat initial.
+ * @return : true si la taille et la date de modification sont inchangées.
+ */
+static bool unchanged(int fd, const struct stat* st) {
+    struct stat after;
+    return fstat(fd, &after) == 0 && after.st_size == st->st_size
+        && after.st_mtim.tv_sec == st->st_mtim.tv_sec && after.st_mtim.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+
+
+
+/**
+ * Fonction : load_entry
+ * Description : Cette fonction lit un fichier en entier dans une entrée ; le fichier ne doit pas changer pendant la lecture.
+ * @param entry : L'entrée à remplir.
+ * @param fd : Le fichier ouvert.
+ * @param st : Les attributs du fichier (fstat).
+ * @return : true en cas de succès.
+ */
+static bool load_entry(PeerEntry* entry, int fd, const struct stat* st) {
+    uint64_t size = (uint64_t) st->st_size;
+    entry->data = (char*) malloc(size > 0 ? size : 1);
+    if (entry->data == NULL) {
+        return false;
+    }
+    uint64_t done = 0;
+    while (done < size) {
+        ssize_t n = pread(fd, entry->data + done, size - done, (off_t) done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        done += (uint64_t) n;
+    }
+    if (!unchanged(fd, st)) {
+        return false;   // Fichier modifié pendant la lecture : lu directement par le demandeur
+    }
+    set_version(entry, st);
+    return true;
+}
+
+
+
+
+/**
+ * Fonction : cache_evict
+ * Description : Cette fonction retire les entrées les moins récemment utilisées au-delà de la taille du cache,
+ *               sauf celle qui vient d'être ajoutée (mutex du groupe pris).
+ * @return : Aucune valeur de retour
+ */
+static void cache_evict(PeerGroup* group, PeerEntry* keep) {
+    while (group->cache_bytes > group->cache_limit && group->oldest != keep) {
+        cache_remove(group, group->oldest);
+        group->evictions++;
+    }
+}
+
+
+
+
+/**
+ * Fonction : cache_acquire
+ * Description : Cette fonction fournit l'entrée du cache d'un fichier, en le lisant sur le disque s'il n'y est pas
+ *               ou s'il a changé. Les demandes simultanées d'un même fichier partagent une seule lecture.
+ * @param group : Le groupe d'instances.
+ * @param filename : Le nom normalisé du fichier.
+ * @param fd : Le fichier ouvert (fichier ordinaire d'au plus max_file octets).
+ * @param st : Les attributs du fichier (fstat).
+ * @return : L'entrée (à rendre avec entry_release), ou NULL en cas d'erreur.
+ */
+static PeerEntry* cache_acquire(PeerGroup* group, const char* filename, int fd, const struct stat* st) {
+    pthread_mutex_lock(&group->mutex);
+    PeerEntry* entry;
+    while ((entry = cache_find(group, filename)) != NULL && entry->loading) {
+        pthread_cond_wait(&group->cond, &group->mutex);
+    }
+    if (entry != NULL && same_file(entry, st)) {
+        entry->refs++;
+        lru_unlink(group, entry);
+        lru_push(group, entry);
+        group->hits++;
+        pthread_mutex_unlock(&group->mutex);
+        return entry;
+    }
+    if (entry != NULL) {
+        cache_remove(group, entry);     // Fichier modifié depuis sa mise en cache
+    }
+    entry = (PeerEntry*) calloc(1, sizeof(PeerEntry));
+    if (entry == NULL) {
+        pthread_mutex_unlock(&group->mutex);
+        return NULL;
+    }
+    strcpy(entry->filename, filename);
+    entry->loading = true;
+    entry->refs = 2;                    // Cache + appelant
+    uint32_t bucket = bucket_of(filename);
+    entry->next = group->buckets[bucket];
+    group->buckets[bucket] = entry;
+    pthread_mutex_unlock(&group->mutex);
+
+    bool loaded = load_entry(entry, fd, st);
+
+    pthread_mutex_lock(&group->mutex);
+    entry->loading = false;
+    if (loaded) {
+        lru_push(group, entry);
+        group->cache_bytes += entry->size;
+        group->cache_files++;
+        group->disk_loads++;
+        cache_evict(group, entry);
+    } else {
+        hash_unlink(group, entry);
+        entry_release_locked(entry);
+    }
+    pthread_cond_broadcast(&group->cond);
+    pthread_mutex_unlock(&group->mutex);
+    if (!loaded) {
+        entry_release(group, entry);
+        return NULL;
+    }
+    return entry;
+}
+
+
+
+
+/**
+ * Fonction : cache_lookup
+ * Description : Cette fonction cherche la version à jour d'un fichier dans le cache, sans attendre une lecture en cours.
+ * @param group : Le groupe d'instances.
+ * @param filename : Le nom normalisé du fichier.
+ * @param st : Les attributs du fichier ouvert (fstat).
+ * @return : L'entrée (à rendre avec entry_release), ou NULL.
+ */
+static PeerEntry* cache_lookup(PeerGroup* group, const char* filename, const struct stat* st) {
+    pthread_mutex_lock(&group->mutex);
+    PeerEntry* entry = cache_find(group, filename);
+    if (entry != NULL && !entry->loading && same_file(entry, st)) {
+        entry->refs++;
+        lru_unlink(group, entry);
+        lru_push(group, entry);
+        group->hits++;
+    } else {
+        entry = NULL;
+    }
+    pthread_mutex_unlock(&group->mutex);
+    return entry;
+}
+
+
+
+
+/**
+ * Fonction : cache_insert
+ * Description : Cette fonction confie au cache une entrée lue en entier pendant son envoi à un pair ; elle remplace
+ *               l'entrée existante du même nom, sauf si celle-ci est en cours de lecture (l'entrée est alors libérée).
+ * @param group : Le groupe d'instances.
+ * @param entry : L'entrée chargée (une seule référence, transmise au cache).
+ * @return : Aucune valeur de retour
+ */
+static void cache_insert(PeerGroup* group, PeerEntry* entry) {
+    pthread_mutex_lock(&group->mutex);
+    PeerEntry* current = cache_find(group, entry->filename);
+    if (current != NULL && current->loading) {
+        entry_release_locked(entry);
+        pthread_mutex_unlock(&group->mutex);
+        return;
+    }
+    if (current != NULL) {
+        cache_remove(group, current);
+    }
+    uint32_t bucket = bucket_of(entry->filename);
+    entry->next = group->buckets[bucket];
+    group->buckets[bucket] = entry;
+    lru_push(group, entry);
+    group->cache_bytes += entry->size;
+    group->cache_files++;
+    group->disk_loads++;
+    cache_evict(group, entry);
+    pthread_mutex_unlock(&group->mutex);
+}
+
+
+
+
+/**
+ * Fonction : serve_peer
+ * Description : Cette fonction traite la demande d'un pair : le fichier est envoyé depuis le cache mémoire, ou
+ *               au fil de sa lecture sur le disque (PEER_CHUNK_SIZE octets à la fois). Un fichier assez petit
+ *               pour le cache y est conservé une fois envoyé en entier.
+ * @param group : Le groupe d'instances.
+ * @param fd : La connexion du pair.
+ * @return : Aucune valeur de retour
+ */
+static void serve_peer(PeerGroup* group, int fd) {
+    uint16_t len;
+    char filename[PATH_MAX];
+    if (read_all(fd, &len, sizeof(len)) < 0) {
+        return;
+    }
+    len = ntohs(len);
+    if (len == 0 || len >= sizeof(filename) || read_all(fd, filename, len) < 0) {
+        return;
+    }
+    filename[len] = '\0';
+
+    PeerReply reply;
+    memset(&reply, 0, sizeof(reply));
+    struct stat st;
+    int file = strlen(filename) == len && fsroot_normalize(filename) == 0
+        ? fsroot_open(group->root, filename, O_RDONLY | O_CLOEXEC, 0) : -1;
+    int open_errno = errno;
+    if (file < 0 || fstat(file, &st) < 0 || !S_ISREG(st.st_mode)) {
+        reply.status = htonl(file < 0 && open_errno != ENOENT && open_errno != ENOTDIR ? PEER_ERROR : PEER_NOT_FOUND);
+        send_all(fd, &reply, sizeof(reply));
+        if (file >= 0) {
+            close(file);
+        }
+        return;
+    }
+
+    uint64_t size = (uint64_t) st.st_size;
+    uint64_t sent = 0;
+    bool cacheable = size <= group->max_file;
+    PeerEntry* entry = cacheable ? cache_lookup(group, filename, &st) : NULL;
+    reply.status = htonl(PEER_OK);
+    reply.size = htobe64(size);
+    if (entry != NULL) {
+        close(file);
+        if (send_all(fd, &reply, sizeof(reply)) == 0 && send_all(fd, entry->data, entry->size) == 0) {
+            sent = entry->size;
+        }
+        entry_release(group, entry);
+    } else {
+        // Lecture du disque envoyée au fur et à mesure ; les blocs d'un fichier assez petit sont lus directement dans sa future entrée
+        char buffer[PEER_CHUNK_SIZE];
+        PeerEntry* loaded = cacheable ? (PeerEntry*) calloc(1, sizeof(PeerEntry)) : NULL;
+        if (loaded != NULL && (loaded->data = (char*) malloc(size > 0 ? size : 1)) == NULL) {
+            free(loaded);
+            loaded = NULL;
+        }
+        if (send_all(fd, &reply, sizeof(reply)) == 0) {
+            while (sent < size) {
+                char* chunk = loaded != NULL ? loaded->data + sent : buffer;
+                size_t want = size - sent < PEER_CHUNK_SIZE ? (size_t) (size - sent) : PEER_CHUNK_SIZE;
+                ssize_t n = pread(file, chunk, want, (off_t) sent);
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (n <= 0 || send_all(fd, chunk, (size_t) n) < 0) {
+                    break;
+                }
+                sent += (uint64_t) n;
+            }
+        }
+        if (loaded != NULL && sent == size && unchanged(file, &st)) {
+            strcpy(loaded->filename, filename);
+            set_version(loaded, &st);
+            loaded->refs = 1;
+            cache_insert(group, loaded);
+        } else if (loaded != NULL) {
+            free(loaded->data);
+            free(loaded);
+        }
+        close(file);
+        if (!cacheable) {
+            pthread_mutex_lock(&group->mutex);
+            group->uncached++;
+            pthread_mutex_unlock(&group->mutex);
+        }
+    }
+    pthread_mutex_lock(&group->mutex);
+    group->served++;
+    group->served_bytes += sent;
+    pthread_mutex_unlock(&group->mutex);
+}
+
+
+
+
+/**
+ * Fonction : connection_thread
+ * Description : Fonction du thread d'une connexion de pair.
+ * @return : NULL
+ */
+static void* connection_thread(void* arg) {
+    PeerConnection* connection = (PeerConnection*) arg;
+    set_timeouts(connection->fd, PEER_SEND_TIMEOUT_MS);   // Le flux suit le rythme du client TFTP du demandeur
+    serve_peer(connection->group, connection->fd);
+    close(connection->fd);
+    pthread_mutex_lock(&connection->group->mutex);
+    connection->group->connections--;
+    pthread_mutex_unlock(&connection->group->mutex);
+    free(connection);
+    return NULL;
+}
+
+
+
+
+/**
+ * Fonction : listed_address
+ * Description : Cette fonction vérifie qu'une connexion vient de l'adresse de l'une des instances de la liste.
+ * @return : true si l'adresse est dans la liste.
+ */
+static bool listed_address(const PeerGroup* group, const struct sockaddr_in* addr) {
+    for (int i = 0; i < group->node_count; i++) {
+        if (group->nodes[i].addr.sin_addr.s_addr == addr->sin_addr.s_addr) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+
+
+/**
+ * Fonction : accept_thread
+ * Description : Fonction du thread d'écoute du canal : chaque connexion d'une instance de la liste est confiée à un
+ *               thread, dans la limite de PEER_MAX_CONNECTIONS (au-delà, le demandeur lit le fichier lui-même).
+ * @return : NULL
+ */
+static void* accept_thread(void* arg) {
+    PeerGroup* group = (PeerGroup*) arg;
+    for (;;) {
+        struct sockaddr_in addr;
+        socklen_t addr_len = sizeof(addr);
+        int fd = accept4(group->listen_fd, (struct sockaddr*) &addr, &addr_len, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EMFILE || errno == ENFILE) {
+                usleep(10000);
+            }
+            continue;
+        }
+        pthread_mutex_lock(&group->mutex);
+        bool accepted = addr.sin_family == AF_INET && listed_address(group, &addr) && group->connections < PEER_MAX_CONNECTIONS;
+        if (accepted) {
+            group->connections++;
+        } else {
+            group->rejected++;
+        }
+        pthread_mutex_unlock(&group->mutex);
+        if (!accepted) {
+            close(fd);
+            continue;
+        }
+        PeerConnection* connection = (PeerConnection*) malloc(sizeof(PeerConnection));
+        pthread_t tid;
+        if (connection != NULL) {
+            connection->group = group;
+            connection->fd = fd;
+        }
+        if (connection == NULL || pthread_create(&tid, NULL, connection_thread, connection) != 0) {
+            close(fd);
+            free(connection);
+            pthread_mutex_lock(&group->mutex);
+            group->connections--;
+            pthread_mutex_unlock(&group->mutex);
+            continue;
+        }
+        pthread_detach(tid);
+    }
+    return NULL;
+}
+
+
+
+
+/**
+ * Fonction : peer_init
+ * Description : Cette fonction lit la liste des instances, construit l'anneau et démarre le thread d'écoute du canal.
+ * @param group : Le groupe d'instances à initialiser.
+ * @param root : La racine de service (partagée par les instances).
+ * @param peers : Les adresses des canaux de toutes les instances, « hôte:port,... » (NULL = désactivé).
+ * @param self : L'adresse du canal de cette instance (doit figurer dans la liste).
+ * @param cache_mb : La taille du cache mémoire (Mo).
+ * @return : 0 en cas de succès, -1 en cas d'erreur (errno positionné).
+ */
+int peer_init(PeerGroup* group, ServingRoot* root, const char* peers, const char* self, int cache_mb) {
+    memset(group, 0, sizeof(*group));
+    pthread_mutex_init(&group->mutex, NULL);
+    pthread_cond_init(&group->cond, NULL);
+    group->root = root;
+    group->listen_fd = -1;
+    if (peers == NULL) {
+        return 0;
+    }
+    struct sockaddr_in self_addr;
+    if (self == NULL || parse_address(self, &self_addr) < 0) {
+        if (self == NULL) {
+            errno = EINVAL;
+        }
+        return -1;
+    }
+
+    char* list = strdup(peers);
+    group->nodes = (PeerNode*) calloc(PEER_MAX_NODES, sizeof(PeerNode));
+    if (list == NULL || group->nodes == NULL) {
+        free(list);
+        return -1;
+    }
+    int count = 0;
+    int self_count = 0;
+    char* save;
+    for (char* token = strtok_r(list, ",", &save); token != NULL; token = strtok_r(NULL, ",", &save)) {
+        PeerNode* node = &group->nodes[count];
+        if (count == PEER_MAX_NODES || strlen(token) >= sizeof(node->name) || parse_address(token, &node->addr) < 0) {
+            if (count == PEER_MAX_NODES || strlen(token) >= sizeof(node->name)) {
+                errno = count == PEER_MAX_NODES ? E2BIG : ENAMETOOLONG;
+            }
+            free(list);
+            return -1;
+        }
+        strcpy(node->name, token);
+        for (int i = 0; i < count; i++) {
+            if (strcmp(group->nodes[i].name, node->name) == 0) {
+                free(list);
+                errno = EINVAL;     // Instance en double
+                return -1;
+            }
+        }
+        node->self = node->addr.sin_addr.s_addr == self_addr.sin_addr.s_addr && node->addr.sin_port == self_addr.sin_port;
+        if (node->self) {
+            group->self = count;
+            self_count++;
+        }
+        count++;
+    }
+    free(list);
+    if (self_count != 1) {
+        errno = EINVAL;     // Cette instance doit figurer une fois dans la liste
+        return -1;
+    }
+
+    group->ring = (PeerPoint*) malloc((size_t) count * PEER_VNODES * sizeof(PeerPoint));
+    if (group->ring == NULL) {
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        for (int v = 0; v < PEER_VNODES; v++) {
+            char key[80];
+            snprintf(key, sizeof(key), "%s#%d", group->nodes[i].name, v);
+            group->ring[group->ring_size].hash = hash_key(key);
+            group->ring[group->ring_size].node = i;
+            group->ring_size++;
+        }
+    }
+    qsort(group->ring, (size_t) group->ring_size, sizeof(PeerPoint), compare_points);
+    group->cache_limit = (uint64_t) cache_mb * 1048576;
+    group->max_file = group->cache_limit / 4;
+
+    int one = 1;
+    group->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (group->listen_fd < 0) {
+        return -1;
+    }
+    setsockopt(group->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(group->listen_fd, (struct sockaddr*) &self_addr, sizeof(self_addr)) < 0 || listen(group->listen_fd, 128) < 0) {
+        int saved = errno;
+        close(group->listen_fd);
+        errno = saved;
+        return -1;
+    }
+    group->node_count = count;      // Liste des adresses acceptées par le thread d'écoute
+    int ret = pthread_create(&group->thread, NULL, accept_thread, group);
+    if (ret != 0) {
+        group->node_count = 0;
+        close(group->listen_fd);
+        errno = ret;
+        return -1;
+    }
+    pthread_detach(group->thread);
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : reader_read
+ * Description : Fonction de lecture du flux (fopencookie) : copie depuis le cache mémoire.
+ * @return : Le nombre d'octets lus, 0 en fin de fichier.
+ */
+static ssize_t reader_read(void* cookie, char* buffer, size_t size) {
+    PeerReader* reader = (PeerReader*) cookie;
+    if (size > reader->entry->size - reader->offset) {
+        size = reader->entry->size - reader->offset;
+    }
+    memcpy(buffer, reader->entry->data + reader->offset, size);
+    reader->offset += size;
+    return (ssize_t) size;
+}
+
+
+
+
+/**
+ * Fonction : reader_close
+ * Description : Fonction de fermeture du flux (fopencookie) : rend la référence sur l'entrée du cache.
+ * @return : 0
+ */
+static int reader_close(void* cookie) {
+    PeerReader* reader = (PeerReader*) cookie;
+    entry_release(reader->group, reader->entry);
+    free(reader);
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : stream_read
+ * Description : Fonction de lecture du flux (fopencookie) : lit le contenu envoyé par l'instance propriétaire.
+ * @return : Le nombre d'octets lus, 0 en fin de fichier, -1 si le canal est coupé avant la fin (errno = EIO).
+ */
+static ssize_t stream_read(void* cookie, char* buffer, size_t size) {
+    PeerStream* stream = (PeerStream*) cookie;
+    if (size > stream->remaining) {
+        size = (size_t) stream->remaining;
+    }
+    if (size == 0) {
+        return 0;
+    }
+    ssize_t n;
+    do {
+        n = recv(stream->fd, buffer, size, 0);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+        errno = EIO;
+        return -1;
+    }
+    stream->remaining -= (uint64_t) n;
+    stream->received += (uint64_t) n;
+    return n;
+}
+
+
+
+
+/**
+ * Fonction : stream_close
+ * Description : Fonction de fermeture du flux (fopencookie) : ferme le canal.
+ * @return : 0
+ */
+static int stream_close(void* cookie) {
+    PeerStream* stream = (PeerStream*) cookie;
+    pthread_mutex_lock(&stream->group->mutex);
+    stream->group->fetch_bytes += stream->received;
+    pthread_mutex_unlock(&stream->group->mutex);
+    close(stream->fd);
+    free(stream);
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : connect_peer
+ * Description : Cette fonction ouvre une connexion vers une instance, en PEER_CONNECT_TIMEOUT_MS au plus.
+ * @return : Le socket connecté, ou -1 en cas d'échec.
+ */
+static int connect_peer(const PeerNode* node) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, (const struct sockaddr*) &node->addr, sizeof(node->addr)) < 0) {
+        struct pollfd pfd = { fd, POLLOUT, 0 };
+        int error = 0;
+        socklen_t error_len = sizeof(error);
+        if (errno != EINPROGRESS || poll(&pfd, 1, PEER_CONNECT_TIMEOUT_MS) != 1
+            || getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &error_len) < 0 || error != 0) {
+            close(fd);
+            return -1;
+        }
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+    set_timeouts(fd, PEER_IO_TIMEOUT_MS);
+    return fd;
+}
+
+
+
+
+/**
+ * Fonction : fetch_remote
+ * Description : Cette fonction demande un fichier à son instance propriétaire.
+ * @param group : Le groupe d'instances.
+ * @param node : L'instance propriétaire.
+ * @param filename : Le nom normalisé du fichier.
+ * @return : Le flux de lecture du contenu reçu, ou NULL (errno = ENOENT : le fichier est lu localement).
+ */
+static FILE* fetch_remote(PeerGroup* group, PeerNode* node, const char* filename) {
+    int fd = connect_peer(node);
+    if (fd < 0) {
+        pthread_mutex_lock(&group->mutex);
+        node->down_until_us = now_us() + PEER_RETRY_MS * 1000ULL;
+        group->fallbacks++;
+        pthread_mutex_unlock(&group->mutex);
+        errno = ENOENT;
+        return NULL;
+    }
+
+    char request[sizeof(uint16_t) + PATH_MAX];
+    size_t len = strlen(filename);
+    uint16_t net_len = htons((uint16_t) len);
+    memcpy(request, &net_len, sizeof(net_len));
+    memcpy(request + sizeof(net_len), filename, len);
+    PeerReply reply;
+    PeerStream* stream = NULL;
+    if (send_all(fd, request, sizeof(net_len) + len) == 0 && read_all(fd, &reply, sizeof(reply)) == 0) {
+        if (ntohl(reply.status) == PEER_NOT_FOUND) {
+            close(fd);
+            errno = ENOENT;     // La lecture locale confirme l'absence (et fournit l'erreur au client)
+            return NULL;
+        }
+        if (ntohl(reply.status) == PEER_OK) {
+            stream = (PeerStream*) calloc(1, sizeof(PeerStream));
+        }
+    }
+    FILE* file = NULL;
+    if (stream != NULL) {
+        stream->group = group;
+        stream->fd = fd;
+        stream->remaining = be64toh(reply.size);
+        cookie_io_functions_t functions = { stream_read, NULL, NULL, stream_close };
+        file = fopencookie(stream, "rb", functions);
+        if (file == NULL) {
+            free(stream);
+        }
+    }
+    pthread_mutex_lock(&group->mutex);
+    if (file != NULL) {
+        group->fetches++;
+    } else {
+        group->fallbacks++;
+    }
+    pthread_mutex_unlock(&group->mutex);
+    if (file == NULL) {
+        close(fd);
+        errno = ENOENT;
+    }
+    return file;
+}
+
+
+
+
+/**
+ * Fonction : peer_open
+ * Description : Cette fonction ouvre en lecture un fichier par le mode pair : depuis le cache mémoire si cette
+ *               instance en est propriétaire, sinon depuis l'instance propriétaire.
+ * @param group : Le groupe d'instances.
+ * @param filename : Le nom normalisé du fichier.
+ * @return : Le flux de lecture, ou NULL (errno = ENOENT : le fichier doit être lu localement, erreurs comprises).
+ */
+FILE* peer_open(PeerGroup* group, const char* filename) {
+    if (group->node_count == 0) {
+        errno = ENOENT;
+        return NULL;
+    }
+    PeerNode* node = &group->nodes[owner_of(group, filename)];
+    if (!node->self) {
+        pthread_mutex_lock(&group->mutex);
+        bool down = node->down_until_us > now_us();
+        if (down) {
+            group->fallbacks++;
+        }
+        pthread_mutex_unlock(&group->mutex);
+        if (down) {
+            errno = ENOENT;
+            return NULL;
+        }
+        return fetch_remote(group, node, filename);
+    }
+
+    // Fichier dont cette instance est propriétaire : servi depuis son cache (les fichiers trop gros sont lus normalement)
+    int fd = fsroot_open(group->root, filename, O_RDONLY | O_CLOEXEC, 0);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || (uint64_t) st.st_size > group->max_file) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        errno = ENOENT;
+        return NULL;
+    }
+    PeerEntry* entry = cache_acquire(group, filename, fd, &st);
+    close(fd);
+    PeerReader* reader = entry != NULL ? (PeerReader*) calloc(1, sizeof(PeerReader)) : NULL;
+    if (reader == NULL) {
+        if (entry != NULL) {
+            entry_release(group, entry);
+        }
+        errno = ENOENT;
+        return NULL;
+    }
+    reader->group = group;
+    reader->entry = entry;
+
+    cookie_io_functions_t functions = { reader_read, NULL, NULL, reader_close };
+    FILE* file = fopencookie(reader, "rb", functions);
+    if (file == NULL) {
+        entry_release(group, entry);
+        free(reader);
+        errno = ENOENT;
+    }
+    return file;
+}
+
+
+
+
+/**
+ * Fonction : peer_report
+ * Description : Cette fonction affiche l'état du mode pair.
+ * @param group : Le groupe d'instances.
+ * @param out : Le flux de sortie.
+ * @return : Aucune valeur de retour
+ */
+void peer_report(PeerGroup* group, FILE* out) {
+    if (group->node_count == 0) {
+        return;
+    }
+    pthread_mutex_lock(&group->mutex);
+    fprintf(out, "[PEER] %s (%d instances) | cache %lu fichiers, %.1f/%.1f Mo | succès %lu | lus sur disque %lu | évictions %lu"
+            " | hors cache %lu | reçus des pairs %lu (%.1f Mo) | servis aux pairs %lu (%.1f Mo) | connexions refusées %lu"
+            " | lectures locales de secours %lu\n",
+            group->nodes[group->self].name, group->node_count, group->cache_files, group->cache_bytes / 1048576.0,
+            group->cache_limit / 1048576.0, group->hits, group->disk_loads, group->evictions, group->uncached,
+            group->fetches, group->fetch_bytes / 1048576.0, group->served, group->served_bytes / 1048576.0, group->rejected,
+            group->fallbacks);
+    pthread_mutex_unlock(&group->mutex);
+}
@@ -0,0 +1,166 @@
+/**
+ * @file peer.h
+ * @brief Mode pair : plusieurs instances du serveur (même racine de service, ex. NFS) se partagent la lecture des
+ *        fichiers. Chaque fichier a une instance propriétaire, choisie par hachage cohérent de son nom sur la liste
+ *        des instances (anneau de points virtuels) : seule la propriétaire lit le fichier sur le disque et le garde
+ *        dans son cache mémoire ; les autres le lui demandent par un canal TCP. Une instance injoignable est
+ *        contournée (lecture locale) et n'est plus sollicitée pendant PEER_RETRY_MS.
+ *
+ *        Toutes les instances doivent recevoir la même liste « hôte:port,... » (adresses des canaux) dans le même
+ *        format : l'anneau est calculé à partir de ces chaînes. Le cache est validé à chaque requête (stat).
+ *
+ *        Le canal n'accepte que les connexions venant des adresses de la liste, au plus PEER_MAX_CONNECTIONS à la fois ;
+ *        le contenu est envoyé au fil de sa lecture sur le disque (ou depuis le cache).
+ *
+ *        Protocole du canal (une requête par connexion, entiers dans l'ordre du réseau) :
+ *          requête : uint16 longueur | nom normalisé (sans '\0')
+ *          réponse : PeerReply | contenu (size octets si status = PEER_OK)
+ */
+
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <limits.h>
+#include <netinet/in.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include "fsroot.h"
+
+#ifndef PEER_H
+#define PEER_H
+
+#define PEER_MAX_NODES 64
+#define PEER_VNODES 128                 /* Points de chaque instance sur l'anneau */
+#define PEER_BUCKETS 1024               /* Nombre d'alvéoles de la table de hachage du cache (puissance de 2) */
+#define PEER_CONNECT_TIMEOUT_MS 250     /* Au-delà, l'instance propriétaire est considérée injoignable */
+#define PEER_IO_TIMEOUT_MS 5000         /* Attente maximale d'une lecture ou écriture sur le canal */
+/* Écriture de l'instance propriétaire : le demandeur ne lit plus le flux tant que son client TFTP
+   ne répond pas, soit jusqu'à TIMEOUT_SECONDS * (MAX_RETRIES + 1) avant l'abandon du transfert */
+#define PEER_SEND_TIMEOUT_MS ((TIMEOUT_SECONDS * (MAX_RETRIES + 1) + 5) * 1000)
+#define PEER_RETRY_MS 5000              /* Durée pendant laquelle une instance injoignable est contournée */
+#define PEER_MAX_CONNECTIONS 32         /* Connexions de pairs servies simultanément (un thread chacune) */
+#define PEER_CHUNK_SIZE 65536           /* Taille des lectures du disque envoyées aux pairs */
+
+
+/**
+ * @enum PeerStatus
+ * @brief État de la réponse d'une instance propriétaire.
+ */
+typedef enum {
+    PEER_OK = 0,
+    PEER_NOT_FOUND,                 /* Fichier absent (ou pas un fichier ordinaire) */
+    PEER_ERROR                      /* Autre erreur : le demandeur lit le fichier lui-même */
+} PeerStatus;
+
+
+
+
+/**
+ * @struct PeerReply
+ * @brief En-tête de la réponse du canal.
+ */
+typedef struct PeerReply {
+    uint32_t status;                /* PeerStatus */
+    uint32_t reserved;
+    uint64_t size;                  /* Taille du contenu qui suit */
+} PeerReply;
+
+
+
+
+/**
+ * @struct PeerNode
+ * @brief Instance de la liste.
+ */
+typedef struct PeerNode {
+    char name[64];                  /* « hôte:port » tel qu'écrit dans la liste (clé de l'anneau) */
+    struct sockaddr_in addr;
+    bool self;
+    uint64_t down_until_us;         /* Instance contournée jusqu'à cet instant (0 = joignable) */
+} PeerNode;
+
+
+
+
+/**
+ * @struct PeerPoint
+ * @brief Point de l'anneau de hachage cohérent.
+ */
+typedef struct PeerPoint {
+    uint64_t hash;
+    int node;
+} PeerPoint;
+
+
+
+
+/**
+ * @struct PeerEntry
+ * @brief Fichier du cache mémoire de l'instance propriétaire, partagé par le cache et les lecteurs en cours ;
+ *        libéré par son dernier utilisateur.
+ */
+typedef struct PeerEntry {
+    char filename[PATH_MAX];
+    char* data;
+    uint64_t size;
+    dev_t dev;
+    ino_t ino;
+    struct timespec mtime;
+    struct timespec ctime;
+    bool loading;                   /* Lecture du disque en cours : les autres demandes l'attendent */
+    int refs;                       /* Cache + lecteurs (protégé par le mutex de PeerGroup) */
+    struct PeerEntry* next;         /* Entrée suivante dans l'alvéole */
+    struct PeerEntry* newer;        /* Liste LRU */
+    struct PeerEntry* older;
+} PeerEntry;
+
+
+
+
+/**
+ * @struct PeerGroup
+ * @brief Instances, anneau, cache mémoire et compteurs.
+ */
+typedef struct PeerGroup {
+    ServingRoot* root;
+    PeerNode* nodes;
+    int node_count;                 /* 0 = désactivé */
+    int self;
+    PeerPoint* ring;
+    int ring_size;
+    int listen_fd;
+    pthread_t thread;
+
+    PeerEntry* buckets[PEER_BUCKETS];
+    PeerEntry* newest;
+    PeerEntry* oldest;
+    uint64_t cache_limit;           /* Octets conservés en mémoire */
+    uint64_t max_file;              /* Les fichiers plus gros sont lus depuis le disque à chaque demande */
+    uint64_t cache_bytes;
+    unsigned long cache_files;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;            /* Fin d'une lecture du disque */
+    int connections;                /* Connexions de pairs en cours de traitement */
+
+    unsigned long hits;             /* Fichiers servis depuis le cache */
+    unsigned long disk_loads;       /* Fichiers lus sur le disque et mis en cache */
+    unsigned long uncached;         /* Fichiers trop gros envoyés aux pairs depuis le disque */
+    unsigned long evictions;
+    unsigned long fetches;          /* Fichiers reçus d'une instance propriétaire */
+    unsigned long long fetch_bytes;
+    unsigned long fallbacks;        /* Propriétaire injoignable ou en erreur : lecture locale */
+    unsigned long served;           /* Demandes des pairs servies */
+    unsigned long long served_bytes;
+    unsigned long rejected;         /* Connexions refusées (adresse hors liste ou trop de connexions) */
+} PeerGroup;
+
+
+
+int peer_init(PeerGroup* group, ServingRoot* root, const char* peers, const char* self, int cache_mb);
+FILE* peer_open(PeerGroup* group, const char* filename);
+void peer_report(PeerGroup* group, FILE* out);
+
+#endif
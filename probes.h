@@ -0,0 +1,40 @@
+/**
+ * @file probes.h
+ * @brief Sondes statiques USDT (sys/sdt.h) du fournisseur « tftpd », utilisables avec bpftrace, perf ou SystemTap :
+ *        une sonde est une instruction nop et une note ELF ; elle ne coûte rien tant qu'aucun outil ne s'y attache.
+ *        Sans sys/sdt.h (ou avec -DTFTP_NO_USDT), les sondes ne génèrent aucun code.
+ *
+ *        Sondes (arg0 = identifiant du transfert) :
+ *          request__accepted(id, opcode, filename)             lock__wait__begin(id, filename, write)
+ *          lock__wait__end(id, filename, write, wait_us)       data__sent(id, block, bytes, total_bytes)
+ *          ack__received(id, block, total_bytes)              data__received(id, block, bytes, total_bytes)
+ *          retransmit(id, block, retry)                        timeout(id, block, retry)
+ *          transfer__complete(id, opcode, total_bytes, us)     rename__done(id, filename, total_bytes)
+ *        Exemple : bpftrace -e 'usdt:./server:tftpd:retransmit { @[arg1] = count(); }'
+ */
+
+
+#ifndef PROBES_H
+#define PROBES_H
+
+#if !defined(TFTP_NO_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define TFTP_USDT 1
+#endif
+#endif
+
+
+/* PROBES_ENABLED : les mesures qui ne servent qu'aux sondes sont omises quand il vaut 0.
+   Sans sondes, les arguments ne sont pas évalués. */
+#ifdef TFTP_USDT
+#define PROBES_ENABLED 1
+#define PROBE3(name, a1, a2, a3) DTRACE_PROBE3(tftpd, name, a1, a2, a3)
+#define PROBE4(name, a1, a2, a3, a4) DTRACE_PROBE4(tftpd, name, a1, a2, a3, a4)
+#else
+#define PROBES_ENABLED 0
+#define PROBE3(name, a1, a2, a3) do { if (0) { (void) (a1); (void) (a2); (void) (a3); } } while (0)
+#define PROBE4(name, a1, a2, a3, a4) do { if (0) { (void) (a1); (void) (a2); (void) (a3); (void) (a4); } } while (0)
+#endif
+
+#endif
@@ -0,0 +1,493 @@
+/**
+ * @file proxy.c
+ * @brief Implémentation du mode proxy-cache.
+ *        Le premier client qui demande un fichier absent lance un thread de téléchargement (client TFTP du serveur amont)
+ *        qui écrit chaque bloc reçu dans un fichier anonyme (O_TMPFILE) du répertoire cible. Chaque client lit ce fichier au travers
+ *        d'un flux (fopencookie) qui attend les blocs manquants : handle_read_request n'a pas à connaître l'origine des données.
+ *        Une fois le fichier complet, il reçoit son nom sous verrou d'écriture (sync.c) et les demandes suivantes sont servies localement.
+ */
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <netdb.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include "proxy.h"
+#include "tftp.h"
+
+
+/**
+ * @struct ProxyReader
+ * @brief Flux de lecture d'un client sur un téléchargement en cours.
+ */
+typedef struct ProxyReader {
+    ProxyFetch* fetch;
+    uint64_t offset;            /* Position de lecture dans le fichier temporaire */
+} ProxyReader;
+
+
+
+
+/**
+ * Fonction : proxy_init
+ * Description : Cette fonction initialise le mode proxy-cache et résout l'adresse du serveur amont.
+ * @param proxy : Le proxy à initialiser.
+ * @param upstream : Le serveur amont, sous la forme « hôte » ou « hôte:port ».
+ * @param root : La racine de service (les fichiers téléchargés y sont conservés).
+ * @param file_list : La liste de synchronisation des fichiers.
+ * @param rollover : Le numéro de bloc après 65535 (0 ou 1).
+ * @return : 0 en cas de succès, -1 si l'adresse est invalide (errno positionné).
+ */
+int proxy_init(UpstreamProxy* proxy, const char* upstream, ServingRoot* root, FileList* file_list, uint16_t rollover) {
+    memset(proxy, 0, sizeof(*proxy));
+    proxy->root = root;
+    proxy->file_list = file_list;
+    proxy->rollover = rollover;
+    pthread_mutex_init(&proxy->mutex, NULL);
+
+    char host[256];
+    if (strlen(upstream) >= sizeof(host)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(host, upstream);
+
+    long port = PROXY_DEFAULT_PORT;
+    char* colon = strrchr(host, ':');
+    if (colon != NULL) {
+        char* end;
+        *colon = '\0';
+        port = strtol(colon + 1, &end, 10);
+        if (colon[1] == '\0' || *end != '\0' || port <= 0 || port > 65535) {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    struct addrinfo hints;
+    struct addrinfo* result;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    if (getaddrinfo(host, NULL, &hints, &result) != 0) {
+        errno = EHOSTUNREACH;
+        return -1;
+    }
+    memcpy(&proxy->upstream, result->ai_addr, sizeof(proxy->upstream));
+    proxy->upstream.sin_port = htons((uint16_t) port);
+    freeaddrinfo(result);
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : fetch_release
+ * Description : Cette fonction rend une référence sur un téléchargement et le libère après la dernière.
+ * @param fetch : Le téléchargement.
+ * @return : Aucune valeur de retour
+ */
+static void fetch_release(ProxyFetch* fetch) {
+    pthread_mutex_lock(&fetch->mutex);
+    int refs = --fetch->refs;
+    pthread_mutex_unlock(&fetch->mutex);
+    if (refs == 0) {
+        close(fetch->fd);
+        pthread_mutex_destroy(&fetch->mutex);
+        pthread_cond_destroy(&fetch->cond);
+        free(fetch);
+    }
+}
+
+
+
+
+/**
+ * Fonction : pwrite_all
+ * Description : Cette fonction écrit entièrement un tampon à une position donnée d'un descripteur.
+ * @return : 0 en cas de succès, -1 en cas d'erreur.
+ */
+static int pwrite_all(int fd, const char* data, size_t length, uint64_t offset) {
+    while (length > 0) {
+        ssize_t written = pwrite(fd, data, length, (off_t) offset);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        data += written;
+        length -= written;
+        offset += written;
+    }
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : download
+ * Description : Cette fonction télécharge un fichier auprès du serveur amont (RRQ en mode octet) et publie
+ *               chaque bloc reçu aux lecteurs du téléchargement.
+ * @param proxy : Le proxy.
+ * @param fetch : Le téléchargement.
+ * @return : 0 en cas de succès, sinon le code errno de l'échec (ENOENT si le serveur amont n'a pas le fichier).
+ */
+static int download(UpstreamProxy* proxy, ProxyFetch* fetch) {
+    char request[MAX_PACKET_SIZE];
+    size_t name_len = strlen(fetch->filename);
+    if (name_len + sizeof("octet") + 3 > sizeof(request)) {
+        return ENAMETOOLONG;
+    }
+    request[0] = 0;
+    request[1] = TFTP_OPCODE_RRQ;
+    memcpy(request + 2, fetch->filename, name_len + 1);
+    memcpy(request + 3 + name_len, "octet", sizeof("octet"));
+    size_t request_len = 3 + name_len + sizeof("octet");
+
+    int sockfd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (sockfd < 0) {
+        return errno;
+    }
+    struct timeval tv;
+    tv.tv_sec = TIMEOUT_SECONDS;
+    tv.tv_usec = 0;
+    setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv, sizeof tv);
+
+    struct sockaddr_in peer = proxy->upstream;     // Port du transfert (TID) connu après le premier DATA
+    bool tid_known = false;
+    TFTP_AckPacket ack_packet;
+    const void* last_packet = request;              // Paquet à retransmettre après un délai d'attente
+    size_t last_len = request_len;
+    uint16_t expected = 1;
+    int retryCount = 0;
+    int result = 0;
+    unsigned char packet[MAX_PACKET_SIZE];
+
+    sendto(sockfd, request, request_len, 0, (struct sockaddr*)&peer, sizeof(peer));
+    while (1) {
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        ssize_t recvlen = recvfrom(sockfd, packet, sizeof(packet), 0, (struct sockaddr*)&from, &from_len);
+        if (recvlen < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (retryCount >= MAX_RETRIES) {
+                result = ETIMEDOUT;
+                break;
+            }
+            printf("[PROXY] Time Out !, retransmission vers le serveur amont (%s)\n", fetch->filename);
+            sendto(sockfd, last_packet, last_len, 0, (struct sockaddr*)&peer, sizeof(peer));
+            retryCount++;
+            continue;
+        }
+        if (recvlen < TFTP_HEADER_SIZE || from.sin_addr.s_addr != peer.sin_addr.s_addr
+            || (tid_known && from.sin_port != peer.sin_port)) {
+            continue;   // Paquet étranger au transfert
+        }
+
+        uint16_t opcode = (uint16_t) (packet[0] << 8 | packet[1]);
+        uint16_t block = (uint16_t) (packet[2] << 8 | packet[3]);
+        if (opcode == TFTP_OPCODE_ERR) {
+            result = block == FileNotFound ? ENOENT : block == AccessViolation ? EACCES : EIO;
+            break;
+        }
+        if (opcode != TFTP_OPCODE_DATA) {
+            continue;
+        }
+        if (!tid_known) {
+            peer.sin_port = from.sin_port;
+            tid_known = true;
+        }
+        if (block != expected) {
+            // Bloc déjà reçu : notre ACK a été perdu, il est renvoyé
+            if (last_packet == &ack_packet) {
+                sendto(sockfd, &ack_packet, sizeof(ack_packet), 0, (struct sockaddr*)&peer, sizeof(peer));
+            }
+            continue;
+        }
+
+        size_t length = recvlen - TFTP_HEADER_SIZE;
+        if (pwrite_all(fetch->fd, (const char*)packet + TFTP_HEADER_SIZE, length, fetch->available) < 0) {
+            result = errno;
+            send_error_packet(sockfd, &peer, DiskFullOrAllocationExceeded, get_error_message(DiskFullOrAllocationExceeded), NULL);
+            break;
+        }
+        ack_packet.opcode = htons(TFTP_OPCODE_ACK);
+        ack_packet.block_num = htons(block);
+        sendto(sockfd, &ack_packet, sizeof(ack_packet), 0, (struct sockaddr*)&peer, sizeof(peer));
+        last_packet = &ack_packet;
+        last_len = sizeof(ack_packet);
+        retryCount = 0;
+
+        // fetch->available n'est modifié que par ce thread : la lecture ci-dessus se fait sans verrou
+        pthread_mutex_lock(&fetch->mutex);
+        fetch->available += length;
+        fetch->done = length < MAX_DATA_SIZE;
+        pthread_cond_broadcast(&fetch->cond);
+        pthread_mutex_unlock(&fetch->mutex);
+        if (length < MAX_DATA_SIZE) {
+            break;
+        }
+        expected = next_block_number(expected, proxy->rollover);
+    }
+
+    close(sockfd);
+    return result;
+}
+
+
+
+
+/**
+ * Fonction : fetch_thread
+ * Description : Fonction du thread de téléchargement : téléchargement, puis publication du fichier complet
+ *               sous son nom (en cas d'échec, le fichier anonyme disparaît à sa dernière fermeture).
+ * @param arg : Le téléchargement.
+ * @return : NULL
+ */
+static void* fetch_thread(void* arg) {
+    ProxyFetch* fetch = (ProxyFetch*)arg;
+    UpstreamProxy* proxy = fetch->proxy;
+
+    int error = download(proxy, fetch);
+    if (error == 0) {
+        // Publication sous verrou d'écriture : attend la fin des lectures en cours de ce nom
+        if (sync_start_write(fetch->filename, proxy->file_list) < 0) {
+            printf("[PROXY] %s : non publié (table des fichiers pleine)\n", fetch->filename);  // Les lecteurs en cours gardent le flux
+        } else {
+            if (fsroot_link_tmpfile(proxy->root, fetch->fd, fetch->filename) != 0 && errno != EEXIST) {
+                perror("Erreur lors de la publication du fichier téléchargé");   // EEXIST : fichier reçu entre-temps (WRQ), conservé
+            }
+            sync_end_write(fetch->filename, proxy->file_list);
+        }
+    } else {
+        pthread_mutex_lock(&fetch->mutex);
+        fetch->error = error;
+        pthread_cond_broadcast(&fetch->cond);
+        pthread_mutex_unlock(&fetch->mutex);
+    }
+
+    pthread_mutex_lock(&proxy->mutex);
+    for (ProxyFetch** p = &proxy->fetches; *p != NULL; p = &(*p)->next) {
+        if (*p == fetch) {
+            *p = fetch->next;
+            break;
+        }
+    }
+    if (error == 0) {
+        proxy->completed++;
+    } else {
+        proxy->failed++;
+    }
+    proxy->bytes += fetch->available;
+    pthread_mutex_unlock(&proxy->mutex);
+
+    printf("[PROXY] %s : %s (%" PRIu64 " Bytes)\n", fetch->filename, error == 0 ? "téléchargé" : strerror(error), fetch->available);
+    fetch_release(fetch);
+    return NULL;
+}
+
+
+
+
+/**
+ * Fonction : fetch_start
+ * Description : Cette fonction crée le fichier temporaire d'un téléchargement et lance son thread.
+ *               Elle est appelée sous le verrou du proxy.
+ * @param proxy : Le proxy.
+ * @param filename : Le fichier à télécharger.
+ * @return : Le téléchargement (avec une référence pour l'appelant), ou NULL en cas d'erreur (errno positionné).
+ */
+static ProxyFetch* fetch_start(UpstreamProxy* proxy, const char* filename) {
+    ProxyFetch* fetch = (ProxyFetch*)calloc(1, sizeof(ProxyFetch));
+    if (fetch == NULL) {
+        return NULL;
+    }
+    fetch->proxy = proxy;
+    strcpy(fetch->filename, filename);
+    fetch->fd = -1;
+    if (fsroot_mkdirs(proxy->root, filename) == 0) {
+        fetch->fd = fsroot_open_tmpfile(proxy->root, filename, O_RDWR | O_CLOEXEC, 0644);
+    }
+    if (fetch->fd < 0) {
+        int saved_errno = errno;
+        free(fetch);
+        errno = saved_errno;
+        return NULL;
+    }
+    fetch->refs = 2;    // Thread de téléchargement + appelant
+    pthread_mutex_init(&fetch->mutex, NULL);
+    pthread_cond_init(&fetch->cond, NULL);
+
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, fetch_thread, fetch) != 0) {
+        close(fetch->fd);
+        pthread_mutex_destroy(&fetch->mutex);
+        pthread_cond_destroy(&fetch->cond);
+        free(fetch);
+        errno = EAGAIN;
+        return NULL;
+    }
+    pthread_detach(tid);
+
+    fetch->next = proxy->fetches;
+    proxy->fetches = fetch;
+    proxy->started++;
+    return fetch;
+}
+
+
+
+
+/**
+ * Fonction : reader_read
+ * Description : Fonction de lecture du flux (fopencookie) : attend que le bloc demandé soit reçu.
+ * @return : Le nombre d'octets lus, 0 en fin de fichier, -1 si le téléchargement a échoué (errno = EIO).
+ */
+static ssize_t reader_read(void* cookie, char* buffer, size_t size) {
+    ProxyReader* reader = (ProxyReader*)cookie;
+    ProxyFetch* fetch = reader->fetch;
+
+    pthread_mutex_lock(&fetch->mutex);
+    while (reader->offset >= fetch->available && !fetch->done && fetch->error == 0) {
+        pthread_cond_wait(&fetch->cond, &fetch->mutex);
+    }
+    uint64_t available = fetch->available;
+    int error = fetch->error;
+    pthread_mutex_unlock(&fetch->mutex);
+
+    if (reader->offset >= available) {
+        if (error != 0) {
+            errno = EIO;
+            return -1;
+        }
+        return 0;
+    }
+    if (size > available - reader->offset) {
+        size = available - reader->offset;
+    }
+    ssize_t n = pread(fetch->fd, buffer, size, (off_t) reader->offset);
+    if (n > 0) {
+        reader->offset += n;
+    }
+    return n;
+}
+
+
+
+
+/**
+ * Fonction : reader_close
+ * Description : Fonction de fermeture du flux (fopencookie) : rend la référence sur le téléchargement.
+ * @return : 0
+ */
+static int reader_close(void* cookie) {
+    ProxyReader* reader = (ProxyReader*)cookie;
+    fetch_release(reader->fetch);
+    free(reader);
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : proxy_open
+ * Description : Cette fonction ouvre en lecture un fichier absent de la racine : rattachement au téléchargement
+ *               en cours s'il existe, sinon lancement d'un nouveau téléchargement. Elle attend le premier bloc,
+ *               pour qu'un fichier absent du serveur amont soit signalé au client comme un fichier local absent.
+ * @param proxy : Le proxy.
+ * @param filename : Le fichier demandé (normalisé).
+ * @return : Le flux de lecture, ou NULL en cas d'erreur (errno = ENOENT si le serveur amont n'a pas le fichier).
+ */
+FILE* proxy_open(UpstreamProxy* proxy, const char* filename) {
+    if (strlen(filename) >= PATH_MAX) {
+        errno = ENAMETOOLONG;
+        return NULL;
+    }
+    ProxyReader* reader = (ProxyReader*)calloc(1, sizeof(ProxyReader));
+    if (reader == NULL) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&proxy->mutex);
+    ProxyFetch* fetch = proxy->fetches;
+    while (fetch != NULL && strcmp(fetch->filename, filename) != 0) {
+        fetch = fetch->next;
+    }
+    if (fetch != NULL) {
+        pthread_mutex_lock(&fetch->mutex);
+        fetch->refs++;
+        pthread_mutex_unlock(&fetch->mutex);
+        proxy->coalesced++;
+    } else {
+        // Le fichier a pu être publié par un téléchargement terminé depuis l'échec de l'ouverture locale
+        int fd = fsroot_open(proxy->root, filename, O_RDONLY | O_CLOEXEC, 0);
+        if (fd < 0) {
+            fetch = fetch_start(proxy, filename);
+        }
+        if (fetch == NULL) {
+            int saved_errno = errno;
+            pthread_mutex_unlock(&proxy->mutex);
+            free(reader);
+            FILE* file = fd >= 0 ? fdopen(fd, "rb") : NULL;
+            if (fd >= 0 && file == NULL) {
+                close(fd);
+            }
+            errno = saved_errno;
+            return file;
+        }
+    }
+    pthread_mutex_unlock(&proxy->mutex);
+
+    pthread_mutex_lock(&fetch->mutex);
+    while (fetch->available == 0 && !fetch->done && fetch->error == 0) {
+        pthread_cond_wait(&fetch->cond, &fetch->mutex);
+    }
+    int error = fetch->available == 0 ? fetch->error : 0;
+    pthread_mutex_unlock(&fetch->mutex);
+
+    reader->fetch = fetch;
+    cookie_io_functions_t functions = { reader_read, NULL, NULL, reader_close };
+    FILE* file = error == 0 ? fopencookie(reader, "rb", functions) : NULL;
+    if (file == NULL) {
+        fetch_release(fetch);
+        free(reader);
+        errno = error != 0 ? error : ENOMEM;
+        return NULL;
+    }
+    return file;
+}
+
+
+
+
+/**
+ * Fonction : proxy_report
+ * Description : Cette fonction affiche les compteurs du mode proxy-cache.
+ * @param proxy : Le proxy.
+ * @param out : Le flux de sortie.
+ * @return : Aucune valeur de retour
+ */
+void proxy_report(UpstreamProxy* proxy, FILE* out) {
+    pthread_mutex_lock(&proxy->mutex);
+    int active = 0;
+    for (ProxyFetch* fetch = proxy->fetches; fetch != NULL; fetch = fetch->next) {
+        active++;
+    }
+    fprintf(out, "[PROXY] amont %s:%d | téléchargements %lu (en cours %d) | demandes regroupées %lu | terminés %lu | échecs %lu | reçu %.1f Ko\n",
+            inet_ntoa(proxy->upstream.sin_addr), ntohs(proxy->upstream.sin_port), proxy->started, active,
+            proxy->coalesced, proxy->completed, proxy->failed, proxy->bytes / 1024.0);
+    pthread_mutex_unlock(&proxy->mutex);
+}
@@ -0,0 +1,71 @@
+/**
+ * @file proxy.h
+ * @brief Mode proxy-cache : un fichier absent de la racine de service est récupéré auprès d'un serveur TFTP amont,
+ *        transmis au client au fur et à mesure de sa réception, puis conservé sous la racine.
+ *        Les demandes simultanées d'un même fichier partagent un seul téléchargement.
+ */
+
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <netinet/in.h>
+
+#include "sync.h"
+#include "fsroot.h"
+
+#ifndef PROXY_H
+#define PROXY_H
+
+#define PROXY_DEFAULT_PORT 69
+
+
+/**
+ * @struct ProxyFetch
+ * @brief Téléchargement en cours d'un fichier. Le fichier temporaire (anonyme, O_TMPFILE : invisible des clients
+ *        tant qu'il n'est pas complet) est relu par les clients (pread) pendant que le thread de téléchargement
+ *        y écrit ; il est libéré par le dernier utilisateur.
+ */
+typedef struct ProxyFetch {
+    struct UpstreamProxy* proxy;
+    char filename[PATH_MAX];        /* Nom du fichier (sous la racine) */
+    int fd;                         /* Fichier temporaire anonyme, ouvert en lecture/écriture */
+    uint64_t available;             /* Octets déjà reçus et écrits */
+    bool done;                      /* Fichier complet */
+    int error;                      /* errno de l'échec (0 = aucun) */
+    int refs;                       /* Thread de téléchargement + flux de lecture ouverts */
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;            /* Nouvelles données, fin ou échec */
+    struct ProxyFetch* next;
+} ProxyFetch;
+
+
+
+
+/**
+ * @struct UpstreamProxy
+ * @brief Serveur amont et liste des téléchargements en cours.
+ */
+typedef struct UpstreamProxy {
+    ServingRoot* root;
+    FileList* file_list;            /* Synchronisation de la publication avec les lectures en cours */
+    struct sockaddr_in upstream;
+    uint16_t rollover;              /* Numéro de bloc après 65535 (0 ou 1) */
+    ProxyFetch* fetches;
+    pthread_mutex_t mutex;
+
+    unsigned long started;          /* Téléchargements lancés */
+    unsigned long coalesced;        /* Demandes rattachées à un téléchargement en cours */
+    unsigned long completed;
+    unsigned long failed;
+    unsigned long long bytes;       /* Octets reçus du serveur amont */
+} UpstreamProxy;
+
+
+
+int proxy_init(UpstreamProxy* proxy, const char* upstream, ServingRoot* root, FileList* file_list, uint16_t rollover);
+FILE* proxy_open(UpstreamProxy* proxy, const char* filename);
+void proxy_report(UpstreamProxy* proxy, FILE* out);
+
+#endif
@@ -0,0 +1,141 @@
+/**
+ * @file ratelimit.c
+ * @brief Implémentation de la limitation du débit de requêtes par adresse IP source.
+ *        Chaque source dispose d'un seau à jetons ; les entrées inactives vieillissent et sont réutilisées.
+ */
+
+
+#include <string.h>
+#include <time.h>
+
+#include "ratelimit.h"
+
+
+
+/**
+ * Fonction : now_ms
+ * Description : Cette fonction retourne la date courante en millisecondes (horloge monotone).
+ * @return : La date courante en millisecondes (modulo 2^32).
+ */
+static uint32_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t) (ts.tv_sec * 1000u + ts.tv_nsec / 1000000);
+}
+
+
+
+
+/**
+ * Fonction : hash_ip
+ * Description : Cette fonction calcule l'indice de départ d'une adresse IP dans la table.
+ * @param ip : L'adresse IP (ordre réseau).
+ * @return : L'indice dans la table.
+ */
+static uint32_t hash_ip(uint32_t ip) {
+    ip ^= ip >> 16;
+    ip *= 0x7feb352dU;
+    ip ^= ip >> 15;
+    ip *= 0x846ca68bU;
+    ip ^= ip >> 16;
+    return ip & (RATELIMIT_TABLE_SIZE - 1);
+}
+
+
+
+
+/**
+ * Fonction : ratelimit_init
+ * Description : Cette fonction initialise le limiteur de débit.
+ * @param rl : Un pointeur vers la structure du limiteur.
+ * @param rate : Le nombre de requêtes autorisées par seconde et par source (0 = désactivé).
+ * @param burst : Le nombre de requêtes autorisées en rafale.
+ * @return : Aucune valeur de retour
+ */
+void ratelimit_init(RateLimiter* rl, double rate, int burst) {
+    memset(rl, 0, sizeof(*rl));
+    rl->rate = (float) rate;
+    rl->burst = burst > 0 ? (float) burst : 1.0f;
+    // Une entrée inactive assez longtemps pour avoir rempli son seau est équivalente à une entrée libre
+    rl->idle_ms = rate > 0 ? (uint32_t) (1000.0 * rl->burst / rate) + 1000 : 0;
+}
+
+
+
+
+/**
+ * Fonction : ratelimit_allow
+ * Description : Cette fonction indique si une requête provenant de la source donnée peut être traitée,
+ *               et consomme un jeton le cas échéant.
+ * @param rl : Un pointeur vers la structure du limiteur.
+ * @param source : L'adresse IP source de la requête.
+ * @return : true si la requête est autorisée, false si la source dépasse sa limite.
+ */
+bool ratelimit_allow(RateLimiter* rl, struct in_addr source) {
+    if (rl->rate <= 0) {
+        return true;
+    }
+
+    uint32_t ip = source.s_addr;
+    uint32_t now = now_ms();
+    uint32_t start = hash_ip(ip);
+    RateBucket* bucket = NULL;
+    RateBucket* victim = NULL;
+    bool victim_free = false;
+
+    for (int i = 0; i < RATELIMIT_MAX_PROBES; i++) {
+        RateBucket* candidate = &rl->buckets[(start + i) & (RATELIMIT_TABLE_SIZE - 1)];
+        if (candidate->ip == ip) {
+            bucket = candidate;
+            break;
+        }
+        // Une entrée libre ou expirée est réutilisable sans perte ; sinon on retient la moins récemment utilisée
+        bool is_free = candidate->ip == 0 || now - candidate->last_ms > rl->idle_ms;
+        if (victim == NULL || (is_free && !victim_free)
+            || (!is_free && !victim_free && now - candidate->last_ms > now - victim->last_ms)) {
+            victim = candidate;
+            victim_free = is_free;
+        }
+    }
+
+    if (bucket == NULL) {   // Nouvelle source
+        if (!victim_free) {
+            rl->evicted++;
+        }
+        bucket = victim;
+        bucket->ip = ip;
+        bucket->tokens = rl->burst;
+    } else {
+        bucket->tokens += (now - bucket->last_ms) * rl->rate / 1000.0f;
+        if (bucket->tokens > rl->burst) {
+            bucket->tokens = rl->burst;
+        }
+    }
+    bucket->last_ms = now;
+
+    if (bucket->tokens < 1.0f) {
+        rl->limited++;
+        return false;
+    }
+    bucket->tokens -= 1.0f;
+    rl->accepted++;
+    return true;
+}
+
+
+
+
+/**
+ * Fonction : ratelimit_report
+ * Description : Cette fonction affiche les compteurs du limiteur de débit.
+ * @param rl : Un pointeur vers la structure du limiteur.
+ * @param out : Le flux de sortie.
+ * @return : Aucune valeur de retour
+ */
+void ratelimit_report(RateLimiter* rl, FILE* out) {
+    if (rl->rate <= 0) {
+        return;
+    }
+    fprintf(out, "[RATELIMIT] %.1f req/s par source (rafale %.0f) | acceptées %lu | limitées %lu | évictions %lu\n",
+            rl->rate, rl->burst, rl->accepted, rl->limited, rl->evicted);
+}
@@ -0,0 +1,52 @@
+/**
+ * @file ratelimit.h
+ * @brief Limitation du débit de requêtes par adresse IP source (seaux à jetons).
+ */
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <arpa/inet.h>
+
+#ifndef RATELIMIT_H
+#define RATELIMIT_H
+
+#define RATELIMIT_TABLE_SIZE 4096   /* Nombre d'entrées de la table (puissance de 2) */
+#define RATELIMIT_MAX_PROBES 8      /* Longueur maximale de sondage linéaire */
+
+
+/**
+ * @struct RateBucket
+ * @brief Seau à jetons associé à une adresse IP source.
+ */
+typedef struct RateBucket {
+    uint32_t ip;            /* Adresse IP (ordre réseau), 0 = entrée libre */
+    uint32_t last_ms;       /* Date de la dernière requête (ms, horloge monotone) */
+    float tokens;           /* Jetons disponibles */
+} RateBucket;
+
+
+
+
+/**
+ * @struct RateLimiter
+ * @brief Table de hachage compacte de seaux à jetons. Utilisée uniquement par le thread d'écoute (pas de verrou).
+ */
+typedef struct RateLimiter {
+    float rate;                 /* Jetons ajoutés par seconde (0 = limitation désactivée) */
+    float burst;                /* Capacité d'un seau */
+    uint32_t idle_ms;           /* Durée d'inactivité au bout de laquelle une entrée peut être réutilisée */
+    RateBucket buckets[RATELIMIT_TABLE_SIZE];
+    unsigned long accepted;
+    unsigned long limited;      /* Requêtes rejetées car hors limite */
+    unsigned long evicted;      /* Entrées actives évincées faute de place */
+} RateLimiter;
+
+
+
+void ratelimit_init(RateLimiter* rl, double rate, int burst);
+bool ratelimit_allow(RateLimiter* rl, struct in_addr source);
+void ratelimit_report(RateLimiter* rl, FILE* out);
+
+#endif
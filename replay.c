@@ -0,0 +1,662 @@
+/**
+ * @file replay.c
+ * @brief Rejeu d'une trace enregistrée par le serveur (option --trace) contre un serveur TFTP local.
+ *        Chaque requête enregistrée devient une session rejouée depuis son propre socket : la requête est envoyée
+ *        à sa date d'origine (divisée par le facteur d'accélération), puis la session se comporte comme le client
+ *        d'origine : chaque ACK (RRQ) ou DATA (WRQ) enregistré est renvoyé en réponse au paquet du serveur,
+ *        mais jamais avant sa date d'origine. Les tailles des DATA envoyés sont celles de la trace.
+ *
+ *        Le résultat (sessions terminées, débit, latence des transferts) est écrit sur une ligne JSON,
+ *        pour comparer deux versions du serveur avec le même mélange de requêtes.
+ *
+ *        Usage : ./replay [-s adresse] [-p port] [-x accélération] [-v] trace.bin
+ */
+
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "tftp.h"
+#include "trace.h"
+
+
+#define REPLAY_HASH_BUCKETS 65536       /* Alvéoles de la table des sessions en cours de chargement */
+#define REPLAY_DEFAULT_PORT 69
+
+
+typedef enum {
+    SESSION_PENDING = 0,    /* Requête pas encore envoyée */
+    SESSION_ACTIVE,
+    SESSION_DONE,
+    SESSION_FAILED
+} SessionState;
+
+
+/**
+ * @struct Session
+ * @brief Transfert enregistré (requête et paquets suivants du client) et état de son rejeu.
+ */
+typedef struct Session {
+    struct sockaddr_in client;      /* Adresse du client dans la trace */
+    uint64_t request_us;            /* Date de la requête dans la trace */
+    uint8_t request[TRACE_MAX_PACKET];
+    uint16_t request_len;
+    bool write;                     /* WRQ (sinon RRQ) */
+    uint64_t* followup_us;          /* Dates des ACK/DATA enregistrés (retransmissions exclues) */
+    uint16_t* followup_len;         /* Tailles des paquets enregistrés */
+    int num_followups;
+    int followup_capacity;
+    int hash_next;                  /* Session précédente de même clé (chargement) */
+
+    SessionState state;
+    int fd;
+    struct sockaddr_in server;      /* TID du serveur, appris au premier paquet reçu */
+    bool tid_known;
+    int next;                       /* Prochain paquet enregistré à rejouer */
+    uint16_t block;                 /* RRQ : bloc attendu ; WRQ : dernier bloc envoyé */
+    bool last;                      /* Le dernier bloc a été reçu (RRQ) ou envoyé (WRQ) */
+    uint8_t out[MAX_PACKET_SIZE];   /* Dernier paquet envoyé (retransmission) */
+    size_t out_len;
+    uint64_t send_at_ns;            /* Envoi différé de out (0 = aucun) */
+    uint64_t deadline_ns;           /* Retransmission de out (0 = aucune) */
+    int retries;
+    uint64_t started_ns;
+    uint64_t finished_ns;
+    uint64_t bytes;
+    size_t unacked;                 /* Octets du dernier DATA envoyé, comptés à la réception de son ACK (WRQ) */
+} Session;
+
+
+/**
+ * @struct Replay
+ * @brief Ensemble des sessions chargées depuis la trace et paramètres du rejeu.
+ */
+typedef struct Replay {
+    Session* sessions;
+    int num_sessions;
+    int capacity;
+    TraceEvent* strays;             /* Paquets reçus par le port d'écoute hors requête valide */
+    int num_strays;
+    int stray_capacity;
+    uint64_t first_us;              /* Date du premier paquet de la trace */
+
+    struct sockaddr_in target;
+    double speed;                   /* Facteur d'accélération (0 = sans attente) */
+    uint64_t start_ns;
+    bool verbose;
+} Replay;
+
+
+
+
+/**
+ * Fonction : now_ns
+ * Description : Cette fonction retourne la date courante en nanosecondes (horloge monotone).
+ * @return : La date courante en nanosecondes.
+ */
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+
+
+/**
+ * Fonction : due_ns
+ * Description : Cette fonction convertit une date de la trace en date de rejeu.
+ * @param replay : Le rejeu.
+ * @param trace_us : La date dans la trace.
+ * @return : La date (horloge monotone) à laquelle le paquet doit être rejoué.
+ */
+static uint64_t due_ns(const Replay* replay, uint64_t trace_us) {
+    if (replay->speed <= 0) {
+        return replay->start_ns;
+    }
+    return replay->start_ns + (uint64_t) ((trace_us - replay->first_us) * 1000.0 / replay->speed);
+}
+
+
+
+
+/**
+ * Fonction : hash_key
+ * Description : Cette fonction calcule l'alvéole d'une adresse client (IP + port).
+ */
+static unsigned hash_key(const struct sockaddr_in* addr) {
+    uint32_t h = addr->sin_addr.s_addr * 2654435761u ^ addr->sin_port * 40503u;
+    return (h ^ (h >> 16)) & (REPLAY_HASH_BUCKETS - 1);
+}
+
+
+
+
+/**
+ * Fonction : add_followup
+ * Description : Cette fonction ajoute un ACK ou DATA enregistré à une session, sauf s'il s'agit
+ *               d'une retransmission (même numéro de bloc que le précédent).
+ * @return : 0 en cas de succès, -1 en cas d'erreur d'allocation.
+ */
+static int add_followup(Session* s, const TraceEvent* ev, uint16_t* last_block) {
+    if (ev->captured < TFTP_HEADER_SIZE) {
+        return 0;
+    }
+    uint16_t block = (uint16_t) (ev->data[2] << 8 | ev->data[3]);
+    if (s->num_followups > 0 && block == *last_block) {
+        return 0;
+    }
+    if (s->num_followups == s->followup_capacity) {
+        int capacity = s->followup_capacity > 0 ? s->followup_capacity * 2 : 64;
+        uint64_t* times = realloc(s->followup_us, capacity * sizeof(uint64_t));
+        if (times == NULL) {
+            return -1;
+        }
+        s->followup_us = times;
+        uint16_t* lengths = realloc(s->followup_len, capacity * sizeof(uint16_t));
+        if (lengths == NULL) {
+            return -1;
+        }
+        s->followup_len = lengths;
+        s->followup_capacity = capacity;
+    }
+    s->followup_us[s->num_followups] = ev->time_us;
+    s->followup_len[s->num_followups] = ev->length;
+    s->num_followups++;
+    *last_block = block;
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : load_trace
+ * Description : Cette fonction lit la trace et reconstitue les sessions : chaque RRQ/WRQ ouvre une session,
+ *               les paquets suivants de la même adresse client lui sont rattachés.
+ * @param replay : Le rejeu à remplir.
+ * @param path : Le chemin du fichier de trace.
+ * @return : 0 en cas de succès, -1 en cas d'erreur.
+ */
+static int load_trace(Replay* replay, const char* path) {
+    FILE* file = fopen(path, "rb");
+    uint64_t start_unix_us;
+    if (file == NULL) {
+        perror("Erreur lors de l'ouverture de la trace");
+        return -1;
+    }
+    if (trace_read_header(file, &start_unix_us) < 0) {
+        fprintf(stderr, "Erreur : %s n'est pas une trace du serveur\n", path);
+        fclose(file);
+        return -1;
+    }
+
+    int* buckets = malloc(REPLAY_HASH_BUCKETS * sizeof(int));
+    uint16_t* last_blocks = NULL;
+    TraceEvent ev;
+    int ret = 0;
+    if (buckets == NULL) {
+        fclose(file);
+        return -1;
+    }
+    memset(buckets, -1, REPLAY_HASH_BUCKETS * sizeof(int));
+
+    while (ret == 0 && (ret = trace_read_event(file, &ev)) == 1) {
+        ret = 0;
+        if (replay->num_sessions == 0 && replay->num_strays == 0) {
+            replay->first_us = ev.time_us;
+        }
+        uint16_t opcode = ev.captured >= 2 ? (uint16_t) (ev.data[0] << 8 | ev.data[1]) : 0;
+        unsigned h = hash_key(&ev.source);
+
+        if (opcode == TFTP_OPCODE_RRQ || opcode == TFTP_OPCODE_WRQ) {
+            if (replay->num_sessions == replay->capacity) {
+                int capacity = replay->capacity > 0 ? replay->capacity * 2 : 256;
+                Session* sessions = realloc(replay->sessions, capacity * sizeof(Session));
+                uint16_t* blocks = realloc(last_blocks, capacity * sizeof(uint16_t));
+                if (sessions != NULL) {
+                    replay->sessions = sessions;
+                }
+                if (blocks != NULL) {
+                    last_blocks = blocks;
+                }
+                if (sessions == NULL || blocks == NULL) {
+                    ret = -1;
+                    break;
+                }
+                replay->capacity = capacity;
+            }
+            Session* s = &replay->sessions[replay->num_sessions];
+            memset(s, 0, sizeof(*s));
+            s->client = ev.source;
+            s->request_us = ev.time_us;
+            memcpy(s->request, ev.data, ev.captured);
+            s->request_len = ev.captured;
+            s->write = opcode == TFTP_OPCODE_WRQ;
+            s->fd = -1;
+            s->hash_next = buckets[h];
+            buckets[h] = replay->num_sessions++;
+            continue;
+        }
+
+        // Paquet suivant d'une session (ACK ou DATA), sinon paquet isolé reçu par le port d'écoute
+        int index = buckets[h];
+        while (index >= 0 && memcmp(&replay->sessions[index].client, &ev.source, sizeof(ev.source)) != 0) {
+            index = replay->sessions[index].hash_next;
+        }
+        if (index >= 0 && (opcode == TFTP_OPCODE_ACK || opcode == TFTP_OPCODE_DATA)) {
+            ret = add_followup(&replay->sessions[index], &ev, &last_blocks[index]);
+        } else if (index < 0) {
+            if (replay->num_strays == replay->stray_capacity) {
+                int capacity = replay->stray_capacity > 0 ? replay->stray_capacity * 2 : 64;
+                TraceEvent* strays = realloc(replay->strays, capacity * sizeof(TraceEvent));
+                if (strays == NULL) {
+                    ret = -1;
+                    break;
+                }
+                replay->strays = strays;
+                replay->stray_capacity = capacity;
+            }
+            replay->strays[replay->num_strays++] = ev;
+        }
+    }
+
+    if (ret < 0) {
+        fprintf(stderr, "Erreur : trace %s invalide ou tronquée (%d sessions lues)\n", path, replay->num_sessions);
+    }
+    free(buckets);
+    free(last_blocks);
+    fclose(file);
+    return ret < 0 && replay->num_sessions == 0 ? -1 : 0;
+}
+
+
+
+
+/**
+ * Fonction : send_out
+ * Description : Cette fonction envoie le paquet courant d'une session et arme sa retransmission.
+ */
+static void send_out(Session* s, uint64_t now) {
+    struct sockaddr_in* to = &s->server;
+    sendto(s->fd, s->out, s->out_len, 0, (struct sockaddr*) to, sizeof(*to));
+    s->send_at_ns = 0;
+    s->deadline_ns = now + (uint64_t) TIMEOUT_SECONDS * 1000000000ULL;
+}
+
+
+
+
+/**
+ * Fonction : finish
+ * Description : Cette fonction termine une session (succès ou échec) et ferme son socket.
+ */
+static void finish(Replay* replay, Session* s, SessionState state, uint64_t now, const char* reason) {
+    s->state = state;
+    s->finished_ns = now;
+    s->send_at_ns = 0;
+    s->deadline_ns = 0;
+    close(s->fd);
+    s->fd = -1;
+    if (replay->verbose) {
+        fprintf(stderr, "%s %s %s : %" PRIu64 " octets en %.1f ms%s%s\n", state == SESSION_DONE ? "OK " : "ERR",
+                s->write ? "WRQ" : "RRQ", (const char*) s->request + 2, s->bytes, (now - s->started_ns) / 1e6,
+                reason != NULL ? " - " : "", reason != NULL ? reason : "");
+    }
+}
+
+
+
+
+/**
+ * Fonction : start_session
+ * Description : Cette fonction ouvre le socket d'une session et envoie sa requête au port d'écoute.
+ */
+static void start_session(Replay* replay, Session* s, uint64_t now) {
+    s->fd = socket(AF_INET, SOCK_DGRAM, 0);
+    s->started_ns = now;
+    if (s->fd < 0) {
+        s->state = SESSION_ACTIVE;
+        finish(replay, s, SESSION_FAILED, now, strerror(errno));
+        return;
+    }
+    s->state = SESSION_ACTIVE;
+    s->server = replay->target;
+    s->block = s->write ? 0 : 1;
+    memcpy(s->out, s->request, s->request_len);
+    s->out_len = s->request_len;
+    send_out(s, now);
+}
+
+
+
+
+/**
+ * Fonction : schedule
+ * Description : Cette fonction prépare la réponse suivante d'une session (ACK ou DATA) et la programme
+ *               à la date du paquet enregistré correspondant (immédiatement si la trace n'en contient plus).
+ */
+static void schedule(Replay* replay, Session* s, uint16_t block, size_t payload, uint64_t now) {
+    uint16_t opcode = htons(s->write ? TFTP_OPCODE_DATA : TFTP_OPCODE_ACK);
+    uint16_t block_num = htons(block);
+    memcpy(s->out, &opcode, 2);
+    memcpy(s->out + 2, &block_num, 2);
+    memset(s->out + TFTP_HEADER_SIZE, 0, payload);
+    s->out_len = TFTP_HEADER_SIZE + payload;
+
+    uint64_t at = now;
+    if (s->next < s->num_followups) {
+        uint64_t due = due_ns(replay, s->followup_us[s->next]);
+        at = due > now ? due : now;
+        s->next++;
+    }
+    s->send_at_ns = at;
+    s->deadline_ns = 0;
+    if (at <= now) {
+        send_out(s, now);
+    }
+}
+
+
+
+
+/**
+ * Fonction : on_packet
+ * Description : Cette fonction traite un paquet reçu du serveur par une session.
+ */
+static void on_packet(Replay* replay, Session* s, const uint8_t* packet, ssize_t len, const struct sockaddr_in* from, uint64_t now) {
+    if (len < TFTP_HEADER_SIZE) {
+        return;
+    }
+    if (!s->tid_known) {
+        s->server = *from;      // Le serveur répond depuis le socket dédié au transfert
+        s->tid_known = true;
+    } else if (from->sin_port != s->server.sin_port || from->sin_addr.s_addr != s->server.sin_addr.s_addr) {
+        return;
+    }
+
+    uint16_t opcode = (uint16_t) (packet[0] << 8 | packet[1]);
+    uint16_t block = (uint16_t) (packet[2] << 8 | packet[3]);
+    s->retries = 0;
+
+    if (opcode == TFTP_OPCODE_ERR) {
+        char reason[64];
+        snprintf(reason, sizeof(reason), "erreur %u : %.*s", block, (int) (len - TFTP_HEADER_SIZE), (const char*) packet + TFTP_HEADER_SIZE);
+        finish(replay, s, SESSION_FAILED, now, reason);
+        return;
+    }
+
+    if (!s->write && opcode == TFTP_OPCODE_DATA) {
+        if (block == s->block && !s->last) {
+            s->bytes += len - TFTP_HEADER_SIZE;
+            s->last = len < MAX_PACKET_SIZE;
+            schedule(replay, s, block, 0, now);
+            s->block = next_block_number(block, 0);
+        } else if (s->send_at_ns == 0) {
+            send_out(s, now);   // DATA retransmis : notre ACK a été perdu
+        }
+    } else if (s->write && opcode == TFTP_OPCODE_ACK && block == s->block) {
+        s->bytes += s->unacked;
+        if (s->last) {
+            finish(replay, s, SESSION_DONE, now, NULL);
+            return;
+        }
+        // Taille du DATA suivant : celle enregistrée, sinon un DATA vide termine le transfert
+        size_t payload = 0;
+        if (s->next < s->num_followups && s->followup_len[s->next] >= TFTP_HEADER_SIZE) {
+            payload = s->followup_len[s->next] - TFTP_HEADER_SIZE;
+        }
+        if (payload > MAX_DATA_SIZE) {
+            payload = MAX_DATA_SIZE;
+        }
+        s->last = payload < MAX_DATA_SIZE;
+        s->unacked = payload;
+        s->block = next_block_number(s->block, 0);
+        schedule(replay, s, s->block, payload, now);
+    }
+}
+
+
+
+
+/**
+ * Fonction : run
+ * Description : Cette fonction rejoue toutes les sessions : envoi des requêtes et des réponses programmées,
+ *               retransmissions, réception des paquets du serveur.
+ * @param replay : Le rejeu (sessions chargées).
+ * @return : Aucune valeur de retour
+ */
+static void run(Replay* replay) {
+    struct pollfd* fds = malloc(sizeof(struct pollfd) * (replay->num_sessions + 1));
+    int* owners = malloc(sizeof(int) * (replay->num_sessions + 1));
+    int stray_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    int next_session = 0;
+    int next_stray = 0;
+    int active = 0;
+    uint8_t packet[MAX_PACKET_SIZE];
+
+    if (fds == NULL || owners == NULL) {
+        free(fds);
+        free(owners);
+        return;
+    }
+
+    replay->start_ns = now_ns();
+    while (next_session < replay->num_sessions || next_stray < replay->num_strays || active > 0) {
+        uint64_t now = now_ns();
+        uint64_t wake = UINT64_MAX;
+
+        // Requêtes et paquets isolés dont la date est atteinte
+        while (next_session < replay->num_sessions && due_ns(replay, replay->sessions[next_session].request_us) <= now) {
+            Session* s = &replay->sessions[next_session++];
+            start_session(replay, s, now);
+            if (s->state == SESSION_ACTIVE) {
+                active++;
+            }
+        }
+        while (next_stray < replay->num_strays && due_ns(replay, replay->strays[next_stray].time_us) <= now) {
+            TraceEvent* ev = &replay->strays[next_stray++];
+            sendto(stray_fd, ev->data, ev->captured, 0, (struct sockaddr*) &replay->target, sizeof(replay->target));
+        }
+        if (next_session < replay->num_sessions) {
+            wake = due_ns(replay, replay->sessions[next_session].request_us);
+        }
+        if (next_stray < replay->num_strays && due_ns(replay, replay->strays[next_stray].time_us) < wake) {
+            wake = due_ns(replay, replay->strays[next_stray].time_us);
+        }
+
+        // Envois différés et retransmissions
+        int nfds = 0;
+        for (int i = 0; i < next_session; i++) {
+            Session* s = &replay->sessions[i];
+            if (s->state != SESSION_ACTIVE) {
+                continue;
+            }
+            if (s->send_at_ns != 0 && s->send_at_ns <= now) {
+                send_out(s, now);
+            } else if (s->deadline_ns != 0 && s->deadline_ns <= now) {
+                if (s->retries++ >= MAX_RETRIES) {
+                    finish(replay, s, SESSION_FAILED, now, "pas de réponse du serveur");
+                    active--;
+                    continue;
+                }
+                send_out(s, now);
+            }
+            // Le dernier ACK d'un RRQ envoyé : transfert terminé
+            if (!s->write && s->last && s->send_at_ns == 0) {
+                finish(replay, s, SESSION_DONE, now, NULL);
+                active--;
+                continue;
+            }
+            uint64_t t = s->send_at_ns != 0 ? s->send_at_ns : s->deadline_ns;
+            if (t != 0 && t < wake) {
+                wake = t;
+            }
+            fds[nfds].fd = s->fd;
+            fds[nfds].events = POLLIN;
+            owners[nfds++] = i;
+        }
+        if (nfds == 0 && next_session >= replay->num_sessions && next_stray >= replay->num_strays) {
+            break;
+        }
+
+        int timeout = -1;
+        if (wake != UINT64_MAX) {
+            timeout = wake > now ? (int) ((wake - now + 999999) / 1000000) : 0;
+        }
+        if (poll(fds, nfds, timeout) <= 0) {
+            continue;
+        }
+
+        now = now_ns();
+        for (int k = 0; k < nfds; k++) {
+            if (!(fds[k].revents & POLLIN)) {
+                continue;
+            }
+            Session* s = &replay->sessions[owners[k]];
+            struct sockaddr_in from;
+            socklen_t from_len = sizeof(from);
+            ssize_t len = recvfrom(s->fd, packet, sizeof(packet), 0, (struct sockaddr*) &from, &from_len);
+            if (len > 0 && s->state == SESSION_ACTIVE) {
+                on_packet(replay, s, packet, len, &from, now);
+                if (s->state != SESSION_ACTIVE) {
+                    active--;
+                }
+            }
+        }
+    }
+
+    if (stray_fd >= 0) {
+        close(stray_fd);
+    }
+    free(fds);
+    free(owners);
+}
+
+
+
+
+/**
+ * Fonction : compare_u64
+ * Description : Fonction de comparaison pour qsort (ordre croissant).
+ */
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*) a;
+    uint64_t y = *(const uint64_t*) b;
+    return (x > y) - (x < y);
+}
+
+
+
+
+/**
+ * Fonction : report
+ * Description : Cette fonction écrit le résultat du rejeu sur une ligne JSON.
+ */
+static void report(const Replay* replay, const char* path, uint64_t elapsed_ns) {
+    uint64_t* latencies = malloc(sizeof(uint64_t) * (replay->num_sessions + 1));
+    uint64_t bytes = 0;
+    int done = 0;
+    int failed = 0;
+
+    for (int i = 0; i < replay->num_sessions; i++) {
+        const Session* s = &replay->sessions[i];
+        if (s->state == SESSION_DONE) {
+            latencies[done++] = s->finished_ns - s->started_ns;
+            bytes += s->bytes;
+        } else {
+            failed++;
+        }
+    }
+    qsort(latencies, done, sizeof(uint64_t), compare_u64);
+
+    double seconds = elapsed_ns / 1e9;
+    printf("{\"trace\":\"%s\",\"speed\":%g,\"sessions\":%d,\"completed\":%d,\"failed\":%d,\"stray_packets\":%d,"
+           "\"bytes\":%" PRIu64 ",\"duration_s\":%.3f,\"throughput_mbps\":%.2f,"
+           "\"latency_ms\":{\"p50\":%.2f,\"p90\":%.2f,\"p99\":%.2f,\"max\":%.2f}}\n",
+           path, replay->speed, replay->num_sessions, done, failed, replay->num_strays,
+           bytes, seconds, seconds > 0 ? bytes * 8 / seconds / 1e6 : 0.0,
+           done > 0 ? latencies[(done - 1) * 50 / 100] / 1e6 : 0.0,
+           done > 0 ? latencies[(done - 1) * 90 / 100] / 1e6 : 0.0,
+           done > 0 ? latencies[(done - 1) * 99 / 100] / 1e6 : 0.0,
+           done > 0 ? latencies[done - 1] / 1e6 : 0.0);
+    free(latencies);
+}
+
+
+
+
+/**
+ * Fonction : print_usage
+ * Description : Cette fonction affiche l'aide de la ligne de commande.
+ */
+static void print_usage(const char* prog) {
+    fprintf(stderr, "Usage : %s [options] trace\n"
+                    "  -s ADRESSE   adresse IPv4 du serveur (défaut : 127.0.0.1)\n"
+                    "  -p PORT      port d'écoute du serveur (défaut : %d)\n"
+                    "  -x FACTEUR   accélération : 1 = vitesse d'origine, 10 = dix fois plus vite, 0 = sans attente (défaut : 1)\n"
+                    "  -v           affiche le résultat de chaque session\n",
+            prog, REPLAY_DEFAULT_PORT);
+}
+
+
+
+
+int main(int argc, char* argv[]) {
+    Replay replay;
+    const char* server = "127.0.0.1";
+    int port = REPLAY_DEFAULT_PORT;
+    int opt;
+
+    memset(&replay, 0, sizeof(replay));
+    replay.speed = 1;
+    while ((opt = getopt(argc, argv, "s:p:x:vh")) != -1) {
+        switch (opt) {
+            case 's': server = optarg; break;
+            case 'p': port = atoi(optarg); break;
+            case 'x': replay.speed = strtod(optarg, NULL); break;
+            case 'v': replay.verbose = true; break;
+            default:
+                print_usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind != argc - 1 || port <= 0 || port > 65535 || replay.speed < 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    replay.target.sin_family = AF_INET;
+    replay.target.sin_port = htons(port);
+    if (inet_pton(AF_INET, server, &replay.target.sin_addr) != 1) {
+        fprintf(stderr, "Erreur : adresse invalide '%s'\n", server);
+        return 1;
+    }
+
+    // Une tempête de démarrages peut ouvrir plus de sockets simultanés que la limite par défaut
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    if (load_trace(&replay, argv[optind]) < 0) {
+        return 1;
+    }
+
+    uint64_t start = now_ns();
+    run(&replay);
+    report(&replay, argv[optind], now_ns() - start);
+
+    for (int i = 0; i < replay.num_sessions; i++) {
+        free(replay.sessions[i].followup_us);
+        free(replay.sessions[i].followup_len);
+    }
+    free(replay.sessions);
+    free(replay.strays);
+    return 0;
+}
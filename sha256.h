@@ -0,0 +1,35 @@
+/**
+ * @file sha256.h
+ * @brief Calcul incrémental de l'empreinte SHA-256 (FIPS 180-4).
+ */
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef SHA256_H
+#define SHA256_H
+
+#define SHA256_DIGEST_SIZE 32
+#define SHA256_HEX_SIZE (2 * SHA256_DIGEST_SIZE + 1)
+
+
+/**
+ * @struct Sha256
+ * @brief État d'un calcul d'empreinte en cours.
+ */
+typedef struct Sha256 {
+    uint32_t state[8];
+    uint64_t length;                /* Octets déjà traités */
+    uint8_t block[64];              /* Bloc incomplet */
+    size_t block_len;
+} Sha256;
+
+
+
+void sha256_init(Sha256* ctx);
+void sha256_update(Sha256* ctx, const void* data, size_t length);
+void sha256_final(Sha256* ctx, uint8_t digest[SHA256_DIGEST_SIZE]);
+void sha256_hex(const uint8_t digest[SHA256_DIGEST_SIZE], char hex[SHA256_HEX_SIZE]);
+
+#endif
@@ -0,0 +1,850 @@
+/**
+ * @file sim.c
+ * @brief Simulation des transferts en temps virtuel : handle_read_request et handle_write_request (tftp.c) sont
+ *        exécutés tels quels, avec un transport (TFTP_Transport) qui remplace le socket par un réseau simulé
+ *        (délai fixe, pertes aléatoires ou scriptées) et l'horloge par une horloge virtuelle. Un client simulé
+ *        répond aux paquets du serveur (ACK des DATA en RRQ, DATA suivant en WRQ) et retransmet son dernier paquet
+ *        à l'expiration de son propre délai. Les attentes ne prennent aucun temps réel : des milliers de transferts
+ *        par seconde, pour comparer le débit utile selon le délai de retransmission, les pertes et le délai réseau.
+ *
+ *        Les options -T, -l, -d et -r acceptent des listes (valeurs séparées par des virgules) : chaque combinaison est
+ *        mesurée et écrite sur une ligne JSON. Les transferts de même rang tirent les mêmes pertes d'une combinaison
+ *        à l'autre (même graine), pour que les écarts viennent des paramètres. Les gestionnaires envoient des blocs
+ *        de 512 octets, un bloc à la fois (options décodées mais pas négociées) : taille de bloc et fenêtre sont
+ *        rapportées, pas variées. Le numéro de bloc suivant 65535 (-r, comme --rollover) est vérifié par le client
+ *        simulé : un fichier de plus de 65535 blocs (-s 33554432 ou plus) passe le rebouclage sans rien écrire
+ *        sur le disque. Le contenu du fichier est calculé à partir de la position de chaque octet (motif aléatoire
+ *        de période SIM_PATTERN_SIZE), jamais conservé : le serveur le lit et l'écrit par des flux (fopencookie)
+ *        qui le génèrent ou le vérifient, le client simulé fait de même. La taille n'est donc pas limitée par la
+ *        mémoire (-s 4400000000 : plus de 4 Go, 131 rebouclages). Avec -e, le code de sortie signale tout transfert
+ *        en échec (make check).
+ *
+ *        Script de pertes (-x) : « data:N » ou « ack:N », séparés par des virgules ; chaque élément perd une
+ *        transmission du paquet de ce numéro de bloc (répéter l'élément pour perdre aussi les retransmissions).
+ *
+ *        Usage : ./sim [-m rrq|wrq|both] [-n transferts] [-s octets] [-T délais ms] [-c délai client ms]
+ *                      [-l pertes] [-d allers-retours ms] [-r rebouclages] [-x script] [-S graine] [-e] [-o fichier]
+ */
+
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "tftp.h"
+
+
+#define SIM_DEFAULT_TRANSFERS 1000      /* Transferts par combinaison de paramètres */
+#define SIM_DEFAULT_SIZE 65536          /* Taille du fichier transféré */
+#define SIM_MAX_EVENTS 32               /* Paquets en vol (deux sens) */
+#define SIM_MAX_VALUES 16               /* Valeurs d'une liste de paramètres */
+#define SIM_MAX_SCRIPT 64               /* Éléments du script de pertes */
+#define SIM_PATTERN_SIZE 4093           /* Période du contenu : premier, un bloc décalé de k * 512 octets ne correspond pas */
+
+
+/**
+ * @struct SimDrop
+ * @brief Élément du script de pertes.
+ */
+typedef struct SimDrop {
+    uint16_t opcode;                /* TFTP_OPCODE_DATA ou TFTP_OPCODE_ACK */
+    uint16_t block;
+} SimDrop;
+
+
+
+
+/**
+ * @struct SimParams
+ * @brief Paramètres d'une combinaison.
+ */
+typedef struct SimParams {
+    bool write;                     /* WRQ (sinon RRQ) */
+    int timeout_ms;                 /* Délai de retransmission du serveur (client->timeout_ms) */
+    int client_timeout_ms;          /* Délai de retransmission du client simulé */
+    double loss;                    /* Probabilité de perte de chaque paquet, dans les deux sens */
+    int rtt_ms;                     /* Aller-retour (délai d'un sens : la moitié) */
+    int rollover;                   /* Numéro du bloc qui suit 65535 (0 ou 1, client->rollover) */
+    const char* pattern;            /* Motif du contenu (SIM_PATTERN_SIZE octets, répété) */
+    uint64_t size;
+    const SimDrop* script;
+    int script_len;
+} SimParams;
+
+
+
+
+/**
+ * @struct SimFile
+ * @brief Flux du fichier côté serveur : génère le contenu (RRQ) ou vérifie le contenu écrit (WRQ).
+ */
+typedef struct SimFile {
+    const SimParams* params;
+    uint64_t pos;
+    bool mismatch;                  /* WRQ : octets écrits différents du fichier, ou au-delà de sa taille */
+} SimFile;
+
+
+
+
+/**
+ * @struct SimEvent
+ * @brief Paquet en vol, délivré à sa date d'arrivée.
+ */
+typedef struct SimEvent {
+    uint64_t at_us;
+    uint64_t seq;                   /* Ordre d'envoi (arrivées simultanées) */
+    bool to_server;
+    uint16_t len;
+    char packet[MAX_PACKET_SIZE];
+} SimEvent;
+
+
+
+
+/**
+ * @struct SimTransfer
+ * @brief État d'un transfert simulé : horloge, réseau et client.
+ */
+typedef struct SimTransfer {
+    const SimParams* params;
+    uint64_t now_us;                /* Horloge virtuelle */
+    uint64_t rng;
+    SimEvent events[SIM_MAX_EVENTS];
+    int event_count;
+    uint64_t seq;
+    bool script_used[SIM_MAX_SCRIPT];
+
+    uint16_t block;                 /* RRQ : dernier bloc reçu ; WRQ : dernier bloc envoyé */
+    uint64_t offset;                /* RRQ : octets reçus ; WRQ : début du bloc courant */
+    size_t current_len;             /* WRQ : taille du bloc courant */
+    bool started;                   /* WRQ : premier DATA envoyé */
+    bool done;
+    bool corrupt;                   /* RRQ : contenu reçu différent du fichier */
+    char last[MAX_PACKET_SIZE];     /* Dernier paquet du client (retransmis à l'expiration de son délai) */
+    size_t last_len;
+    uint64_t timer_at;              /* Expiration du délai du client (0 = aucune) */
+    int retries;
+
+    char last_server[MAX_PACKET_SIZE];
+    size_t last_server_len;
+    unsigned long server_packets;
+    unsigned long retransmits;      /* Paquets du serveur identiques au précédent */
+    unsigned long dropped;
+} SimTransfer;
+
+
+
+
+/**
+ * @struct SimResult
+ * @brief Résultats cumulés d'une combinaison.
+ */
+typedef struct SimResult {
+    unsigned long ok;
+    unsigned long failed;
+    uint64_t bytes;
+    uint64_t duration_us;           /* Transferts réussis */
+    uint64_t virtual_us;            /* Tous les transferts */
+    unsigned long server_packets;
+    unsigned long retransmits;
+    unsigned long dropped;
+} SimResult;
+
+
+static FILE* out;                   /* Résultats JSON (la sortie standard reçoit les messages des gestionnaires) */
+
+
+
+
+/**
+ * Fonction : now_ns
+ * Description : Cette fonction lit l'horloge monotone réelle (durée de la simulation).
+ * @return : La date en nanosecondes.
+ */
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+
+
+/**
+ * Fonction : random_unit
+ * Description : Cette fonction tire un nombre pseudo-aléatoire uniforme dans [0, 1) (splitmix64).
+ * @param state : L'état du générateur.
+ * @return : Le nombre tiré.
+ */
+static double random_unit(uint64_t* state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    z ^= z >> 31;
+    return (z >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+
+
+/**
+ * Fonction : fill_content
+ * Description : Cette fonction écrit len octets du fichier simulé à partir d'une position
+ *               (octet de la position p : pattern[p % SIM_PATTERN_SIZE]).
+ * @return : Aucune valeur de retour
+ */
+static void fill_content(const SimParams* params, uint64_t offset, char* buffer, size_t len) {
+    while (len > 0) {
+        size_t start = (size_t) (offset % SIM_PATTERN_SIZE);
+        size_t n = SIM_PATTERN_SIZE - start < len ? SIM_PATTERN_SIZE - start : len;
+        memcpy(buffer, params->pattern + start, n);
+        buffer += n;
+        offset += n;
+        len -= n;
+    }
+}
+
+
+
+
+/**
+ * Fonction : same_content
+ * Description : Cette fonction vérifie que len octets correspondent au fichier simulé à partir d'une position.
+ * @return : true si les octets et leur position sont ceux du fichier.
+ */
+static bool same_content(const SimParams* params, uint64_t offset, const char* buffer, size_t len) {
+    if (offset > params->size || len > params->size - offset) {
+        return false;
+    }
+    while (len > 0) {
+        size_t start = (size_t) (offset % SIM_PATTERN_SIZE);
+        size_t n = SIM_PATTERN_SIZE - start < len ? SIM_PATTERN_SIZE - start : len;
+        if (memcmp(buffer, params->pattern + start, n) != 0) {
+            return false;
+        }
+        buffer += n;
+        offset += n;
+        len -= n;
+    }
+    return true;
+}
+
+
+
+
+/**
+ * Fonction : file_read
+ * Description : Fonction de lecture du flux du serveur (fopencookie) : contenu généré à la position courante.
+ * @return : Le nombre d'octets lus (0 en fin de fichier).
+ */
+static ssize_t file_read(void* cookie, char* buffer, size_t size) {
+    SimFile* file = (SimFile*) cookie;
+    uint64_t left = file->params->size - file->pos;
+    size_t n = left < size ? (size_t) left : size;
+    fill_content(file->params, file->pos, buffer, n);
+    file->pos += n;
+    return (ssize_t) n;
+}
+
+
+
+
+/**
+ * Fonction : file_write
+ * Description : Fonction d'écriture du flux du serveur (fopencookie) : contenu vérifié à la position courante.
+ * @return : Le nombre d'octets écrits.
+ */
+static ssize_t file_write(void* cookie, const char* buffer, size_t size) {
+    SimFile* file = (SimFile*) cookie;
+    if (!same_content(file->params, file->pos, buffer, size)) {
+        file->mismatch = true;
+    }
+    file->pos += size;
+    return (ssize_t) size;
+}
+
+
+
+
+/**
+ * Fonction : packet_header
+ * Description : Cette fonction lit l'opcode et le numéro de bloc d'un paquet.
+ * @return : Aucune valeur de retour
+ */
+static void packet_header(const char* packet, size_t len, uint16_t* opcode, uint16_t* block) {
+    uint16_t fields[2] = { 0, 0 };
+    memcpy(fields, packet, len < sizeof(fields) ? len : sizeof(fields));
+    *opcode = ntohs(fields[0]);
+    *block = ntohs(fields[1]);
+}
+
+
+
+
+/**
+ * Fonction : expected_next_block
+ * Description : Cette fonction donne le numéro de bloc qui suit celui donné, pour le client simulé (référence
+ *               indépendante de next_block_number : après 65535 vient la valeur de rebouclage).
+ * @return : Le numéro du bloc suivant.
+ */
+static uint16_t expected_next_block(uint16_t block, int rollover) {
+    return block == 65535 ? (uint16_t) rollover : (uint16_t) (block + 1);
+}
+
+
+
+
+/**
+ * Fonction : is_lost
+ * Description : Cette fonction décide de la perte d'un paquet : script d'abord, puis tirage aléatoire.
+ * @return : true si le paquet est perdu.
+ */
+static bool is_lost(SimTransfer* t, const char* packet, size_t len) {
+    uint16_t opcode, block;
+    packet_header(packet, len, &opcode, &block);
+    for (int i = 0; i < t->params->script_len; i++) {
+        if (!t->script_used[i] && t->params->script[i].opcode == opcode && t->params->script[i].block == block) {
+            t->script_used[i] = true;
+            return true;
+        }
+    }
+    return t->params->loss > 0 && random_unit(&t->rng) < t->params->loss;
+}
+
+
+
+
+/**
+ * Fonction : transmit
+ * Description : Cette fonction met un paquet en vol vers le serveur ou le client, sauf s'il est perdu.
+ * @return : Aucune valeur de retour
+ */
+static void transmit(SimTransfer* t, bool to_server, const char* packet, size_t len) {
+    if (is_lost(t, packet, len) || t->event_count == SIM_MAX_EVENTS) {
+        t->dropped++;
+        return;
+    }
+    SimEvent* event = &t->events[t->event_count++];
+    event->at_us = t->now_us + (uint64_t) t->params->rtt_ms * 500;
+    event->seq = t->seq++;
+    event->to_server = to_server;
+    event->len = (uint16_t) len;
+    memcpy(event->packet, packet, len);
+}
+
+
+
+
+/**
+ * Fonction : client_send
+ * Description : Cette fonction envoie le dernier paquet du client et arme son délai de retransmission.
+ * @return : Aucune valeur de retour
+ */
+static void client_send(SimTransfer* t) {
+    t->timer_at = t->now_us + (uint64_t) t->params->client_timeout_ms * 1000;
+    transmit(t, true, t->last, t->last_len);
+}
+
+
+
+
+/**
+ * Fonction : client_receive
+ * Description : Cette fonction traite un paquet reçu par le client simulé. RRQ : un DATA attendu est vérifié et
+ *               acquitté, un DATA dupliqué est acquitté à nouveau. WRQ : l'ACK du dernier DATA envoyé déclenche
+ *               l'envoi du suivant, les autres ACK sont ignorés.
+ * @return : Aucune valeur de retour
+ */
+static void client_receive(SimTransfer* t, const char* packet, size_t len) {
+    uint16_t opcode, block;
+    packet_header(packet, len, &opcode, &block);
+    const SimParams* params = t->params;
+    uint16_t header[2];
+
+    if (!params->write) {
+        if (opcode != TFTP_OPCODE_DATA || len < TFTP_HEADER_SIZE) {
+            return;
+        }
+        size_t data_len = len - TFTP_HEADER_SIZE;
+        if (block == expected_next_block(t->block, params->rollover) && !t->done) {
+            if (!same_content(params, t->offset, packet + TFTP_HEADER_SIZE, data_len)) {
+                t->corrupt = true;
+            }
+            t->offset += data_len;
+            t->block = block;
+            t->done = data_len < MAX_DATA_SIZE;
+        } else if (block != t->block) {
+            return;
+        }
+        header[0] = htons(TFTP_OPCODE_ACK);
+        header[1] = htons(t->block);
+        memcpy(t->last, header, sizeof(header));
+        t->last_len = sizeof(header);
+        t->retries = 0;
+        client_send(t);
+        if (t->done) {
+            t->timer_at = 0;    // Dernier ACK : le client ne retransmet plus (il acquitte encore les DATA dupliqués)
+        }
+        return;
+    }
+
+    if (opcode != TFTP_OPCODE_ACK || block != t->block || t->done) {
+        return;
+    }
+    if (t->started) {
+        t->offset += t->current_len;
+        if (t->current_len < MAX_DATA_SIZE) {
+            t->done = true;
+            t->timer_at = 0;
+            return;
+        }
+    }
+    t->started = true;
+    t->block = expected_next_block(t->block, params->rollover);
+    t->current_len = params->size - t->offset < MAX_DATA_SIZE ? params->size - t->offset : MAX_DATA_SIZE;
+    header[0] = htons(TFTP_OPCODE_DATA);
+    header[1] = htons(t->block);
+    memcpy(t->last, header, sizeof(header));
+    fill_content(params, t->offset, t->last + TFTP_HEADER_SIZE, t->current_len);
+    t->last_len = TFTP_HEADER_SIZE + t->current_len;
+    t->retries = 0;
+    client_send(t);
+}
+
+
+
+
+/**
+ * Fonction : client_timeout
+ * Description : Cette fonction traite l'expiration du délai du client : retransmission du dernier paquet.
+ * @return : Aucune valeur de retour
+ */
+static void client_timeout(SimTransfer* t) {
+    if (t->last_len == 0 || t->done || t->retries >= MAX_RETRIES) {
+        return;
+    }
+    t->retries++;
+    client_send(t);
+}
+
+
+
+
+/**
+ * Fonction : sim_send
+ * Description : Fonction d'envoi du transport simulé (paquets du serveur).
+ * @return : La taille du paquet.
+ */
+static ssize_t sim_send(TFTP_Client* client, const void* buffer, size_t len) {
+    SimTransfer* t = (SimTransfer*) client->transport_ctx;
+    t->server_packets++;
+    if (len == t->last_server_len && memcmp(buffer, t->last_server, len) == 0) {
+        t->retransmits++;
+    } else if (len <= sizeof(t->last_server)) {
+        memcpy(t->last_server, buffer, len);
+        t->last_server_len = len;
+    }
+    transmit(t, false, (const char*) buffer, len);
+    return (ssize_t) len;
+}
+
+
+
+
+/**
+ * Fonction : sim_recv
+ * Description : Fonction de réception du transport simulé : l'horloge avance d'événement en événement (paquets
+ *               délivrés au client, délai du client) jusqu'au prochain paquet pour le serveur, ou jusqu'à l'expiration.
+ * @return : La taille du paquet reçu, -1 si le délai est écoulé (errno = EAGAIN).
+ */
+static ssize_t sim_recv(TFTP_Client* client, void* buffer, size_t len, int timeout_ms) {
+    SimTransfer* t = (SimTransfer*) client->transport_ctx;
+    uint64_t deadline = t->now_us + (uint64_t) timeout_ms * 1000;
+    for (;;) {
+        int next = -1;
+        for (int i = 0; i < t->event_count; i++) {
+            if (next == -1 || t->events[i].at_us < t->events[next].at_us
+                || (t->events[i].at_us == t->events[next].at_us && t->events[i].seq < t->events[next].seq)) {
+                next = i;
+            }
+        }
+        uint64_t event_at = next >= 0 ? t->events[next].at_us : UINT64_MAX;
+        if (t->timer_at != 0 && t->timer_at <= event_at && t->timer_at <= deadline) {
+            t->now_us = t->timer_at;
+            t->timer_at = 0;
+            client_timeout(t);
+            continue;
+        }
+        if (next < 0 || event_at > deadline) {
+            t->now_us = deadline;
+            errno = EAGAIN;
+            return -1;
+        }
+
+        SimEvent event = t->events[next];
+        t->events[next] = t->events[--t->event_count];
+        t->now_us = event.at_us;
+        if (event.to_server) {
+            size_t n = event.len < len ? event.len : len;
+            memcpy(buffer, event.packet, n);
+            return (ssize_t) n;
+        }
+        client_receive(t, event.packet, event.len);
+    }
+}
+
+
+
+
+/**
+ * Fonction : sim_now_us
+ * Description : Fonction d'horloge du transport simulé.
+ * @return : La date virtuelle en microsecondes.
+ */
+static uint64_t sim_now_us(TFTP_Client* client) {
+    return ((SimTransfer*) client->transport_ctx)->now_us;
+}
+
+
+static const TFTP_Transport sim_transport = { sim_send, sim_recv, sim_now_us };
+
+
+
+
+/**
+ * Fonction : run_transfer
+ * Description : Cette fonction exécute un transfert simulé avec le gestionnaire RRQ ou WRQ du serveur.
+ * @param params : Les paramètres de la combinaison.
+ * @param seed : La graine du transfert.
+ * @param t : L'état du transfert (réinitialisé).
+ * @param result : Les résultats cumulés.
+ * @return : 0 en cas de succès de la simulation (transfert réussi ou non), -1 en cas d'erreur.
+ */
+static int run_transfer(const SimParams* params, uint64_t seed, SimTransfer* t, SimResult* result) {
+    char packet[64];
+    int packet_len = snprintf(packet + 2, sizeof(packet) - 2, "sim.bin%coctet", '\0') + 3;
+    uint16_t opcode = htons(params->write ? TFTP_OPCODE_WRQ : TFTP_OPCODE_RRQ);
+    memcpy(packet, &opcode, sizeof(opcode));
+    TFTP_Request request;
+    int error_code;
+    const char* error_message;
+    if (parse_request(packet, packet_len, &request, &error_code, &error_message) != 0) {
+        fprintf(stderr, "Requête simulée refusée : %s\n", error_message);
+        return -1;
+    }
+
+    memset(t, 0, sizeof(*t));
+    t->params = params;
+    t->rng = seed;
+    t->now_us = 1;
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(1069);
+    TFTP_Client* client = init_client(addr, "");
+    SimFile sim_file = { params, 0, false };
+    cookie_io_functions_t functions = { file_read, file_write, NULL, NULL };
+    FILE* file = fopencookie(&sim_file, params->write ? "wb" : "rb", functions);
+    if (client == NULL || file == NULL) {
+        free(client);
+        if (file != NULL) {
+            fclose(file);
+        }
+        return -1;
+    }
+    client->socket_fd = -1;
+    client->file = file;
+    client->timeout_ms = params->timeout_ms;
+    client->rollover = (uint16_t) params->rollover;
+    client->transport = &sim_transport;
+    client->transport_ctx = t;
+
+    uint64_t start_us = t->now_us;
+    int ret = params->write ? handle_write_request(client, &request) : handle_read_request(client, &request);
+    uint64_t duration_us = t->now_us - start_us;
+    fclose(file);
+    bool ok = ret == 0 && (params->write
+        ? client->bytes == params->size && sim_file.pos == params->size && !sim_file.mismatch
+        : t->done && !t->corrupt && t->offset == params->size);
+    free(client);
+
+    if (ok) {
+        result->ok++;
+        result->bytes += params->size;
+        result->duration_us += duration_us;
+    } else {
+        result->failed++;
+    }
+    result->virtual_us += duration_us;
+    result->server_packets += t->server_packets;
+    result->retransmits += t->retransmits;
+    result->dropped += t->dropped;
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : compare_u64
+ * Description : Fonction de comparaison de qsort pour des entiers non signés de 64 bits.
+ */
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*) a;
+    uint64_t y = *(const uint64_t*) b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+
+
+
+/**
+ * Fonction : run_setting
+ * Description : Cette fonction exécute les transferts d'une combinaison et écrit sa ligne JSON.
+ * @param params : Les paramètres de la combinaison.
+ * @param transfers : Le nombre de transferts.
+ * @param seed : La graine de l'exécution.
+ * @param virtual_us : Un pointeur qui cumule la durée virtuelle simulée.
+ * @param failed : Un pointeur qui cumule les transferts en échec.
+ * @return : 0 en cas de succès, -1 en cas d'erreur.
+ */
+static int run_setting(const SimParams* params, long transfers, uint64_t seed, uint64_t* virtual_us, unsigned long* failed) {
+    SimTransfer* t = (SimTransfer*) malloc(sizeof(SimTransfer));
+    uint64_t* durations = (uint64_t*) malloc(sizeof(uint64_t) * (size_t) transfers);
+    if (t == NULL || durations == NULL) {
+        free(t);
+        free(durations);
+        return -1;
+    }
+    SimResult result;
+    memset(&result, 0, sizeof(result));
+    int ret = 0;
+    long count = 0;
+    for (long i = 0; i < transfers && ret == 0; i++) {
+        uint64_t before = result.duration_us;
+        unsigned long ok = result.ok;
+        ret = run_transfer(params, seed ^ ((uint64_t) i * 0x9e3779b97f4a7c15ULL), t, &result);
+        if (result.ok != ok) {
+            durations[count++] = result.duration_us - before;
+        }
+    }
+    if (ret == 0) {
+        qsort(durations, (size_t) count, sizeof(uint64_t), compare_u64);
+        fprintf(out, "{\"suite\":\"sim\",\"op\":\"%s\",\"timeout_ms\":%d,\"client_timeout_ms\":%d,\"loss\":%.4f,\"rtt_ms\":%d,"
+                     "\"block_size\":%d,\"window\":1,\"rollover\":%d,\"bytes\":%" PRIu64 ",\"blocks\":%" PRIu64 ",\"transfers\":%ld,\"ok\":%lu,\"failed\":%lu,"
+                     "\"goodput_kBps\":%.1f,\"p50_ms\":%.3f,\"p99_ms\":%.3f,\"max_ms\":%.3f,"
+                     "\"server_packets\":%lu,\"retransmits\":%lu,\"dropped\":%lu}\n",
+                params->write ? "wrq" : "rrq", params->timeout_ms, params->client_timeout_ms, params->loss, params->rtt_ms,
+                MAX_DATA_SIZE, params->rollover, params->size, params->size / MAX_DATA_SIZE + 1, transfers, result.ok, result.failed,
+                result.duration_us > 0 ? result.bytes * 1000.0 / result.duration_us : 0.0,
+                count > 0 ? durations[(count - 1) / 2] / 1000.0 : 0.0,
+                count > 0 ? durations[(count - 1) * 99 / 100] / 1000.0 : 0.0,
+                count > 0 ? durations[count - 1] / 1000.0 : 0.0,
+                result.server_packets, result.retransmits, result.dropped);
+        fflush(out);
+        *virtual_us += result.virtual_us;
+        *failed += result.failed;
+    }
+    free(t);
+    free(durations);
+    return ret;
+}
+
+
+
+
+/**
+ * Fonction : parse_list
+ * Description : Cette fonction lit une liste de nombres séparés par des virgules.
+ * @param text : La liste.
+ * @param values : Le tableau qui reçoit les valeurs (SIM_MAX_VALUES au plus).
+ * @return : Le nombre de valeurs, -1 si la liste est invalide.
+ */
+static int parse_list(const char* text, double* values) {
+    int count = 0;
+    const char* p = text;
+    while (*p != '\0') {
+        char* end;
+        double value = strtod(p, &end);
+        if (end == p || value < 0 || count == SIM_MAX_VALUES || (*end != ',' && *end != '\0')) {
+            return -1;
+        }
+        values[count++] = value;
+        p = *end == ',' ? end + 1 : end;
+    }
+    return count > 0 ? count : -1;
+}
+
+
+
+
+/**
+ * Fonction : parse_script
+ * Description : Cette fonction lit le script de pertes (« data:N,ack:N,... »).
+ * @param text : Le script.
+ * @param script : Le tableau qui reçoit les éléments (SIM_MAX_SCRIPT au plus).
+ * @return : Le nombre d'éléments, -1 si le script est invalide.
+ */
+static int parse_script(const char* text, SimDrop* script) {
+    int count = 0;
+    const char* p = text;
+    while (*p != '\0') {
+        uint16_t opcode;
+        if (strncmp(p, "data:", 5) == 0) {
+            opcode = TFTP_OPCODE_DATA;
+            p += 5;
+        } else if (strncmp(p, "ack:", 4) == 0) {
+            opcode = TFTP_OPCODE_ACK;
+            p += 4;
+        } else {
+            return -1;
+        }
+        char* end;
+        long block = strtol(p, &end, 10);
+        if (end == p || block < 0 || block > 65535 || count == SIM_MAX_SCRIPT || (*end != ',' && *end != '\0')) {
+            return -1;
+        }
+        script[count].opcode = opcode;
+        script[count].block = (uint16_t) block;
+        count++;
+        p = *end == ',' ? end + 1 : end;
+    }
+    return count;
+}
+
+
+
+
+/**
+ * Fonction : print_usage
+ * Description : Cette fonction affiche l'aide de la ligne de commande.
+ * @param prog : Le nom du programme.
+ */
+static void print_usage(const char* prog) {
+    fprintf(stderr, "Usage : %s [options]\n"
+                    "  -m MODE      transferts simulés : rrq, wrq ou both (défaut : both)\n"
+                    "  -n N         transferts par combinaison (défaut : %d)\n"
+                    "  -s OCTETS    taille du fichier transféré (défaut : %d)\n"
+                    "  -T MS,...    délais de retransmission du serveur (défaut : %d)\n"
+                    "  -c MS        délai de retransmission du client (défaut : celui du serveur)\n"
+                    "  -l P,...     probabilités de perte de chaque paquet (défaut : 0)\n"
+                    "  -d MS,...    allers-retours du réseau (défaut : 1)\n"
+                    "  -r R,...     numéro du bloc qui suit 65535, 0 ou 1 (défaut : 0)\n"
+                    "  -x SCRIPT    pertes scriptées, ex. data:3,ack:3,ack:3 (chaque élément perd une transmission)\n"
+                    "  -S GRAINE    graine des pertes aléatoires (défaut : 1)\n"
+                    "  -e           code de sortie 1 si un transfert échoue (vérifications)\n"
+                    "  -o FICHIER   fichier de résultats JSON, une combinaison par ligne (défaut : sortie standard)\n",
+            prog, SIM_DEFAULT_TRANSFERS, SIM_DEFAULT_SIZE, TIMEOUT_SECONDS * 1000);
+}
+
+
+
+
+int main(int argc, char* argv[]) {
+    const char* mode = "both";
+    const char* output = NULL;
+    long transfers = SIM_DEFAULT_TRANSFERS;
+    long long size = SIM_DEFAULT_SIZE;
+    double timeouts[SIM_MAX_VALUES] = { TIMEOUT_SECONDS * 1000 };
+    double losses[SIM_MAX_VALUES] = { 0 };
+    double rtts[SIM_MAX_VALUES] = { 1 };
+    double rollovers[SIM_MAX_VALUES] = { 0 };
+    int timeout_count = 1, loss_count = 1, rtt_count = 1, rollover_count = 1;
+    bool check = false;
+    int client_timeout_ms = 0;
+    SimDrop script[SIM_MAX_SCRIPT];
+    int script_len = 0;
+    uint64_t seed = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "m:n:s:T:c:l:d:r:x:S:eo:h")) != -1) {
+        switch (opt) {
+            case 'm': mode = optarg; break;
+            case 'n': transfers = strtol(optarg, NULL, 10); break;
+            case 's': size = strtoll(optarg, NULL, 10); break;
+            case 'T': timeout_count = parse_list(optarg, timeouts); break;
+            case 'c': client_timeout_ms = atoi(optarg); break;
+            case 'l': loss_count = parse_list(optarg, losses); break;
+            case 'd': rtt_count = parse_list(optarg, rtts); break;
+            case 'r': rollover_count = parse_list(optarg, rollovers); break;
+            case 'x': script_len = parse_script(optarg, script); break;
+            case 'S': seed = strtoull(optarg, NULL, 10); break;
+            case 'e': check = true; break;
+            case 'o': output = optarg; break;
+            default:
+                print_usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    bool rrq = strcmp(mode, "rrq") == 0 || strcmp(mode, "both") == 0;
+    bool wrq = strcmp(mode, "wrq") == 0 || strcmp(mode, "both") == 0;
+    if (transfers <= 0 || size < 0 || timeout_count < 0 || loss_count < 0 || rtt_count < 0 || rollover_count < 0
+        || script_len < 0 || client_timeout_ms < 0 || (!rrq && !wrq)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    for (int i = 0; i < timeout_count; i++) {
+        if (timeouts[i] < 1) {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    for (int i = 0; i < rollover_count; i++) {
+        if (rollovers[i] != 0 && rollovers[i] != 1) {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    // Les résultats sont écrits sur une copie de la sortie standard : les messages des gestionnaires
+    // (requêtes, retransmissions) sont écartés.
+    out = output != NULL ? fopen(output, "w") : fdopen(dup(STDOUT_FILENO), "w");
+    if (out == NULL || freopen("/dev/null", "w", stdout) == NULL) {
+        perror("Erreur lors de l'ouverture du fichier de résultats");
+        return 1;
+    }
+
+    char pattern[SIM_PATTERN_SIZE];
+    uint64_t fill = seed;
+    for (int i = 0; i < SIM_PATTERN_SIZE; i++) {
+        pattern[i] = (char) (random_unit(&fill) * 256);
+    }
+
+    uint64_t wall_start = now_ns();
+    uint64_t virtual_us = 0;
+    long settings = 0;
+    unsigned long failed = 0;
+    int ret = 0;
+    for (int w = 0; w < 2 && ret == 0; w++) {
+        if ((w == 0 && !rrq) || (w == 1 && !wrq)) {
+            continue;
+        }
+        for (int r = 0; r < rollover_count && ret == 0; r++) {
+            for (int i = 0; i < timeout_count && ret == 0; i++) {
+                for (int j = 0; j < loss_count && ret == 0; j++) {
+                    for (int k = 0; k < rtt_count && ret == 0; k++) {
+                        SimParams params = {
+                            w == 1, (int) timeouts[i], client_timeout_ms > 0 ? client_timeout_ms : (int) timeouts[i],
+                            losses[j], (int) rtts[k], (int) rollovers[r], pattern, (uint64_t) size, script, script_len
+                        };
+                        ret = run_setting(&params, transfers, seed, &virtual_us, &failed);
+                        settings++;
+                    }
+                }
+            }
+        }
+    }
+    if (ret == 0) {
+        fprintf(out, "{\"suite\":\"sim\",\"settings\":%ld,\"transfers\":%ld,\"failed\":%lu,\"virtual_s\":%.1f,\"wall_ms\":%.1f}\n",
+                settings, settings * transfers, failed, virtual_us / 1e6, (now_ns() - wall_start) / 1e6);
+    }
+    if (check && failed > 0) {
+        fprintf(stderr, "%lu transfert(s) simulé(s) en échec\n", failed);
+    }
+    fclose(out);
+    return ret == 0 && !(check && failed > 0) ? 0 : 1;
+}
@@ -0,0 +1,177 @@
+/**
+ * @file sockfilter.c
+ * @brief Implémentation des filtres BPF classiques des sockets.
+ *        Sur un socket UDP, le programme voit le datagramme à partir de l'en-tête UDP (8 octets) :
+ *        la charge utile TFTP commence à l'offset UDP_HEADER_SIZE, et la longueur chargée inclut l'en-tête.
+ */
+
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <linux/filter.h>
+#include <linux/sock_diag.h>
+
+#include "sockfilter.h"
+#include "tftp.h"
+
+#define UDP_HEADER_SIZE 8
+#define MIN_REQUEST_SIZE 11             /* Opcode + nom d'un caractère + « octet » : même seuil que le thread d'écoute */
+#define BPF_ACCEPT 0xFFFFFFFF           /* Datagramme conservé entier */
+#define BPF_DROP 0
+
+
+
+/* Requêtes : longueur minimale, opcode RRQ ou WRQ, dernier octet nul (fin du mode ou de la dernière option) */
+static struct sock_filter listener_program[] = {
+    BPF_STMT(BPF_LD | BPF_W | BPF_LEN, 0),
+    BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, UDP_HEADER_SIZE + MIN_REQUEST_SIZE, 0, 9),
+    BPF_STMT(BPF_LD | BPF_H | BPF_ABS, UDP_HEADER_SIZE),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, TFTP_OPCODE_RRQ, 1, 0),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, TFTP_OPCODE_WRQ, 0, 6),
+    BPF_STMT(BPF_LD | BPF_W | BPF_LEN, 0),
+    BPF_STMT(BPF_ALU | BPF_SUB | BPF_K, 1),
+    BPF_STMT(BPF_MISC | BPF_TAX, 0),
+    BPF_STMT(BPF_LD | BPF_B | BPF_IND, 0),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 0, 1),
+    BPF_STMT(BPF_RET | BPF_K, BPF_ACCEPT),
+    BPF_STMT(BPF_RET | BPF_K, BPF_DROP),
+};
+
+/* Transferts : en-tête TFTP complet, opcode DATA, ACK ou ERROR */
+static struct sock_filter transfer_program[] = {
+    BPF_STMT(BPF_LD | BPF_W | BPF_LEN, 0),
+    BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, UDP_HEADER_SIZE + TFTP_HEADER_SIZE, 0, 5),
+    BPF_STMT(BPF_LD | BPF_H | BPF_ABS, UDP_HEADER_SIZE),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, TFTP_OPCODE_DATA, 2, 0),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, TFTP_OPCODE_ACK, 1, 0),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, TFTP_OPCODE_ERR, 0, 1),
+    BPF_STMT(BPF_RET | BPF_K, BPF_ACCEPT),
+    BPF_STMT(BPF_RET | BPF_K, BPF_DROP),
+};
+
+
+
+
+/**
+ * Fonction : socket_drops
+ * Description : Cette fonction lit le nombre de datagrammes rejetés par le noyau sur un socket.
+ * @param sockfd : Le socket.
+ * @return : Le nombre de rejets (0 si SO_MEMINFO n'est pas disponible).
+ */
+static uint32_t socket_drops(int sockfd) {
+    uint32_t meminfo[SK_MEMINFO_VARS];
+    socklen_t len = sizeof(meminfo);
+    memset(meminfo, 0, sizeof(meminfo));
+    if (getsockopt(sockfd, SOL_SOCKET, SO_MEMINFO, meminfo, &len) < 0 || len <= SK_MEMINFO_DROPS * sizeof(uint32_t)) {
+        return 0;
+    }
+    return meminfo[SK_MEMINFO_DROPS];
+}
+
+
+
+
+/**
+ * Fonction : sockfilter_init
+ * Description : Cette fonction initialise les filtres des sockets.
+ * @param filter : Les filtres à initialiser.
+ * @param enabled : false pour ne jamais attacher de filtre.
+ * @return : Aucune valeur de retour
+ */
+void sockfilter_init(SocketFilter* filter, bool enabled) {
+    memset(filter, 0, sizeof(*filter));
+    filter->enabled = enabled;
+    filter->listener_fd = -1;
+    pthread_mutex_init(&filter->mutex, NULL);
+}
+
+
+
+
+/**
+ * Fonction : sockfilter_attach
+ * Description : Cette fonction attache le programme BPF du type demandé à un socket.
+ *               Un échec n'est pas fatal : le socket fonctionne sans filtre (les vérifications restent faites en espace utilisateur).
+ * @param filter : Les filtres.
+ * @param sockfd : Le socket.
+ * @param kind : Le programme à attacher.
+ * @return : 0 en cas de succès ou si les filtres sont désactivés, -1 en cas d'échec (errno positionné).
+ */
+int sockfilter_attach(SocketFilter* filter, int sockfd, SockFilterKind kind) {
+    if (!filter->enabled) {
+        return 0;
+    }
+
+    struct sock_fprog program;
+    if (kind == SOCKFILTER_LISTENER) {
+        program.len = sizeof(listener_program) / sizeof(listener_program[0]);
+        program.filter = listener_program;
+    } else {
+        program.len = sizeof(transfer_program) / sizeof(transfer_program[0]);
+        program.filter = transfer_program;
+    }
+
+    int ret = setsockopt(sockfd, SOL_SOCKET, SO_ATTACH_FILTER, &program, sizeof(program));
+    int saved_errno = errno;
+    pthread_mutex_lock(&filter->mutex);
+    if (ret == 0) {
+        filter->attached++;
+        if (kind == SOCKFILTER_LISTENER) {
+            filter->listener_fd = sockfd;
+        }
+    } else {
+        filter->failures++;
+    }
+    pthread_mutex_unlock(&filter->mutex);
+    errno = saved_errno;
+    return ret;
+}
+
+
+
+
+/**
+ * Fonction : sockfilter_collect
+ * Description : Cette fonction ajoute aux compteurs les rejets d'un socket de transfert à la fin d'un transfert.
+ *               Le compteur du noyau est cumulatif : seuls les rejets apparus depuis la dernière lecture sont ajoutés
+ *               (un socket du pool sert à plusieurs transferts).
+ * @param filter : Les filtres.
+ * @param sockfd : Le socket de transfert.
+ * @param seen : Les rejets déjà comptés pour ce socket (mis à jour).
+ * @return : Aucune valeur de retour
+ */
+void sockfilter_collect(SocketFilter* filter, int sockfd, uint32_t* seen) {
+    if (!filter->enabled) {
+        return;
+    }
+    uint32_t drops = socket_drops(sockfd);
+    if (drops > *seen) {
+        pthread_mutex_lock(&filter->mutex);
+        filter->transfer_drops += drops - *seen;
+        pthread_mutex_unlock(&filter->mutex);
+    }
+    *seen = drops;
+}
+
+
+
+
+/**
+ * Fonction : sockfilter_report
+ * Description : Cette fonction affiche les compteurs des filtres.
+ * @param filter : Les filtres.
+ * @param out : Le flux de sortie.
+ * @return : Aucune valeur de retour
+ */
+void sockfilter_report(SocketFilter* filter, FILE* out) {
+    if (!filter->enabled) {
+        return;
+    }
+    pthread_mutex_lock(&filter->mutex);
+    uint32_t listener_drops = filter->listener_fd >= 0 ? socket_drops(filter->listener_fd) : 0;
+    fprintf(out, "[BPF] filtres attachés %lu (échecs %lu) | rejetés par le noyau : écoute %u, transferts terminés %llu (filtre ou tampon plein)\n",
+            filter->attached, filter->failures, listener_drops, filter->transfer_drops);
+    pthread_mutex_unlock(&filter->mutex);
+}
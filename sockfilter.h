@@ -0,0 +1,52 @@
+/**
+ * @file sockfilter.h
+ * @brief Filtres BPF classiques (SO_ATTACH_FILTER) des sockets du serveur : le noyau rejette les datagrammes
+ *        inutiles (trop courts, opcode inattendu) sans réveiller le thread d'écoute ni les threads de transfert.
+ */
+
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifndef SOCKFILTER_H
+#define SOCKFILTER_H
+
+
+/**
+ * @enum SockFilterKind
+ * @brief Programme à attacher à un socket.
+ */
+typedef enum {
+    SOCKFILTER_LISTENER = 0,    /* Port d'écoute : RRQ/WRQ d'au moins 11 octets, terminés par un octet nul */
+    SOCKFILTER_TRANSFER         /* Socket de transfert : DATA/ACK/ERROR d'au moins 4 octets */
+} SockFilterKind;
+
+
+
+
+/**
+ * @struct SocketFilter
+ * @brief Filtres attachés et compteurs des datagrammes rejetés par le noyau.
+ *        Le noyau compte les rejets par socket (SK_MEMINFO_DROPS, lu avec SO_MEMINFO) ; ce compteur inclut
+ *        aussi les datagrammes perdus faute de place dans le tampon de réception.
+ */
+typedef struct SocketFilter {
+    bool enabled;
+    int listener_fd;                /* Socket d'écoute filtré (-1 = aucun) */
+    pthread_mutex_t mutex;
+
+    unsigned long attached;         /* Filtres attachés */
+    unsigned long failures;         /* Échecs de SO_ATTACH_FILTER (le socket reste sans filtre) */
+    unsigned long long transfer_drops;  /* Rejets cumulés des sockets de transfert, relevés en fin de transfert */
+} SocketFilter;
+
+
+
+void sockfilter_init(SocketFilter* filter, bool enabled);
+int sockfilter_attach(SocketFilter* filter, int sockfd, SockFilterKind kind);
+void sockfilter_collect(SocketFilter* filter, int sockfd, uint32_t* seen);
+void sockfilter_report(SocketFilter* filter, FILE* out);
+
+#endif
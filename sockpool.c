@@ -0,0 +1,300 @@
+/**
+ * @file sockpool.c
+ * @brief Implémentation du pool de sockets de transfert.
+ *        Pour un datagramme UDP, le noyau préfère le socket connecté à l'expéditeur parmi ceux liés au même port :
+ *        pendant un transfert, le socket du pool ne reçoit que les paquets de son client, et son jumeau (non connecté)
+ *        reçoit ceux des autres expéditeurs. Au retour dans le pool, le socket est déconnecté (AF_UNSPEC) et garde son port.
+ */
+
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#include "sockpool.h"
+#include "tftp.h"
+
+#define STRAY_EVENTS 16
+
+
+
+/**
+ * Fonction : bind_socket
+ * Description : Cette fonction crée un socket UDP réutilisable (SO_REUSEADDR) et le lie à un port de toutes les interfaces.
+ * @param port : Le port (0 : port éphémère choisi par le noyau).
+ * @return : Le descripteur du socket, -1 en cas d'erreur (errno positionné).
+ */
+static int bind_socket(uint16_t port) {
+    int sockfd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (sockfd < 0) {
+        return -1;
+    }
+    int on = 1;
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) < 0
+        || bind(sockfd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        int saved_errno = errno;
+        close(sockfd);
+        errno = saved_errno;
+        return -1;
+    }
+    return sockfd;
+}
+
+
+
+
+/**
+ * Fonction : open_pair
+ * Description : Cette fonction crée un socket du pool et son jumeau sur un même port éphémère.
+ *               Le jumeau est lié en premier pour obtenir le port, le socket du pool est ensuite lié explicitement
+ *               à ce port (il le conserve ainsi après chaque déconnexion).
+ * @param pool : Le pool.
+ * @param entry : L'entrée à remplir.
+ * @return : 0 en cas de succès, -1 en cas d'erreur (errno positionné).
+ */
+static int open_pair(SocketPool* pool, PooledSocket* entry) {
+    entry->stray_fd = bind_socket(0);
+    if (entry->stray_fd < 0) {
+        return -1;
+    }
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    if (getsockname(entry->stray_fd, (struct sockaddr*)&addr, &len) < 0
+        || (entry->fd = bind_socket(ntohs(addr.sin_port))) < 0) {
+        int saved_errno = errno;
+        close(entry->stray_fd);
+        errno = saved_errno;
+        return -1;
+    }
+    entry->port = ntohs(addr.sin_port);
+    sockfilter_attach(pool->filter, entry->fd, SOCKFILTER_TRANSFER);
+    sockfilter_attach(pool->filter, entry->stray_fd, SOCKFILTER_TRANSFER);
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : stray_loop
+ * Description : Fonction du thread des paquets égarés : répond UnknownTransferID aux paquets reçus par les jumeaux
+ *               (expéditeur autre que le client du transfert), sauf aux paquets ERROR (RFC 1350 : jamais d'erreur en réponse à une erreur).
+ * @param arg : Le pool.
+ * @return : Aucune valeur de retour (le thread ne se termine pas).
+ */
+static void* stray_loop(void* arg) {
+    SocketPool* pool = (SocketPool*)arg;
+    struct epoll_event events[STRAY_EVENTS];
+    char buffer[MAX_PACKET_SIZE];
+
+    for (;;) {
+        int n = epoll_wait(pool->epoll_fd, events, STRAY_EVENTS, -1);
+        for (int i = 0; i < n; i++) {
+            int stray_fd = events[i].data.fd;
+            struct sockaddr_in from;
+            socklen_t from_len = sizeof(from);
+            ssize_t len;
+            while ((len = recvfrom(stray_fd, buffer, sizeof(buffer), MSG_DONTWAIT, (struct sockaddr*)&from, &from_len)) >= 0) {
+                uint16_t opcode = len >= 2 ? (uint16_t) ((unsigned char) buffer[0] << 8 | (unsigned char) buffer[1]) : 0;
+                if (opcode != TFTP_OPCODE_ERR) {
+                    send_error_packet(stray_fd, &from, UnknownTransferID, get_error_message(UnknownTransferID), NULL);
+                }
+                pthread_mutex_lock(&pool->mutex);
+                pool->strays++;
+                pthread_mutex_unlock(&pool->mutex);
+                from_len = sizeof(from);
+            }
+        }
+    }
+    return NULL;
+}
+
+
+
+
+/**
+ * Fonction : sockpool_init
+ * Description : Cette fonction crée les sockets du pool, leurs jumeaux et le thread des paquets égarés.
+ *               Le thread hérite du masque de signaux de l'appelant.
+ * @param pool : Le pool à initialiser.
+ * @param size : Le nombre de sockets (0 : un socket créé pour chaque transfert).
+ * @param filter : Les filtres BPF à attacher aux sockets.
+ * @return : 0 en cas de succès, -1 en cas d'erreur (errno positionné).
+ */
+int sockpool_init(SocketPool* pool, int size, SocketFilter* filter) {
+    memset(pool, 0, sizeof(*pool));
+    pool->filter = filter;
+    pool->epoll_fd = -1;
+    pthread_mutex_init(&pool->mutex, NULL);
+    if (size <= 0) {
+        return 0;
+    }
+
+    pool->sockets = (PooledSocket*)calloc(size, sizeof(PooledSocket));
+    pool->free_ring = (int*)calloc(size, sizeof(int));
+    pool->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (pool->sockets == NULL || pool->free_ring == NULL || pool->epoll_fd < 0) {
+        return -1;
+    }
+
+    for (int i = 0; i < size; i++) {
+        PooledSocket* entry = &pool->sockets[i];
+        if (open_pair(pool, entry) < 0) {
+            return -1;
+        }
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.fd = entry->stray_fd;
+        if (epoll_ctl(pool->epoll_fd, EPOLL_CTL_ADD, entry->stray_fd, &event) < 0) {
+            return -1;
+        }
+        pool->free_ring[i] = i;
+        pool->size++;
+    }
+    pool->num_free = pool->size;
+
+    int ret = pthread_create(&pool->stray_thread, NULL, stray_loop, pool);
+    if (ret != 0) {
+        errno = ret;
+        return -1;
+    }
+    pthread_detach(pool->stray_thread);
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : connect_peer
+ * Description : Cette fonction connecte un socket à l'adresse du client.
+ * @return : 0 en cas de succès, -1 en cas d'erreur (errno positionné).
+ */
+static int connect_peer(int sockfd, const struct sockaddr_in* peer) {
+    return connect(sockfd, (const struct sockaddr*)peer, sizeof(*peer));
+}
+
+
+
+
+/**
+ * Fonction : sockpool_checkout
+ * Description : Cette fonction fournit un socket de transfert connecté au client.
+ *               Les sockets libres sont réutilisés dans l'ordre de leur libération ; si le pool est vide,
+ *               un socket est créé (le port éphémère est alors choisi par le noyau lors du connect).
+ * @param pool : Le pool.
+ * @param peer : L'adresse du client.
+ * @return : Le descripteur du socket, -1 en cas d'erreur (errno positionné).
+ */
+int sockpool_checkout(SocketPool* pool, const struct sockaddr_in* peer) {
+    pthread_mutex_lock(&pool->mutex);
+    if (pool->num_free > 0) {
+        PooledSocket* entry = &pool->sockets[pool->free_ring[pool->free_head]];
+        pool->free_head = (pool->free_head + 1) % pool->size;
+        pool->num_free--;
+        entry->in_use = true;
+        pool->checkouts++;
+        if (pool->size - pool->num_free > pool->max_in_use) {
+            pool->max_in_use = pool->size - pool->num_free;
+        }
+        pthread_mutex_unlock(&pool->mutex);
+
+        if (connect_peer(entry->fd, peer) < 0) {
+            int saved_errno = errno;
+            sockpool_release(pool, entry->fd);
+            pthread_mutex_lock(&pool->mutex);
+            pool->failures++;
+            pthread_mutex_unlock(&pool->mutex);
+            errno = saved_errno;
+            return -1;
+        }
+        // Paquets reçus avant la connexion (socket libre) : ils ne concernent pas ce transfert
+        char discard[MAX_PACKET_SIZE];
+        while (recv(entry->fd, discard, sizeof(discard), MSG_DONTWAIT) >= 0) {
+        }
+        return entry->fd;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    int sockfd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (sockfd >= 0) {
+        sockfilter_attach(pool->filter, sockfd, SOCKFILTER_TRANSFER);
+        if (connect_peer(sockfd, peer) < 0) {
+            int saved_errno = errno;
+            close(sockfd);
+            errno = saved_errno;
+            sockfd = -1;
+        }
+    }
+    pthread_mutex_lock(&pool->mutex);
+    if (sockfd >= 0) {
+        pool->fallbacks++;
+    } else {
+        pool->failures++;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return sockfd;
+}
+
+
+
+
+/**
+ * Fonction : sockpool_release
+ * Description : Cette fonction rend un socket de transfert : relevé des rejets du filtre, déconnexion et retour
+ *               en fin de file des sockets libres (un socket créé hors du pool est fermé).
+ * @param pool : Le pool.
+ * @param sockfd : Le socket fourni par sockpool_checkout.
+ * @return : Aucune valeur de retour
+ */
+void sockpool_release(SocketPool* pool, int sockfd) {
+    for (int i = 0; i < pool->size; i++) {
+        PooledSocket* entry = &pool->sockets[i];
+        if (entry->fd != sockfd) {
+            continue;
+        }
+        sockfilter_collect(pool->filter, sockfd, &entry->drops_seen);
+        struct sockaddr unspec;
+        memset(&unspec, 0, sizeof(unspec));
+        unspec.sa_family = AF_UNSPEC;
+        connect(sockfd, &unspec, sizeof(unspec));
+
+        pthread_mutex_lock(&pool->mutex);
+        entry->in_use = false;
+        pool->free_ring[(pool->free_head + pool->num_free) % pool->size] = i;
+        pool->num_free++;
+        pthread_mutex_unlock(&pool->mutex);
+        return;
+    }
+
+    uint32_t seen = 0;
+    sockfilter_collect(pool->filter, sockfd, &seen);
+    close(sockfd);
+}
+
+
+
+
+/**
+ * Fonction : sockpool_report
+ * Description : Cette fonction affiche les compteurs du pool de sockets.
+ * @param pool : Le pool.
+ * @param out : Le flux de sortie.
+ * @return : Aucune valeur de retour
+ */
+void sockpool_report(SocketPool* pool, FILE* out) {
+    pthread_mutex_lock(&pool->mutex);
+    fprintf(out, "[POOL] sockets %d (libres %d, max utilisés %d) | transferts servis par le pool %lu, hors pool %lu | échecs %lu | paquets d'un TID inconnu %lu\n",
+            pool->size, pool->num_free, pool->max_in_use, pool->checkouts, pool->fallbacks, pool->failures, pool->strays);
+    pthread_mutex_unlock(&pool->mutex);
+}
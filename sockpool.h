@@ -0,0 +1,66 @@
+/**
+ * @file sockpool.h
+ * @brief Pool de sockets de transfert créés et liés au démarrage, connectés (connect) au client le temps d'un transfert.
+ *        Le noyau ne délivre alors au transfert que les paquets de son client ; les paquets d'un autre identifiant
+ *        de transfert (TID) sont reçus par un socket jumeau et reçoivent l'erreur UnknownTransferID.
+ */
+
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <netinet/in.h>
+
+#include "sockfilter.h"
+
+#ifndef SOCKPOOL_H
+#define SOCKPOOL_H
+
+
+/**
+ * @struct PooledSocket
+ * @brief Socket de transfert du pool et son jumeau, liés au même port (SO_REUSEADDR).
+ *        Le socket connecté est préféré par le noyau pour les paquets de son client ; les autres vont au jumeau.
+ */
+typedef struct PooledSocket {
+    int fd;                         /* Socket de transfert (connecté pendant un transfert) */
+    int stray_fd;                   /* Jumeau non connecté : paquets des autres TID */
+    uint16_t port;
+    uint32_t drops_seen;            /* Rejets du noyau déjà comptés (voir sockfilter_collect) */
+    bool in_use;
+} PooledSocket;
+
+
+
+
+/**
+ * @struct SocketPool
+ * @brief Sockets libres (file FIFO : un port n'est réutilisé qu'après tous les autres) et thread des paquets égarés.
+ */
+typedef struct SocketPool {
+    PooledSocket* sockets;
+    int size;
+    int* free_ring;                 /* Indices des sockets libres (tampon circulaire) */
+    int free_head;
+    int num_free;
+    SocketFilter* filter;
+    int epoll_fd;                   /* Jumeaux surveillés par le thread des paquets égarés */
+    pthread_t stray_thread;
+    pthread_mutex_t mutex;
+
+    unsigned long checkouts;        /* Transferts servis par un socket du pool */
+    unsigned long fallbacks;        /* Transferts servis par un socket créé à la demande (pool vide) */
+    unsigned long failures;         /* Sockets qui n'ont pas pu être créés ou connectés */
+    unsigned long strays;           /* Paquets d'un TID inconnu (réponse UnknownTransferID) */
+    int max_in_use;
+} SocketPool;
+
+
+
+int sockpool_init(SocketPool* pool, int size, SocketFilter* filter);
+int sockpool_checkout(SocketPool* pool, const struct sockaddr_in* peer);
+void sockpool_release(SocketPool* pool, int sockfd);
+void sockpool_report(SocketPool* pool, FILE* out);
+
+#endif
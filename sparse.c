@@ -0,0 +1,225 @@
+/**
+ * @file sparse.c
+ * @brief Implémentation des écritures et lectures de fichiers creux.
+ *        Un fichier reçu est toujours un fichier temporaire neuf : les zones sautées sont des trous, sans
+ *        FALLOC_FL_PUNCH_HOLE. Le lecteur ne fait appel à SEEK_DATA/SEEK_HOLE qu'aux changements de zone, et
+ *        ne repositionne le flux (fseeko) qu'à ces moments-là.
+ */
+
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "sparse.h"
+
+
+
+/**
+ * Fonction : sparse_is_zero
+ * Description : Cette fonction indique si un bloc ne contient que des octets nuls (SSE2 : 16 octets par opération).
+ * @param data : Le bloc.
+ * @param len : La taille du bloc.
+ * @return : true si tous les octets sont nuls.
+ */
+bool sparse_is_zero(const void* data, size_t len) {
+    const unsigned char* p = (const unsigned char*) data;
+#if defined(__SSE2__)
+    __m128i acc = _mm_setzero_si128();
+    while (len >= 64) {
+        acc = _mm_or_si128(acc, _mm_or_si128(_mm_or_si128(_mm_loadu_si128((const __m128i*) p), _mm_loadu_si128((const __m128i*) (p + 16))),
+                                             _mm_or_si128(_mm_loadu_si128((const __m128i*) (p + 32)), _mm_loadu_si128((const __m128i*) (p + 48)))));
+        p += 64;
+        len -= 64;
+    }
+    while (len >= 16) {
+        acc = _mm_or_si128(acc, _mm_loadu_si128((const __m128i*) p));
+        p += 16;
+        len -= 16;
+    }
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(acc, _mm_setzero_si128())) != 0xFFFF) {
+        return false;
+    }
+#else
+    uint64_t acc = 0;
+    while (len >= 8) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        acc |= word;
+        p += 8;
+        len -= 8;
+    }
+    if (acc != 0) {
+        return false;
+    }
+#endif
+    while (len--) {
+        if (*p++ != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+
+
+/**
+ * Fonction : sparse_writer_init
+ * Description : Cette fonction prépare l'écriture d'un fichier reçu.
+ * @param writer : L'état d'écriture.
+ * @param file : Le flux du fichier temporaire (les flux sans descripteur sont écrits normalement).
+ * @return : Aucune valeur de retour
+ */
+void sparse_writer_init(SparseWriter* writer, FILE* file) {
+    memset(writer, 0, sizeof(*writer));
+    writer->enabled = file != NULL && fileno(file) >= 0;
+}
+
+
+
+
+/**
+ * Fonction : sparse_write
+ * Description : Cette fonction écrit un bloc reçu, ou le saute s'il est nul.
+ * @param writer : L'état d'écriture.
+ * @param file : Le flux du fichier.
+ * @param data : Le bloc.
+ * @param len : La taille du bloc.
+ * @return : Le nombre d'octets écrits ou sautés (inférieur à len en cas d'erreur, comme fwrite).
+ */
+size_t sparse_write(SparseWriter* writer, FILE* file, const void* data, size_t len) {
+    if (writer->enabled && len > 0 && sparse_is_zero(data, len)) {
+        writer->pending += len;
+        writer->skipped += len;
+        return len;
+    }
+    if (len == 0) {
+        return 0;       // Bloc final vide : les octets nuls en attente sont rétablis par sparse_writer_finish
+    }
+    if (writer->pending > 0) {
+        if (fseeko(file, (off_t) writer->pending, SEEK_CUR) != 0) {
+            return 0;
+        }
+        writer->pending = 0;
+    }
+    return fwrite(data, 1, len, file);
+}
+
+
+
+
+/**
+ * Fonction : sparse_writer_finish
+ * Description : Cette fonction rétablit la longueur d'un fichier qui se termine par des blocs nuls sautés
+ *               (à appeler après le dernier bloc, avant la validation du fichier).
+ * @param writer : L'état d'écriture.
+ * @param file : Le flux du fichier.
+ * @return : 0 en cas de succès, -1 en cas d'erreur (errno positionné).
+ */
+int sparse_writer_finish(SparseWriter* writer, FILE* file) {
+    if (writer->pending == 0) {
+        return 0;
+    }
+    off_t end;
+    if (fflush(file) != 0 || (end = ftello(file)) < 0 || ftruncate(fileno(file), end + (off_t) writer->pending) != 0
+        || fseeko(file, (off_t) writer->pending, SEEK_CUR) != 0) {
+        return -1;
+    }
+    writer->pending = 0;
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : sparse_reader_init
+ * Description : Cette fonction prépare la lecture d'un fichier envoyé ; seuls les fichiers qui occupent moins
+ *               de blocs que leur taille (donc creux) sont lus zone par zone.
+ * @param reader : L'état de lecture.
+ * @param file : Le flux du fichier ouvert au début.
+ * @return : Aucune valeur de retour
+ */
+void sparse_reader_init(SparseReader* reader, FILE* file) {
+    memset(reader, 0, sizeof(*reader));
+    reader->fd = file != NULL ? fileno(file) : -1;
+    struct stat st;
+    if (reader->fd < 0 || fstat(reader->fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        return;
+    }
+    reader->size = st.st_size;
+    reader->enabled = (off_t) st.st_blocks * 512 < st.st_size;
+}
+
+
+
+
+/**
+ * Fonction : find_region
+ * Description : Cette fonction détermine la zone (données ou trou) qui contient la position courante,
+ *               puis positionne le flux sur cette position.
+ * @param reader : L'état de lecture.
+ * @param file : Le flux du fichier.
+ * @return : 0 en cas de succès, -1 si SEEK_DATA n'est pas disponible (lecture normale jusqu'à la fin).
+ */
+static int find_region(SparseReader* reader, FILE* file) {
+    off_t data = lseek(reader->fd, reader->pos, SEEK_DATA);
+    if (data < 0 && errno == ENXIO) {
+        data = reader->size;        // Trou jusqu'à la fin du fichier
+    }
+    off_t hole = data == reader->pos ? lseek(reader->fd, reader->pos, SEEK_HOLE) : data;
+    if (data < 0 || hole < 0 || fseeko(file, reader->pos, SEEK_SET) != 0) {
+        reader->enabled = false;
+        return -1;
+    }
+    reader->in_hole = data > reader->pos;
+    reader->region_end = reader->in_hole ? data : hole;
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : sparse_read
+ * Description : Cette fonction lit le bloc suivant d'un fichier envoyé ; un bloc entièrement dans un trou est
+ *               produit sans lecture.
+ * @param reader : L'état de lecture.
+ * @param file : Le flux du fichier.
+ * @param buffer : Le tampon du bloc.
+ * @param len : La taille d'un bloc.
+ * @return : Le nombre d'octets lus (comme fread : inférieur à len en fin de fichier ou en cas d'erreur).
+ */
+size_t sparse_read(SparseReader* reader, FILE* file, void* buffer, size_t len) {
+    if (!reader->enabled) {
+        return fread(buffer, 1, len, file);
+    }
+    if (reader->pos >= reader->region_end && reader->pos < reader->size && find_region(reader, file) < 0) {
+        return fread(buffer, 1, len, file);
+    }
+
+    off_t available = reader->size - reader->pos;
+    size_t wanted = available < (off_t) len ? (size_t) (available > 0 ? available : 0) : len;
+    if (reader->in_hole && reader->pos + (off_t) wanted <= reader->region_end) {
+        memset(buffer, 0, wanted);
+        reader->pos += wanted;
+        reader->zero_bytes += wanted;
+        if (reader->pos >= reader->region_end && reader->region_end >= reader->size) {
+            fseeko(file, reader->pos, SEEK_SET);    // Fin de fichier : le flux reflète la position logique
+        }
+        return wanted;
+    }
+    if (reader->in_hole) {
+        fseeko(file, reader->pos, SEEK_SET);    // Bloc à cheval sur un trou et des données : lecture normale
+        reader->region_end = reader->pos;
+    }
+    size_t n = fread(buffer, 1, len, file);
+    reader->pos += n;
+    return n;
+}
@@ -0,0 +1,53 @@
+/**
+ * @file sparse.h
+ * @brief Fichiers creux : les blocs nuls reçus ne sont pas écrits (trous laissés par déplacement de la position,
+ *        longueur rétablie à la fin), et les trous des fichiers envoyés sont lus sans accès disque (SEEK_DATA/SEEK_HOLE).
+ */
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+#ifndef SPARSE_H
+#define SPARSE_H
+
+
+/**
+ * @struct SparseWriter
+ * @brief Écriture d'un fichier reçu : les blocs nuls consécutifs sont cumulés et sautés en un seul déplacement.
+ */
+typedef struct SparseWriter {
+    bool enabled;                   /* Flux associé à un fichier ordinaire (pas d'enveloppe fopencookie) */
+    uint64_t pending;               /* Octets nuls à sauter avant la prochaine écriture */
+    uint64_t skipped;               /* Octets nuls non écrits */
+} SparseWriter;
+
+
+
+
+/**
+ * @struct SparseReader
+ * @brief Lecture d'un fichier envoyé : zone courante (données ou trou) connue jusqu'à region_end.
+ */
+typedef struct SparseReader {
+    bool enabled;                   /* Fichier ordinaire qui contient au moins un trou */
+    int fd;
+    off_t size;
+    off_t pos;                      /* Position logique de lecture */
+    off_t region_end;               /* Fin de la zone courante */
+    bool in_hole;
+    uint64_t zero_bytes;            /* Octets nuls produits sans lecture */
+} SparseReader;
+
+
+
+bool sparse_is_zero(const void* data, size_t len);
+void sparse_writer_init(SparseWriter* writer, FILE* file);
+size_t sparse_write(SparseWriter* writer, FILE* file, const void* data, size_t len);
+int sparse_writer_finish(SparseWriter* writer, FILE* file);
+void sparse_reader_init(SparseReader* reader, FILE* file);
+size_t sparse_read(SparseReader* reader, FILE* file, void* buffer, size_t len);
+
+#endif
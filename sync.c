@@ -1,10 +1,116 @@
 /**
  * @file sync.c
  * @brief Implémentation des fonctions de synchronisation des accès aux fichiers.
+ *        Chaque fichier est un moniteur lecteurs/écrivain : ses compteurs sont modifiés sous files_mutex et les
+ *        transferts bloqués attendent sur sa variable de condition. Une entrée n'est libérée que lorsqu'aucun
+ *        transfert ne l'utilise ni ne l'attend, toujours sous files_mutex.
  */
 
 
+#include <time.h>
+
 #include "sync.h"
+#include "probes.h"
+
+
+__thread uint64_t sync_transfer_id = 0;
+
+
+
+/**
+ * Fonction : wait_clock_us
+ * Description : Cette fonction lit l'horloge monotone (durée d'attente des sondes USDT et des statistiques). Sans
+ *               sondes, un début de lecture ou d'écriture n'est chronométré que s'il attend un autre transfert.
+ * @return : La date en microsecondes.
+ */
+static uint64_t wait_clock_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+
+/**
+ * Fonction : lock_files
+ * Description : Cette fonction verrouille le mutex de la liste des fichiers en comptant les prises où il était déjà pris.
+ * @param file_list : Un pointeur vers la structure représentant la liste des fichiers.
+ * @return : Aucune valeur de retour
+ */
+static void lock_files(FileList* file_list) {
+    if (pthread_mutex_trylock(&(file_list->files_mutex)) != 0) {
+        uint64_t start_us = wait_clock_us();
+        pthread_mutex_lock(&(file_list->files_mutex));
+        file_list->stats.list_contended++;
+        file_list->stats.list_wait_us += wait_clock_us() - start_us;
+    }
+    file_list->stats.list_locks++;
+}
+
+
+
+/**
+ * Fonction : record_wait
+ * Description : Cette fonction comptabilise le début d'une lecture ou d'une écriture (files_mutex pris). Les attentes
+ *               d'un autre transfert sont aussi cumulées par fichier ; quand la table est pleine, le fichier le
+ *               moins attendu est remplacé (les fichiers chauds y restent).
+ * @param file_list : Un pointeur vers la structure représentant la liste des fichiers.
+ * @param filename : Le nom du fichier.
+ * @param write : Début d'une écriture (sinon d'une lecture).
+ * @param waited : Le transfert a attendu dans pthread_cond_wait.
+ * @param wait_us : La durée du début de l'opération.
+ * @return : Aucune valeur de retour
+ */
+static void record_wait(FileList* file_list, const char* filename, bool write, bool waited, uint64_t wait_us) {
+    SyncStats* stats = &file_list->stats;
+    if (write) {
+        stats->writes++;
+    } else {
+        stats->reads++;
+    }
+    stats->wait_us += wait_us;
+    if (wait_us > stats->max_wait_us) {
+        stats->max_wait_us = wait_us;
+    }
+    if (!waited) {
+        return;
+    }
+    if (write) {
+        stats->write_waits++;
+    } else {
+        stats->read_waits++;
+    }
+
+    SyncFileStats* hot = NULL;
+    for (int i = 0; i < stats->hot_count && hot == NULL; i++) {
+        if (strcmp(stats->hot[i].filename, filename) == 0) {
+            hot = &stats->hot[i];
+        }
+    }
+    if (hot == NULL) {
+        if (stats->hot_count < SYNC_HOT_FILES) {
+            hot = &stats->hot[stats->hot_count++];
+        } else {
+            hot = &stats->hot[0];
+            for (int i = 1; i < SYNC_HOT_FILES; i++) {
+                if (stats->hot[i].wait_us < hot->wait_us) {
+                    hot = &stats->hot[i];
+                }
+            }
+        }
+        memset(hot, 0, sizeof(*hot));
+        snprintf(hot->filename, sizeof(hot->filename), "%s", filename);
+    }
+    if (write) {
+        hot->write_waits++;
+    } else {
+        hot->read_waits++;
+    }
+    hot->wait_us += wait_us;
+    if (wait_us > hot->max_wait_us) {
+        hot->max_wait_us = wait_us;
+    }
+}
 
 
 
@@ -18,6 +124,7 @@ void initialize_fileList(FileList* file_list) {
     if (file_list != NULL) {
         file_list->num_files = 0;
         pthread_mutex_init(&(file_list->files_mutex), NULL);
+        memset(&file_list->stats, 0, sizeof(file_list->stats));
         for (int i = 0; i < MAX_CLIENTS; ++i) {
             file_list->files[i] = NULL;
         }
@@ -40,9 +147,10 @@ FileEntry* get_or_create_fileEntry(const char* filename, FileList* file_list) {
 
     if (file == NULL){
         file = create_fileEntry(filename,file_list);
-        if (add_fileEntry(file,file_list) < 0) {
-            file = NULL;
+        if (file != NULL && add_fileEntry(file,file_list) < 0) {
+            pthread_cond_destroy(&file->cond);
             free(file);
+            file = NULL;
         }
     }
     
@@ -60,7 +168,7 @@ FileEntry* get_or_create_fileEntry(const char* filename, FileList* file_list) {
  */
 FileEntry* get_fileEntry(const char* filename, FileList* file_list) {
 
-    for (int i = 0; i < file_list->num_files; ++i) {
+    for (int i = 0; i < file_list->num_files; ++i) {   // Les entrées occupent les num_files premières cases
         if (strcmp(file_list->files[i]->filename, filename) == 0) {
             return file_list->files[i]; // Fichier trouvé
         }
@@ -89,16 +197,21 @@ FileEntry* create_fileEntry(const char* filename, FileList* file_list) {
     if (file_list->num_files >= MAX_CLIENTS) {
         return NULL; // Dépassement de capacité
     }
+    if (strlen(filename) >= sizeof(((FileEntry*) NULL)->filename)) {
+        return NULL; // Nom trop long
+    }
 
     FileEntry* new_entry = (FileEntry*)malloc(sizeof(FileEntry));
     if (new_entry != NULL) {
         // Initialisation de la nouvelle entrée de fichier
         strcpy(new_entry->filename, filename);
-        pthread_mutex_init(&(new_entry->rw_mutex), NULL);
         pthread_cond_init(&(new_entry->cond), NULL);
+        new_entry->writing = false;
         new_entry->actif_readers = 0;
         new_entry->num_readers = 0;
         new_entry->num_writers = 0;
+        new_entry->waiting_readers = 0;
+        new_entry->waiting_writers = 0;
     }
 
     return new_entry;
@@ -120,15 +233,11 @@ int add_fileEntry(FileEntry* new_entry, FileList* file_list) {
         return -1;
     }
 
-    for (int i = 0; i < MAX_CLIENTS; ++i) {  // Recherche d'un emplacement vide dans le tableau files
-        if (file_list->files[i] == NULL) {
-            file_list->files[i] = new_entry;  // Ajout de la nouvelle entrée à l'emplacement vide trouvé
-            file_list->num_files++;
-            // printf("fichier Ajouté %d\n",i);
-            return 0;
-        }
+    if (file_list->num_files >= MAX_CLIENTS) {
+        return -1; // Aucun emplacement vide
     }
-    return -1; // Aucun emplacement vide trouvé
+    file_list->files[file_list->num_files++] = new_entry;  // Ajout à la suite des entrées (tableau sans trou)
+    return 0;
 }
 
 
@@ -136,50 +245,47 @@ int add_fileEntry(FileEntry* new_entry, FileList* file_list) {
 
 
 /**
- * Fonction : delete_fileEntry
- * Description : Cette fonction supprime une entrée de fichier de la liste des fichiers.
- * @param filename : Le nom du fichier à supprimer.
+ * Fonction : release_entry
+ * Description : Cette fonction libère l'entrée d'un fichier qu'aucun transfert n'utilise ni n'attend (files_mutex pris) :
+ *               personne ne peut plus attendre sur sa variable de condition.
+ * @param entry : L'entrée du fichier.
  * @param fileList : Un pointeur vers la structure représentant la liste des fichiers.
- * @return : 0 en cas de succès, -1 en cas d'échec.
+ * @return : 0 si l'entrée a été libérée, -1 si elle est encore utilisée.
  */
-int delete_fileEntry(const char* filename, FileList* fileList) {
-    pthread_mutex_lock(&(fileList->files_mutex)); // Verrouillage du mutex
-    
-    FileEntry* entry = get_fileEntry(filename, fileList);// Recherche de l'entrée du fichier dans la liste
-    if (entry == NULL) {
-        pthread_mutex_unlock(&(fileList->files_mutex));
-        return -1; // Fichier non trouvé
+static int release_entry(FileEntry* entry, FileList* fileList) {
+    if (entry->num_readers != 0 || entry->num_writers != 0) {
+        return -1;
     }
-    
-    if (entry->num_readers == 0 && entry->num_writers == 0 && pthread_mutex_trylock(&(entry->rw_mutex)) == 0) { // Vérification si aucun lecteur ni écriture en cours
-    // if (entry->num_readers == 0 && entry->num_writers == 0) {
-        // Suppression de l'entrée du fichier
-        for (int i = 0; i < fileList->num_files; ++i) {
-            if (fileList->files[i] == entry) {
-                free(fileList->files[i]);
-                fileList->files[i] = NULL;
-                // printf("fichier supprimé %d\n",i);
-                break;
-            }
+    for (int i = 0; i < fileList->num_files; ++i) {
+        if (fileList->files[i] == entry) {
+            fileList->num_files--; // Décrémentation du nombre de fichiers dans la liste
+            fileList->files[i] = fileList->files[fileList->num_files];  // La dernière entrée comble le trou
+            fileList->files[fileList->num_files] = NULL;
+            break;
         }
-        
-        
-        fileList->num_files--; // Décrémentation du nombre de fichiers dans la liste
-        pthread_mutex_unlock(&(fileList->files_mutex)); // Déverrouillage du mutex
-        // pthread_cond_broadcast(&file->cond);
-        return 0; // Suppression réussie
     }
-    
-    pthread_mutex_unlock(&(fileList->files_mutex)); // Déverrouillage du mutex
-    // pthread_cond_broadcast(&file->cond);
-    return -1; // Impossible de supprimer le fichier car des opérations en cours
+    pthread_cond_destroy(&entry->cond);
+    free(entry);
+    return 0;
 }
 
 
 
 
-
-
+/**
+ * Fonction : delete_fileEntry
+ * Description : Cette fonction supprime une entrée de fichier de la liste des fichiers.
+ * @param filename : Le nom du fichier à supprimer.
+ * @param fileList : Un pointeur vers la structure représentant la liste des fichiers.
+ * @return : 0 en cas de succès, -1 en cas d'échec.
+ */
+int delete_fileEntry(const char* filename, FileList* fileList) {
+    lock_files(fileList); // Verrouillage du mutex
+    FileEntry* entry = get_fileEntry(filename, fileList);// Recherche de l'entrée du fichier dans la liste
+    int ret = entry != NULL ? release_entry(entry, fileList) : -1;  // Impossible si des opérations sont en cours
+    pthread_mutex_unlock(&(fileList->files_mutex)); // Déverrouillage du mutex
+    return ret;
+}
 
 
 
@@ -189,27 +295,39 @@ int delete_fileEntry(const char* filename, FileList* fileList) {
  * Description : Cette fonction signale le début d'une opération de lecture sur un fichier.
  * @param filename : Le nom du fichier sur lequel l'opération de lecture démarre.
  * @param file_list : Un pointeur vers la structure représentant la liste des fichiers.
- * @return : Aucun
+ * @return : 0 en cas de succès, -1 si le fichier ne peut pas être suivi (table pleine) : la lecture doit être refusée.
  */
-void sync_start_read(char *filename, FileList* file_list){
-    pthread_mutex_lock(&(file_list->files_mutex)); // Verrouillage du mutex de la list
+int sync_start_read(char *filename, FileList* file_list){
+    uint64_t wait_start_us = PROBES_ENABLED ? wait_clock_us() : 0;
+    PROBE3(lock__wait__begin, sync_transfer_id, filename, 0);
+    lock_files(file_list); // Verrouillage du mutex de la list
     FileEntry* file = get_or_create_fileEntry(filename,file_list);
     if (file == NULL){
-        return;
+        file_list->stats.refused++;
+        pthread_mutex_unlock(&(file_list->files_mutex));
+        PROBE4(lock__wait__end, sync_transfer_id, filename, 0, wait_clock_us() - wait_start_us);
+        return -1;
     }
 
     file->num_readers++; // ++ Nb lecteurs qui veulent effectuer un lecture
-    while (pthread_mutex_trylock(&(file->rw_mutex)) != 0 && file->actif_readers == 0) {
-        // Si le verrouillage du mutex échoue
+    bool waited = false;
+    while (file->writing) {
+        // Un écrivain est actif
         printf("file %s in use(Writing) ! please wait -_-\n",filename);
-        pthread_cond_wait(&file->cond, &file_list->files_mutex);
-        if (file->num_readers > 1){
-            break;
+        if (!waited && !PROBES_ENABLED) {
+            wait_start_us = wait_clock_us();
         }
+        waited = true;
+        file->waiting_readers++;
+        pthread_cond_wait(&file->cond, &file_list->files_mutex);
+        file->waiting_readers--;
     }
     file->actif_readers++;
+    uint64_t wait_us = PROBES_ENABLED || waited ? wait_clock_us() - wait_start_us : 0;
+    record_wait(file_list, filename, false, waited, wait_us);
     pthread_mutex_unlock(&(file_list->files_mutex));
-    
+    PROBE4(lock__wait__end, sync_transfer_id, filename, 0, wait_us);
+    return 0;
 }
 
 
@@ -223,20 +341,20 @@ void sync_start_read(char *filename, FileList* file_list){
  * @return : Aucun
  */
 void sync_end_read(char *filename, FileList* file_list){
-    pthread_mutex_lock(&(file_list->files_mutex)); // Verrouillage du mutex de la list
+    lock_files(file_list); // Verrouillage du mutex de la list
     FileEntry* file = get_fileEntry(filename,file_list);
     if (file == NULL){
+        pthread_mutex_unlock(&(file_list->files_mutex));
         return;
     }
 
     file->num_readers--;
     file->actif_readers--;
-    if (file->num_readers == 0) {
-        pthread_mutex_unlock(&file->rw_mutex); // Réveiller un éventuel thread en attente d'écriture
-        pthread_cond_broadcast(&file->cond); // Réveiller un éventuel thread en attente d'écriture
+    if (file->actif_readers == 0) {
+        pthread_cond_broadcast(&file->cond); // Réveiller un éventuel thread en attente d'écriture (sous files_mutex)
     }
+    release_entry(file, file_list);     // Entrée libérée si plus personne ne l'utilise
     pthread_mutex_unlock(&(file_list->files_mutex)); // Déverrouiller l'accès à la liste des fichiers
-    delete_fileEntry(filename,file_list);
 }
 
 
@@ -246,23 +364,40 @@ void sync_end_read(char *filename, FileList* file_list){
  * Description : Cette fonction signale le début d'une opération d'écriture sur un fichier.
  * @param filename : Le nom du fichier sur lequel l'opération d'écriture démarre.
  * @param file_list : Un pointeur vers la structure représentant la liste des fichiers.
- * @return : Aucun
+ * @return : 0 en cas de succès, -1 si le fichier ne peut pas être suivi (table pleine) : l'écriture doit être refusée.
  */
-void sync_start_write(char *filename, FileList* file_list){
-    pthread_mutex_lock(&(file_list->files_mutex)); // Verrouiller le mutex de la liste des fichiers
+int sync_start_write(char *filename, FileList* file_list){
+    uint64_t wait_start_us = PROBES_ENABLED ? wait_clock_us() : 0;
+    PROBE3(lock__wait__begin, sync_transfer_id, filename, 1);
+    lock_files(file_list); // Verrouiller le mutex de la liste des fichiers
 
     FileEntry* file = get_or_create_fileEntry(filename,file_list);  // Récupérer ou créer une entrée de fichier pour le fichier spécifié
     if (file == NULL){
-        return;
+        file_list->stats.refused++;
+        pthread_mutex_unlock(&(file_list->files_mutex));
+        PROBE4(lock__wait__end, sync_transfer_id, filename, 1, wait_clock_us() - wait_start_us);
+        return -1;
     }
 
     file->num_writers++;
-    while (pthread_mutex_trylock(&file->rw_mutex) != 0 || file->actif_readers > 0) {
-        // Si le verrouillage du mutex échoue
+    bool waited = false;
+    while (file->writing || file->actif_readers > 0) {
+        // Un autre écrivain ou des lecteurs sont actifs
         printf("file %s in use ! please wait -_-\n",filename);
+        if (!waited && !PROBES_ENABLED) {
+            wait_start_us = wait_clock_us();
+        }
+        waited = true;
+        file->waiting_writers++;
         pthread_cond_wait(&file->cond, &file_list->files_mutex);
+        file->waiting_writers--;
     }
+    file->writing = true;
+    uint64_t wait_us = PROBES_ENABLED || waited ? wait_clock_us() - wait_start_us : 0;
+    record_wait(file_list, filename, true, waited, wait_us);
     pthread_mutex_unlock(&(file_list->files_mutex)); // Déverrouiller l'accès à la liste des fichiers
+    PROBE4(lock__wait__end, sync_transfer_id, filename, 1, wait_us);
+    return 0;
 }
 
 
@@ -277,23 +412,80 @@ void sync_start_write(char *filename, FileList* file_list){
  * @return : Aucun
  */
 void sync_end_write(char *filename, FileList* file_list){
-    pthread_mutex_lock(&(file_list->files_mutex)); // Verrouillage du mutex de la list
+    lock_files(file_list); // Verrouillage du mutex de la list
     FileEntry* file = get_fileEntry(filename,file_list);    // Récupérer l'entrée de fichier pour le fichier spécifié
 
     if (file == NULL){
+        pthread_mutex_unlock(&(file_list->files_mutex));
         return;
     }
 
     file->num_writers--;
-
-    pthread_mutex_unlock(&file->rw_mutex);  // Déverrouiller le verrou de lecture/écriture
+    file->writing = false;
+    pthread_cond_broadcast(&file->cond);    // Réveiller tous les threads en attente (sous files_mutex : l'entrée existe encore)
+    release_entry(file, file_list);         // Supprimer l'entrée de fichier si plus personne ne l'utilise
     pthread_mutex_unlock(&(file_list->files_mutex));    // Déverrouiller le mutex de la liste des fichiers
-    pthread_cond_broadcast(&file->cond);    // Réveiller tous les threads en attente
-    delete_fileEntry(filename,file_list);   // Supprimer l'entrée de fichier de la liste des fichiers
-     
 }
 
 
 
 
+/**
+ * Fonction : compare_hot_files
+ * Description : Fonction de comparaison de qsort : fichiers par durée d'attente décroissante.
+ */
+static int compare_hot_files(const void* a, const void* b) {
+    uint64_t wa = ((const SyncFileStats*) a)->wait_us;
+    uint64_t wb = ((const SyncFileStats*) b)->wait_us;
+    return wa < wb ? 1 : (wa > wb ? -1 : 0);
+}
+
 
+
+
+/**
+ * Fonction : sync_report
+ * Description : Cette fonction affiche la contention de la couche de synchronisation : compteurs globaux, fichiers
+ *               les plus attendus et lecteurs/écrivains actuels de chaque fichier. Les valeurs sont copiées sous
+ *               files_mutex puis affichées sans le tenir.
+ * @param file_list : Un pointeur vers la structure représentant la liste des fichiers.
+ * @param out : Le flux de sortie.
+ * @return : Aucune valeur de retour
+ */
+void sync_report(FileList* file_list, FILE* out) {
+    FileEntry* entries = (FileEntry*) malloc(MAX_CLIENTS * sizeof(FileEntry));
+    SyncStats* stats = (SyncStats*) malloc(sizeof(SyncStats));
+    if (entries == NULL || stats == NULL) {
+        free(entries);
+        free(stats);
+        return;
+    }
+    int count = 0;
+    pthread_mutex_lock(&(file_list->files_mutex));
+    *stats = file_list->stats;
+    for (int i = 0; i < file_list->num_files; ++i) {
+        entries[count++] = *file_list->files[i];    // Noms et compteurs seulement (la variable de condition copiée n'est pas utilisée)
+    }
+    pthread_mutex_unlock(&(file_list->files_mutex));
+
+    unsigned long starts = stats->reads + stats->writes;
+    fprintf(out, "[SYNC] lectures %lu (attentes %lu) | écritures %lu (attentes %lu) | attente moyenne %.3f ms, max %.3f ms"
+            " | files_mutex déjà pris %lu/%lu (%.3f ms) | fichiers ouverts %d | refus (table pleine) %lu\n",
+            stats->reads, stats->read_waits, stats->writes, stats->write_waits,
+            starts > 0 ? stats->wait_us / 1000.0 / starts : 0.0, stats->max_wait_us / 1000.0,
+            stats->list_contended, stats->list_locks, stats->list_wait_us / 1000.0, count, stats->refused);
+    qsort(stats->hot, (size_t) stats->hot_count, sizeof(SyncFileStats), compare_hot_files);
+    for (int i = 0; i < stats->hot_count && i < SYNC_REPORT_TOP; i++) {
+        const SyncFileStats* hot = &stats->hot[i];
+        fprintf(out, "[SYNC] attendu %s | lectures bloquées %lu | écritures bloquées %lu | total %.3f ms, max %.3f ms\n",
+                hot->filename, hot->read_waits, hot->write_waits, hot->wait_us / 1000.0, hot->max_wait_us / 1000.0);
+    }
+    for (int i = 0; i < count; i++) {
+        const FileEntry* entry = &entries[i];
+        fprintf(out, "[SYNC] ouvert %s | lecteurs %d (actifs %d, en attente %d) | écrivains %d (en attente %d)\n",
+                entry->filename, entry->num_readers, entry->actif_readers, entry->waiting_readers,
+                entry->num_writers, entry->waiting_writers);
+    }
+    free(entries);
+    free(stats);
+}
@@ -5,34 +5,78 @@
  */
 
 
+#include <limits.h>
 #include <pthread.h>
 #include <stdbool.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
 
 #ifndef SYNC_H
 #define SYNC_H
 
 #define MAX_CLIENTS 500
+#define SYNC_HOT_FILES 64       /* Fichiers dont les attentes sont conservées (les moins attendus sont remplacés) */
+#define SYNC_REPORT_TOP 10      /* Fichiers les plus attendus affichés par sync_report */
 
 
 /**
  * @struct FileEntry
- * @brief Structure représentant un fichier avec son mutex et sa variable de condition.
+ * @brief Structure représentant un fichier avec sa variable de condition. L'état lecteurs/écrivain est protégé
+ *        par files_mutex (aucun verrou n'est tenu par un transfert entre le début et la fin de son opération).
  */
 typedef struct FileEntry {
-    char filename[256]; 
-    pthread_mutex_t rw_mutex; /** Mutex pour synchronisation */ 
-    pthread_cond_t cond; /** Variable de condition */
+    char filename[PATH_MAX];
+    pthread_cond_t cond; /** Variable de condition (attendue avec files_mutex) */
+    bool writing;       /* Un écrivain est actif */
     int actif_readers;  /* les lecteurs actifs */
-    int num_readers;    /* Nombre de lecteurs actuels */
-    int num_writers;    /* Nombre d'écrivains actuels */
+    int num_readers;    /* Nombre de lecteurs actuels (actifs ou en attente) */
+    int num_writers;    /* Nombre d'écrivains actuels (actif ou en attente) */
+    int waiting_readers;    /* Lecteurs bloqués dans pthread_cond_wait */
+    int waiting_writers;    /* Écrivains bloqués dans pthread_cond_wait */
 }FileEntry;
 
 
 
 
+/**
+ * @struct SyncFileStats
+ * @brief Attentes cumulées d'un fichier (conservées après la suppression de son FileEntry).
+ */
+typedef struct SyncFileStats {
+    char filename[PATH_MAX];    /* Nom complet (même taille que FileEntry.filename : pas de fusion par préfixe) */
+    unsigned long read_waits;   /* Lectures qui ont attendu un autre transfert */
+    unsigned long write_waits;  /* Écritures qui ont attendu un autre transfert */
+    uint64_t wait_us;           /* Durée totale de ces attentes */
+    uint64_t max_wait_us;
+} SyncFileStats;
+
+
+
+
+/**
+ * @struct SyncStats
+ * @brief Compteurs de contention de la couche de synchronisation (protégés par files_mutex).
+ */
+typedef struct SyncStats {
+    unsigned long reads;            /* sync_start_read */
+    unsigned long writes;           /* sync_start_write */
+    unsigned long read_waits;       /* Lectures bloquées par un écrivain */
+    unsigned long write_waits;      /* Écritures bloquées par un lecteur ou un écrivain */
+    uint64_t wait_us;               /* Durée totale des débuts de lecture et d'écriture (attente de files_mutex comprise ; sans sondes USDT, attentes d'un autre transfert seulement) */
+    uint64_t max_wait_us;
+    unsigned long list_locks;       /* Prises de files_mutex */
+    unsigned long list_contended;   /* Prises de files_mutex qui l'ont trouvé déjà pris */
+    uint64_t list_wait_us;          /* Durée totale de ces attentes de files_mutex */
+    unsigned long refused;          /* Débuts refusés : table des fichiers pleine (ou nom trop long) */
+    SyncFileStats hot[SYNC_HOT_FILES];
+    int hot_count;
+} SyncStats;
+
+
+
+
 /**
  * @struct FileList
  * @brief Structure représentant une liste de fichiers avec leur mutex.
@@ -41,13 +85,17 @@ typedef struct FileList{
     FileEntry* files[MAX_CLIENTS]; // Liste des fichiers
     int num_files; // Nombre de fichiers dans la liste
     pthread_mutex_t files_mutex;
+    SyncStats stats;    // Contention (protégé par files_mutex)
 }FileList;
 
 
 
 
+typedef int (*Sync_Start_Function)(char *filename, FileList* file_list);
 typedef void (*Sync_Function)(char *filename, FileList* file_list);
 
+extern __thread uint64_t sync_transfer_id;     /* Transfert du thread courant (sondes USDT de l'attente des verrous) */
+
 void initialize_fileList(FileList* file_list);
 FileEntry* get_or_create_fileEntry(const char* filename, FileList* file_list);
 FileEntry* get_fileEntry(const char* filename, FileList* file_list);
@@ -55,9 +103,10 @@ FileEntry* create_fileEntry(const char* filename, FileList* file_list);
 int add_fileEntry(FileEntry* new_entry, FileList* file_list);
 int delete_fileEntry(const char* filename, FileList* fileList);
 
-void sync_start_read(char *filename, FileList* file_list);
+int sync_start_read(char *filename, FileList* file_list);
 void sync_end_read(char *filename, FileList* file_list);
-void sync_start_write(char *filename, FileList* file_list);
+int sync_start_write(char *filename, FileList* file_list);
 void sync_end_write(char *filename, FileList* file_list);
+void sync_report(FileList* file_list, FILE* out);
 
 #endif
\ No newline at end of file
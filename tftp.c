@@ -7,7 +7,13 @@
  ********************************************************/
 
 
+#include <inttypes.h>
+
 #include "tftp.h"
+#include "crc32c.h"
+#include "probes.h"
+#include "impair.h"
+#include "sparse.h"
 
 
 
@@ -33,6 +39,74 @@ const char* TFTPErrorMessages[NUM_TFTP_ERRORS] = {
 
 
 
+/**
+ * Fonction : transfer_send
+ * @brief : Cette fonction envoie un paquet du transfert, par le socket (et la dégradation simulée) ou par le transport simulé.
+ * @param client : Un pointeur vers la structure représentant le client TFTP.
+ * @param buffer : Le paquet.
+ * @param len : La taille du paquet.
+ * @return : Le nombre d'octets envoyés, -1 en cas d'erreur.
+ */
+static ssize_t transfer_send(TFTP_Client *client, const void *buffer, size_t len) {
+    if (client->transport != NULL) {
+        return client->transport->send(client, buffer, len);
+    }
+    return impair_send(client->impair, client->socket_fd, buffer, len);
+}
+
+
+
+
+/**
+ * Fonction : transfer_recv
+ * @brief : Cette fonction attend un paquet du transfert pendant au plus client->timeout_ms.
+ * @param client : Un pointeur vers la structure représentant le client TFTP.
+ * @param buffer : Le tampon de réception.
+ * @param len : La taille du tampon.
+ * @return : La taille du paquet reçu, -1 si le délai est écoulé ou en cas d'erreur.
+ */
+static ssize_t transfer_recv(TFTP_Client *client, void *buffer, size_t len) {
+    if (client->transport != NULL) {
+        return client->transport->recv(client, buffer, len, client->timeout_ms);
+    }
+    return impair_recv(client->impair, client->socket_fd, buffer, len, client->timeout_ms);
+}
+
+
+
+
+/**
+ * Fonction : transfer_now_us
+ * @brief : Cette fonction donne l'horloge du transfert (virtuelle avec le transport simulé).
+ * @param client : Un pointeur vers la structure représentant le client TFTP.
+ * @return : La date en microsecondes.
+ */
+static uint64_t transfer_now_us(TFTP_Client *client) {
+    return client->transport != NULL ? client->transport->now_us(client) : histo_now_us();
+}
+
+
+
+
+/**
+ * Fonction : set_receive_timeout
+ * @brief : Cette fonction applique client->timeout_ms au socket du transfert (SO_RCVTIMEO) ; sans effet avec le transport simulé.
+ * @param client : Un pointeur vers la structure représentant le client TFTP.
+ * @return : Aucune valeur de retour
+ */
+static void set_receive_timeout(TFTP_Client *client) {
+    if (client->transport != NULL) {
+        return;
+    }
+    struct timeval tv;
+    tv.tv_sec = client->timeout_ms / 1000;
+    tv.tv_usec = (client->timeout_ms % 1000) * 1000;
+    setsockopt(client->socket_fd, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv, sizeof tv);
+}
+
+
+
+
 /**
  * Fonction : handle_read_request
  * @brief : Cette fonction est responsable de la gestion d'une demande de lecture (RRQ) provenant d'un client TFTP.
@@ -44,50 +118,73 @@ const char* TFTPErrorMessages[NUM_TFTP_ERRORS] = {
  */
 int handle_read_request(TFTP_Client *client, TFTP_Request *request) {
 
-    struct timeval tv;
-    tv.tv_sec = TIMEOUT_SECONDS;
-    tv.tv_usec = 0;
-    setsockopt(client->socket_fd, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv, sizeof tv);
+    set_receive_timeout(client);
 
     TFTP_DataPacket data_packet;
     TFTP_AckPacket ack_packet;
     size_t num_bytes_read;
     int retryCount = 0;
-    int block_num = 1;
-
-    printf("[RRQ] @IP %s:%d, file: %s, Mode: %s\n", inet_ntoa(client->client_addr.sin_addr), ntohs(client->client_addr.sin_port), request->filename, request->mode);
+    uint16_t block_num = 1;
+    uint64_t total_bytes = 0;  // 64 bits : les images de plusieurs Go dépassent 65535 blocs
+    uint32_t crc = 0;          // CRC32C calculé pendant l'envoi : pas de relecture pour le contrôle d'intégrité
+    uint64_t sent_us = 0;      // Envoi du DATA courant (0 après une retransmission : pas de mesure d'aller-retour)
+    bool first_data = true;
+    SparseReader sparse;       // Trous d'un fichier creux envoyés sans lecture du disque
+    sparse_reader_init(&sparse, client->file);
+
+    char options[96];
+    format_options(&request->options, options, sizeof(options));
+    printf("[RRQ] @IP %s:%d, file: %s, Mode: %s%s%s\n", inet_ntoa(client->client_addr.sin_addr), ntohs(client->client_addr.sin_port), request->filename, request->mode,
+           options[0] != '\0' ? ", Options:" : "", options);
 
     do {
-        num_bytes_read = fread(data_packet.data, 1, sizeof(data_packet.data), client->file);
-        if (num_bytes_read == (long unsigned int) -1) {
+        num_bytes_read = sparse_read(&sparse, client->file, data_packet.data, sizeof(data_packet.data));
+        if (num_bytes_read < sizeof(data_packet.data) && ferror(client->file)) {   // Erreur de lecture (ou téléchargement amont interrompu)
             perror("Erreur lors de la lecture du fichier");
             send_error_packet(client->socket_fd,&client->client_addr,FileNotFound, get_error_message(FileNotFound),NULL);// Envoi d'un paquet d'erreur au client
             return -1;
         }
 
+        crc = crc32c_update(crc, data_packet.data, num_bytes_read);
         data_packet.opcode = htons(TFTP_OPCODE_DATA);
         data_packet.block_num = htons(block_num);
 
-        if (sendto(client->socket_fd, &data_packet, num_bytes_read + 4, 0, (struct sockaddr*)&client->client_addr, sizeof(client->client_addr)) == -1) {
+        if (transfer_send(client, &data_packet, num_bytes_read + 4) == -1) {
             send_error_packet(client->socket_fd, &client->client_addr,FileNotFound, get_error_message(NotDefined), NULL);// Envoi d'un paquet d'erreur au client
             perror("Erreur lors de l'envoi du paquet de données");
             return -1;
         }
+        sent_us = transfer_now_us(client);
+        PROBE4(data__sent, client->transfer_id, block_num, num_bytes_read, total_bytes + num_bytes_read);
+        if (first_data && client->received_us != 0) {
+            histo_record(client->histo, HISTO_FIRST_DATA, sent_us - client->received_us);
+        }
+        first_data = false;
 
         // printf("[DATA] Packet : %d (%zd Bytes) -> @IP %s:%d\n", block_num,num_bytes_read+4,inet_ntoa(client_addr->sin_addr), ntohs(client_addr->sin_port));
         
 
         retryCount = 0;
         while (1) {
-            ssize_t recvlen = recvfrom(client->socket_fd, &ack_packet, sizeof(ack_packet), 0, NULL, NULL);
+            ssize_t recvlen = transfer_recv(client, &ack_packet, sizeof(ack_packet));
+            if (recvlen > 0) {
+                trace_record(client->trace, &client->client_addr, &ack_packet, recvlen);
+            }
             if (recvlen > 0 && ack_packet.opcode == htons(TFTP_OPCODE_ACK) && ack_packet.block_num == htons(block_num)) {
+                if (sent_us != 0) {
+                    histo_record(client->histo, HISTO_ACK_RTT, transfer_now_us(client) - sent_us);
+                }
+                PROBE3(ack__received, client->transfer_id, block_num, total_bytes + num_bytes_read);
                 // printf("[ACK]  Packet : %d <- @IP %s:%d\n", ntohs(ack_packet.block_num),inet_ntoa(client_addr->sin_addr), ntohs(client_addr->sin_port));
                 break; // ACK reçu
             } else if (recvlen == -1) {
                 // Timeout, retransmission
+                PROBE3(timeout, client->transfer_id, block_num, retryCount);
                 if (retryCount < MAX_RETRIES) {
                     printf("Client[fd %d] Time Out !, retransmission du DATA %d\n",client->socket_fd ,block_num);
-                    sendto(client->socket_fd, &data_packet, num_bytes_read + TFTP_HEADER_SIZE, 0, (struct sockaddr*)&client->client_addr, sizeof(client->client_addr));
+                    transfer_send(client, &data_packet, num_bytes_read + TFTP_HEADER_SIZE);
+                    PROBE3(retransmit, client->transfer_id, block_num, retryCount + 1);
+                    sent_us = 0;
                     retryCount++;
                 } else {
                     printf("Client[fd %d] |-_-| Nombre maximum de tentatives atteint, abandon de la transmission.\n",client->socket_fd);
@@ -97,11 +194,22 @@ int handle_read_request(TFTP_Client *client, TFTP_Request *request) {
             }
         }
 
-        block_num++;
+        total_bytes += num_bytes_read;
+        block_num = next_block_number(block_num, client->rollover);
         //  usleep(50000); //50ms
     } while (num_bytes_read == sizeof(data_packet.data));
 
-    printf("Client[fd %d] |^_^| Transmission terminée avec succès. | file : %s (%zu Bytes)\n",client->socket_fd,request->filename, ftell(client->file));
+    uint64_t duration_us = client->received_us != 0 ? transfer_now_us(client) - client->received_us : 0;
+    if (client->received_us != 0) {
+        histo_record_transfer(client->histo, total_bytes, duration_us);
+    }
+    PROBE4(transfer__complete, client->transfer_id, TFTP_OPCODE_RRQ, total_bytes, duration_us);
+    client->crc32c = crc;
+    client->bytes = total_bytes;
+    printf("Client[fd %d] |^_^| Transmission terminée avec succès. | file : %s (%" PRIu64 " Bytes, crc32c %08x)\n",client->socket_fd,request->filename, total_bytes, crc);
+    if (sparse.zero_bytes > 0) {
+        printf("Client[fd %d] fichier creux : %" PRIu64 " octets nuls envoyés sans lecture\n", client->socket_fd, sparse.zero_bytes);
+    }
     return 0;
 }
 
@@ -127,12 +235,12 @@ int handle_read_request(TFTP_Client *client, TFTP_Request *request) {
  */
 int handle_write_request(TFTP_Client *client, TFTP_Request *request) {
 
-    printf("[WRQ] @IP %s:%d, file: %s, Mode: %s\n", inet_ntoa(client->client_addr.sin_addr), ntohs(client->client_addr.sin_port), request->filename, request->mode);
+    char options[96];
+    format_options(&request->options, options, sizeof(options));
+    printf("[WRQ] @IP %s:%d, file: %s, Mode: %s%s%s\n", inet_ntoa(client->client_addr.sin_addr), ntohs(client->client_addr.sin_port), request->filename, request->mode,
+           options[0] != '\0' ? ", Options:" : "", options);
   
-    struct timeval tv;
-    tv.tv_sec = TIMEOUT_SECONDS;
-    tv.tv_usec = 0;
-    setsockopt(client->socket_fd, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv, sizeof tv);
+    set_receive_timeout(client);
     int retryCount = 0;
 
 
@@ -140,20 +248,32 @@ int handle_write_request(TFTP_Client *client, TFTP_Request *request) {
     TFTP_AckPacket ackPacket;
     ackPacket.opcode = htons(TFTP_OPCODE_ACK);
     ackPacket.block_num = htons(0);
-    sendto(client->socket_fd, &ackPacket, sizeof(ackPacket), 0, (struct sockaddr*)&client->client_addr, sizeof(client->client_addr));
+    transfer_send(client, &ackPacket, sizeof(ackPacket));
 
 
-    int blockNumber = 1;
+    uint16_t blockNumber = 1;
+    uint16_t previousBlock = 0;    // Dernier bloc acquitté (pour détecter les doublons, y compris après un rebouclage)
+    uint64_t total_bytes = 0;
+    uint32_t crc = 0;          // CRC32C des données écrites, enregistré à côté du fichier après son renommage
+    SparseWriter sparse;       // Blocs nuls non écrits : trous dans le fichier reçu
+    sparse_writer_init(&sparse, client->file);
+    uint64_t ack_sent_us = transfer_now_us(client);     // Envoi du dernier ACK (0 après une retransmission : pas de mesure)
 
     while (1) {
         TFTP_DataPacket dataPacket;
-        ssize_t recvlen = recvfrom(client->socket_fd, &dataPacket, sizeof(dataPacket), 0, NULL, NULL);
+        ssize_t recvlen = transfer_recv(client, &dataPacket, sizeof(dataPacket));
+        if (recvlen > 0) {
+            trace_record(client->trace, &client->client_addr, &dataPacket, recvlen);
+        }
 
         if (recvlen == -1) {
             // Timeout, retransmission de l'ACK précédent
             printf("Client[fd %d] Time Out !, retransmission de l'ACK %d\n",client->socket_fd,ntohs(ackPacket.block_num));
+            PROBE3(timeout, client->transfer_id, ntohs(ackPacket.block_num), retryCount);
             if (retryCount < MAX_RETRIES) {
-                sendto(client->socket_fd, &ackPacket, sizeof(ackPacket), 0, (struct sockaddr*)&client->client_addr, sizeof(client->client_addr));
+                transfer_send(client, &ackPacket, sizeof(ackPacket));
+                PROBE3(retransmit, client->transfer_id, ntohs(ackPacket.block_num), retryCount + 1);
+                ack_sent_us = 0;
                 retryCount++;
                 continue;
             } else {
@@ -164,30 +284,72 @@ int handle_write_request(TFTP_Client *client, TFTP_Request *request) {
 
         retryCount = 0; // reset
 
-        if (dataPacket.opcode == htons(TFTP_OPCODE_DATA) && ntohs(dataPacket.block_num) == blockNumber-1) {
-            sendto(client->socket_fd, &ackPacket, sizeof(ackPacket), 0, (struct sockaddr*)&client->client_addr, sizeof(client->client_addr));
+        if (dataPacket.opcode == htons(TFTP_OPCODE_DATA) && ntohs(dataPacket.block_num) == previousBlock) {
+            transfer_send(client, &ackPacket, sizeof(ackPacket));     // DATA retransmis : notre ACK a été perdu
+            PROBE3(retransmit, client->transfer_id, previousBlock, 0);
+            ack_sent_us = 0;
             continue;
         }
 
         if (dataPacket.opcode == htons(TFTP_OPCODE_DATA) && ntohs(dataPacket.block_num) == blockNumber) {
-            size_t bytesWritten = fwrite(dataPacket.data, 1, recvlen - 4, client->file);
+            if (ack_sent_us != 0) {
+                histo_record(client->histo, HISTO_DATA_RTT, transfer_now_us(client) - ack_sent_us);
+            }
+            size_t bytesWritten = sparse_write(&sparse, client->file, dataPacket.data, recvlen - 4);
             if ((int) bytesWritten < recvlen - 4) {
                 printf("Erreur lors de l'écriture dans le fichier\n");
                 send_error_packet(client->socket_fd, &client->client_addr, DiskFullOrAllocationExceeded, get_error_message(DiskFullOrAllocationExceeded),NULL);
                 return -1;
             }
 
+            total_bytes += bytesWritten;
+            crc = crc32c_update(crc, dataPacket.data, bytesWritten);
+            PROBE4(data__received, client->transfer_id, blockNumber, bytesWritten, total_bytes);
+
+            // Dernier paquet : longueur rétablie si le fichier se termine par un trou
+            if (recvlen < MAX_PACKET_SIZE && sparse_writer_finish(&sparse, client->file) != 0) {
+                perror("Erreur lors de l'ajustement de la taille du fichier");
+                send_error_packet(client->socket_fd, &client->client_addr, DiskFullOrAllocationExceeded, get_error_message(DiskFullOrAllocationExceeded),NULL);
+                return -1;
+            }
+
+            // Dernier paquet : le fichier doit être validé (rendu durable) avant l'envoi du dernier ACK
+            int finalized = recvlen < MAX_PACKET_SIZE && client->finalize != NULL ? client->finalize(client, request) : 0;
+            if (finalized < 0) {
+                printf("Client[fd %d] Erreur lors de la validation du fichier %s\n", client->socket_fd, request->filename);
+                send_error_packet(client->socket_fd, &client->client_addr, DiskFullOrAllocationExceeded, get_error_message(DiskFullOrAllocationExceeded),NULL);
+                return -1;
+            }
+            if (finalized > 0) {    // Fichier en place mais sa durabilité n'est pas garantie : pas d'ACK, le client peut renvoyer
+                printf("Client[fd %d] Fichier %s remplacé, mais son répertoire n'a pas pu être synchronisé\n", client->socket_fd, request->filename);
+                client->crc32c = crc;
+                client->bytes = total_bytes;
+                send_error_packet(client->socket_fd, &client->client_addr, NotDefined, get_error_message(NotDefined), "Fichier enregistré sans garantie de durabilité");
+                return -1;
+            }
+
             // Envoi de l'ACK
             ackPacket.block_num = dataPacket.block_num;
-            sendto(client->socket_fd, &ackPacket, sizeof(ackPacket), 0, (struct sockaddr*)&client->client_addr, sizeof(client->client_addr));
+            transfer_send(client, &ackPacket, sizeof(ackPacket));
+            ack_sent_us = transfer_now_us(client);
 
             if (recvlen < MAX_PACKET_SIZE) {
                 // Dernier paquet reçu, fin de la transmission
-                printf("Client[fd %d] |^_^| Réception terminée avec succès. | file : %s (%zu):\n",client->socket_fd, request->filename, ftell(client->file));
+                if (client->received_us != 0) {
+                    histo_record_transfer(client->histo, total_bytes, ack_sent_us - client->received_us);
+                }
+                PROBE4(transfer__complete, client->transfer_id, TFTP_OPCODE_WRQ, total_bytes, client->received_us != 0 ? ack_sent_us - client->received_us : 0);
+                client->crc32c = crc;
+                client->bytes = total_bytes;
+                printf("Client[fd %d] |^_^| Réception terminée avec succès. | file : %s (%" PRIu64 " Bytes, crc32c %08x)\n",client->socket_fd, request->filename, total_bytes, crc);
+                if (sparse.skipped > 0) {
+                    printf("Client[fd %d] fichier creux : %" PRIu64 " octets nuls non écrits\n", client->socket_fd, sparse.skipped);
+                }
                 break;
             }
 
-            blockNumber++;
+            previousBlock = blockNumber;
+            blockNumber = next_block_number(blockNumber, client->rollover);
         } else if (ntohs(dataPacket.opcode) == TFTP_OPCODE_ERR) {
             printf("Erreur reçue du serveur : %s\n",dataPacket.data);
             return -1;
@@ -210,6 +372,19 @@ int handle_write_request(TFTP_Client *client, TFTP_Request *request) {
 
 
 
+/**
+ * Fonction : next_transfer_id
+ * @brief : Cette fonction attribue un identifiant unique à un transfert (argument 0 des sondes USDT).
+ * @return : L'identifiant (à partir de 1).
+ */
+uint64_t next_transfer_id(void) {
+    static uint64_t last_id = 0;
+    return __atomic_add_fetch(&last_id, 1, __ATOMIC_RELAXED);
+}
+
+
+
+
 /**
  * @brief : get_error_message
  * Description : Cette fonction retourne le message d'erreur correspondant à un code d'erreur TFTP spécifié.
@@ -320,6 +495,180 @@ char* get_temp_file_name(const char* nom_fichier) {
 
 
 
+/**
+ * Fonction : parse_option_value
+ * @brief : Cette fonction convertit la valeur décimale d'une option (chiffres seulement, sans dépassement).
+ * @param value : La valeur (terminée par un octet nul).
+ * @param max : La valeur maximale acceptée.
+ * @param result : Un pointeur vers le résultat.
+ * @return : true si la valeur est valide.
+ */
+static bool parse_option_value(const char* value, uint64_t max, uint64_t* result) {
+    uint64_t v = 0;
+    if (*value == '\0') {
+        return false;
+    }
+    for (; *value != '\0'; value++) {
+        if (*value < '0' || *value > '9' || v > (max - (uint64_t) (*value - '0')) / 10) {
+            return false;
+        }
+        v = v * 10 + (uint64_t) (*value - '0');
+    }
+    *result = v;
+    return true;
+}
+
+
+
+
+/**
+ * Fonction : parse_request
+ * @brief : Cette fonction analyse un paquet RRQ/WRQ en une seule passe, en vérifiant chaque champ par rapport à la taille reçue.
+ * Elle ne copie rien : le nom de fichier et le mode sont des vues dans le paquet (chaque champ se termine par un octet nul
+ * du paquet), les options RFC 2347 reconnues sont décodées. Un couple option/valeur incomplet en fin de paquet est ignoré.
+ * @param packet : Le paquet reçu (le nom de fichier pourra y être normalisé sur place).
+ * @param packet_len : La taille du paquet reçu.
+ * @param request : Un pointeur vers la structure qui reçoit la requête analysée.
+ * @param error_code : Un pointeur vers le code d'erreur TFTP à renvoyer en cas d'échec.
+ * @param error_message : Un pointeur vers le message d'erreur complémentaire en cas d'échec.
+ * @return : 0 si la requête est valide, -1 sinon.
+ */
+int parse_request(char* packet, ssize_t packet_len, TFTP_Request* request, int* error_code, const char** error_message) {
+    *error_code = IllegalOperation;
+    *error_message = "Requête mal formée";
+    if (packet_len < 4 || packet_len > MAX_PACKET_SIZE) {
+        return -1;
+    }
+
+    memcpy(&request->opcode, packet, sizeof(uint16_t));
+    if (ntohs(request->opcode) != TFTP_OPCODE_RRQ && ntohs(request->opcode) != TFTP_OPCODE_WRQ) {
+        *error_message = "Opcode non pris en charge";
+        return -1;
+    }
+    const char* limit = packet + packet_len;
+
+    // Nom de fichier (terminé par un octet nul dans les limites du paquet)
+    char* filename = packet + 2;
+    char* end = memchr(filename, '\0', limit - filename);
+    if (end == NULL) {
+        return -1;
+    }
+    if (end == filename) {
+        *error_code = NotDefined;
+        *error_message = "Nom de fichier vide";
+        return -1;
+    }
+    request->filename = filename;
+
+    // Mode de transfert
+    const char* mode = end + 1;
+    const char* mode_end = mode < limit ? memchr(mode, '\0', limit - mode) : NULL;
+    if (mode_end == NULL || (strcasecmp(mode, "netascii") != 0 && strcasecmp(mode, "octet") != 0)) {
+        *error_code = NotDefined;
+        *error_message = "Mode de transfert non reconnu";
+        return -1;
+    }
+    request->mode = mode;
+
+    // Options : couples nom/valeur
+    TFTP_Options* options = &request->options;
+    memset(options, 0, sizeof(*options));
+    const char* name = mode_end + 1;
+    while (name < limit) {
+        const char* name_end = memchr(name, '\0', limit - name);
+        const char* value = name_end != NULL ? name_end + 1 : limit;
+        const char* value_end = value < limit ? memchr(value, '\0', limit - value) : NULL;
+        if (value_end == NULL) {
+            break;
+        }
+        uint64_t v;
+        if (strcasecmp(name, "blksize") == 0 && parse_option_value(value, 65464, &v) && v >= 8) {
+            options->blksize = (uint16_t) v;
+            options->present |= TFTP_OPTION_BLKSIZE;
+        } else if (strcasecmp(name, "tsize") == 0 && parse_option_value(value, UINT64_MAX, &v)) {
+            options->tsize = v;
+            options->present |= TFTP_OPTION_TSIZE;
+        } else if (strcasecmp(name, "timeout") == 0 && parse_option_value(value, 255, &v) && v >= 1) {
+            options->timeout = (uint8_t) v;
+            options->present |= TFTP_OPTION_TIMEOUT;
+        } else if (strcasecmp(name, "windowsize") == 0 && parse_option_value(value, 65535, &v) && v >= 1) {
+            options->windowsize = (uint16_t) v;
+            options->present |= TFTP_OPTION_WINDOWSIZE;
+        } else if (options->ignored < UINT8_MAX) {
+            options->ignored++;
+        }
+        name = value_end + 1;
+    }
+
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : rebase_request
+ * @brief : Cette fonction reporte les vues d'une requête analysée sur une copie de son paquet (file d'attente, client).
+ * @param request : La requête analysée.
+ * @param from : Le paquet analysé.
+ * @param to : La copie du paquet.
+ * @return : Aucun
+ */
+void rebase_request(TFTP_Request* request, const char* from, char* to) {
+    request->filename = to + (request->filename - from);
+    request->mode = to + (request->mode - from);
+}
+
+
+
+
+/**
+ * Fonction : format_options
+ * @brief : Cette fonction décrit les options décodées d'une requête (journal des transferts).
+ * @param options : Les options.
+ * @param buffer : Le tampon qui reçoit la description (vide si aucune option).
+ * @param size : La taille du tampon.
+ * @return : La longueur de la description.
+ */
+int format_options(const TFTP_Options* options, char* buffer, size_t size) {
+    int len = 0;
+    buffer[0] = '\0';
+    if (options->present & TFTP_OPTION_BLKSIZE) {
+        len += snprintf(buffer + len, size - len, " blksize=%u", (unsigned) options->blksize);
+    }
+    if ((options->present & TFTP_OPTION_TSIZE) && (size_t) len < size) {
+        len += snprintf(buffer + len, size - len, " tsize=%" PRIu64, options->tsize);
+    }
+    if ((options->present & TFTP_OPTION_TIMEOUT) && (size_t) len < size) {
+        len += snprintf(buffer + len, size - len, " timeout=%u", (unsigned) options->timeout);
+    }
+    if ((options->present & TFTP_OPTION_WINDOWSIZE) && (size_t) len < size) {
+        len += snprintf(buffer + len, size - len, " windowsize=%u", (unsigned) options->windowsize);
+    }
+    return len;
+}
+
+
+
+
+/**
+ * Fonction : next_block_number
+ * @brief : Cette fonction calcule le numéro du bloc suivant. Le champ block_num est sur 16 bits :
+ *          après le bloc 65535, la numérotation reprend à la valeur de rebouclage (0 ou 1 selon les clients).
+ * @param block : Le numéro du bloc courant.
+ * @param rollover : La valeur de rebouclage (0 ou 1).
+ * @return : Le numéro du bloc suivant.
+ */
+uint16_t next_block_number(uint16_t block, uint16_t rollover) {
+    if (block == UINT16_MAX) {
+        return rollover;
+    }
+    return block + 1;
+}
+
+
+
+
 
 
 
@@ -383,6 +732,22 @@ TFTP_Client *init_client(struct sockaddr_in client_addr, const char *request) {
     }
     memcpy(&client->client_addr, &client_addr, sizeof(client_addr)); // Copier les informations de l'adresse IP et du port du client
     strcpy(client->packet, request);// Copier la demande du client
+    client->file = NULL;
+    client->packet_len = 0;
+    client->rollover = 0;
+    client->staged = NULL;
+    client->finalize = NULL;
+    client->trace = NULL;
+    client->histo = NULL;
+    client->received_us = 0;
+    client->size_class = 0;
+    client->crc32c = 0;
+    client->bytes = 0;
+    client->transfer_id = 0;
+    client->impair = NULL;
+    client->timeout_ms = TIMEOUT_SECONDS * 1000;
+    client->transport = NULL;
+    client->transport_ctx = NULL;
     
     return client;
 }
@@ -492,12 +857,15 @@ void supprimer_client(TFTP_ClientsList *listeClients, TFTP_Client *client) {
 
     pthread_mutex_lock(&listeClients->mutex);   // Verrouiller le mutex pour garantir l'accès exclusif à la liste
     for (int i = 0; i < listeClients->nbClients; i++) {
-        if (listeClients->clients[i]->socket_fd == client->socket_fd) {
-            // Libérer la mémoire allouée pour le client
-            close(client->socket_fd);
+        if (listeClients->clients[i] == client) {
+            // Libérer la mémoire allouée pour le client (le socket a pu être rendu au pool : socket_fd = -1)
+            if (client->socket_fd >= 0) {
+                close(client->socket_fd);
+            }
             if (client->file != NULL){
                 fclose(client->file);
             }
+            impair_detach(client->impair);
             listeClients->clients[i] = NULL;
             // printf("client %d supprimé\n",i);
             free(client);
@@ -22,6 +22,8 @@
 #include <strings.h>
 
 #include "sync.h"
+#include "trace.h"
+#include "histo.h"
 
 #ifndef TFTP_H
 #define TFTP_H
@@ -49,11 +51,27 @@
 
 
 
+// Options RFC 2347 reconnues (champ present de TFTP_Options)
+#define TFTP_OPTION_BLKSIZE 0x01    /* RFC 2348 : 8 à 65464 */
+#define TFTP_OPTION_TSIZE 0x02      /* RFC 2349 */
+#define TFTP_OPTION_TIMEOUT 0x04    /* RFC 2349 : 1 à 255 s */
+#define TFTP_OPTION_WINDOWSIZE 0x08 /* RFC 7440 : 1 à 65535 */
+
+typedef struct {
+    uint8_t present;        // Options demandées avec une valeur valide (TFTP_OPTION_*)
+    uint8_t ignored;        // Options inconnues ou de valeur invalide
+    uint16_t blksize;
+    uint16_t windowsize;
+    uint8_t timeout;
+    uint64_t tsize;
+} TFTP_Options; // Options décodées d'une demande TFTP
+
 typedef struct {
     uint16_t opcode;
-    char filename[512];
-    char mode[10]; // octet | netascci
-} TFTP_Request; // Structure représentant une demande TFTP
+    char* filename;         // Vue dans le paquet analysé (terminée par l'octet nul du paquet, normalisée sur place)
+    const char* mode;       // Vue dans le paquet : octet | netascii
+    TFTP_Options options;
+} TFTP_Request; // Structure représentant une demande TFTP (valide tant que le paquet analysé existe)
 
 typedef struct {
     uint16_t opcode;
@@ -89,14 +107,46 @@ enum TFTPError {
 };
 
 
+struct TFTP_Client;
+
+
+/**
+ * @struct TFTP_Transport
+ * @brief Envois, réceptions et horloge de handle_read_request et handle_write_request. Sans transport
+ *        (client->transport = NULL) : socket du transfert, dégradation simulée (impair.h) et horloge monotone ;
+ *        le simulateur (sim.c) les remplace par un réseau et une horloge virtuels.
+ */
+typedef struct TFTP_Transport {
+    ssize_t (*send)(struct TFTP_Client* client, const void* buffer, size_t len);
+    ssize_t (*recv)(struct TFTP_Client* client, void* buffer, size_t len, int timeout_ms);  /* -1 : délai écoulé */
+    uint64_t (*now_us)(struct TFTP_Client* client);
+} TFTP_Transport;
+
+
 // Structure représentant un client TFTP
-typedef struct {
+typedef struct TFTP_Client {
     int socket_fd;                  
     struct sockaddr_in client_addr; 
     socklen_t addr_len;             
     char filename[504];
     char packet[MAX_PACKET_SIZE];
+    ssize_t packet_len;             /* Taille du paquet de requête reçu */
+    TFTP_Request request;           /* Requête analysée par le thread d'écoute (vues dans packet) */
     FILE* file;
+    uint16_t rollover;              /* Numéro de bloc après 65535 (0 ou 1) */
+    struct StagedUpload* staged;    /* Fichier reçu en mode durable (NULL sinon) */
+    int (*finalize)(struct TFTP_Client *client, TFTP_Request *request); /* Validation avant le dernier ACK (WRQ, optionnelle) */
+    PacketTrace* trace;             /* Enregistrement des paquets reçus (NULL = désactivé) */
+    HistoRegistry* histo;           /* Histogrammes de latence (NULL = désactivés) */
+    uint64_t received_us;           /* Date de réception de la requête (histo_now_us, 0 = inconnue) */
+    int size_class;                 /* Classe de taille attribuée par le contrôle d'admission (AdmissionClass) */
+    uint32_t crc32c;                /* CRC32C des données transférées (calculé bloc par bloc) */
+    uint64_t bytes;                 /* Octets transférés */
+    uint64_t transfer_id;           /* Identifiant du transfert (sondes USDT) */
+    struct ImpairState* impair;     /* Dégradation réseau simulée (NULL = envois et réceptions directs) */
+    int timeout_ms;                 /* Délai avant retransmission (TIMEOUT_SECONDS par défaut) */
+    const TFTP_Transport* transport;    /* Transport simulé (NULL = socket du transfert) */
+    void* transport_ctx;            /* État du transport simulé */
 } TFTP_Client;
 
 
@@ -119,8 +169,13 @@ int handle_read_request(TFTP_Client *client, TFTP_Request *request); // Gère un
 int handle_write_request(TFTP_Client *client, TFTP_Request *request);  // Gère une demande d'écriture
 int create_Socket(const char *ipAddress, int port); // Crée un socket (avec Bind)
 const char* get_error_message(int error_code);  // Obtient le message d'erreur correspondant à un code
+uint64_t next_transfer_id(void);    // Attribue un identifiant de transfert (sondes USDT)
 void send_error_packet(int sockfd, struct sockaddr_in* client_addr, uint16_t errorCode, const char* error_message, const char* additional_message); // Envoie un paquet d'erreur
 char* get_temp_file_name(const char* nom_fichier);
+int parse_request(char* packet, ssize_t packet_len, TFTP_Request* request, int* error_code, const char** error_message); // Analyse une requête RRQ/WRQ
+void rebase_request(TFTP_Request* request, const char* from, char* to); // Reporte les vues d'une requête sur une copie du paquet
+int format_options(const TFTP_Options* options, char* buffer, size_t size); // Décrit les options décodées
+uint16_t next_block_number(uint16_t block, uint16_t rollover); // Numéro du bloc suivant (avec rebouclage)
 
 /*****************************************************************************************************************
  *                                                     SECTION 2                                                 *
@@ -0,0 +1,236 @@
+/**
+ * @file trace.c
+ * @brief Implémentation de l'enregistrement des paquets reçus.
+ *        Les enregistrements sont écrits dans un tampon stdio sous un mutex ; le tampon est vidé au plus tard
+ *        toutes les TRACE_FLUSH_MS millisecondes, pour qu'une trace reste exploitable si le serveur est tué.
+ */
+
+
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include "trace.h"
+
+#define TRACE_BUFFER_SIZE (1 << 20)     /* Tampon stdio du fichier de trace */
+#define TRACE_OPCODE_RRQ 1
+#define TRACE_OPCODE_WRQ 2
+#define TRACE_HEADER_BYTES 4            /* Octets conservés pour les paquets autres que les requêtes */
+
+
+
+/**
+ * Fonction : now_ns
+ * Description : Cette fonction retourne la date courante en nanosecondes (horloge monotone).
+ * @return : La date courante en nanosecondes.
+ */
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+
+
+/**
+ * Fonction : put_le / get_le
+ * Description : Ces fonctions écrivent et lisent un entier de `size` octets en little-endian.
+ */
+static void put_le(uint8_t* p, uint64_t value, int size) {
+    for (int i = 0; i < size; i++) {
+        p[i] = (uint8_t) (value >> (8 * i));
+    }
+}
+
+static uint64_t get_le(const uint8_t* p, int size) {
+    uint64_t value = 0;
+    for (int i = size - 1; i >= 0; i--) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+
+
+
+/**
+ * Fonction : trace_init
+ * Description : Cette fonction crée le fichier de trace et écrit son en-tête.
+ * @param trace : La trace à initialiser.
+ * @param path : Le chemin du fichier de trace (NULL = enregistrement désactivé).
+ * @return : 0 en cas de succès, -1 en cas d'erreur (errno positionné).
+ */
+int trace_init(PacketTrace* trace, const char* path) {
+    memset(trace, 0, sizeof(*trace));
+    pthread_mutex_init(&trace->mutex, NULL);
+    if (path == NULL) {
+        return 0;
+    }
+
+    trace->file = fopen(path, "wb");
+    if (trace->file == NULL) {
+        return -1;
+    }
+    setvbuf(trace->file, NULL, _IOFBF, TRACE_BUFFER_SIZE);
+
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    uint8_t header[TRACE_HEADER_SIZE];
+    memcpy(header, TRACE_MAGIC, 8);
+    put_le(header + 8, (uint64_t) tv.tv_sec * 1000000 + tv.tv_usec, 8);
+    if (fwrite(header, sizeof(header), 1, trace->file) != 1) {
+        fclose(trace->file);
+        trace->file = NULL;
+        return -1;
+    }
+
+    trace->start_ns = now_ns();
+    trace->last_flush_ns = trace->start_ns;
+    trace->bytes = sizeof(header);
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : trace_record
+ * Description : Cette fonction enregistre un paquet reçu. Les requêtes sont conservées entières,
+ *               les ACK et DATA réduits à leur en-tête (opcode et numéro de bloc) : seule leur taille est gardée.
+ * @param trace : La trace (NULL ou désactivée : aucun effet).
+ * @param source : L'adresse du client.
+ * @param packet : Le paquet reçu.
+ * @param length : La taille du paquet reçu.
+ * @return : Aucune valeur de retour
+ */
+void trace_record(PacketTrace* trace, const struct sockaddr_in* source, const void* packet, size_t length) {
+    if (trace == NULL || trace->file == NULL) {
+        return;
+    }
+
+    const uint8_t* bytes = packet;
+    if (length > TRACE_MAX_PACKET) {
+        length = TRACE_MAX_PACKET;
+    }
+    uint16_t opcode = length >= 2 ? (uint16_t) (bytes[0] << 8 | bytes[1]) : 0;
+    size_t captured = length;
+    if (opcode != TRACE_OPCODE_RRQ && opcode != TRACE_OPCODE_WRQ && captured > TRACE_HEADER_BYTES) {
+        captured = TRACE_HEADER_BYTES;
+    }
+
+    uint8_t record[TRACE_RECORD_SIZE];
+    put_le(record + 8, ntohl(source->sin_addr.s_addr), 4);
+    put_le(record + 12, ntohs(source->sin_port), 2);
+    put_le(record + 14, length, 2);
+    put_le(record + 16, captured, 2);
+
+    pthread_mutex_lock(&trace->mutex);
+    // Date relevée sous le verrou : les enregistrements restent triés dans le fichier
+    uint64_t now = now_ns();
+    put_le(record, (now - trace->start_ns) / 1000, 8);
+    if (fwrite(record, sizeof(record), 1, trace->file) != 1 || fwrite(bytes, 1, captured, trace->file) != captured) {
+        trace->errors++;
+    } else {
+        trace->records++;
+        trace->bytes += sizeof(record) + captured;
+    }
+    if (now - trace->last_flush_ns >= (uint64_t) TRACE_FLUSH_MS * 1000000) {
+        fflush(trace->file);
+        trace->last_flush_ns = now;
+    }
+    pthread_mutex_unlock(&trace->mutex);
+}
+
+
+
+
+/**
+ * Fonction : trace_flush
+ * Description : Cette fonction vide le tampon du fichier de trace.
+ * @param trace : La trace.
+ * @return : Aucune valeur de retour
+ */
+void trace_flush(PacketTrace* trace) {
+    if (trace->file == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&trace->mutex);
+    fflush(trace->file);
+    trace->last_flush_ns = now_ns();
+    pthread_mutex_unlock(&trace->mutex);
+}
+
+
+
+
+/**
+ * Fonction : trace_report
+ * Description : Cette fonction affiche les compteurs de l'enregistrement (et vide le tampon de la trace).
+ * @param trace : La trace.
+ * @param out : Le flux de sortie.
+ * @return : Aucune valeur de retour
+ */
+void trace_report(PacketTrace* trace, FILE* out) {
+    if (trace->file == NULL) {
+        return;
+    }
+    trace_flush(trace);
+    pthread_mutex_lock(&trace->mutex);
+    fprintf(out, "[TRACE] paquets enregistrés %lu | taille %.1f Ko | erreurs d'écriture %lu\n",
+            trace->records, trace->bytes / 1024.0, trace->errors);
+    pthread_mutex_unlock(&trace->mutex);
+}
+
+
+
+
+/**
+ * Fonction : trace_read_header
+ * Description : Cette fonction lit et vérifie l'en-tête d'un fichier de trace.
+ * @param file : Le fichier de trace ouvert en lecture.
+ * @param start_unix_us : Reçoit la date de début de la trace (µs depuis l'epoch).
+ * @return : 0 en cas de succès, -1 si le fichier n'est pas une trace.
+ */
+int trace_read_header(FILE* file, uint64_t* start_unix_us) {
+    uint8_t header[TRACE_HEADER_SIZE];
+    if (fread(header, sizeof(header), 1, file) != 1 || memcmp(header, TRACE_MAGIC, 8) != 0) {
+        return -1;
+    }
+    *start_unix_us = get_le(header + 8, 8);
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : trace_read_event
+ * Description : Cette fonction lit l'enregistrement suivant d'un fichier de trace.
+ * @param file : Le fichier de trace (positionné après l'en-tête).
+ * @param event : Reçoit le paquet enregistré.
+ * @return : 1 si un paquet a été lu, 0 en fin de fichier, -1 si l'enregistrement est invalide ou tronqué.
+ */
+int trace_read_event(FILE* file, TraceEvent* event) {
+    uint8_t record[TRACE_RECORD_SIZE];
+    size_t n = fread(record, 1, sizeof(record), file);
+    if (n == 0) {
+        return 0;
+    }
+    if (n != sizeof(record)) {
+        return -1;
+    }
+
+    memset(&event->source, 0, sizeof(event->source));
+    event->time_us = get_le(record, 8);
+    event->source.sin_family = AF_INET;
+    event->source.sin_addr.s_addr = htonl((uint32_t) get_le(record + 8, 4));
+    event->source.sin_port = htons((uint16_t) get_le(record + 12, 2));
+    event->length = (uint16_t) get_le(record + 14, 2);
+    event->captured = (uint16_t) get_le(record + 16, 2);
+    if (event->captured > event->length || event->captured > TRACE_MAX_PACKET
+        || fread(event->data, 1, event->captured, file) != event->captured) {
+        return -1;
+    }
+    return 1;
+}
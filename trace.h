@@ -0,0 +1,69 @@
+/**
+ * @file trace.h
+ * @brief Enregistrement des paquets reçus par le serveur (requêtes, ACK, DATA) dans un fichier
+ *        binaire compact, relu par l'outil de rejeu (replay.c).
+ *
+ *        Format : en-tête de TRACE_HEADER_SIZE octets (TRACE_MAGIC, puis date de début en µs depuis l'epoch),
+ *        suivi d'enregistrements de TRACE_RECORD_SIZE octets + charge utile. Tous les entiers sont en little-endian :
+ *          u64 date (µs depuis le début) | u32 adresse IPv4 | u16 port | u16 taille du paquet | u16 octets conservés
+ *        Les requêtes RRQ/WRQ sont conservées entières ; pour les autres paquets, seul l'en-tête TFTP (4 octets) l'est.
+ */
+
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <netinet/in.h>
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#define TRACE_MAGIC "TFTPTRC1"
+#define TRACE_HEADER_SIZE 16
+#define TRACE_RECORD_SIZE 18
+#define TRACE_MAX_PACKET 516
+#define TRACE_FLUSH_MS 1000             /* Le tampon est vidé au plus tard après ce délai */
+
+
+/**
+ * @struct TraceEvent
+ * @brief Paquet enregistré (tel que relu depuis le fichier de trace).
+ */
+typedef struct TraceEvent {
+    uint64_t time_us;               /* Date de réception depuis le début de la trace */
+    struct sockaddr_in source;      /* Adresse du client */
+    uint16_t length;                /* Taille du paquet reçu */
+    uint16_t captured;              /* Octets conservés dans data */
+    uint8_t data[TRACE_MAX_PACKET];
+} TraceEvent;
+
+
+
+
+/**
+ * @struct PacketTrace
+ * @brief Fichier de trace partagé par le thread d'écoute et les threads de transfert.
+ */
+typedef struct PacketTrace {
+    FILE* file;                     /* NULL = enregistrement désactivé */
+    uint64_t start_ns;              /* Date de début (horloge monotone) */
+    uint64_t last_flush_ns;
+    pthread_mutex_t mutex;
+
+    unsigned long records;
+    unsigned long long bytes;       /* Octets écrits dans la trace */
+    unsigned long errors;
+} PacketTrace;
+
+
+
+int trace_init(PacketTrace* trace, const char* path);
+void trace_record(PacketTrace* trace, const struct sockaddr_in* source, const void* packet, size_t length);
+void trace_flush(PacketTrace* trace);
+void trace_report(PacketTrace* trace, FILE* out);
+
+int trace_read_header(FILE* file, uint64_t* start_unix_us);
+int trace_read_event(FILE* file, TraceEvent* event);
+
+#endif
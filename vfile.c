@@ -0,0 +1,676 @@
+/**
+ * @file vfile.c
+ * @brief Implémentation des fichiers virtuels générés à partir de modèles.
+ *        Un modèle compilé est une suite d'éléments (texte recopié, variable) : la génération n'analyse plus le texte.
+ */
+
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "vfile.h"
+
+
+/**
+ * @struct VFileMatch
+ * @brief Parties du nom demandé qui correspondent aux « * » et « ? » du motif.
+ */
+typedef struct VFileMatch {
+    const char* start[VFILE_MAX_CAPTURES];
+    size_t len[VFILE_MAX_CAPTURES];
+    int count;
+} VFileMatch;
+
+
+/**
+ * @struct VFileReader
+ * @brief Flux de lecture d'un contenu généré.
+ */
+typedef struct VFileReader {
+    VirtualFiles* vf;
+    VFileOutput* output;
+    size_t offset;
+} VFileReader;
+
+
+/**
+ * @struct VFileVariable
+ * @brief Nom d'une variable des modèles.
+ */
+typedef struct VFileVariable {
+    const char* name;
+    VFileSegmentKind kind;
+} VFileVariable;
+
+static const VFileVariable variables[] = {
+    {"filename", VFILE_FILENAME},
+    {"basename", VFILE_BASENAME},
+    {"ip",       VFILE_IP},
+    {"ip_hex",   VFILE_IP_HEX},
+    {"port",     VFILE_PORT},
+};
+
+
+
+
+/**
+ * Fonction : hash_key
+ * Description : Cette fonction calcule l'alvéole d'une clé du cache (FNV-1a).
+ * @param key : La clé.
+ * @return : L'indice de l'alvéole.
+ */
+static uint32_t hash_key(const char* key) {
+    uint32_t h = 2166136261u;
+    for (const unsigned char* p = (const unsigned char*) key; *p; p++) {
+        h ^= *p;
+        h *= 16777619u;
+    }
+    return h & (VFILE_BUCKETS - 1);
+}
+
+
+
+
+/**
+ * Fonction : match_pattern
+ * Description : Cette fonction compare un nom demandé au motif d'une règle et relève les parties variables.
+ * @param pattern : La suite du motif.
+ * @param name : La suite du nom.
+ * @param capture : Le numéro de la prochaine partie variable.
+ * @param match : Les parties relevées.
+ * @return : true si le nom correspond au motif.
+ */
+static bool match_pattern(const char* pattern, const char* name, int capture, VFileMatch* match) {
+    for (;;) {
+        if (*pattern == '*') {
+            for (const char* end = name; ; end++) {
+                if (match_pattern(pattern + 1, end, capture + 1, match)) {
+                    if (capture < VFILE_MAX_CAPTURES) {
+                        match->start[capture] = name;
+                        match->len[capture] = (size_t) (end - name);
+                    }
+                    return true;
+                }
+                if (*end == '\0' || *end == '/') {
+                    return false;
+                }
+            }
+        }
+        if (*pattern == '?') {
+            if (*name == '\0' || *name == '/') {
+                return false;
+            }
+            if (capture < VFILE_MAX_CAPTURES) {
+                match->start[capture] = name;
+                match->len[capture] = 1;
+            }
+            capture++;
+        } else if (*pattern != *name) {
+            return false;
+        } else if (*pattern == '\0') {
+            match->count = capture < VFILE_MAX_CAPTURES ? capture : VFILE_MAX_CAPTURES;
+            return true;
+        }
+        pattern++;
+        name++;
+    }
+}
+
+
+
+
+/**
+ * Fonction : find_rule
+ * Description : Cette fonction cherche la première règle dont le motif correspond au nom demandé.
+ * @param vf : Les fichiers virtuels.
+ * @param filename : Le nom normalisé du fichier.
+ * @param match : Les parties variables du nom (peut être NULL).
+ * @return : L'indice de la règle, ou -1 si aucune ne correspond.
+ */
+static int find_rule(VirtualFiles* vf, const char* filename, VFileMatch* match) {
+    VFileMatch unused;
+    for (int i = 0; i < vf->rule_count; i++) {
+        if (match_pattern(vf->rules[i].pattern, filename, 0, match != NULL ? match : &unused)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+
+
+/**
+ * Fonction : add_segment
+ * Description : Cette fonction ajoute un élément à un modèle compilé.
+ * @return : 0 en cas de succès, -1 en cas d'erreur d'allocation.
+ */
+static int add_segment(VFileRule* rule, int* capacity, VFileSegmentKind kind, size_t offset, size_t len) {
+    if (rule->segment_count == *capacity) {
+        *capacity = *capacity == 0 ? 16 : *capacity * 2;
+        VFileSegment* grown = (VFileSegment*) realloc(rule->segments, (size_t) *capacity * sizeof(VFileSegment));
+        if (grown == NULL) {
+            return -1;
+        }
+        rule->segments = grown;
+    }
+    VFileSegment* segment = &rule->segments[rule->segment_count++];
+    segment->kind = kind;
+    segment->offset = (uint32_t) offset;
+    segment->len = (uint32_t) len;
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : compile_template
+ * Description : Cette fonction analyse le texte d'un modèle et le remplace par une suite d'éléments.
+ * @param rule : La règle (texte déjà chargé).
+ * @return : 0 en cas de succès, -1 si le modèle est invalide (message affiché).
+ */
+static int compile_template(VFileRule* rule) {
+    int capacity = 0;
+    const char* text = rule->text;
+    size_t literal = 0;     // Début du texte à recopier
+    size_t i = 0;
+    while (text[i] != '\0') {
+        if (text[i] != '$' || (text[i + 1] != '$' && text[i + 1] != '{')) {
+            i++;
+            continue;
+        }
+        if (i > literal && add_segment(rule, &capacity, VFILE_LITERAL, literal, i - literal) < 0) {
+            return -1;
+        }
+        if (text[i + 1] == '$') {       // « $$ » : le second « $ » est recopié
+            literal = i + 1;
+            i += 2;
+            continue;
+        }
+        const char* name = text + i + 2;
+        const char* end = strchr(name, '}');
+        size_t len = end != NULL ? (size_t) (end - name) : 0;
+        int kind = -1;
+        size_t capture = 0;
+        if (len == 1 && name[0] >= '1' && name[0] <= '9') {
+            kind = VFILE_CAPTURE;
+            capture = (size_t) (name[0] - '1');
+        }
+        for (size_t v = 0; kind < 0 && v < sizeof(variables) / sizeof(variables[0]); v++) {
+            if (strlen(variables[v].name) == len && strncmp(variables[v].name, name, len) == 0) {
+                kind = variables[v].kind;
+            }
+        }
+        if (end == NULL || kind < 0) {
+            fprintf(stderr, "Erreur : %s : variable inconnue '%.*s'\n", rule->template_name, end != NULL ? (int) len + 3 : 2, text + i);
+            return -1;
+        }
+        if (add_segment(rule, &capacity, (VFileSegmentKind) kind, 0, capture) < 0) {
+            return -1;
+        }
+        rule->per_client |= kind == VFILE_IP || kind == VFILE_IP_HEX || kind == VFILE_PORT;
+        rule->cacheable &= kind != VFILE_PORT;
+        i += len + 3;
+        literal = i;
+    }
+    if (i > literal && add_segment(rule, &capacity, VFILE_LITERAL, literal, i - literal) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : load_template
+ * Description : Cette fonction lit le texte d'un modèle.
+ * @param path : Le fichier modèle.
+ * @return : Le texte (terminé par '\0'), ou NULL en cas d'erreur (errno positionné).
+ */
+static char* load_template(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+    char* text = (char*) malloc(VFILE_MAX_OUTPUT + 1);
+    size_t len = text != NULL ? fread(text, 1, VFILE_MAX_OUTPUT + 1, file) : 0;
+    bool error = text == NULL || ferror(file) || len > VFILE_MAX_OUTPUT;
+    fclose(file);
+    if (error) {
+        int saved_errno = len > VFILE_MAX_OUTPUT ? EFBIG : errno;
+        free(text);
+        errno = saved_errno;
+        return NULL;
+    }
+    text[len] = '\0';
+    char* shrunk = (char*) realloc(text, len + 1);
+    return shrunk != NULL ? shrunk : text;
+}
+
+
+
+
+/**
+ * Fonction : vfile_init
+ * Description : Cette fonction lit le fichier des règles et compile leurs modèles.
+ * @param vf : Les fichiers virtuels à initialiser.
+ * @param rules_file : Le fichier des règles (NULL = désactivé).
+ * @return : 0 en cas de succès, -1 en cas d'erreur (message affiché).
+ */
+int vfile_init(VirtualFiles* vf, const char* rules_file) {
+    memset(vf, 0, sizeof(*vf));
+    pthread_mutex_init(&vf->mutex, NULL);
+    for (int i = 0; i < VFILE_BUCKETS; i++) {
+        vf->buckets[i] = -1;
+    }
+    if (rules_file == NULL) {
+        return 0;
+    }
+
+    FILE* file = fopen(rules_file, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Erreur : %s : %s\n", rules_file, strerror(errno));
+        return -1;
+    }
+    char* line = NULL;
+    size_t line_size = 0;
+    int line_number = 0;
+    int ret = 0;
+    while (ret == 0 && getline(&line, &line_size, file) >= 0) {
+        line_number++;
+        char* comment = strchr(line, '#');
+        if (comment != NULL) {
+            *comment = '\0';
+        }
+        char* save;
+        char* pattern = strtok_r(line, " \t\r\n", &save);
+        char* template_name = strtok_r(NULL, " \t\r\n", &save);
+        if (pattern == NULL) {
+            continue;
+        }
+        if (template_name == NULL || strtok_r(NULL, " \t\r\n", &save) != NULL) {
+            fprintf(stderr, "Erreur : %s:%d : règle invalide (attendu « motif modèle »)\n", rules_file, line_number);
+            ret = -1;
+            break;
+        }
+
+        VFileRule* grown = (VFileRule*) realloc(vf->rules, (size_t) (vf->rule_count + 1) * sizeof(VFileRule));
+        if (grown == NULL) {
+            ret = -1;
+            break;
+        }
+        vf->rules = grown;
+        VFileRule* rule = &vf->rules[vf->rule_count];
+        memset(rule, 0, sizeof(*rule));
+        while (*pattern == '/') {
+            pattern++;      // Motif comparé aux noms normalisés
+        }
+        rule->pattern = strdup(pattern);
+        rule->template_name = strdup(template_name);
+        rule->cacheable = true;
+        rule->text = load_template(template_name);
+        if (rule->text == NULL) {
+            fprintf(stderr, "Erreur : %s:%d : modèle %s : %s\n", rules_file, line_number, template_name, strerror(errno));
+            ret = -1;
+        } else if (rule->pattern == NULL || rule->template_name == NULL || compile_template(rule) < 0) {
+            ret = -1;
+        }
+        vf->rule_count++;
+    }
+    free(line);
+    fclose(file);
+    if (ret == 0 && vf->rule_count > 0) {
+        vf->entries = (VFileCacheEntry*) calloc(VFILE_CACHE_SIZE, sizeof(VFileCacheEntry));
+        if (vf->entries == NULL) {
+            ret = -1;
+        }
+    }
+    return ret;
+}
+
+
+
+
+/**
+ * Fonction : render
+ * Description : Cette fonction génère le contenu d'un fichier virtuel à partir d'un modèle compilé.
+ * @param rule : La règle.
+ * @param filename : Le nom demandé.
+ * @param match : Les parties variables du nom.
+ * @param peer : L'adresse du client.
+ * @return : Le contenu (une référence), ou NULL en cas d'erreur (errno positionné).
+ */
+static VFileOutput* render(const VFileRule* rule, const char* filename, const VFileMatch* match, const struct sockaddr_in* peer) {
+    char ip[INET_ADDRSTRLEN];
+    char ip_hex[9];
+    char port[6];
+    inet_ntop(AF_INET, &peer->sin_addr, ip, sizeof(ip));
+    snprintf(ip_hex, sizeof(ip_hex), "%08X", (unsigned) ntohl(peer->sin_addr.s_addr));
+    snprintf(port, sizeof(port), "%u", (unsigned) ntohs(peer->sin_port));
+    const char* basename = strrchr(filename, '/');
+    basename = basename != NULL ? basename + 1 : filename;
+
+    // Deux passes : longueur, puis recopie
+    VFileOutput* output = NULL;
+    for (int pass = 0; pass < 2; pass++) {
+        size_t len = 0;
+        for (int i = 0; i < rule->segment_count; i++) {
+            const VFileSegment* segment = &rule->segments[i];
+            const char* value = NULL;
+            size_t value_len = 0;
+            switch (segment->kind) {
+                case VFILE_LITERAL: value = rule->text + segment->offset; value_len = segment->len; break;
+                case VFILE_CAPTURE:
+                    if ((int) segment->len < match->count) {
+                        value = match->start[segment->len];
+                        value_len = match->len[segment->len];
+                    }
+                    break;
+                case VFILE_FILENAME: value = filename; break;
+                case VFILE_BASENAME: value = basename; break;
+                case VFILE_IP: value = ip; break;
+                case VFILE_IP_HEX: value = ip_hex; break;
+                case VFILE_PORT: value = port; break;
+            }
+            if (value != NULL && segment->kind != VFILE_LITERAL && segment->kind != VFILE_CAPTURE) {
+                value_len = strlen(value);
+            }
+            if (output != NULL && value_len > 0) {
+                memcpy(output->data + len, value, value_len);
+            }
+            len += value_len;
+        }
+        if (output != NULL) {
+            break;
+        }
+        if (len > VFILE_MAX_OUTPUT) {
+            errno = EFBIG;
+            return NULL;
+        }
+        output = (VFileOutput*) malloc(sizeof(VFileOutput) + len);
+        if (output == NULL) {
+            return NULL;
+        }
+        output->refs = 1;
+        output->len = len;
+    }
+    return output;
+}
+
+
+
+
+/**
+ * Fonction : output_release
+ * Description : Cette fonction rend une référence sur un contenu généré ; le dernier utilisateur le libère.
+ * @param vf : Les fichiers virtuels (leur mutex protège les références).
+ * @param output : Le contenu.
+ * @return : Aucune valeur de retour
+ */
+static void output_release(VirtualFiles* vf, VFileOutput* output) {
+    pthread_mutex_lock(&vf->mutex);
+    bool last = --output->refs == 0;
+    pthread_mutex_unlock(&vf->mutex);
+    if (last) {
+        free(output);
+    }
+}
+
+
+
+
+/**
+ * Fonction : find_entry
+ * Description : Cette fonction recherche un contenu en cache (mutex déjà verrouillé).
+ * @param vf : Les fichiers virtuels.
+ * @param key : La clé du contenu.
+ * @return : L'indice de l'entrée, ou -1 si elle n'existe pas.
+ */
+static int find_entry(VirtualFiles* vf, const char* key) {
+    for (int i = vf->buckets[hash_key(key)]; i != -1; i = vf->entries[i].next) {
+        if (strcmp(vf->entries[i].key, key) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+
+
+/**
+ * Fonction : insert_entry
+ * Description : Cette fonction met un contenu en cache à la place de l'entrée la plus ancienne (mutex déjà verrouillé).
+ * @param vf : Les fichiers virtuels.
+ * @param key : La clé du contenu.
+ * @param output : Le contenu (le cache prend une référence).
+ * @return : Aucune valeur de retour
+ */
+static void insert_entry(VirtualFiles* vf, const char* key, VFileOutput* output) {
+    int index = vf->next_slot;
+    vf->next_slot = (vf->next_slot + 1) % VFILE_CACHE_SIZE;
+    VFileCacheEntry* entry = &vf->entries[index];
+    if (entry->used) {
+        int* link = &vf->buckets[hash_key(entry->key)];
+        while (*link != index) {
+            link = &vf->entries[*link].next;
+        }
+        *link = entry->next;
+        if (--entry->output->refs == 0) {
+            free(entry->output);
+        }
+    }
+    strcpy(entry->key, key);
+    entry->output = output;
+    output->refs++;
+    uint32_t bucket = hash_key(key);
+    entry->next = vf->buckets[bucket];
+    vf->buckets[bucket] = index;
+    entry->used = true;
+}
+
+
+
+
+/**
+ * Fonction : vfile_get
+ * Description : Cette fonction fournit le contenu d'un fichier virtuel, depuis le cache ou en le générant.
+ * @param vf : Les fichiers virtuels.
+ * @param filename : Le nom normalisé du fichier.
+ * @param peer : L'adresse du client.
+ * @return : Le contenu (à rendre avec output_release), ou NULL (errno = ENOENT si aucune règle ne correspond).
+ */
+static VFileOutput* vfile_get(VirtualFiles* vf, const char* filename, const struct sockaddr_in* peer) {
+    VFileMatch match;
+    int index = vf->rule_count > 0 ? find_rule(vf, filename, &match) : -1;
+    if (index < 0) {
+        errno = ENOENT;
+        return NULL;
+    }
+    const VFileRule* rule = &vf->rules[index];
+
+    char key[VFILE_MAX_KEY];
+    char ip[INET_ADDRSTRLEN] = "";
+    if (rule->per_client) {
+        inet_ntop(AF_INET, &peer->sin_addr, ip, sizeof(ip));
+    }
+    int key_len = snprintf(key, sizeof(key), "%d\n%s\n%s", index, ip, filename);
+    bool cacheable = rule->cacheable && key_len > 0 && key_len < (int) sizeof(key);
+
+    VFileOutput* output = NULL;
+    pthread_mutex_lock(&vf->mutex);
+    int entry = cacheable ? find_entry(vf, key) : -1;
+    if (entry != -1) {
+        output = vf->entries[entry].output;
+        output->refs++;
+        vf->hits++;
+    }
+    pthread_mutex_unlock(&vf->mutex);
+    if (output != NULL) {
+        return output;
+    }
+
+    output = render(rule, filename, &match, peer);     // Hors du mutex
+    if (output == NULL) {
+        return NULL;
+    }
+    pthread_mutex_lock(&vf->mutex);
+    vf->renders++;
+    if (cacheable && find_entry(vf, key) == -1) {
+        insert_entry(vf, key, output);
+    }
+    pthread_mutex_unlock(&vf->mutex);
+    return output;
+}
+
+
+
+
+/**
+ * Fonction : count_request
+ * Description : Cette fonction compte un fichier virtuel servi (un contenu trop gros pour le chemin rapide
+ *               n'est compté qu'une fois, par le chemin normal).
+ * @param vf : Les fichiers virtuels.
+ * @param output : Le contenu servi.
+ * @return : Aucune valeur de retour
+ */
+static void count_request(VirtualFiles* vf, const VFileOutput* output) {
+    pthread_mutex_lock(&vf->mutex);
+    vf->requests++;
+    vf->bytes += output->len;
+    pthread_mutex_unlock(&vf->mutex);
+}
+
+
+
+
+/**
+ * Fonction : vfile_match
+ * Description : Cette fonction indique si un nom correspond à une règle (WRQ refusés, classement des requêtes).
+ * @param vf : Les fichiers virtuels.
+ * @param filename : Le nom normalisé du fichier.
+ * @return : true si le fichier est virtuel.
+ */
+bool vfile_match(VirtualFiles* vf, const char* filename) {
+    return vf->rule_count > 0 && find_rule(vf, filename, NULL) >= 0;
+}
+
+
+
+
+/**
+ * Fonction : reader_read
+ * Description : Fonction de lecture du flux (fopencookie) : copie depuis le contenu généré.
+ * @return : Le nombre d'octets lus, 0 en fin de fichier.
+ */
+static ssize_t reader_read(void* cookie, char* buffer, size_t size) {
+    VFileReader* reader = (VFileReader*) cookie;
+    if (size > reader->output->len - reader->offset) {
+        size = reader->output->len - reader->offset;
+    }
+    memcpy(buffer, reader->output->data + reader->offset, size);
+    reader->offset += size;
+    return (ssize_t) size;
+}
+
+
+
+
+/**
+ * Fonction : reader_close
+ * Description : Fonction de fermeture du flux (fopencookie) : rend la référence sur le contenu.
+ * @return : 0
+ */
+static int reader_close(void* cookie) {
+    VFileReader* reader = (VFileReader*) cookie;
+    output_release(reader->vf, reader->output);
+    free(reader);
+    return 0;
+}
+
+
+
+
+/**
+ * Fonction : vfile_open
+ * Description : Cette fonction ouvre en lecture un fichier virtuel.
+ * @param vf : Les fichiers virtuels.
+ * @param filename : Le nom normalisé du fichier.
+ * @param peer : L'adresse du client.
+ * @return : Le flux de lecture, ou NULL (errno = ENOENT si aucune règle ne correspond).
+ */
+FILE* vfile_open(VirtualFiles* vf, const char* filename, const struct sockaddr_in* peer) {
+    VFileOutput* output = vfile_get(vf, filename, peer);
+    if (output == NULL) {
+        return NULL;
+    }
+    VFileReader* reader = (VFileReader*) calloc(1, sizeof(VFileReader));
+    if (reader == NULL) {
+        output_release(vf, output);
+        return NULL;
+    }
+    reader->vf = vf;
+    reader->output = output;
+    count_request(vf, output);
+
+    cookie_io_functions_t functions = { reader_read, NULL, NULL, reader_close };
+    FILE* file = fopencookie(reader, "rb", functions);
+    if (file == NULL) {
+        output_release(vf, output);
+        free(reader);
+        errno = ENOMEM;
+    }
+    return file;
+}
+
+
+
+
+/**
+ * Fonction : vfile_read_small
+ * Description : Cette fonction copie le contenu d'un petit fichier virtuel (chemin rapide).
+ * @param vf : Les fichiers virtuels.
+ * @param filename : Le nom normalisé du fichier.
+ * @param peer : L'adresse du client.
+ * @param data : Le tampon qui reçoit le contenu.
+ * @param max : La taille du tampon : les contenus de max octets ou plus ne sont pas copiés.
+ * @return : La taille du contenu, -1 si le fichier n'est pas virtuel ou s'il est trop gros.
+ */
+int vfile_read_small(VirtualFiles* vf, const char* filename, const struct sockaddr_in* peer, char* data, size_t max) {
+    VFileOutput* output = vfile_get(vf, filename, peer);
+    if (output == NULL) {
+        return -1;
+    }
+    int len = -1;
+    if (output->len < max) {
+        memcpy(data, output->data, output->len);
+        len = (int) output->len;
+        count_request(vf, output);
+    }
+    output_release(vf, output);
+    return len;
+}
+
+
+
+
+/**
+ * Fonction : vfile_report
+ * Description : Cette fonction affiche l'état des fichiers virtuels.
+ * @param vf : Les fichiers virtuels.
+ * @param out : Le flux de sortie.
+ * @return : Aucune valeur de retour
+ */
+void vfile_report(VirtualFiles* vf, FILE* out) {
+    if (vf->rule_count == 0) {
+        return;
+    }
+    pthread_mutex_lock(&vf->mutex);
+    fprintf(out, "[VFILE] règles %d | servis %lu (%.1f Ko) | cache %lu | générés %lu\n",
+            vf->rule_count, vf->requests, vf->bytes / 1024.0, vf->hits, vf->renders);
+    pthread_mutex_unlock(&vf->mutex);
+}
@@ -0,0 +1,133 @@
+/**
+ * @file vfile.h
+ * @brief Fichiers virtuels : les RRQ dont le nom correspond au motif d'une règle sont servis par un contenu généré
+ *        en mémoire à partir d'un modèle (ex. pxelinux.cfg/01-* : une configuration par adresse MAC, sans fichier
+ *        sur le disque). Les modèles sont analysés une seule fois au démarrage ; les contenus générés sont conservés
+ *        dans un cache, tant que leurs entrées (nom demandé et, si le modèle l'utilise, adresse du client) sont les mêmes.
+ *
+ *        Fichier des règles : une règle par ligne, « motif modèle » (# : commentaire). Le motif est un chemin
+ *        normalisé où « * » remplace une suite de caractères sans « / » et « ? » un caractère ; le modèle est
+ *        un fichier, relatif à la racine de service s'il n'est pas absolu. La première règle qui correspond est utilisée.
+ *
+ *        Variables des modèles : ${1} à ${9} (parties du nom correspondant aux « * » et « ? » du motif), ${filename},
+ *        ${basename}, ${ip}, ${ip_hex} (ex. C0A80001, noms de pxelinux), ${port} ; « $$ » produit « $ ».
+ */
+
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <netinet/in.h>
+
+#ifndef VFILE_H
+#define VFILE_H
+
+#define VFILE_MAX_CAPTURES 9
+#define VFILE_MAX_OUTPUT (1024 * 1024)  /* Taille maximale d'un contenu généré */
+#define VFILE_CACHE_SIZE 1024           /* Contenus générés conservés */
+#define VFILE_BUCKETS 1024              /* Nombre d'alvéoles de la table de hachage (puissance de 2) */
+#define VFILE_MAX_KEY 544               /* Règle, nom demandé et adresse du client */
+
+
+/**
+ * @enum VFileSegmentKind
+ * @brief Élément d'un modèle compilé.
+ */
+typedef enum {
+    VFILE_LITERAL = 0,
+    VFILE_CAPTURE,
+    VFILE_FILENAME,
+    VFILE_BASENAME,
+    VFILE_IP,
+    VFILE_IP_HEX,
+    VFILE_PORT
+} VFileSegmentKind;
+
+
+
+
+/**
+ * @struct VFileSegment
+ * @brief Texte du modèle recopié tel quel (position et longueur dans le texte) ou variable.
+ */
+typedef struct VFileSegment {
+    VFileSegmentKind kind;
+    uint32_t offset;                /* VFILE_LITERAL : position dans le texte du modèle */
+    uint32_t len;                   /* VFILE_LITERAL : longueur ; VFILE_CAPTURE : numéro de la partie (0 à 8) */
+} VFileSegment;
+
+
+
+
+/**
+ * @struct VFileRule
+ * @brief Règle : motif et modèle compilé.
+ */
+typedef struct VFileRule {
+    char* pattern;
+    char* template_name;
+    char* text;                     /* Texte du modèle */
+    VFileSegment* segments;
+    int segment_count;
+    bool per_client;                /* Le modèle utilise l'adresse du client (clé du cache) */
+    bool cacheable;                 /* Faux si le modèle utilise ${port} (différent à chaque requête) */
+} VFileRule;
+
+
+
+
+/**
+ * @struct VFileOutput
+ * @brief Contenu généré, partagé par le cache et les flux ouverts ; libéré par son dernier utilisateur.
+ */
+typedef struct VFileOutput {
+    int refs;                       /* Protégé par le mutex de VirtualFiles */
+    size_t len;
+    char data[];
+} VFileOutput;
+
+
+
+
+/**
+ * @struct VFileCacheEntry
+ * @brief Contenu généré en cache.
+ */
+typedef struct VFileCacheEntry {
+    char key[VFILE_MAX_KEY];
+    VFileOutput* output;
+    int next;                       /* Entrée suivante dans l'alvéole (-1 = fin) */
+    bool used;
+} VFileCacheEntry;
+
+
+
+
+/**
+ * @struct VirtualFiles
+ * @brief Règles et cache des contenus générés.
+ */
+typedef struct VirtualFiles {
+    VFileRule* rules;
+    int rule_count;                 /* 0 = désactivé */
+    VFileCacheEntry* entries;
+    int buckets[VFILE_BUCKETS];
+    int next_slot;                  /* Prochaine entrée à remplacer (FIFO) */
+    pthread_mutex_t mutex;
+
+    unsigned long requests;         /* Fichiers virtuels servis */
+    unsigned long hits;             /* Servis depuis le cache */
+    unsigned long renders;          /* Contenus générés */
+    unsigned long long bytes;
+} VirtualFiles;
+
+
+
+int vfile_init(VirtualFiles* vf, const char* rules_file);
+bool vfile_match(VirtualFiles* vf, const char* filename);
+FILE* vfile_open(VirtualFiles* vf, const char* filename, const struct sockaddr_in* peer);
+int vfile_read_small(VirtualFiles* vf, const char* filename, const struct sockaddr_in* peer, char* data, size_t max);
+void vfile_report(VirtualFiles* vf, FILE* out);
+
+#endif